@@ -106,9 +106,10 @@ void Animation::ReadNodeHierarchy(float animTime, const aiNode * node, const aiM
 
 	aiMatrix4x4 globalTransform = parentTransform * nodeTransform;
 
-	if (boneMapping.find(nodeName) != boneMapping.end())
+	std::map<std::string, uint32_t>::iterator bone = boneMapping.find(nodeName);
+	if (bone != boneMapping.end())
 	{
-		uint32_t boneIndex = boneMapping[nodeName];
+		uint32_t boneIndex = bone->second;
 		boneTransforms[boneIndex] = globalInverseTransform * globalTransform * boneOffsets[boneIndex];
 	}
 	
@@ -1,54 +1,95 @@
+#include <algorithm>
+
 #include "BufferManager.h"
+#include "ResidencyManager.h"
+#include "LogManager.h"
 #include "StdInc.h"
 
+extern LogManager * gLogManager;
+extern ResidencyManager * gResidencyManager;
+
 VulkanBuffer * BufferManager::RequestBuffer(std::string bufferName, VulkanDevice * device, VkBufferUsageFlags usage, const void * dataPtr,
-	VkDeviceSize dataSize, bool useStaging, VulkanCommandBuffer * cmdBuffer)
+	VkDeviceSize dataSize, bool useStaging, bool evictable, bool persistentData)
 {
-	// Check if buffer is already loaded
-	for (unsigned int i = 0; i < buffersLoaded.size(); i++)
-	{
-		if (bufferName == buffersLoaded[i].bufferName)
-		{
-			buffersLoaded[i].useCount++;
-			return buffersLoaded[i].bufferPtr;
-		}
-	}
-
 	// If buffer is not loaded, create new entry
-	VulkanBuffer * buffer = new VulkanBuffer();
-	if (!buffer->Init(device, usage, dataPtr, dataSize, useStaging, cmdBuffer))
-		return nullptr;
+	return buffersLoaded.Request(bufferName, [=]() -> VulkanBuffer*
+	{
+		VulkanBuffer * buffer = new VulkanBuffer();
+		if (!buffer->Init(device, usage, dataPtr, dataSize, useStaging, evictable, persistentData))
+			return nullptr;
 
-	BufferEntry entry;
-	entry.bufferName = bufferName;
-	entry.bufferPtr = buffer;
-	entry.useCount = 1;
-	buffersLoaded.push_back(entry);
+		buffer->SetLastUsedFrame(gResidencyManager->GetFrame());
 
-	return buffer;
+		return buffer;
+	});
 }
 
 void BufferManager::ReleaseBuffer(VulkanBuffer * buffer, VulkanDevice * device)
 {
-	for (unsigned int i = 0; i < buffersLoaded.size(); i++)
+	// Frames in flight may still draw with it, it's destroyed once their fences signaled
+	if (buffer == nullptr || buffersLoaded.Get(buffer->GetHandle()) != buffer)
+		return;
+
+	buffersLoaded.Release(buffer->GetHandle(), gResidencyManager->GetFrame() + MAX_FRAMES_IN_FLIGHT);
+}
+
+void BufferManager::DestroyReleasedBuffers(VulkanDevice * device, std::vector<VkBuffer> & destroyedBuffers, bool all)
+{
+	buffersLoaded.DestroyReleased(gResidencyManager->GetFrame(), all, [device, &destroyedBuffers](VulkanBuffer * buffer)
+	{
+		if (buffer->IsResident())
+			destroyedBuffers.push_back(*buffer->GetBuffer());
+		SAFE_UNLOAD(buffer, device);
+	});
+}
+
+bool BufferManager::MakeResident(VulkanBuffer * buffer, VulkanDevice * device)
+{
+	// Reloaded from the backing copy, the upload is submitted ahead of the frame that draws with it
+	if (!buffer->IsResident())
 	{
-		if (buffer == buffersLoaded[i].bufferPtr)
+		if (!buffer->Restore(device))
 		{
-			if (buffersLoaded[i].useCount > 1)
-				buffersLoaded[i].useCount--;
-			else
-			{
-				SAFE_UNLOAD(buffersLoaded[i].bufferPtr, device);
-				buffersLoaded.erase(buffersLoaded.begin() + i);
-			}
-
-			buffer = nullptr;
-			break;
+			gLogManager->AddMessage("ERROR: Failed to reload an evicted buffer!");
+			return false;
 		}
+
+		gResidencyManager->ReportReload(RESIDENCY_RESOURCE_BUFFER, buffer->GetMemorySize());
 	}
+
+	buffer->SetLastUsedFrame(gResidencyManager->GetFrame());
+
+	return true;
+}
+
+VkDeviceSize BufferManager::EvictBuffers(VulkanDevice * device, VkDeviceSize bytes)
+{
+	uint64_t frame = gResidencyManager->GetFrame();
+
+	// Least recently used first, only buffers no frame in flight can be reading
+	std::vector<VulkanBuffer*> candidates;
+	buffersLoaded.ForEach([&candidates, frame](VulkanBuffer * buffer)
+	{
+		if (buffer->IsEvictable() && buffer->IsResident() && buffer->GetLastUsedFrame() + RESIDENCY_MIN_IDLE_FRAMES <= frame)
+			candidates.push_back(buffer);
+	});
+
+	std::sort(candidates.begin(), candidates.end(), [](VulkanBuffer * a, VulkanBuffer * b) { return a->GetLastUsedFrame() < b->GetLastUsedFrame(); });
+
+	VkDeviceSize freed = 0;
+	for (unsigned int i = 0; i < candidates.size() && freed < bytes; i++)
+	{
+		VkDeviceSize size = candidates[i]->GetMemorySize();
+		candidates[i]->Evict(device);
+
+		gResidencyManager->ReportEviction(RESIDENCY_RESOURCE_BUFFER, size);
+		freed += size;
+	}
+
+	return freed;
 }
 
 size_t BufferManager::GetLoadedBuffersCount()
 {
-	return buffersLoaded.size();
+	return buffersLoaded.GetCount();
 }
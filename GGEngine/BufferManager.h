@@ -3,20 +3,18 @@
 #include <vector>
 #include <string>
 #include "VulkanBuffer.h"
+#include "ResourceRegistry.h"
 
 class BufferManager
 {
 	private:
-		struct BufferEntry
-		{
-			std::string bufferName;
-			VulkanBuffer * bufferPtr;
-			unsigned int useCount;
-		};
-		std::vector<BufferEntry> buffersLoaded;
+		ResourceRegistry<VulkanBuffer> buffersLoaded;
 	public:
 		VulkanBuffer * RequestBuffer(std::string bufferName, VulkanDevice * device, VkBufferUsageFlags usage, const void * dataPtr,
-			VkDeviceSize dataSize, bool useStaging, VulkanCommandBuffer * cmdBuffer = 0);
+			VkDeviceSize dataSize, bool useStaging, bool evictable = false, bool persistentData = false);
 		void ReleaseBuffer(VulkanBuffer * buffer, VulkanDevice * device);
+		void DestroyReleasedBuffers(VulkanDevice * device, std::vector<VkBuffer> & destroyedBuffers, bool all = false);
+		bool MakeResident(VulkanBuffer * buffer, VulkanDevice * device);
+		VkDeviceSize EvictBuffers(VulkanDevice * device, VkDeviceSize bytes);
 		size_t GetLoadedBuffersCount();
 };
\ No newline at end of file
@@ -1,13 +1,15 @@
 #include "Canvas.h"
 #include "StdInc.h"
 #include "Settings.h"
+#include "LogManager.h"
 
 extern Settings * gSettings;
+extern LogManager * gLogManager;
 
 Canvas::Canvas()
 {
-	vertexBuffer = NULL;
-	vsUBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		vertexBuffer[i] = NULL;
 
 	posX = posY = 0.0f;
 	width = height = 0.25f;
@@ -17,8 +19,8 @@ Canvas::~Canvas()
 {
 	delete[] vertexData;
 
-	vsUBO = NULL;
-	vertexBuffer = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		vertexBuffer[i] = NULL;
 }
 
 bool Canvas::Init(VulkanInterface * vulkan)
@@ -30,22 +32,18 @@ bool Canvas::Init(VulkanInterface * vulkan)
 	vertexData = new Vertex[vertexCount];
 	UpdateVertexData();
 
-	// Vertex buffer
-	vertexBuffer = new VulkanBuffer();
-	if (!vertexBuffer->Init(vulkanDevice, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData, sizeof(Vertex) * vertexCount, false))
-		return false;
-
-	// Uniform inits
-	vertexUniformBuffer.MVP = glm::mat4();
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		// Vertex buffer
+		vertexBuffer[i] = new VulkanBuffer();
+		if (!vertexBuffer[i]->Init(vulkanDevice, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData, sizeof(Vertex) * vertexCount, false))
+			return false;
 
-	// Vertex shader Uniform buffer
-	vsUBO = new VulkanBuffer();
-	if (!vsUBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer,
-		sizeof(vertexUniformBuffer), false))
-		return false;
+		updateVertexBuffer[i] = false;
+	}
 
 	// Init draw command buffers
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
 		if (!cmdBuffer->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), false))
@@ -54,55 +52,59 @@ bool Canvas::Init(VulkanInterface * vulkan)
 		drawCmdBuffers.push_back(cmdBuffer);
 	}
 
-	updateVertexBuffer = false;
 	return true;
 }
 
 void Canvas::Unload(VulkanInterface * vulkan)
 {
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < drawCmdBuffers.size(); i++)
 		SAFE_UNLOAD(drawCmdBuffers[i], vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
 
-	SAFE_UNLOAD(vsUBO, vulkan->GetVulkanDevice());
-	SAFE_UNLOAD(vertexBuffer, vulkan->GetVulkanDevice());
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		SAFE_UNLOAD(vertexBuffer[i], vulkan->GetVulkanDevice());
 }
 
 void Canvas::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * vulkanPipeline,
 	glm::mat4 orthoMatrix, VkImageView * imageView, int frameBufferId)
 {
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	VulkanCommandBuffer * drawCmdBuffer = drawCmdBuffers[frameIndex];
+
 	// Update vertex buffer if needed
-	if (updateVertexBuffer)
+	if (updateVertexBuffer[frameIndex])
 	{
 		UpdateVertexData();
-		vertexBuffer->Update(vulkan->GetVulkanDevice(), vertexData, sizeof(Vertex) * vertexCount);
-		updateVertexBuffer = false;
+		vertexBuffer[frameIndex]->Update(vulkan->GetVulkanDevice(), vertexData, sizeof(Vertex) * vertexCount);
+		updateVertexBuffer[frameIndex] = false;
 	}
 
-	UpdateDescriptorSet(vulkan, vulkanPipeline, imageView);
+	// Canvases share the pipeline, so each texture gets its own cached set
+	VkDescriptorSet descriptorSet = GetDescriptorSet(vulkan, vulkanPipeline, imageView);
 
 	// Update vertex uniform buffer
 	vertexUniformBuffer.MVP = orthoMatrix;
 
-	vsUBO->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(vertexUniformBuffer));
+	uint32_t vsOffset = vulkan->GetUniformRing()->Allocate(&vertexUniformBuffer, sizeof(vertexUniformBuffer));
 
 	// Draw
-	drawCmdBuffers[frameBufferId]->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer((int)frameBufferId));
-	vulkan->InitViewportAndScissors(drawCmdBuffers[frameBufferId], (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
+	drawCmdBuffer->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer((int)frameBufferId));
+	vulkan->InitViewportAndScissors(drawCmdBuffer, (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
 		(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
-	vulkanPipeline->SetActive(drawCmdBuffers[frameBufferId]);
+	vulkanPipeline->SetActive(drawCmdBuffer, descriptorSet, 1, &vsOffset);
 
 	VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindVertexBuffers(drawCmdBuffers[frameBufferId]->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
+	vkCmdBindVertexBuffers(drawCmdBuffer->GetCommandBuffer(), 0, 1, vertexBuffer[frameIndex]->GetBuffer(), offsets);
 
-	vkCmdDraw(drawCmdBuffers[frameBufferId]->GetCommandBuffer(), vertexCount, 1, 0, 0);
-	drawCmdBuffers[frameBufferId]->EndRecording();
-	drawCmdBuffers[frameBufferId]->ExecuteSecondary(commandBuffer);
+	vkCmdDraw(drawCmdBuffer->GetCommandBuffer(), vertexCount, 1, 0, 0);
+	drawCmdBuffer->EndRecording();
+	drawCmdBuffer->ExecuteSecondary(commandBuffer);
 }
 
 void Canvas::SetPosition(float x, float y)
 {
 	if (posX != x || posY != y)
-		updateVertexBuffer = true;
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			updateVertexBuffer[i] = true;
 
 	posX = x;
 	posY = y;
@@ -120,7 +122,8 @@ float Canvas::GetPositionY()
 void Canvas::SetDimensions(float width, float height)
 {
 	if (this->width != width || this->height != height)
-		updateVertexBuffer = true;
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			updateVertexBuffer[i] = true;
 
 	this->width = width;
 	this->height = height;
@@ -181,17 +184,18 @@ void Canvas::UpdateVertexData()
 	vertexData[5].v = 0.0f;
 }
 
-void Canvas::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline, VkImageView * imageView)
+VkDescriptorSet Canvas::GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline, VkImageView * imageView)
 {
 	VkWriteDescriptorSet write[2];
 
+	VkDescriptorBufferInfo vsBufferInfo = vulkan->GetUniformRing()->GetBufferInfo(sizeof(VertexUniformBuffer));
+
 	write[0] = {};
 	write[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	write[0].pNext = NULL;
-	write[0].dstSet = vulkanPipeline->GetDescriptorSet();
 	write[0].descriptorCount = 1;
-	write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	write[0].pBufferInfo = vsUBO->GetBufferInfo();
+	write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write[0].pBufferInfo = &vsBufferInfo;
 	write[0].dstArrayElement = 0;
 	write[0].dstBinding = 0;
 
@@ -203,13 +207,19 @@ void Canvas::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * vulk
 	write[1] = {};
 	write[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	write[1].pNext = NULL;
-	write[1].dstSet = vulkanPipeline->GetDescriptorSet();
 	write[1].descriptorCount = 1;
 	write[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	write[1].pImageInfo = &positionTextureDesc;
 	write[1].dstArrayElement = 0;
 	write[1].dstBinding = 1;
 
-	vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(write) / sizeof(write[0]), write, 0, NULL);
+	VkDescriptorSet descriptorSet;
+	if (!vulkanPipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), write, sizeof(write) / sizeof(write[0]), &descriptorSet))
+	{
+		gLogManager->AddMessage("ERROR: Failed to get a descriptor set for a canvas!");
+		THROW_ERROR();
+	}
+
+	return descriptorSet;
 }
 
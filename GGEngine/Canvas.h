@@ -19,17 +19,16 @@ class Canvas
 		};
 		VertexUniformBuffer vertexUniformBuffer;
 
-		VulkanBuffer * vsUBO;
-		VulkanBuffer * vertexBuffer;
+		VulkanBuffer * vertexBuffer[MAX_FRAMES_IN_FLIGHT];
 		Vertex * vertexData;
 
 		float posX, posY, width, height;
-		bool updateVertexBuffer;
+		bool updateVertexBuffer[MAX_FRAMES_IN_FLIGHT];
 
 		std::vector<VulkanCommandBuffer*> drawCmdBuffers;
 	private:
 		void UpdateVertexData();
-		void UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline, VkImageView * imageView);
+		VkDescriptorSet GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline, VkImageView * imageView);
 	public:
 		Canvas();
 		~Canvas();
@@ -0,0 +1,179 @@
+#include "CommandRecorder.h"
+#include "JobSystem.h"
+#include "LogManager.h"
+#include "StdInc.h"
+
+extern LogManager * gLogManager;
+extern JobSystem * gJobSystem;
+
+CommandRecorder::CommandRecorder()
+{
+	vulkanDevice = NULL;
+	activeThreadCount = 0;
+	frameIndex = 0;
+	nextTask = 0;
+}
+
+CommandRecorder::~CommandRecorder()
+{
+	vulkanDevice = NULL;
+}
+
+bool CommandRecorder::Init(VulkanInterface * vulkan, unsigned int threadCount)
+{
+	vulkanDevice = vulkan->GetVulkanDevice();
+
+	// Recording runs on the job system, one job per thread it has unless told otherwise
+	if (threadCount == 0)
+		threadCount = gJobSystem->GetThreadCount();
+	if (threadCount == 0)
+		threadCount = 1;
+	if (threadCount > MAX_RECORDING_THREADS)
+		threadCount = MAX_RECORDING_THREADS;
+
+	// Command pools can't be used from two threads at once, so every job gets its own for each frame in flight
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		RecordingThread * recordingThread = new RecordingThread();
+		recordingThread->usedCommandBuffers = 0;
+
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
+		{
+			recordingThread->commandPools[j] = new VulkanCommandPool();
+			if (!recordingThread->commandPools[j]->Init(vulkanDevice))
+			{
+				gLogManager->AddMessage("ERROR: Failed to create a command pool for a recording thread!");
+				return false;
+			}
+		}
+
+		threads.push_back(recordingThread);
+	}
+
+	activeThreadCount = threadCount;
+
+	char msg[64];
+	sprintf(msg, "Command recorder records with %u jobs", threadCount);
+	gLogManager->AddMessage(msg);
+
+	return true;
+}
+
+void CommandRecorder::Unload(VulkanInterface * vulkan)
+{
+	for (unsigned int i = 0; i < threads.size(); i++)
+	{
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
+		{
+			for (unsigned int k = 0; k < threads[i]->commandBuffers[j].size(); k++)
+				SAFE_UNLOAD(threads[i]->commandBuffers[j][k], vulkan->GetVulkanDevice(), threads[i]->commandPools[j]);
+
+			SAFE_UNLOAD(threads[i]->commandPools[j], vulkan->GetVulkanDevice());
+		}
+
+		SAFE_DELETE(threads[i]);
+	}
+	threads.clear();
+}
+
+void CommandRecorder::BeginFrame(VulkanInterface * vulkan)
+{
+	frameIndex = vulkan->GetFrameIndex();
+
+	// The frame fence has been waited on, so everything recorded for this slot can be reset at once
+	for (unsigned int i = 0; i < threads.size(); i++)
+	{
+		threads[i]->commandPools[frameIndex]->Reset(vulkanDevice);
+		threads[i]->usedCommandBuffers = 0;
+	}
+
+	tasks.clear();
+}
+
+void CommandRecorder::AddTask(RecordFunction record)
+{
+	RecordingTask task;
+	task.record = record;
+	tasks.push_back(task);
+}
+
+VulkanCommandBuffer * CommandRecorder::GetCommandBuffer(unsigned int threadId, unsigned int taskId)
+{
+	RecordingThread * recordingThread = threads[threadId];
+	std::vector<VulkanCommandBuffer*>& commandBuffers = recordingThread->commandBuffers[frameIndex];
+
+	// Reuse the buffers from the last time this slot was recorded, only allocate when the scene grew
+	if (recordingThread->usedCommandBuffers == commandBuffers.size())
+	{
+		VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
+		if (!cmdBuffer->Init(vulkanDevice, recordingThread->commandPools[frameIndex], false))
+		{
+			gLogManager->AddMessage("ERROR: Failed to create a secondary command buffer for a recording thread!");
+			THROW_ERROR();
+		}
+		commandBuffers.push_back(cmdBuffer);
+	}
+
+	VulkanCommandBuffer * cmdBuffer = commandBuffers[recordingThread->usedCommandBuffers++];
+	tasks[taskId].commandBuffers.push_back(cmdBuffer);
+
+	return cmdBuffer;
+}
+
+void CommandRecorder::AddCommandBuffer(unsigned int taskId, VulkanCommandBuffer * cmdBuffer)
+{
+	// Buffers recorded outside the recorder's pools, executed in task order like the rest
+	tasks[taskId].commandBuffers.push_back(cmdBuffer);
+}
+
+void CommandRecorder::Execute(VulkanCommandBuffer * primaryCmdBuffer)
+{
+	if (tasks.empty())
+		return;
+
+	// The waiting thread records too, it picks up the jobs no worker got to yet
+	nextTask = 0;
+
+	JobCounter counter;
+	for (unsigned int i = 0; i < activeThreadCount; i++)
+		gJobSystem->Run([this, i] { RecordTasks(i); }, &counter);
+	gJobSystem->Wait(&counter);
+
+	// Execute in the order the tasks were added, not the order they finished in
+	std::vector<VkCommandBuffer> secondaryCmdBuffers;
+	for (unsigned int i = 0; i < tasks.size(); i++)
+		for (unsigned int j = 0; j < tasks[i].commandBuffers.size(); j++)
+			secondaryCmdBuffers.push_back(tasks[i].commandBuffers[j]->GetCommandBuffer());
+
+	if (!secondaryCmdBuffers.empty())
+		vkCmdExecuteCommands(primaryCmdBuffer->GetCommandBuffer(), (uint32_t)secondaryCmdBuffers.size(), secondaryCmdBuffers.data());
+
+	tasks.clear();
+}
+
+void CommandRecorder::RecordTasks(unsigned int threadId)
+{
+	unsigned int taskId;
+	while ((taskId = nextTask++) < tasks.size())
+		tasks[taskId].record(this, threadId, taskId);
+}
+
+void CommandRecorder::SetActiveThreadCount(unsigned int count)
+{
+	if (count < 1)
+		count = 1;
+	if (count > threads.size())
+		count = (unsigned int)threads.size();
+
+	activeThreadCount = count;
+}
+
+unsigned int CommandRecorder::GetActiveThreadCount()
+{
+	return activeThreadCount;
+}
+
+unsigned int CommandRecorder::GetThreadCount()
+{
+	return (unsigned int)threads.size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "VulkanInterface.h"
+
+#define MAX_RECORDING_THREADS 16
+
+class CommandRecorder;
+
+// Records the secondary command buffers of one task, gets the recorder, thread id and task id
+typedef std::function<void(CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)> RecordFunction;
+
+class CommandRecorder
+{
+	private:
+		// Recording state of one job, the job system runs each of them on one worker at a time
+		struct RecordingThread
+		{
+			VulkanCommandPool * commandPools[MAX_FRAMES_IN_FLIGHT];
+			std::vector<VulkanCommandBuffer*> commandBuffers[MAX_FRAMES_IN_FLIGHT];
+			size_t usedCommandBuffers;
+		};
+
+		struct RecordingTask
+		{
+			RecordFunction record;
+			std::vector<VulkanCommandBuffer*> commandBuffers;
+		};
+
+		VulkanDevice * vulkanDevice;
+		std::vector<RecordingThread*> threads;
+		std::vector<RecordingTask> tasks;
+		unsigned int activeThreadCount;
+		uint32_t frameIndex;
+		std::atomic<unsigned int> nextTask;
+	private:
+		void RecordTasks(unsigned int threadId);
+	public:
+		CommandRecorder();
+		~CommandRecorder();
+
+		bool Init(VulkanInterface * vulkan, unsigned int threadCount);
+		void Unload(VulkanInterface * vulkan);
+		void BeginFrame(VulkanInterface * vulkan);
+		void AddTask(RecordFunction record);
+		VulkanCommandBuffer * GetCommandBuffer(unsigned int threadId, unsigned int taskId);
+		void AddCommandBuffer(unsigned int taskId, VulkanCommandBuffer * cmdBuffer);
+		void Execute(VulkanCommandBuffer * primaryCmdBuffer);
+		void SetActiveThreadCount(unsigned int count);
+		unsigned int GetActiveThreadCount();
+		unsigned int GetThreadCount();
+};
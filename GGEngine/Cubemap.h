@@ -2,29 +2,23 @@
 
 #include <string>
 
-#include "VulkanCommandBuffer.h"
+#include "Texture.h"
 
 class Cubemap
 {
 	private:
-		struct MipMap
-		{
-			unsigned char * data;
-			int width;
-			int height;
-			unsigned int size;
-		};
 		VkImage textureImage;
 		VkImageView textureImageView;
-		VkDeviceMemory textureMemory;
+		VulkanAllocation textureMemory;
+		VkFormat format;
 		uint32_t mipMapLevels;
 	private:
-		bool ReadCubeFace(std::string filename, std::vector<MipMap> & faceData);
+		bool ReadCubeFace(std::string filename, VirtualFile * file, std::vector<RctMipLevel> & faceLevels);
 	public:
 		Cubemap();
 		~Cubemap();
 
-		bool Init(VulkanDevice * device, VulkanCommandBuffer * cmdBuffer, std::string cubemapDir);
+		bool Init(VulkanDevice * device, std::string cubemapDir);
 		void Unload(VulkanDevice * vulkanDevice);
 		VkImageView * GetImageView();
 };
\ No newline at end of file
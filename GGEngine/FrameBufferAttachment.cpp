@@ -4,14 +4,12 @@
 FrameBufferAttachment::FrameBufferAttachment()
 {
 	image = VK_NULL_HANDLE;
-	memory = VK_NULL_HANDLE;
 	view = VK_NULL_HANDLE;
 }
 
 FrameBufferAttachment::~FrameBufferAttachment()
 {
 	view = VK_NULL_HANDLE;
-	memory = VK_NULL_HANDLE;
 	image = VK_NULL_HANDLE;
 }
 
@@ -51,25 +49,11 @@ bool FrameBufferAttachment::Create(VulkanDevice * device, VkFormat format, VkIma
 	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageCI.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-	VkMemoryAllocateInfo memAlloc{};
-	VkMemoryRequirements memReq;
-
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	result = vkCreateImage(device->GetDevice(), &imageCI, VK_NULL_HANDLE, &image);
 	if (result != VK_SUCCESS)
 		return false;
 
-	vkGetImageMemoryRequirements(device->GetDevice(), image, &memReq);
-	memAlloc.allocationSize = memReq.size;
-	if (!device->MemoryTypeFromProperties(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAlloc.memoryTypeIndex))
-		return false;
-
-	result = vkAllocateMemory(device->GetDevice(), &memAlloc, VK_NULL_HANDLE, &memory);
-	if (result != VK_SUCCESS)
-		return false;
-
-	result = vkBindImageMemory(device->GetDevice(), image, memory, 0);
-	if (result != VK_SUCCESS)
+	if (!device->GetMemoryAllocator()->AllocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory))
 		return false;
 
 	if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
@@ -99,7 +83,7 @@ bool FrameBufferAttachment::Create(VulkanDevice * device, VkFormat format, VkIma
 void FrameBufferAttachment::Unload(VulkanDevice * device)
 {
 	vkDestroyImageView(device->GetDevice(), view, VK_NULL_HANDLE);
-	vkFreeMemory(device->GetDevice(), memory, VK_NULL_HANDLE);
+	device->GetMemoryAllocator()->Free(&memory);
 	vkDestroyImage(device->GetDevice(), image, VK_NULL_HANDLE);
 }
 
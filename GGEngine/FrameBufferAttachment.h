@@ -7,7 +7,7 @@ class FrameBufferAttachment
 {
 	private:
 		VkImage image;
-		VkDeviceMemory memory;
+		VulkanAllocation memory;
 		VkImageView view;
 		VkFormat format;
 	public:
@@ -0,0 +1,127 @@
+#include "GPUTimer.h"
+#include "LogManager.h"
+#include "StdInc.h"
+
+extern LogManager * gLogManager;
+
+GPUTimer::GPUTimer()
+{
+	queryPool = VK_NULL_HANDLE;
+	timestampPeriod = 0.0f;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		frameWritten[i] = false;
+	frameIndex = 0;
+	captureFrames = 0;
+	capturedFrames = 0;
+	shadowTime = 0.0;
+	deferredTime = 0.0;
+}
+
+GPUTimer::~GPUTimer()
+{
+	queryPool = VK_NULL_HANDLE;
+}
+
+bool GPUTimer::Init(VulkanDevice * vulkanDevice)
+{
+	// Without timestamps on the graphics queue the timer stays off, the frame doesn't depend on it
+	VkPhysicalDeviceLimits limits = vulkanDevice->GetGPUProperties().limits;
+	if (!limits.timestampComputeAndGraphics)
+	{
+		gLogManager->AddMessage("WARNING: GPU doesn't support timestamps, GPU timings are off!");
+		return true;
+	}
+
+	timestampPeriod = limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolCI{};
+	queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCI.queryCount = GPU_TIMESTAMP_COUNT * MAX_FRAMES_IN_FLIGHT;
+	if (vkCreateQueryPool(vulkanDevice->GetDevice(), &queryPoolCI, VK_NULL_HANDLE, &queryPool) != VK_SUCCESS)
+		return false;
+
+	return true;
+}
+
+void GPUTimer::Unload(VulkanDevice * vulkanDevice)
+{
+	if (queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(vulkanDevice->GetDevice(), queryPool, VK_NULL_HANDLE);
+}
+
+void GPUTimer::ReadFrame(VulkanDevice * vulkanDevice)
+{
+	uint64_t timestamps[GPU_TIMESTAMP_COUNT];
+	VkResult result = vkGetQueryPoolResults(vulkanDevice->GetDevice(), queryPool, frameIndex * GPU_TIMESTAMP_COUNT, GPU_TIMESTAMP_COUNT,
+		sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return;
+
+	// Ticks to milliseconds
+	double period = timestampPeriod / 1000000.0;
+	shadowTime += (timestamps[GPU_TIMESTAMP_SHADOW_END] - timestamps[GPU_TIMESTAMP_FRAME_START]) * period;
+	deferredTime += (timestamps[GPU_TIMESTAMP_DEFERRED_END] - timestamps[GPU_TIMESTAMP_SHADOW_END]) * period;
+	capturedFrames++;
+
+	if (capturedFrames < captureFrames)
+		return;
+
+	char msg[128];
+	sprintf(msg, "GPU BENCHMARK: FRAMES: %u SHADOW: %f ms DEFERRED: %f ms", capturedFrames, shadowTime / capturedFrames,
+		deferredTime / capturedFrames);
+	gLogManager->AddMessage(msg);
+
+	captureFrames = 0;
+}
+
+void GPUTimer::BeginFrame(VulkanDevice * vulkanDevice, VulkanCommandBuffer * commandBuffer, uint32_t frameIndex)
+{
+	if (queryPool == VK_NULL_HANDLE)
+		return;
+
+	// The slot's fence has been waited on, what the last frame in it wrote is available
+	this->frameIndex = frameIndex;
+	if (frameWritten[frameIndex] && IsCapturing())
+		ReadFrame(vulkanDevice);
+
+	// Only frames that write every timestamp are read back
+	frameWritten[frameIndex] = false;
+	vkCmdResetQueryPool(commandBuffer->GetCommandBuffer(), queryPool, frameIndex * GPU_TIMESTAMP_COUNT, GPU_TIMESTAMP_COUNT);
+}
+
+void GPUTimer::WriteTimestamp(VulkanCommandBuffer * commandBuffer, GPU_TIMESTAMP timestamp)
+{
+	if (queryPool == VK_NULL_HANDLE)
+		return;
+
+	// Start of the frame once the commands before it began, the others once everything before them is done
+	VkPipelineStageFlagBits stage = (timestamp == GPU_TIMESTAMP_FRAME_START ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	vkCmdWriteTimestamp(commandBuffer->GetCommandBuffer(), stage, queryPool, frameIndex * GPU_TIMESTAMP_COUNT + timestamp);
+
+	if (timestamp == GPU_TIMESTAMP_COUNT - 1)
+		frameWritten[frameIndex] = true;
+}
+
+void GPUTimer::StartCapture(uint32_t frameCount)
+{
+	if (queryPool == VK_NULL_HANDLE)
+	{
+		gLogManager->AddMessage("GPU BENCHMARK: GPU doesn't support timestamps!");
+		return;
+	}
+
+	// Frames recorded before the capture started are skipped
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		frameWritten[i] = false;
+
+	captureFrames = frameCount;
+	capturedFrames = 0;
+	shadowTime = 0.0;
+	deferredTime = 0.0;
+}
+
+bool GPUTimer::IsCapturing()
+{
+	return capturedFrames < captureFrames;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "VulkanDevice.h"
+#include "VulkanCommandBuffer.h"
+#include "VulkanInterface.h"
+
+// Points of the frame the GPU timer writes a timestamp at
+enum GPU_TIMESTAMP
+{
+	GPU_TIMESTAMP_FRAME_START,
+	GPU_TIMESTAMP_SHADOW_END,
+	GPU_TIMESTAMP_DEFERRED_END,
+	GPU_TIMESTAMP_COUNT
+};
+
+// Timestamps of the shadow and deferred passes, one query range per frame slot read back once its fence was waited on.
+// A capture averages them over a number of frames and logs the result
+class GPUTimer
+{
+	private:
+		VkQueryPool queryPool;
+		float timestampPeriod;
+		bool frameWritten[MAX_FRAMES_IN_FLIGHT];
+		uint32_t frameIndex;
+		uint32_t captureFrames;
+		uint32_t capturedFrames;
+		double shadowTime;
+		double deferredTime;
+	private:
+		void ReadFrame(VulkanDevice * vulkanDevice);
+	public:
+		GPUTimer();
+		~GPUTimer();
+
+		bool Init(VulkanDevice * vulkanDevice);
+		void Unload(VulkanDevice * vulkanDevice);
+		void BeginFrame(VulkanDevice * vulkanDevice, VulkanCommandBuffer * commandBuffer, uint32_t frameIndex);
+		void WriteTimestamp(VulkanCommandBuffer * commandBuffer, GPU_TIMESTAMP timestamp);
+		void StartCapture(uint32_t frameCount);
+		bool IsCapturing();
+};
@@ -17,7 +17,7 @@ void GUIElement::copy(const GUIElement &source, VulkanInterface* vulkan, VulkanC
 {
 	this->name = source.name;
 	name.append(".rct");
-	this->texture = gTextureManager->RequestTexture((baseItemsDir + this->name), vulkan->GetVulkanDevice(), cmdBuffer);
+	this->texture = gTextureManager->RequestTexture((baseItemsDir + this->name), vulkan->GetVulkanDevice());
 	this->canvas = new Canvas();
 	if (!canvas->Init(vulkan))
 		gLogManager->AddMessage("ERROR: Failed to init canvas!");
@@ -25,7 +25,7 @@ void GUIElement::copy(const GUIElement &source, VulkanInterface* vulkan, VulkanC
 
 bool GUIElement::Init(VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer, std::string filename)
 {
-	texture = gTextureManager->RequestTexture(filename, vulkan->GetVulkanDevice(), cmdBuffer);
+	texture = gTextureManager->RequestTexture(filename, vulkan->GetVulkanDevice());
 	if (texture == nullptr)
 		return false;
 
@@ -0,0 +1,74 @@
+#include "InstanceRenderer.h"
+
+InstanceRenderer::InstanceRenderer()
+{
+	batchCount = 0;
+	drawCount = 0;
+	drawnInstanceCount = 0;
+}
+
+void InstanceRenderer::AddInstance(Model * model, Camera * camera, ShadowMaps * shadowMaps)
+{
+	ModelAsset * asset = model->GetAsset();
+
+	// Copies at different levels of detail draw different index ranges, so they go into batches of their own
+	ModelInstanceData instanceData;
+	unsigned int lod = model->PrepareInstance(camera, shadowMaps, &instanceData);
+
+	auto it = batchIndices[lod].find(asset);
+	if (it == batchIndices[lod].end())
+	{
+		if (batchCount == batches.size())
+			batches.push_back(InstanceBatch());
+
+		// The first copy added stands in for the whole batch when it's recorded
+		batches[batchCount].model = model;
+		batches[batchCount].lod = lod;
+		it = batchIndices[lod].insert(std::make_pair(asset, batchCount)).first;
+		batchCount++;
+	}
+
+	batches[it->second].instances.push_back(instanceData);
+}
+
+void InstanceRenderer::Render(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
+	Camera * camera, ShadowMaps * shadowMaps)
+{
+	UniformRing * uniformRing = vulkan->GetUniformRing();
+
+	for (unsigned int i = 0; i < batchCount; i++)
+	{
+		InstanceBatch & batch = batches[i];
+		uint32_t instanceCount = (uint32_t)batch.instances.size();
+
+		// Instance data goes to the frame's uniform ring too, the draws read it as vertex binding 1
+		uint32_t instanceOffset = uniformRing->Allocate(batch.instances.data(), sizeof(ModelInstanceData) * instanceCount);
+		batch.model->RenderInstanced(vulkan, recorder, vulkanPipeline, camera, shadowMaps, instanceOffset, instanceCount, batch.lod);
+
+		drawCount += batch.model->GetMeshCount();
+		drawnInstanceCount += instanceCount;
+
+		batch.instances.clear();
+		batch.model = NULL;
+	}
+
+	for (int i = 0; i < MESH_MAX_LODS; i++)
+		batchIndices[i].clear();
+	batchCount = 0;
+}
+
+void InstanceRenderer::ResetStatistics()
+{
+	drawCount = 0;
+	drawnInstanceCount = 0;
+}
+
+unsigned int InstanceRenderer::GetDrawCount()
+{
+	return drawCount;
+}
+
+unsigned int InstanceRenderer::GetDrawnInstanceCount()
+{
+	return drawnInstanceCount;
+}
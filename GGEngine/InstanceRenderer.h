@@ -0,0 +1,34 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "Model.h"
+
+// Gathers the visible copies of each model asset, every mesh is then drawn once per asset and level of detail with all of them as instances
+class InstanceRenderer
+{
+	private:
+		struct InstanceBatch
+		{
+			Model * model;
+			unsigned int lod;
+			std::vector<ModelInstanceData> instances;
+		};
+
+		// Batches keep their storage from frame to frame, only the first batchCount are in use
+		std::vector<InstanceBatch> batches;
+		std::unordered_map<ModelAsset*, unsigned int> batchIndices[MESH_MAX_LODS];
+		unsigned int batchCount;
+
+		unsigned int drawCount;
+		unsigned int drawnInstanceCount;
+	public:
+		InstanceRenderer();
+
+		void AddInstance(Model * model, Camera * camera, ShadowMaps * shadowMaps);
+		void Render(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
+			Camera * camera, ShadowMaps * shadowMaps);
+		void ResetStatistics();
+		unsigned int GetDrawCount();
+		unsigned int GetDrawnInstanceCount();
+};
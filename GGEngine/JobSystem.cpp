@@ -0,0 +1,232 @@
+#include <math.h>
+
+#include "JobSystem.h"
+#include "LogManager.h"
+#include "Timer.h"
+#include "StdInc.h"
+
+extern LogManager * gLogManager;
+extern Timer * gTimer;
+
+// Queue of the current thread, threads that aren't workers share the main thread's queue
+static thread_local unsigned int threadQueueId = 0;
+
+JobSystem::JobSystem()
+{
+	pendingJobs = 0;
+	running = false;
+}
+
+JobSystem::~JobSystem()
+{
+}
+
+bool JobSystem::Init(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	// The main thread works too while it waits, so it gets queue 0 and one thread less is started
+	for (unsigned int i = 0; i < threadCount; i++)
+		queues.push_back(new WorkerQueue());
+
+	threadQueueId = 0;
+	running = true;
+
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+
+	char msg[64];
+	sprintf(msg, "Job system started with %u threads", threadCount);
+	gLogManager->AddMessage(msg);
+
+	return true;
+}
+
+void JobSystem::Unload()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	jobAvailable.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+
+	for (unsigned int i = 0; i < queues.size(); i++)
+		SAFE_DELETE(queues[i]);
+	queues.clear();
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter * counter)
+{
+	Job job;
+	job.function = function;
+	job.counter = counter;
+
+	if (counter)
+		counter->count++;
+
+	WorkerQueue * queue = queues[GetQueueId()];
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->jobs.push_back(job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		pendingJobs++;
+	}
+	jobAvailable.notify_one();
+}
+
+void JobSystem::Wait(JobCounter * counter)
+{
+	unsigned int queueId = GetQueueId();
+
+	// Help out instead of blocking, the jobs we wait for may still be sitting in our own queue
+	while (counter->count > 0)
+		if (!RunPendingJob(queueId))
+			std::this_thread::yield();
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int batchSize, std::function<void(unsigned int start, unsigned int end)> function)
+{
+	if (batchSize == 0)
+		batchSize = 1;
+
+	if (count <= batchSize || queues.size() == 1)
+	{
+		function(0, count);
+		return;
+	}
+
+	JobCounter counter;
+	for (unsigned int start = 0; start < count; start += batchSize)
+	{
+		unsigned int end = (start + batchSize < count ? start + batchSize : count);
+		Run([&function, start, end] { function(start, end); }, &counter);
+	}
+
+	Wait(&counter);
+}
+
+void JobSystem::RunBenchmark()
+{
+	const unsigned int jobCount = 10000;
+	const unsigned int workSize = 1 << 22;
+	char msg[128];
+
+	// Scheduling overhead: empty jobs, so only the cost of queueing, stealing and joining is measured
+	JobCounter counter;
+	gTimer->BenchmarkCodeStart();
+	for (unsigned int i = 0; i < jobCount; i++)
+		Run([] {}, &counter);
+	Wait(&counter);
+	gTimer->BenchmarkCodeEnd();
+
+	sprintf(msg, "JOB BENCHMARK: %u EMPTY JOBS: %f ms (%f us/job)", jobCount, gTimer->GetBenchmarkResult(),
+		gTimer->GetBenchmarkResult() * 1000.0f / jobCount);
+	gLogManager->AddMessage(msg);
+
+	// Scaling: the same amount of work split into 1, 2, 4, ... jobs, up to the thread count
+	std::vector<float> results(workSize);
+	unsigned int threadCount = GetThreadCount();
+	for (unsigned int jobs = 1; ; jobs = (jobs * 2 < threadCount ? jobs * 2 : threadCount))
+	{
+		gTimer->BenchmarkCodeStart();
+		ParallelFor(workSize, workSize / jobs, [&results](unsigned int start, unsigned int end)
+		{
+			for (unsigned int i = start; i < end; i++)
+				results[i] = sqrtf((float)i);
+		});
+		gTimer->BenchmarkCodeEnd();
+
+		sprintf(msg, "JOB BENCHMARK: PARALLEL FOR WITH %u JOBS: %f ms", jobs, gTimer->GetBenchmarkResult());
+		gLogManager->AddMessage(msg);
+
+		if (jobs == threadCount)
+			break;
+	}
+}
+
+unsigned int JobSystem::GetThreadCount()
+{
+	return (unsigned int)queues.size();
+}
+
+void JobSystem::WorkerMain(unsigned int queueId)
+{
+	threadQueueId = queueId;
+
+	while (true)
+	{
+		if (RunPendingJob(queueId))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		jobAvailable.wait(lock, [this] { return !running || pendingJobs > 0; });
+
+		if (!running)
+			return;
+	}
+}
+
+bool JobSystem::PopJob(unsigned int queueId, Job & job)
+{
+	WorkerQueue * queue = queues[queueId];
+	std::lock_guard<std::mutex> lock(queue->mutex);
+
+	if (queue->jobs.empty())
+		return false;
+
+	job = queue->jobs.back();
+	queue->jobs.pop_back();
+	return true;
+}
+
+bool JobSystem::StealJob(unsigned int queueId, Job & job)
+{
+	for (unsigned int i = 1; i < queues.size(); i++)
+	{
+		WorkerQueue * queue = queues[(queueId + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+
+		if (queue->jobs.empty())
+			continue;
+
+		job = queue->jobs.front();
+		queue->jobs.pop_front();
+		return true;
+	}
+
+	return false;
+}
+
+bool JobSystem::RunPendingJob(unsigned int queueId)
+{
+	Job job;
+	if (!PopJob(queueId, job) && !StealJob(queueId, job))
+		return false;
+
+	pendingJobs--;
+
+	job.function();
+
+	if (job.counter)
+		job.counter->count--;
+
+	return true;
+}
+
+unsigned int JobSystem::GetQueueId()
+{
+	if (threadQueueId < queues.size())
+		return threadQueueId;
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// Number of unfinished jobs of one fork/join, Wait() returns when it reaches zero
+struct JobCounter
+{
+	std::atomic<unsigned int> count;
+
+	JobCounter() { count = 0; }
+};
+
+class JobSystem
+{
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			JobCounter * counter;
+		};
+
+		// Owner pushes and pops at the back, thieves steal from the front
+		struct WorkerQueue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		std::vector<std::thread> workers;
+		std::vector<WorkerQueue*> queues;
+		std::atomic<unsigned int> pendingJobs;
+		std::mutex sleepMutex;
+		std::condition_variable jobAvailable;
+		bool running;
+	private:
+		void WorkerMain(unsigned int queueId);
+		bool PopJob(unsigned int queueId, Job & job);
+		bool StealJob(unsigned int queueId, Job & job);
+		bool RunPendingJob(unsigned int queueId);
+		unsigned int GetQueueId();
+	public:
+		JobSystem();
+		~JobSystem();
+
+		bool Init(unsigned int threadCount);
+		void Unload();
+		void Run(std::function<void()> function, JobCounter * counter);
+		void Wait(JobCounter * counter);
+		void ParallelFor(unsigned int count, unsigned int batchSize, std::function<void(unsigned int start, unsigned int end)> function);
+		void RunBenchmark();
+		unsigned int GetThreadCount();
+};
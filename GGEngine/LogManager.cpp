@@ -18,6 +18,9 @@ LogManager::~LogManager()
 
 void LogManager::AddMessage(std::string msg)
 {
+	// Messages come from the job system threads too, localtime() isn't thread safe either
+	std::lock_guard<std::mutex> lock(mutex);
+
 	time_t t = time(NULL);
 	struct tm * now = localtime(&t);
 
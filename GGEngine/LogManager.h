@@ -3,12 +3,14 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <mutex>
 #include <glm.hpp>
 
 class LogManager
 {
 	private:
 		std::ofstream file;
+		std::mutex mutex;
 	public:
 		bool Init();
 		~LogManager();
@@ -15,6 +15,7 @@
 #include "VulkanInterface.h"
 #include "Input.h"
 #include "Timer.h"
+#include "JobSystem.h"
 #include "SceneManager.h"
 
 
@@ -24,6 +25,7 @@ LogManager * gLogManager;
 Settings * gSettings;
 Input * gInput;
 Timer * gTimer;
+JobSystem * gJobSystem;
 SceneManager * sceneManager = new SceneManager();
 
 bool gProgramRunning = true;
@@ -84,6 +86,14 @@ int main()
 		return false;
 	}
 
+	// Job system, one thread per core
+	gJobSystem = new JobSystem();
+	if (!gJobSystem->Init(0))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init job system!");
+		return false;
+	}
+
 	// Scene manager
 	
 	if (!sceneManager->Init(vulkan))
@@ -162,11 +172,12 @@ int main()
 		}
 	}
 
-	vkDeviceWaitIdle(vulkan->GetVulkanDevice()->GetDevice());
+	vulkan->GetVulkanDevice()->WaitIdle();
 
 	gLogManager->AddMessage("Unloading...");
 	SAFE_DELETE(gTimer);
 	SAFE_UNLOAD(sceneManager, vulkan);
+	SAFE_UNLOAD(gJobSystem);
 	SAFE_DELETE(vulkan);
 	SAFE_DELETE(gInput);
 	SAFE_DELETE(window);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+// Read only view of a whole file, loaders parse it in place instead of reading it into buffers
+class MappedFile
+{
+	private:
+		void * fileHandle;
+		void * mappingHandle;
+		const uint8_t * data;
+		size_t size;
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool Open(std::string filename);
+		void Close();
+		const uint8_t * GetData();
+		size_t GetSize();
+};
\ No newline at end of file
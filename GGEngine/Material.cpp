@@ -73,3 +73,24 @@ float Material::GetRoughnessOffset()
 {
 	return roughnessOffset;
 }
+
+MaterialPushConstants Material::GetPushConstants()
+{
+	// Textures that didn't get a slot in the bindless array fall back to the first one
+	MaterialPushConstants pushConstants;
+	pushConstants.diffuseTexture = diffuseTexture->GetBindlessIndex();
+	pushConstants.materialTexture = materialTexture->GetBindlessIndex();
+	pushConstants.normalTexture = (HasNormalMap() ? normalTexture->GetBindlessIndex() : 0);
+	pushConstants.hasNormalMap = (HasNormalMap() ? 1.0f : 0.0f);
+	pushConstants.metallicOffset = metallicOffset;
+	pushConstants.roughnessOffset = roughnessOffset;
+
+	if (pushConstants.diffuseTexture == UINT32_MAX)
+		pushConstants.diffuseTexture = 0;
+	if (pushConstants.materialTexture == UINT32_MAX)
+		pushConstants.materialTexture = 0;
+	if (pushConstants.normalTexture == UINT32_MAX)
+		pushConstants.normalTexture = 0;
+
+	return pushConstants;
+}
@@ -2,6 +2,17 @@
 
 #include "Texture.h"
 
+// Material of the bindless path, pushed per draw instead of written to a descriptor set
+struct MaterialPushConstants
+{
+	uint32_t diffuseTexture;
+	uint32_t materialTexture;
+	uint32_t normalTexture;
+	float hasNormalMap;
+	float metallicOffset;
+	float roughnessOffset;
+};
+
 class Material
 {
 	private:
@@ -25,4 +36,5 @@ class Material
 		bool HasNormalMap();
 		float GetMetallicOffset();
 		float GetRoughnessOffset();
+		MaterialPushConstants GetPushConstants();
 };
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "VulkanPipeline.h"
 #include "VulkanBuffer.h"
 #include "Material.h"
+#include "MeshFile.h"
 
 class Mesh
 {
@@ -18,6 +19,11 @@ class Mesh
 
 		unsigned int vertexCount;
 		unsigned int indexCount;
+		VkIndexType indexType;
+
+		// Index ranges of the levels of detail in the one index buffer, full detail first
+		unsigned int lodCount;
+		MeshFileLod lods[MESH_MAX_LODS];
 
 		struct MaterialUniformBuffer
 		{
@@ -33,15 +39,23 @@ class Mesh
 		VulkanBuffer * materialUBO;
 
 		Material * material;
+	private:
+		const MeshFileLod & GetLod(unsigned int lod);
 	public:
 		Mesh();
 		~Mesh();
 
-		bool Init(VulkanInterface * vulkan, FILE * modelFile, std::string meshName);
+		bool Init(VulkanInterface * vulkan, const MeshFileMesh & fileMesh, std::string meshName, bool quantized);
 		void Unload(VulkanInterface * vulkan);
-		void Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer);
+		void Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, unsigned int lod);
+		void RenderInstanced(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VkBuffer instanceBuffer,
+			VkDeviceSize instanceOffset, uint32_t instanceCount, unsigned int lod);
 		void SetMaterial(Material * material);
 		void UpdateUniformBuffer(VulkanInterface * vulkan);
+		bool MakeResident(VulkanInterface * vulkan);
+		uint32_t GetResidencyVersion();
+		unsigned int GetLodCount();
+		unsigned int GetTriangleCount(unsigned int lod);
 		Material * GetMaterial();
 		VkDescriptorBufferInfo * GetMaterialBufferInfo();
 };
\ No newline at end of file
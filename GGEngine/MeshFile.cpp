@@ -0,0 +1,298 @@
+#include <sstream>
+
+#include "MeshFile.h"
+#include "LogManager.h"
+
+extern LogManager * gLogManager;
+
+// Names are fixed size fields, a full one has no terminator
+static std::string ReadName(const char * name)
+{
+	size_t length = 0;
+	while (length < MESH_NAME_SIZE && name[length] != '\0')
+		length++;
+
+	return std::string(name, length);
+}
+
+MeshFile::MeshFile()
+{
+	version = 0;
+	vertexSize = 0;
+	frustumCullRadius = 0.0f;
+}
+
+bool MeshFile::Open(std::string filename, bool skinned)
+{
+	Close();
+
+	if (!file.Open(filename))
+	{
+		gLogManager->AddMessage("ERROR: Model file not found! (" + filename + ")");
+		return false;
+	}
+
+	uint32_t magic = 0;
+	if (file.GetSize() >= sizeof(uint32_t))
+		memcpy(&magic, file.GetData(), sizeof(uint32_t));
+
+	bool parsed;
+	if (magic == (skinned ? RCS_MAGIC : RCM_MAGIC))
+	{
+		uint32_t fileVersion = 0;
+		if (file.GetSize() >= 2 * sizeof(uint32_t))
+			memcpy(&fileVersion, file.GetData() + sizeof(uint32_t), sizeof(uint32_t));
+
+		if (fileVersion < 2 || fileVersion > MESH_FORMAT_VERSION)
+		{
+			gLogManager->AddMessage("ERROR: Model file has an unknown version! (" + filename + ")");
+			Close();
+			return false;
+		}
+
+		parsed = ParseVersion2(skinned);
+	}
+	else
+		parsed = ParseVersion1(filename, skinned);
+
+	if (!parsed)
+	{
+		gLogManager->AddMessage("ERROR: Model file is corrupted! (" + filename + ")");
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshFile::Close()
+{
+	file.Close();
+	meshes.clear();
+	bones.clear();
+	version = 0;
+	vertexSize = 0;
+	frustumCullRadius = 0.0f;
+}
+
+bool MeshFile::ParseVersion2(bool skinned)
+{
+	const uint8_t * data = file.GetData();
+	size_t size = file.GetSize();
+
+	MeshFileHeader header;
+	if (size < sizeof(MeshFileHeader))
+		return false;
+	memcpy(&header, data, sizeof(MeshFileHeader));
+
+	// The vertex size tells the full layout from the quantized one, any other was written for other shaders
+	uint32_t fullSize = (skinned ? RCS_VERTEX_SIZE : RCM_VERTEX_SIZE);
+	uint32_t quantizedSize = (skinned ? RCS_QUANTIZED_VERTEX_SIZE : RCM_QUANTIZED_VERTEX_SIZE);
+	if (header.version < 2 || header.version > MESH_FORMAT_VERSION || (header.vertexSize != fullSize && header.vertexSize != quantizedSize))
+		return false;
+
+	size_t entrySize = GetMeshEntrySize(header.version);
+	if ((size - sizeof(MeshFileHeader)) / entrySize < header.meshCount)
+		return false;
+
+	version = header.version;
+	vertexSize = header.vertexSize;
+	frustumCullRadius = header.frustumCullRadius;
+
+	for (uint32_t i = 0; i < header.meshCount; i++)
+	{
+		// Copied out, the fields older versions don't have keep their defaults
+		MeshFileEntry entry{};
+		entry.indexSize = sizeof(uint32_t);
+		memcpy(&entry, data + sizeof(MeshFileHeader) + i * entrySize, entrySize);
+
+		if (header.version < 4)
+			SetFullDetailLod(entry);
+
+		uint64_t vertexBytes = (uint64_t)entry.vertexCount * vertexSize;
+		// 16 bit indices can only address the vertices of small meshes
+		if (entry.indexSize != sizeof(uint32_t) && (entry.indexSize != sizeof(uint16_t) || entry.vertexCount > MESH_SHORT_INDEX_MAX_VERTICES))
+			return false;
+
+		uint64_t indexBytes = (uint64_t)entry.indexCount * entry.indexSize;
+		if (entry.vertexOffset % MESH_BLOB_ALIGNMENT != 0 || entry.indexOffset % MESH_BLOB_ALIGNMENT != 0 ||
+			entry.vertexOffset > size || vertexBytes > size - entry.vertexOffset ||
+			entry.indexOffset > size || indexBytes > size - entry.indexOffset)
+			return false;
+
+		// Every level draws whole triangles from within the index blob
+		if (entry.lodCount == 0 || entry.lodCount > MESH_MAX_LODS)
+			return false;
+		for (uint32_t j = 0; j < entry.lodCount; j++)
+			if (entry.lods[j].firstIndex > entry.indexCount || entry.lods[j].indexCount > entry.indexCount - entry.lods[j].firstIndex)
+				return false;
+
+		MeshFileMesh mesh;
+		mesh.vertexData = data + entry.vertexOffset;
+		mesh.vertexCount = entry.vertexCount;
+		mesh.quantized = (vertexSize == quantizedSize);
+		mesh.indexData = data + entry.indexOffset;
+		mesh.indexCount = entry.indexCount;
+		mesh.indexSize = entry.indexSize;
+		mesh.lodCount = entry.lodCount;
+		memcpy(mesh.lods, entry.lods, sizeof(mesh.lods));
+		mesh.diffuseTexture = ReadName(entry.diffuseTexture);
+		mesh.normalTexture = ReadName(entry.normalTexture);
+		mesh.materialTexture = ReadName(entry.materialTexture);
+		mesh.metallicOffset = entry.metallicOffset;
+		mesh.roughnessOffset = entry.roughnessOffset;
+		meshes.push_back(mesh);
+	}
+
+	if (header.boneCount > 0)
+	{
+		if (header.boneTableOffset > size || (size - header.boneTableOffset) / sizeof(MeshFileBone) < header.boneCount)
+			return false;
+
+		const MeshFileBone * fileBones = (const MeshFileBone*)(data + header.boneTableOffset);
+		bones.resize(header.boneCount);
+		for (uint32_t i = 0; i < header.boneCount; i++)
+		{
+			memcpy(bones[i].offset, fileBones[i].offset, sizeof(bones[i].offset));
+			bones[i].name = ReadName(fileBones[i].name);
+			bones[i].id = fileBones[i].id;
+		}
+	}
+
+	return true;
+}
+
+bool MeshFile::ParseVersion1(std::string filename, bool skinned)
+{
+	// Mesh count (and cull radius for static models), then every mesh's counts, data and texture names
+	version = 1;
+	vertexSize = (skinned ? RCS_VERTEX_SIZE : RCM_VERTEX_SIZE);
+
+	uint32_t meshCount;
+	if (file.Read(&meshCount, sizeof(uint32_t)) != sizeof(uint32_t))
+		return false;
+	if (!skinned && file.Read(&frustumCullRadius, sizeof(float)) != sizeof(float))
+		return false;
+
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		MeshFileMesh mesh;
+		mesh.quantized = false;
+		mesh.indexSize = sizeof(uint32_t);
+		if (file.Read(&mesh.vertexCount, sizeof(uint32_t)) != sizeof(uint32_t) ||
+			file.Read(&mesh.indexCount, sizeof(uint32_t)) != sizeof(uint32_t))
+			return false;
+
+		mesh.vertexData = file.ReadInPlace((size_t)mesh.vertexCount * vertexSize);
+		mesh.indexData = file.ReadInPlace((size_t)mesh.indexCount * sizeof(uint32_t));
+
+		char diffuseTextureName[MESH_NAME_SIZE];
+		char normalTextureName[MESH_NAME_SIZE];
+		if (mesh.vertexData == NULL || mesh.indexData == NULL ||
+			file.Read(diffuseTextureName, MESH_NAME_SIZE) != MESH_NAME_SIZE || file.Read(normalTextureName, MESH_NAME_SIZE) != MESH_NAME_SIZE)
+			return false;
+
+		// Full detail only
+		memset(mesh.lods, 0, sizeof(mesh.lods));
+		mesh.lodCount = 1;
+		mesh.lods[0].indexCount = mesh.indexCount;
+
+		mesh.diffuseTexture = ReadName(diffuseTextureName);
+		mesh.normalTexture = ReadName(normalTextureName);
+		mesh.materialTexture = "NONE";
+		mesh.metallicOffset = 0.0f;
+		mesh.roughnessOffset = 0.0f;
+		meshes.push_back(mesh);
+	}
+
+	if (skinned)
+	{
+		uint32_t boneCount;
+		if (file.Read(&boneCount, sizeof(uint32_t)) != sizeof(uint32_t) || boneCount > file.GetSize() / sizeof(bones[0].offset))
+			return false;
+
+		bones.resize(boneCount);
+		for (uint32_t i = 0; i < boneCount; i++)
+			if (file.Read(bones[i].offset, sizeof(bones[i].offset)) != sizeof(bones[i].offset))
+				return false;
+
+		// The names and ids follow all the offsets
+		for (uint32_t i = 0; i < boneCount; i++)
+		{
+			uint32_t nameSize;
+			if (file.Read(&nameSize, sizeof(uint32_t)) != sizeof(uint32_t))
+				return false;
+
+			const char * name = (const char*)file.ReadInPlace(nameSize);
+			if (name == NULL || file.Read(&bones[i].id, sizeof(uint32_t)) != sizeof(uint32_t))
+				return false;
+
+			bones[i].name = std::string(name, nameSize);
+		}
+	}
+
+	// Materials come from the .mat next to it, one line per mesh
+	size_t pos = filename.rfind('.');
+	filename.replace(pos, 4, ".mat");
+
+	VirtualFile matData;
+	if (!matData.Open(filename))
+	{
+		gLogManager->AddMessage("ERROR: Model .mat file not found! (" + filename + ")");
+		return false;
+	}
+	std::istringstream matFile(matData.GetText());
+
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		std::string matName;
+		matFile >> matName >> meshes[i].materialTexture >> meshes[i].metallicOffset >> meshes[i].roughnessOffset;
+	}
+
+	return true;
+}
+
+uint32_t MeshFile::GetVersion()
+{
+	return version;
+}
+
+uint32_t MeshFile::GetVertexSize()
+{
+	return vertexSize;
+}
+
+bool MeshFile::IsQuantized()
+{
+	return vertexSize == RCM_QUANTIZED_VERTEX_SIZE || vertexSize == RCS_QUANTIZED_VERTEX_SIZE;
+}
+
+size_t MeshFile::GetSize()
+{
+	return file.GetSize();
+}
+
+float MeshFile::GetFrustumCullRadius()
+{
+	return frustumCullRadius;
+}
+
+unsigned int MeshFile::GetMeshCount()
+{
+	return (unsigned int)meshes.size();
+}
+
+const MeshFileMesh & MeshFile::GetMesh(int meshId)
+{
+	return meshes[meshId];
+}
+
+unsigned int MeshFile::GetBoneCount()
+{
+	return (unsigned int)bones.size();
+}
+
+const MeshFileSkinBone & MeshFile::GetBone(int boneId)
+{
+	return bones[boneId];
+}
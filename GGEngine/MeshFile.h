@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "VirtualFileSystem.h"
+#include "MeshFormat.h"
+
+// One mesh of a model file with its material, vertex and index data point into the mapped file
+struct MeshFileMesh
+{
+	const void * vertexData;
+	uint32_t vertexCount;
+	bool quantized;
+	const void * indexData;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t lodCount;
+	MeshFileLod lods[MESH_MAX_LODS];
+	std::string diffuseTexture;
+	std::string normalTexture;
+	std::string materialTexture;
+	float metallicOffset;
+	float roughnessOffset;
+};
+
+// Offset matrix of one bone of a .rcs and the id the animations know it by
+struct MeshFileSkinBone
+{
+	float offset[16];
+	std::string name;
+	uint32_t id;
+};
+
+// Parsed .rcm or .rcs, version 2 and later files are validated in place, version 1 ones are walked mesh by mesh and read their .mat
+class MeshFile
+{
+	private:
+		VirtualFile file;
+		uint32_t version;
+		uint32_t vertexSize;
+		float frustumCullRadius;
+		std::vector<MeshFileMesh> meshes;
+		std::vector<MeshFileSkinBone> bones;
+	private:
+		bool ParseVersion2(bool skinned);
+		bool ParseVersion1(std::string filename, bool skinned);
+	public:
+		MeshFile();
+
+		bool Open(std::string filename, bool skinned);
+		void Close();
+		uint32_t GetVersion();
+		uint32_t GetVertexSize();
+		bool IsQuantized();
+		size_t GetSize();
+		float GetFrustumCullRadius();
+		unsigned int GetMeshCount();
+		const MeshFileMesh & GetMesh(int meshId);
+		unsigned int GetBoneCount();
+		const MeshFileSkinBone & GetBone(int boneId);
+};
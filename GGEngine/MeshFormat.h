@@ -0,0 +1,415 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+// Version 2 .rcm and .rcs files start with the magic, older ones straight with the mesh count.
+// Version 3 added the per mesh index size, version 4 the LOD ranges. Older files still load, MeshConverter upgrades them
+#define RCM_MAGIC 0x324D4352
+#define RCS_MAGIC 0x32534352
+#define MESH_FORMAT_VERSION 4
+
+// Vertex and index blobs start on this boundary, so the mapped file can be staged from directly
+#define MESH_BLOB_ALIGNMENT 16
+
+// Bytes per vertex the static and the skinned mesh pipelines read, in the full and the quantized layout
+#define RCM_VERTEX_SIZE 56
+#define RCS_VERTEX_SIZE 88
+#define RCM_QUANTIZED_VERTEX_SIZE 20
+#define RCS_QUANTIZED_VERTEX_SIZE 28
+
+// Quantized bone ids are bound as signed bytes, so the skinning shaders keep their ivec4 input
+#define MESH_QUANTIZED_MAX_BONES 128
+
+#define MESH_NAME_SIZE 64
+
+// Meshes with at most this many vertices are indexed with 16 bits
+#define MESH_SHORT_INDEX_MAX_VERTICES 65536
+
+// Full detail and up to three simplified levels per mesh
+#define MESH_MAX_LODS 4
+
+// The mesh table follows the header, the bone table (.rcs) sits at boneTableOffset
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t meshCount;
+	uint32_t vertexSize;
+	float frustumCullRadius;
+	uint32_t boneCount;
+	uint64_t boneTableOffset;
+};
+
+// Range of the mesh's indices one level of detail draws, all of them index the mesh's one vertex blob
+struct MeshFileLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+// One mesh with the material its .mat line used to hold, texture names are relative to data/textures or NONE.
+// The index blob holds the full detail triangles first, then the coarser levels' after each other
+struct MeshFileEntry
+{
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	char diffuseTexture[MESH_NAME_SIZE];
+	char normalTexture[MESH_NAME_SIZE];
+	char materialTexture[MESH_NAME_SIZE];
+	float metallicOffset;
+	float roughnessOffset;
+	uint32_t indexSize;
+	uint32_t lodCount;
+	MeshFileLod lods[MESH_MAX_LODS];
+};
+
+// Offset matrix in Assimp's row major layout and the id the animations use for the bone
+struct MeshFileBone
+{
+	float offset[16];
+	char name[MESH_NAME_SIZE];
+	uint32_t id;
+	uint32_t padding[3];
+};
+
+struct MeshFileVertex
+{
+	float x, y, z;
+	float u, v;
+	float nx, ny, nz;
+	float tx, ty, tz;
+	float bx, by, bz;
+};
+
+struct MeshFileSkinnedVertex
+{
+	float x, y, z;
+	float u, v;
+	float nx, ny, nz;
+	float boneWeights[4];
+	uint32_t boneIDs[4];
+	float tx, ty, tz;
+	float bx, by, bz;
+};
+
+// Position stays full precision, texture coords are half floats and the normal, tangent and bitangent one packed tangent frame
+struct MeshFileQuantizedVertex
+{
+	float x, y, z;
+	uint16_t u, v;
+	uint32_t tangentFrame;
+};
+
+// Bone weights are unorm8 adding up to 255, bone ids single bytes
+struct MeshFileQuantizedSkinnedVertex
+{
+	float x, y, z;
+	uint16_t u, v;
+	uint32_t tangentFrame;
+	uint8_t boneWeights[4];
+	uint8_t boneIDs[4];
+};
+
+// Version 2 entries end before the index size, their indices are all 32 bit. Version 3 ones have padding where the LODs start
+inline size_t GetMeshEntrySize(uint32_t version)
+{
+	if (version == 2)
+		return offsetof(MeshFileEntry, indexSize);
+	if (version == 3)
+		return offsetof(MeshFileEntry, lodCount) + sizeof(uint32_t);
+
+	return sizeof(MeshFileEntry);
+}
+
+// Entries of files without LODs draw all of their indices
+inline void SetFullDetailLod(MeshFileEntry & entry)
+{
+	memset(entry.lods, 0, sizeof(entry.lods));
+	entry.lodCount = 1;
+	entry.lods[0].indexCount = entry.indexCount;
+}
+
+static_assert(sizeof(MeshFileVertex) == RCM_VERTEX_SIZE, "Static vertex layout changed");
+static_assert(sizeof(MeshFileSkinnedVertex) == RCS_VERTEX_SIZE, "Skinned vertex layout changed");
+static_assert(sizeof(MeshFileQuantizedVertex) == RCM_QUANTIZED_VERTEX_SIZE, "Quantized static vertex layout changed");
+static_assert(sizeof(MeshFileQuantizedSkinnedVertex) == RCS_QUANTIZED_VERTEX_SIZE, "Quantized skinned vertex layout changed");
+
+inline uint32_t GetMeshIndexSize(uint32_t vertexCount)
+{
+	return (vertexCount <= MESH_SHORT_INDEX_MAX_VERTICES ? sizeof(uint16_t) : sizeof(uint32_t));
+}
+
+inline void NarrowIndices(const uint32_t * indices, uint32_t indexCount, uint16_t * shortIndices)
+{
+	for (uint32_t i = 0; i < indexCount; i++)
+		shortIndices[i] = (uint16_t)indices[i];
+}
+
+#define MESH_TWO_PI 6.28318530718f
+
+inline uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	// Too large turns into infinity, NaN stays NaN
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7C00 | (((bits >> 23) & 0xFF) == 0xFF && mantissa != 0 ? 0x200 : 0));
+
+	if (exponent <= -11)
+		return (uint16_t)sign;
+
+	// Denormal, the implicit bit of the float becomes explicit
+	if (exponent <= 0)
+	{
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+
+		return (uint16_t)(sign | half);
+	}
+
+	// Rounded to nearest, a carry into the exponent still gives the right value
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+
+	return (uint16_t)(sign | half);
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+
+	uint32_t bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		// Denormal, normalized for the float
+		exponent = 113;
+		while ((mantissa & 0x400) == 0)
+		{
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// Tangent and bitangent the tangent angle is measured from, built from the normal alone without a branch on its direction
+// ("Building an Orthonormal Basis, Revisited"). The quantized shaders rebuild it the same way, with the sign taken as n.z >= 0
+inline void GetTangentFrameBasis(const float normal[3], float tangent[3], float bitangent[3])
+{
+	float s = (normal[2] >= 0.0f ? 1.0f : -1.0f);
+	float a = -1.0f / (s + normal[2]);
+	float b = normal[0] * normal[1] * a;
+
+	tangent[0] = 1.0f + s * normal[0] * normal[0] * a;
+	tangent[1] = s * b;
+	tangent[2] = -s * normal[0];
+
+	bitangent[0] = b;
+	bitangent[1] = s + normal[1] * normal[1] * a;
+	bitangent[2] = -normal[1];
+}
+
+// Read as A2B10G10R10_UNORM_PACK32: r and g hold the octahedral normal, b the tangent's angle around it in the basis above
+// (a full turn is 1023 steps) and a is 1 when the bitangent is cross(normal, tangent), 0 when it points the other way
+inline void DecodeTangentFrame(uint32_t frame, float normal[3], float tangent[3], float bitangent[3])
+{
+	float ox = (frame & 0x3FF) / 1023.0f * 2.0f - 1.0f;
+	float oy = ((frame >> 10) & 0x3FF) / 1023.0f * 2.0f - 1.0f;
+	float angle = ((frame >> 20) & 0x3FF) / 1023.0f * MESH_TWO_PI;
+	float sign = ((frame >> 30) != 0 ? 1.0f : -1.0f);
+
+	normal[0] = ox;
+	normal[1] = oy;
+	normal[2] = 1.0f - fabsf(ox) - fabsf(oy);
+
+	float fold = (normal[2] < 0.0f ? -normal[2] : 0.0f);
+	normal[0] += (normal[0] >= 0.0f ? -fold : fold);
+	normal[1] += (normal[1] >= 0.0f ? -fold : fold);
+
+	float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	for (int i = 0; i < 3; i++)
+		normal[i] /= length;
+
+	float basisTangent[3], basisBitangent[3];
+	GetTangentFrameBasis(normal, basisTangent, basisBitangent);
+
+	float c = cosf(angle);
+	float s = sinf(angle);
+	for (int i = 0; i < 3; i++)
+		tangent[i] = c * basisTangent[i] + s * basisBitangent[i];
+
+	bitangent[0] = sign * (normal[1] * tangent[2] - normal[2] * tangent[1]);
+	bitangent[1] = sign * (normal[2] * tangent[0] - normal[0] * tangent[2]);
+	bitangent[2] = sign * (normal[0] * tangent[1] - normal[1] * tangent[0]);
+}
+
+inline uint32_t EncodeTangentFrame(const float normal[3], const float tangent[3], const float bitangent[3])
+{
+	float n[3] = { normal[0], normal[1], normal[2] };
+	float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+	if (l1 == 0.0f)
+	{
+		n[2] = 1.0f;
+		l1 = 1.0f;
+	}
+
+	// Octahedral projection, the lower half folded over the diagonals
+	float ox = n[0] / l1;
+	float oy = n[1] / l1;
+	if (n[2] < 0.0f)
+	{
+		float x = ox;
+		ox = (1.0f - fabsf(oy)) * (x >= 0.0f ? 1.0f : -1.0f);
+		oy = (1.0f - fabsf(x)) * (oy >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	uint32_t frame = (uint32_t)((ox * 0.5f + 0.5f) * 1023.0f + 0.5f) | ((uint32_t)((oy * 0.5f + 0.5f) * 1023.0f + 0.5f) << 10);
+
+	// The angle is measured in the basis of the normal as it's decoded, not the exact one
+	float decodedNormal[3], unused[3];
+	DecodeTangentFrame(frame | (1u << 30), decodedNormal, unused, unused);
+
+	float basisTangent[3], basisBitangent[3];
+	GetTangentFrameBasis(decodedNormal, basisTangent, basisBitangent);
+
+	float tangentNormal = tangent[0] * decodedNormal[0] + tangent[1] * decodedNormal[1] + tangent[2] * decodedNormal[2];
+	float t[3];
+	for (int i = 0; i < 3; i++)
+		t[i] = tangent[i] - decodedNormal[i] * tangentNormal;
+
+	float angle = atan2f(t[0] * basisBitangent[0] + t[1] * basisBitangent[1] + t[2] * basisBitangent[2],
+		t[0] * basisTangent[0] + t[1] * basisTangent[1] + t[2] * basisTangent[2]);
+	if (angle < 0.0f)
+		angle += MESH_TWO_PI;
+
+	frame |= ((uint32_t)(angle / MESH_TWO_PI * 1023.0f + 0.5f) % 1023) << 20;
+
+	// Handedness of the original frame
+	float cross[3] = { decodedNormal[1] * t[2] - decodedNormal[2] * t[1], decodedNormal[2] * t[0] - decodedNormal[0] * t[2],
+		decodedNormal[0] * t[1] - decodedNormal[1] * t[0] };
+	if (cross[0] * bitangent[0] + cross[1] * bitangent[1] + cross[2] * bitangent[2] >= 0.0f)
+		frame |= 3u << 30;
+
+	return frame;
+}
+
+inline void QuantizeVertex(const MeshFileVertex & vertex, MeshFileQuantizedVertex & quantized)
+{
+	float normal[3] = { vertex.nx, vertex.ny, vertex.nz };
+	float tangent[3] = { vertex.tx, vertex.ty, vertex.tz };
+	float bitangent[3] = { vertex.bx, vertex.by, vertex.bz };
+
+	quantized.x = vertex.x;
+	quantized.y = vertex.y;
+	quantized.z = vertex.z;
+	quantized.u = FloatToHalf(vertex.u);
+	quantized.v = FloatToHalf(vertex.v);
+	quantized.tangentFrame = EncodeTangentFrame(normal, tangent, bitangent);
+}
+
+inline void ExpandVertex(const MeshFileQuantizedVertex & quantized, MeshFileVertex & vertex)
+{
+	float normal[3], tangent[3], bitangent[3];
+	DecodeTangentFrame(quantized.tangentFrame, normal, tangent, bitangent);
+
+	vertex.x = quantized.x;
+	vertex.y = quantized.y;
+	vertex.z = quantized.z;
+	vertex.u = HalfToFloat(quantized.u);
+	vertex.v = HalfToFloat(quantized.v);
+	vertex.nx = normal[0];
+	vertex.ny = normal[1];
+	vertex.nz = normal[2];
+	vertex.tx = tangent[0];
+	vertex.ty = tangent[1];
+	vertex.tz = tangent[2];
+	vertex.bx = bitangent[0];
+	vertex.by = bitangent[1];
+	vertex.bz = bitangent[2];
+}
+
+inline void QuantizeSkinnedVertex(const MeshFileSkinnedVertex & vertex, MeshFileQuantizedSkinnedVertex & quantized)
+{
+	float normal[3] = { vertex.nx, vertex.ny, vertex.nz };
+	float tangent[3] = { vertex.tx, vertex.ty, vertex.tz };
+	float bitangent[3] = { vertex.bx, vertex.by, vertex.bz };
+
+	quantized.x = vertex.x;
+	quantized.y = vertex.y;
+	quantized.z = vertex.z;
+	quantized.u = FloatToHalf(vertex.u);
+	quantized.v = FloatToHalf(vertex.v);
+	quantized.tangentFrame = EncodeTangentFrame(normal, tangent, bitangent);
+
+	int total = 0;
+	int largest = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		float weight = vertex.boneWeights[i];
+		weight = (weight < 0.0f ? 0.0f : (weight > 1.0f ? 1.0f : weight));
+
+		quantized.boneWeights[i] = (uint8_t)(weight * 255.0f + 0.5f);
+		quantized.boneIDs[i] = (uint8_t)vertex.boneIDs[i];
+
+		total += quantized.boneWeights[i];
+		if (vertex.boneWeights[i] > vertex.boneWeights[largest])
+			largest = i;
+	}
+
+	// Normalized weights still add up to one after rounding, the difference goes to the largest
+	if (total > 0 && abs(total - 255) <= 4)
+		quantized.boneWeights[largest] = (uint8_t)(quantized.boneWeights[largest] + 255 - total);
+}
+
+inline void ExpandSkinnedVertex(const MeshFileQuantizedSkinnedVertex & quantized, MeshFileSkinnedVertex & vertex)
+{
+	float normal[3], tangent[3], bitangent[3];
+	DecodeTangentFrame(quantized.tangentFrame, normal, tangent, bitangent);
+
+	vertex.x = quantized.x;
+	vertex.y = quantized.y;
+	vertex.z = quantized.z;
+	vertex.u = HalfToFloat(quantized.u);
+	vertex.v = HalfToFloat(quantized.v);
+	vertex.nx = normal[0];
+	vertex.ny = normal[1];
+	vertex.nz = normal[2];
+	for (int i = 0; i < 4; i++)
+	{
+		vertex.boneWeights[i] = quantized.boneWeights[i] / 255.0f;
+		vertex.boneIDs[i] = quantized.boneIDs[i];
+	}
+	vertex.tx = tangent[0];
+	vertex.ty = tangent[1];
+	vertex.tz = tangent[2];
+	vertex.bx = bitangent[0];
+	vertex.by = bitangent[1];
+	vertex.bz = bitangent[2];
+}
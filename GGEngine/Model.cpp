@@ -1,4 +1,3 @@
-#include <fstream>
 #include <gtc/type_ptr.hpp>
 
 #include "Model.h"
@@ -6,19 +5,40 @@
 #include "LogManager.h"
 #include "Settings.h"
 #include "TextureManager.h"
+#include "ModelManager.h"
 
 extern LogManager * gLogManager;
 extern Settings * gSettings;
 extern TextureManager * gTextureManager;
+extern ModelManager * gModelManager;
+
+TriangleCounts Model::triangleCounts[MODEL_PASS_COUNT];
 
 Model::Model()
 {
-	deferredVS_UBO = NULL;
+	asset = NULL;
+	emptyCollisionShape = NULL;
+
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+		frustumCullData.frustumCullCascade[i] = 0.0f;
+
+	cacheCommandPool = NULL;
+	cacheEnabled = false;
+	residencyVersionSum = 0;
+
+	for (int i = 0; i < MODEL_PASS_COUNT; i++)
+	{
+		lods[i] = 0;
+		ringSlots[i][0] = UNIFORM_RING_NO_SLOT;
+		ringSlots[i][1] = UNIFORM_RING_NO_SLOT;
+	}
 }
 
 Model::~Model()
 {
-	deferredVS_UBO = NULL;
+	cacheCommandPool = NULL;
+	emptyCollisionShape = NULL;
+	asset = NULL;
 }
 
 bool Model::Init(std::string filename, VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer,
@@ -26,13 +46,10 @@ bool Model::Init(std::string filename, VulkanInterface * vulkan, VulkanCommandBu
 {
 	this->physics = physics;
 	
-	if (!InitUniformBuffers(vulkan->GetVulkanDevice()))
+	// Files are only parsed for the first model spawned from them
+	asset = gModelManager->RequestModel(filename, vulkan);
+	if (asset == nullptr)
 		return false;
-	
-	if (!ReadRCMFile(vulkan, cmdBuffer, filename))
-		return false;
-
-	ReadCollisionFile(filename);
 
 	SetupPhysicsObject(mass);
 
@@ -44,32 +61,29 @@ void Model::Unload(VulkanInterface * vulkan)
 	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
 	
 	RemoveRigidBody();
+	SAFE_DELETE(emptyCollisionShape);
 
-	if (physicsStatic == false)
-		SAFE_DELETE(collisionShape);
+	// The descriptor sets are freed with the pipelines' pools
+	for (int i = 0; i < MODEL_PASS_COUNT; i++)
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
+			for (unsigned int k = 0; k < cachedPasses[i][j].commandBuffers.size(); k++)
+				SAFE_UNLOAD(cachedPasses[i][j].commandBuffers[k], vulkanDevice, cacheCommandPool);
+	SAFE_UNLOAD(cacheCommandPool, vulkanDevice);
 
-	if (collisionMeshPresent == true)
+	// The frames in flight are done with the old data by the time a new owner of the slots writes to them
+	for (int i = 0; i < MODEL_PASS_COUNT; i++)
 	{
-		SAFE_DELETE(collisionMesh);
+		vulkan->GetUniformRing()->FreeSlot(ringSlots[i][0], sizeof(VertexUniformBuffer));
+		vulkan->GetUniformRing()->FreeSlot(ringSlots[i][1], sizeof(FrustumUniformBuffer));
+		ringSlots[i][0] = UNIFORM_RING_NO_SLOT;
+		ringSlots[i][1] = UNIFORM_RING_NO_SLOT;
 	}
-	else
-		SAFE_DELETE(emptyCollisionShape);
 
-	SAFE_UNLOAD(shadowGS_UBO, vulkanDevice);
-	SAFE_UNLOAD(deferredVS_UBO, vulkanDevice);
-
-	for (unsigned int i = 0; i < textures.size(); i++)
-		gTextureManager->ReleaseTexture(textures[i], vulkanDevice);
-
-	for (unsigned int i = 0; i < meshes.size(); i++)
-	{
-		SAFE_UNLOAD(drawCmdBuffers[i], vulkanDevice, vulkan->GetVulkanCommandPool());
-		SAFE_DELETE(materials[i]);
-		SAFE_UNLOAD(meshes[i], vulkan);
-	}
+	gModelManager->ReleaseModel(asset, vulkan);
+	asset = NULL;
 }
 
-void Model::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * vulkanPipeline,
+void Model::Render(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
 	Camera * camera, ShadowMaps * shadowMaps)
 {
 	btTransform transform;
@@ -78,51 +92,387 @@ void Model::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer
 
 	transform.getOpenGLMatrix((btScalar*)&vertexUniformBuffer.worldMatrix);
 
-	// Update vertex uniform buffer
-	if (vulkanPipeline->GetPipelineName() == "DEFERRED")
+	// Evicted meshes are reloaded before anything is recorded with them
+	uint32_t versionSum = 0;
+	for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+	{
+		if (!asset->GetMesh(i)->MakeResident(vulkan))
+			THROW_ERROR();
+		versionSum += asset->GetMesh(i)->GetResidencyVersion();
+	}
+
+	// A reloaded buffer or a streamed texture, the sets and cached buffers still point at the old one. Versions only grow
+	for (unsigned int i = 0; i < asset->GetTextureCount(); i++)
+		versionSum += asset->GetTexture(i)->GetResidencyVersion();
+	if (versionSum != residencyVersionSum)
+	{
+		residencyVersionSum = versionSum;
+		MarkDirty();
+	}
+
+	// Bindless deferred pushes the material, the per-draw path writes it to each mesh's uniform buffer
+	bool bindless = (vulkanPipeline->GetPipelineName() == "DEFERREDBINDLESS");
+
+	// Update vertex uniform buffer, streamed textures and the level of detail go by how large the model is on screen
+	float screenSize = 0.0f;
+	if (vulkanPipeline->GetPipelineName() == "DEFERRED" || bindless)
+	{
 		vertexUniformBuffer.MVP = camera->GetProjectionMatrix() * camera->GetViewMatrix() * vertexUniformBuffer.worldMatrix;
+		screenSize = GetScreenSize(camera, transform);
+		RequestTextureScreenSize(screenSize);
+	}
+
+	// Written to the frame's uniform ring, the cached sets point at the ring and the offsets are given at bind time
+	MODEL_PASS pass = (vulkanPipeline->GetPipelineName() == "SHADOW" ? MODEL_PASS_SHADOW : MODEL_PASS_DEFERRED);
+	UniformRing * uniformRing = vulkan->GetUniformRing();
+	DynamicOffsets dynamicOffsets;
+	dynamicOffsets.offsets[0] = WriteUniformData(uniformRing, pass, 0, &vertexUniformBuffer, sizeof(vertexUniformBuffer));
+	dynamicOffsets.offsets[1] = 0;
+	dynamicOffsets.count = 1;
+
+	if (vulkanPipeline->GetPipelineName() == "DEFERRED" || bindless)
+	{
+		if (!bindless)
+			for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+				asset->GetMesh(i)->UpdateUniformBuffer(vulkan);
 
-	deferredVS_UBO->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(vertexUniformBuffer));
+		unsigned int lod = SelectLod(MODEL_PASS_DEFERRED, screenSize);
+		CountTriangles(MODEL_PASS_DEFERRED, lod, 1);
+
+		// Descriptor sets are looked up here, the recording threads only record
+		std::vector<VkDescriptorSet> * descriptorSets = GetDescriptorSets(vulkan, vulkanPipeline, NULL, MODEL_PASS_DEFERRED);
+
+		if (cacheEnabled)
+		{
+			RenderCached(vulkan, recorder, vulkanPipeline, NULL, MODEL_PASS_DEFERRED, dynamicOffsets, lod);
+			return;
+		}
 
-	for (unsigned int i = 0; i < meshes.size(); i++)
+		recorder->AddTask([this, vulkan, vulkanPipeline, descriptorSets, dynamicOffsets, lod](CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)
+		{
+			for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+				RecordMesh(vulkan, recorder->GetCommandBuffer(threadId, taskId), vulkanPipeline, asset->GetMesh(i), NULL, (*descriptorSets)[i], dynamicOffsets, lod);
+		});
+	}
+	else if (vulkanPipeline->GetPipelineName() == "SHADOW")
 	{
-		if (vulkanPipeline->GetPipelineName() == "DEFERRED")
+		dynamicOffsets.offsets[1] = WriteUniformData(uniformRing, MODEL_PASS_SHADOW, 1, &frustumCullData, sizeof(frustumCullData));
+		dynamicOffsets.count = 2;
+
+		unsigned int lod = SelectLod(MODEL_PASS_SHADOW, GetShadowMapSize(shadowMaps));
+		CountTriangles(MODEL_PASS_SHADOW, lod, 1);
+
+		std::vector<VkDescriptorSet> * descriptorSets = GetDescriptorSets(vulkan, vulkanPipeline, shadowMaps, MODEL_PASS_SHADOW);
+
+		if (cacheEnabled)
 		{
-			meshes[i]->UpdateUniformBuffer(vulkan);
-			UpdateDescriptorSet(vulkan, vulkanPipeline, meshes[i], NULL);
+			RenderCached(vulkan, recorder, vulkanPipeline, shadowMaps, MODEL_PASS_SHADOW, dynamicOffsets, lod);
+			return;
+		}
+
+		recorder->AddTask([this, vulkan, vulkanPipeline, shadowMaps, descriptorSets, dynamicOffsets, lod](CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)
+		{
+			for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+				RecordMesh(vulkan, recorder->GetCommandBuffer(threadId, taskId), vulkanPipeline, asset->GetMesh(i), shadowMaps, (*descriptorSets)[i], dynamicOffsets, lod);
+		});
+	}
+}
+
+unsigned int Model::PrepareInstance(Camera * camera, ShadowMaps * shadowMaps, ModelInstanceData * instanceData)
+{
+	btTransform transform;
+
+	rigidBody->getMotionState()->getWorldTransform(transform);
+
+	transform.getOpenGLMatrix((btScalar*)&instanceData->worldMatrix);
+
+	instanceData->shadowCascades = glm::vec4(0.0f);
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+		instanceData->shadowCascades[i] = frustumCullData.frustumCullCascade[i];
+
+	// Textures are shared, the closest instance decides how many levels they stream in. The level of detail is the instance's own,
+	// the batches are split by it
+	if (camera)
+	{
+		float screenSize = GetScreenSize(camera, transform);
+		RequestTextureScreenSize(screenSize);
+		return SelectLod(MODEL_PASS_DEFERRED, screenSize);
+	}
+
+	return SelectLod(MODEL_PASS_SHADOW, GetShadowMapSize(shadowMaps));
+}
+
+void Model::RenderInstanced(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
+	Camera * camera, ShadowMaps * shadowMaps, uint32_t instanceOffset, uint32_t instanceCount, unsigned int lod)
+{
+	// Called on one model of the batch, the others only gave their instance data
+	for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+		if (!asset->GetMesh(i)->MakeResident(vulkan))
+			THROW_ERROR();
+
+	DynamicOffsets dynamicOffsets;
+	dynamicOffsets.offsets[0] = 0;
+	dynamicOffsets.offsets[1] = 0;
+	dynamicOffsets.count = 0;
+
+	bool deferred = (vulkanPipeline->GetPipelineName() == "DEFERREDINSTANCED");
+	CountTriangles(deferred ? MODEL_PASS_DEFERRED : MODEL_PASS_SHADOW, lod, instanceCount);
+
+	if (deferred)
+	{
+		// One slice for the whole batch, the shader applies each instance's world matrix to the view projection
+		VertexUniformBuffer batchUniformBuffer;
+		batchUniformBuffer.MVP = camera->GetProjectionMatrix() * camera->GetViewMatrix();
+		batchUniformBuffer.worldMatrix = glm::mat4(1.0f);
+
+		dynamicOffsets.offsets[0] = vulkan->GetUniformRing()->Allocate(&batchUniformBuffer, sizeof(batchUniformBuffer));
+		dynamicOffsets.count = 1;
+
+		for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+			asset->GetMesh(i)->UpdateUniformBuffer(vulkan);
+	}
+
+	// Which model stands in for the batch changes from frame to frame, so the sets come straight from the pipeline's cache
+	std::vector<VkDescriptorSet> descriptorSets;
+	for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+		descriptorSets.push_back(GetDescriptorSet(vulkan, vulkanPipeline, asset->GetMesh(i), shadowMaps));
 
-			// Record draw command
-			drawCmdBuffers[i]->BeginRecordingSecondary(vulkan->GetDeferredRenderpass()->GetRenderpass(), vulkan->GetDeferredFramebuffer());
+	recorder->AddTask([this, vulkan, vulkanPipeline, shadowMaps, descriptorSets, dynamicOffsets, lod, instanceOffset, instanceCount](CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)
+	{
+		for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+			RecordMesh(vulkan, recorder->GetCommandBuffer(threadId, taskId), vulkanPipeline, asset->GetMesh(i), shadowMaps, descriptorSets[i], dynamicOffsets,
+				lod, instanceOffset, instanceCount);
+	});
+}
 
-			vulkan->InitViewportAndScissors(drawCmdBuffers[i], (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
-				(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
-			vulkanPipeline->SetActive(drawCmdBuffers[i]);
-			meshes[i]->Render(vulkan, drawCmdBuffers[i]);
+bool Model::InitCommandBufferCache(VulkanInterface * vulkan)
+{
+	// Own pool, a cached buffer can be re-recorded on any recording thread
+	cacheCommandPool = new VulkanCommandPool();
+	if (!cacheCommandPool->Init(vulkan->GetVulkanDevice()))
+	{
+		gLogManager->AddMessage("ERROR: Failed to create a command pool for cached command buffers!");
+		return false;
+	}
 
-			drawCmdBuffers[i]->EndRecording();
-			drawCmdBuffers[i]->ExecuteSecondary(commandBuffer);
+	for (int i = 0; i < MODEL_PASS_COUNT; i++)
+	{
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
+		{
+			for (unsigned int k = 0; k < asset->GetMeshCount(); k++)
+			{
+				VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
+				if (!cmdBuffer->Init(vulkan->GetVulkanDevice(), cacheCommandPool, false))
+				{
+					gLogManager->AddMessage("ERROR: Failed to create a cached secondary command buffer!");
+					return false;
+				}
+				cachedPasses[i][j].commandBuffers.push_back(cmdBuffer);
+			}
+
+			cachedPasses[i][j].framebuffer = VK_NULL_HANDLE;
+			cachedPasses[i][j].dynamicOffsets.count = 0;
+			cachedPasses[i][j].lod = 0;
+			cachedPasses[i][j].dirty = true;
 		}
-		else if (vulkanPipeline->GetPipelineName() == "SHADOW")
+	}
+
+	// Without a slot the model still works, its buffers are just re-recorded whenever its offsets move
+	UniformRing * uniformRing = vulkan->GetUniformRing();
+	for (int i = 0; i < MODEL_PASS_COUNT; i++)
+	{
+		ringSlots[i][0] = uniformRing->AllocateSlot(sizeof(VertexUniformBuffer));
+		if (i == MODEL_PASS_SHADOW)
+			ringSlots[i][1] = uniformRing->AllocateSlot(sizeof(FrustumUniformBuffer));
+	}
+
+	cacheEnabled = true;
+
+	return true;
+}
+
+void Model::SetCommandBufferCacheEnabled(bool enabled)
+{
+	cacheEnabled = (enabled && cacheCommandPool != NULL);
+}
+
+void Model::MarkDirty()
+{
+	// After a material change, the sets are looked up again and the cached buffers re-recorded
+	for (int i = 0; i < MODEL_PASS_COUNT; i++)
+	{
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
 		{
-			shadowGS_UBO->Update(vulkan->GetVulkanDevice(), &frustumCullData, sizeof(frustumCullData));
-			UpdateDescriptorSet(vulkan, vulkanPipeline, meshes[i], shadowMaps);
+			descriptorSets[i][j].clear();
+			cachedPasses[i][j].dirty = true;
+		}
+	}
+}
 
-			// Record draw command
-			drawCmdBuffers[i]->BeginRecordingSecondary(shadowMaps->GetShadowRenderpass()->GetRenderpass(), shadowMaps->GetFramebuffer());
+void Model::RenderCached(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
+	ShadowMaps * shadowMaps, MODEL_PASS pass, DynamicOffsets dynamicOffsets, unsigned int lod)
+{
+	CachedPass * cachedPass = &cachedPasses[pass][vulkan->GetFrameIndex()];
+
+	VkFramebuffer framebuffer = (pass == MODEL_PASS_SHADOW ? shadowMaps->GetFramebuffer() : vulkan->GetDeferredFramebuffer());
+	if (cachedPass->framebuffer != framebuffer)
+		cachedPass->dirty = true;
+
+	// Offsets are baked into the buffers, with ring slots they're the same every time the frame slot comes around
+	if (cachedPass->dynamicOffsets.count != dynamicOffsets.count)
+		cachedPass->dirty = true;
+	for (uint32_t i = 0; i < dynamicOffsets.count; i++)
+		if (cachedPass->dynamicOffsets.offsets[i] != dynamicOffsets.offsets[i])
+			cachedPass->dirty = true;
+
+	// The draws' index ranges too, a model changes level now and then
+	if (cachedPass->lod != lod)
+		cachedPass->dirty = true;
 
-			vulkan->InitViewportAndScissors(drawCmdBuffers[i], (float)shadowMaps->GetMapSize(), (float)shadowMaps->GetMapSize(),
-				shadowMaps->GetMapSize(), shadowMaps->GetMapSize());
+	// Transforms and cascade flags are rewritten at the same ring offsets, so they don't dirty anything
+	if (!cachedPass->dirty)
+	{
+		recorder->AddTask([cachedPass](CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)
+		{
+			for (unsigned int i = 0; i < cachedPass->commandBuffers.size(); i++)
+				recorder->AddCommandBuffer(taskId, cachedPass->commandBuffers[i]);
+		});
+		return;
+	}
 
-			shadowMaps->SetDepthBias(drawCmdBuffers[i]);
-			vulkanPipeline->SetActive(drawCmdBuffers[i]);
-			meshes[i]->Render(vulkan, drawCmdBuffers[i]);
+	// This frame slot's fence has been waited on, so its buffers are no longer in use
+	std::vector<VkDescriptorSet> * descriptorSets = &this->descriptorSets[pass][vulkan->GetFrameIndex()];
+	cachedPass->framebuffer = framebuffer;
+	cachedPass->dynamicOffsets = dynamicOffsets;
+	cachedPass->lod = lod;
+	cachedPass->dirty = false;
 
-			drawCmdBuffers[i]->EndRecording();
-			drawCmdBuffers[i]->ExecuteSecondary(commandBuffer);
+	recorder->AddTask([this, vulkan, vulkanPipeline, shadowMaps, cachedPass, descriptorSets, dynamicOffsets, lod](CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)
+	{
+		for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+		{
+			RecordMesh(vulkan, cachedPass->commandBuffers[i], vulkanPipeline, asset->GetMesh(i), shadowMaps, (*descriptorSets)[i], dynamicOffsets, lod);
+			recorder->AddCommandBuffer(taskId, cachedPass->commandBuffers[i]);
 		}
+	});
+}
+
+uint32_t Model::WriteUniformData(UniformRing * uniformRing, MODEL_PASS pass, unsigned int binding, const void * dataPtr, size_t dataSize)
+{
+	if (ringSlots[pass][binding] != UNIFORM_RING_NO_SLOT)
+		return uniformRing->WriteSlot(ringSlots[pass][binding], dataPtr, dataSize);
+
+	return uniformRing->Allocate(dataPtr, dataSize);
+}
+
+void Model::RecordMesh(VulkanInterface * vulkan, VulkanCommandBuffer * drawCmdBuffer, VulkanPipeline * pipeline, Mesh * mesh,
+	ShadowMaps * shadowMaps, VkDescriptorSet descriptorSet, DynamicOffsets dynamicOffsets, unsigned int lod, uint32_t instanceOffset,
+	uint32_t instanceCount)
+{
+	// Record draw command
+	if (shadowMaps)
+	{
+		drawCmdBuffer->BeginRecordingSecondary(shadowMaps->GetShadowRenderpass()->GetRenderpass(), shadowMaps->GetFramebuffer());
+
+		vulkan->InitViewportAndScissors(drawCmdBuffer, (float)shadowMaps->GetMapSize(), (float)shadowMaps->GetMapSize(),
+			shadowMaps->GetMapSize(), shadowMaps->GetMapSize());
+
+		shadowMaps->SetDepthBias(drawCmdBuffer);
+	}
+	else
+	{
+		drawCmdBuffer->BeginRecordingSecondary(vulkan->GetDeferredRenderpass()->GetRenderpass(), vulkan->GetDeferredFramebuffer());
+
+		vulkan->InitViewportAndScissors(drawCmdBuffer, (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
+			(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
+	}
+
+	pipeline->SetActive(drawCmdBuffer, descriptorSet, dynamicOffsets.count, dynamicOffsets.offsets);
+
+	// Textures come from the shared array, only their indices change per draw
+	if (pipeline->GetPipelineName() == "DEFERREDBINDLESS")
+	{
+		pipeline->BindDescriptorSet(drawCmdBuffer, 1, gTextureManager->GetBindlessSet());
+
+		MaterialPushConstants pushConstants = mesh->GetMaterial()->GetPushConstants();
+		pipeline->PushConstants(drawCmdBuffer, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(pushConstants), &pushConstants);
+	}
+
+	// Instance data was written to the uniform ring ahead of the batch
+	if (instanceCount > 0)
+		mesh->RenderInstanced(vulkan, drawCmdBuffer, vulkan->GetUniformRing()->GetBuffer(), instanceOffset, instanceCount, lod);
+	else
+		mesh->Render(vulkan, drawCmdBuffer, lod);
+
+	drawCmdBuffer->EndRecording();
+}
+
+float Model::GetScreenSize(Camera * camera, btTransform & transform)
+{
+	// Height of the bounding sphere on screen in pixels
+	btVector3 origin = transform.getOrigin();
+	float distance = glm::length(camera->GetPosition() - glm::vec3(origin.getX(), origin.getY(), origin.getZ()));
+	float frustumCullRadius = asset->GetFrustumCullRadius();
+	if (distance < frustumCullRadius)
+		distance = frustumCullRadius;
+
+	if (distance <= 0.0f)
+		return 0.0f;
+
+	return frustumCullRadius * camera->GetProjectionMatrix()[1][1] * gSettings->GetWindowHeight() / distance;
+}
+
+float Model::GetShadowMapSize(ShadowMaps * shadowMaps)
+{
+	// Height of the bounding sphere in texels of the finest cascade it's in. The farther cascades spread the same map over up to
+	// 50 units, the bias then halves the size per level
+	int cascade = SHADOW_CASCADE_COUNT - 1;
+	for (int i = SHADOW_CASCADE_COUNT - 1; i >= 0; i--)
+		if (frustumCullData.frustumCullCascade[i] != 0.0f)
+			cascade = i;
+
+	return 2.0f * asset->GetFrustumCullRadius() * shadowMaps->GetTexelsPerUnit(cascade) / (float)(1 << SHADOW_LOD_BIAS);
+}
+
+unsigned int Model::SelectLod(MODEL_PASS pass, float screenSize)
+{
+	unsigned int lodCount = 1;
+	for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+		if (asset->GetMesh(i)->GetLodCount() > lodCount)
+			lodCount = asset->GetMesh(i)->GetLodCount();
+
+	// The level the size calls for
+	unsigned int lod = 0;
+	while (lod + 1 < lodCount && screenSize < LOD_SCREEN_SIZE / (float)(1 << lod))
+		lod++;
+
+	// Leaving the current level takes being past its boundary by the margin
+	unsigned int currentLod = lods[pass];
+	if (lod > currentLod && screenSize >= LOD_SCREEN_SIZE / (float)(1 << currentLod) * (1.0f - LOD_HYSTERESIS))
+		lod = currentLod;
+	else if (lod < currentLod && screenSize < LOD_SCREEN_SIZE / (float)(1 << (currentLod - 1)) * (1.0f + LOD_HYSTERESIS))
+		lod = currentLod;
+
+	lods[pass] = lod;
+	return lod;
+}
+
+void Model::CountTriangles(MODEL_PASS pass, unsigned int lod, uint32_t instanceCount)
+{
+	for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+	{
+		triangleCounts[pass].submitted += (uint64_t)asset->GetMesh(i)->GetTriangleCount(lod) * instanceCount;
+		triangleCounts[pass].fullDetail += (uint64_t)asset->GetMesh(i)->GetTriangleCount(0) * instanceCount;
 	}
 }
 
+void Model::RequestTextureScreenSize(float screenSize)
+{
+	// Streamed textures load levels until they have about as many texels as the model has pixels
+	for (unsigned int i = 0; i < asset->GetTextureCount(); i++)
+		asset->GetTexture(i)->RequestScreenSize(screenSize);
+}
+
 void Model::SetPosition(float x, float y, float z)
 {
 	
@@ -186,22 +536,27 @@ void Model::SetFrustumCullData(float * data)
 
 unsigned int Model::GetMeshCount()
 {
-	return (unsigned int)meshes.size();
+	return asset->GetMeshCount();
 }
 
 Mesh * Model::GetMesh(int meshId)
 {
-	return meshes[meshId];
+	return asset->GetMesh(meshId);
 }
 
 Material * Model::GetMaterial(int materialId)
 {
-	return materials[materialId];
+	return asset->GetMaterial(materialId);
+}
+
+ModelAsset * Model::GetAsset()
+{
+	return asset;
 }
 
 float Model::GetFrustumCullRadius()
 {
-	return frustumCullRadius;
+	return asset->GetFrustumCullRadius();
 }
 
 glm::vec3 Model::GetPosition()
@@ -213,19 +568,43 @@ glm::vec3 Model::GetPosition()
 	return glm::vec3(origin.getX(), origin.getY(), origin.getZ());
 }
 
-void Model::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, Mesh * mesh, ShadowMaps * shadowMaps)
+std::vector<VkDescriptorSet> * Model::GetDescriptorSets(VulkanInterface * vulkan, VulkanPipeline * pipeline, ShadowMaps * shadowMaps,
+	MODEL_PASS pass)
 {
-	if (pipeline->GetPipelineName() == "DEFERRED")
+	std::vector<VkDescriptorSet> * sets = &descriptorSets[pass][vulkan->GetFrameIndex()];
+
+	// Only looked up once, after that the sets are just bound
+	if (sets->size() != asset->GetMeshCount())
+	{
+		sets->clear();
+		for (unsigned int i = 0; i < asset->GetMeshCount(); i++)
+			sets->push_back(GetDescriptorSet(vulkan, pipeline, asset->GetMesh(i), shadowMaps));
+	}
+
+	return sets;
+}
+
+VkDescriptorSet Model::GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, Mesh * mesh, ShadowMaps * shadowMaps)
+{
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	bool result = false;
+
+	// Per draw data lives in the uniform ring, the slice is picked by the dynamic offset
+	VkDescriptorBufferInfo vsBufferInfo = vulkan->GetUniformRing()->GetBufferInfo(sizeof(VertexUniformBuffer));
+	VkDescriptorBufferInfo gsBufferInfo = vulkan->GetUniformRing()->GetBufferInfo(sizeof(FrustumUniformBuffer));
+
+	// The instanced variant has the same set, only binding 0 holds the view projection instead
+	if (pipeline->GetPipelineName() == "DEFERRED" || pipeline->GetPipelineName() == "DEFERREDINSTANCED")
 	{
 		VkWriteDescriptorSet descriptorWrite[5];
 
 		descriptorWrite[0] = {};
 		descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[0].pNext = NULL;
-		descriptorWrite[0].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[0].descriptorCount = 1;
-		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[0].pBufferInfo = deferredVS_UBO->GetBufferInfo();
+		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[0].pBufferInfo = &vsBufferInfo;
 		descriptorWrite[0].dstArrayElement = 0;
 		descriptorWrite[0].dstBinding = 0;
 
@@ -238,7 +617,6 @@ void Model::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipel
 		descriptorWrite[1] = {};
 		descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[1].pNext = NULL;
-		descriptorWrite[1].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[1].descriptorCount = 1;
 		descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWrite[1].pImageInfo = &diffuseTextureDesc;
@@ -254,7 +632,6 @@ void Model::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipel
 		descriptorWrite[2] = {};
 		descriptorWrite[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[2].pNext = NULL;
-		descriptorWrite[2].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[2].descriptorCount = 1;
 		descriptorWrite[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWrite[2].pImageInfo = &materialTextureDesc;
@@ -273,7 +650,6 @@ void Model::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipel
 		descriptorWrite[3] = {};
 		descriptorWrite[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[3].pNext = NULL;
-		descriptorWrite[3].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[3].descriptorCount = 1;
 		descriptorWrite[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWrite[3].pImageInfo = (mesh->GetMaterial()->HasNormalMap() ? &normalTextureDesc : &diffuseTextureDesc);
@@ -284,14 +660,29 @@ void Model::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipel
 		descriptorWrite[4] = {};
 		descriptorWrite[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[4].pNext = NULL;
-		descriptorWrite[4].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[4].descriptorCount = 1;
 		descriptorWrite[4].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		descriptorWrite[4].pBufferInfo = mesh->GetMaterialBufferInfo();
 		descriptorWrite[4].dstArrayElement = 0;
 		descriptorWrite[4].dstBinding = 4;
 
-		vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, NULL);
+		result = pipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), descriptorWrite, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), &descriptorSet);
+	}
+	else if (pipeline->GetPipelineName() == "DEFERREDBINDLESS")
+	{
+		// Same set for every mesh of the model, the cache hands it out once
+		VkWriteDescriptorSet descriptorWrite[1];
+
+		descriptorWrite[0] = {};
+		descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite[0].pNext = NULL;
+		descriptorWrite[0].descriptorCount = 1;
+		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[0].pBufferInfo = &vsBufferInfo;
+		descriptorWrite[0].dstArrayElement = 0;
+		descriptorWrite[0].dstBinding = 0;
+
+		result = pipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), descriptorWrite, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), &descriptorSet);
 	}
 	else if (pipeline->GetPipelineName() == "SHADOW")
 	{
@@ -300,215 +691,56 @@ void Model::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipel
 		descriptorWrite[0] = {};
 		descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[0].pNext = NULL;
-		descriptorWrite[0].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[0].descriptorCount = 1;
-		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[0].pBufferInfo = deferredVS_UBO->GetBufferInfo();
+		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[0].pBufferInfo = &vsBufferInfo;
 		descriptorWrite[0].dstArrayElement = 0;
 		descriptorWrite[0].dstBinding = 0;
 
 		descriptorWrite[1] = {};
 		descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[1].pNext = NULL;
-		descriptorWrite[1].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[1].descriptorCount = 1;
 		descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[1].pBufferInfo = shadowMaps->GetBufferInfo();
+		descriptorWrite[1].pBufferInfo = shadowMaps->GetBufferInfo(frameIndex);
 		descriptorWrite[1].dstArrayElement = 0;
 		descriptorWrite[1].dstBinding = 1;
 
 		descriptorWrite[2] = {};
 		descriptorWrite[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[2].pNext = NULL;
-		descriptorWrite[2].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[2].descriptorCount = 1;
-		descriptorWrite[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[2].pBufferInfo = shadowGS_UBO->GetBufferInfo();
+		descriptorWrite[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[2].pBufferInfo = &gsBufferInfo;
 		descriptorWrite[2].dstArrayElement = 0;
 		descriptorWrite[2].dstBinding = 2;
 
-		vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, NULL);
+		result = pipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), descriptorWrite, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), &descriptorSet);
 	}
-}
-
-bool Model::InitUniformBuffers(VulkanDevice * vulkanDevice)
-{
-	deferredVS_UBO = new VulkanBuffer();
-	if (!deferredVS_UBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer,
-		sizeof(vertexUniformBuffer), false))
+	else if (pipeline->GetPipelineName() == "SHADOWINSTANCED")
 	{
-		gLogManager->AddMessage("ERROR: Failed to init deferred vs uniform buffer!");
-		return false;
-	}
-
-	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
-		frustumCullData.frustumCullCascade[i] = 0.0f;
-	shadowGS_UBO = new VulkanBuffer();
-	if (!shadowGS_UBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &frustumCullData,
-		sizeof(frustumCullData), false))
-	{
-		gLogManager->AddMessage("ERROR: Failed to init shadow gs uniform buffer!");
-		return false;
-	}
-
-	return true;
-}
-
-bool Model::ReadRCMFile(VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer, std::string filename)
-{
-	// Open .rcm file
-	FILE * file = fopen(filename.c_str(), "rb");
-	if (file == NULL)
-	{
-		gLogManager->AddMessage("ERROR: Model file not found!");
-		return false;
-	}
-
-	// Open .mat file
-	size_t pos = filename.rfind('.');
-	filename.replace(pos, 4, ".mat");
-
-	std::ifstream matFile(filename.c_str());
-	if (!matFile.is_open())
-	{
-		gLogManager->AddMessage("ERROR: Model .mat file not found! (" + filename + ")");
-		return false;
-	}
-
-	unsigned int meshCount;
-	fread(&meshCount, sizeof(unsigned int), 1, file);
-	fread(&frustumCullRadius, sizeof(float), 1, file);
-
-	for (unsigned int i = 0; i < meshCount; i++)
-	{
-		// Create and read mesh data
-		char meshIdentifier[16];
-		sprintf(meshIdentifier, "_mesh%d", i);
-
-		Mesh * mesh = new Mesh();
-		if (!mesh->Init(vulkan, file, filename + meshIdentifier))
-		{
-			gLogManager->AddMessage("ERROR: Failed to init a mesh!");
-			return false;
-		}
-		meshes.push_back(mesh);
-
-		std::string texturePath;
-		char diffuseTextureName[64];
-		char normalTextureName[64];
-
-		// Init mesh material
-		Material * material = new Material();
+		// Transforms and cascade flags come per instance, only the cascade matrices are left
+		VkWriteDescriptorSet descriptorWrite[1];
 
-		// Read diffuse texture
-		fread(diffuseTextureName, sizeof(char), 64, file);
-		if (strcmp(diffuseTextureName, "NONE") == 0)
-			texturePath = "data/textures/default_diffuse.rct";
-		else
-			texturePath = "data/textures/" + std::string(diffuseTextureName);
-
-		Texture * diffuse = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), cmdBuffer);
-		if (diffuse == nullptr)
-			return false;
-
-		textures.push_back(diffuse);
-
-		material->SetDiffuseTexture(diffuse);
-
-		// Read normal texture if it's available
-		fread(normalTextureName, sizeof(char), 64, file);
-		if (strcmp(normalTextureName, "NONE") != 0)
-		{
-			texturePath = "data/textures/" + std::string(normalTextureName);
-
-			Texture * normal = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), cmdBuffer);
-			if (normal == nullptr)
-				return false;
-
-			textures.push_back(normal);
-
-			material->SetNormalTexture(normal);
-		}
-
-		std::string matName, matTextureName;
-		float metallicOffset, roughnessOffset;
-		matFile >> matName >> matTextureName >> metallicOffset >> roughnessOffset;
-
-		// Read material texture
-		if (matTextureName == "NONE")
-			texturePath = "data/textures/default_material.rct";
-		else
-			texturePath = "data/textures/" + matTextureName;
-
-		Texture * matTexture = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), cmdBuffer);
-		if (matTexture == nullptr)
-			return false;
-
-		textures.push_back(matTexture);
-
-		material->SetMaterialTexture(matTexture);
-		material->SetMetallicOffset(metallicOffset);
-		material->SetRoughnessOffset(roughnessOffset);
-
-		materials.push_back(material);
-		meshes[i]->SetMaterial(material);
+		descriptorWrite[0] = {};
+		descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite[0].pNext = NULL;
+		descriptorWrite[0].descriptorCount = 1;
+		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite[0].pBufferInfo = shadowMaps->GetBufferInfo(frameIndex);
+		descriptorWrite[0].dstArrayElement = 0;
+		descriptorWrite[0].dstBinding = 0;
 
-		// Init draw command buffers for each meash
-		VulkanCommandBuffer * drawCmdBuffer = new VulkanCommandBuffer();
-		if (!drawCmdBuffer->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), false))
-		{
-			gLogManager->AddMessage("ERROR: Failed to create a draw command buffer!");
-			return false;
-		}
-		drawCmdBuffers.push_back(drawCmdBuffer);
+		result = pipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), descriptorWrite, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), &descriptorSet);
 	}
 
-	fclose(file);
-	matFile.close();
-
-	return true;
-}
-
-void Model::ReadCollisionFile(std::string filename)
-{
-	size_t pos = filename.rfind('.');
-	filename.replace(pos, 4, ".col");
-
-	FILE * colFile = fopen(filename.c_str(), "rb");
-	if (colFile == NULL)
-		collisionMeshPresent = false;
-	else
+	if (!result)
 	{
-		collisionMeshPresent = true;
-
-		collisionMesh = new btTriangleMesh();
-
-		struct ColVertex
-		{
-			float x, y, z;
-		};
-
-		unsigned int colVertexCount;
-
-		fread(&colVertexCount, sizeof(unsigned int), 1, colFile);
-		for (unsigned int i = 0; i < colVertexCount / 3; i++)
-		{
-			btVector3 v0, v1, v2;
-			ColVertex colVertex;
-
-			fread(&colVertex, sizeof(ColVertex), 1, colFile);
-			v0 = btVector3(colVertex.x, colVertex.y, colVertex.z);
-			fread(&colVertex, sizeof(ColVertex), 1, colFile);
-			v1 = btVector3(colVertex.x, colVertex.y, colVertex.z);
-			fread(&colVertex, sizeof(ColVertex), 1, colFile);
-			v2 = btVector3(colVertex.x, colVertex.y, colVertex.z);
-
-			collisionMesh->addTriangle(v0, v1, v2);
-		}
+		gLogManager->AddMessage("ERROR: Failed to get a descriptor set for a model!");
+		THROW_ERROR();
 	}
 
-	if (colFile)
-		fclose(colFile);
+	return descriptorSet;
 }
 
 void Model::SetupPhysicsObject(float mass)
@@ -516,45 +748,16 @@ void Model::SetupPhysicsObject(float mass)
 	this->mass = (btScalar)mass;
 
 	physicsStatic = false;
-	if (mass == 0.0f)
+	if (mass == 0.0f || !asset->HasCollisionMesh())
 		physicsStatic = true;
 
-	if (collisionMeshPresent == false)
-	{
-		emptyCollisionShape = new btEmptyShape();
-		physicsStatic = true;
-	}
-	else
-	{
-		collisionShape = new btGImpactMeshShape(collisionMesh);
-		collisionShape->setLocalScaling(btVector3(1, 1, 1));
-		collisionShape->setMargin(0.0f);
-		collisionShape->updateBound();
-	}
-
 	btTransform transform;
 	transform.setIdentity();
 
+	// The asset's shape is shared, only the body and its inertia belong to this model
 	inertia = btVector3(0.0f, 0.0f, 0.0f);
-
-	if (physicsStatic == true)
-	{
-		if (collisionMeshPresent)
-		{
-			collisionShape->calculateLocalInertia(mass, inertia);
-			mainCollisionShape = collisionShape;
-		}
-		else
-		{
-			emptyCollisionShape->calculateLocalInertia(mass, inertia);
-			mainCollisionShape = emptyCollisionShape;
-		}
-	}
-	else
-	{
-		collisionShape->calculateLocalInertia(mass, inertia);
-		mainCollisionShape = collisionShape;
-	}
+	mainCollisionShape = asset->GetCollisionShape();
+	mainCollisionShape->calculateLocalInertia(mass, inertia);
 
 	CreateRigidBody(transform);
 }
@@ -578,6 +781,19 @@ void Model::RemoveRigidBody()
 
 void Model::DeleteCollision()
 {
-	emptyCollisionShape = new btEmptyShape();
+	// The shared shape stays with the asset, this model gets an empty one of its own
+	if (emptyCollisionShape == NULL)
+		emptyCollisionShape = new btEmptyShape();
 	mainCollisionShape = emptyCollisionShape;
-}
\ No newline at end of file
+}
+
+void Model::ResetTriangleCounts()
+{
+	for (int i = 0; i < MODEL_PASS_COUNT; i++)
+		triangleCounts[i] = {};
+}
+
+TriangleCounts Model::GetTriangleCounts(MODEL_PASS pass)
+{
+	return triangleCounts[pass];
+}
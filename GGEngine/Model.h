@@ -1,22 +1,46 @@
 #pragma once
 
-#include <BulletCollision/Gimpact/btGimpactShape.h>
-
-#include "Mesh.h"
+#include "ModelAsset.h"
 #include "Camera.h"
-#include "Texture.h"
-#include "Material.h"
 #include "Physics.h"
 #include "ShadowMaps.h"
+#include "CommandRecorder.h"
+
+enum MODEL_PASS
+{
+	MODEL_PASS_DEFERRED,
+	MODEL_PASS_SHADOW,
+	MODEL_PASS_COUNT
+};
+
+// A model smaller on screen than this many pixels draws a coarser level of detail, and one more for every halving of its size
+#define LOD_SCREEN_SIZE 320.0f
+
+// Levels only change once the size is this far past a boundary, so models sitting on one don't switch every frame
+#define LOD_HYSTERESIS 0.1f
+
+// Shadow casters are sized by the shadow map of the finest cascade they're in, then drawn this many levels coarser still
+#define SHADOW_LOD_BIAS 1
 
+// Triangles a pass submitted and the ones it would have at full detail
+struct TriangleCounts
+{
+	uint64_t submitted;
+	uint64_t fullDetail;
+};
+
+// Read once per instance from vertex binding 1 by the instanced pipelines
+struct ModelInstanceData
+{
+	glm::mat4 worldMatrix;
+	glm::vec4 shadowCascades;
+};
+
+// One placed copy of a model asset, only the transform, rigid body and per draw data are its own
 class Model
 {
 	private:
-		std::vector<Mesh*> meshes;
-		std::vector<Texture*> textures;
-		std::vector<Material*> materials;
-		std::vector<VulkanCommandBuffer*> drawCmdBuffers;
-		float frustumCullRadius;
+		ModelAsset * asset;
 
 		struct VertexUniformBuffer
 		{
@@ -31,27 +55,66 @@ class Model
 		};
 		FrustumUniformBuffer frustumCullData;
 
-		VulkanBuffer * deferredVS_UBO;
-		VulkanBuffer * shadowGS_UBO;
+		// Where this draw's uniform data went in the frame's uniform ring, in binding order
+		struct DynamicOffsets
+		{
+			uint32_t offsets[2];
+			uint32_t count;
+		};
+
+		// One set per mesh, pass and frame slot, looked up once from the pipeline's cache
+		std::vector<VkDescriptorSet> descriptorSets[MODEL_PASS_COUNT][MAX_FRAMES_IN_FLIGHT];
+
+		// Secondaries of static models, recorded once per pass and frame slot and replayed until dirty
+		struct CachedPass
+		{
+			std::vector<VulkanCommandBuffer*> commandBuffers;
+			VkFramebuffer framebuffer;
+			DynamicOffsets dynamicOffsets;
+			unsigned int lod;
+			bool dirty;
+		};
+		VulkanCommandPool * cacheCommandPool;
+		bool cacheEnabled;
+		CachedPass cachedPasses[MODEL_PASS_COUNT][MAX_FRAMES_IN_FLIGHT];
+
+		// Fixed places in the uniform ring's frame regions for cached models, so the offsets baked into their buffers don't move
+		uint32_t ringSlots[MODEL_PASS_COUNT][2];
+
+		// Sum of the meshes' and textures' residency versions, a change means one of them got a new buffer or image
+		uint32_t residencyVersionSum;
+
+		// Level of detail each pass drew last, the hysteresis is measured from it
+		unsigned int lods[MODEL_PASS_COUNT];
+
+		// Added up on the main thread as the draws are handed to the recorder
+		static TriangleCounts triangleCounts[MODEL_PASS_COUNT];
 
 		Physics * physics;
-		bool collisionMeshPresent;
 		bool physicsStatic;
 		btCollisionShape * emptyCollisionShape;
-		btGImpactMeshShape * collisionShape;
 		btCollisionShape * mainCollisionShape;
-		btTriangleMesh * collisionMesh;
 		btRigidBody * rigidBody;
 		btScalar mass;
 		btVector3 inertia;
 	private:
-		bool InitUniformBuffers(VulkanDevice * vulkanDevice);
-		bool ReadRCMFile(VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer, std::string filename);
-		void ReadCollisionFile(std::string filename);
 		void SetupPhysicsObject(float mass);
 		void CreateRigidBody(btTransform transform);
 		void RemoveRigidBody();
-		void UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, Mesh * mesh, ShadowMaps * shadowMaps);
+		VkDescriptorSet GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, Mesh * mesh, ShadowMaps * shadowMaps);
+		std::vector<VkDescriptorSet> * GetDescriptorSets(VulkanInterface * vulkan, VulkanPipeline * pipeline, ShadowMaps * shadowMaps,
+			MODEL_PASS pass);
+		void RecordMesh(VulkanInterface * vulkan, VulkanCommandBuffer * drawCmdBuffer, VulkanPipeline * pipeline, Mesh * mesh,
+			ShadowMaps * shadowMaps, VkDescriptorSet descriptorSet, DynamicOffsets dynamicOffsets, unsigned int lod,
+			uint32_t instanceOffset = 0, uint32_t instanceCount = 0);
+		void RenderCached(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
+			ShadowMaps * shadowMaps, MODEL_PASS pass, DynamicOffsets dynamicOffsets, unsigned int lod);
+		uint32_t WriteUniformData(UniformRing * uniformRing, MODEL_PASS pass, unsigned int binding, const void * dataPtr, size_t dataSize);
+		float GetScreenSize(Camera * camera, btTransform & transform);
+		float GetShadowMapSize(ShadowMaps * shadowMaps);
+		unsigned int SelectLod(MODEL_PASS pass, float screenSize);
+		void CountTriangles(MODEL_PASS pass, unsigned int lod, uint32_t instanceCount);
+		void RequestTextureScreenSize(float screenSize);
 	public:
 		Model();
 		~Model();
@@ -59,8 +122,14 @@ class Model
 		bool Init(std::string filename, VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer,
 			Physics * physics, float mass);
 		void Unload(VulkanInterface * vulkan);
-		void Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * vulkanPipeline,
+		bool InitCommandBufferCache(VulkanInterface * vulkan);
+		void SetCommandBufferCacheEnabled(bool enabled);
+		void MarkDirty();
+		void Render(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
 			Camera * camera, ShadowMaps * shadowMaps);
+		unsigned int PrepareInstance(Camera * camera, ShadowMaps * shadowMaps, ModelInstanceData * instanceData);
+		void RenderInstanced(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
+			Camera * camera, ShadowMaps * shadowMaps, uint32_t instanceOffset, uint32_t instanceCount, unsigned int lod);
 		void SetPosition(float x, float y, float z);
 		void SetRotation(float x, float y, float z);
 		void SetVelocity(float x, float y, float z);
@@ -68,7 +137,11 @@ class Model
 		unsigned int GetMeshCount();
 		Mesh * GetMesh(int meshId);
 		Material * GetMaterial(int materialId);
+		ModelAsset * GetAsset();
 		float GetFrustumCullRadius();
 		glm::vec3 GetPosition();
 		void DeleteCollision();
+
+		static void ResetTriangleCounts();
+		static TriangleCounts GetTriangleCounts(MODEL_PASS pass);
 };
\ No newline at end of file
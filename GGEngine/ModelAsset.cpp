@@ -0,0 +1,234 @@
+#include "ModelAsset.h"
+#include "StdInc.h"
+#include "LogManager.h"
+#include "TextureManager.h"
+#include "ModelManager.h"
+
+extern LogManager * gLogManager;
+extern TextureManager * gTextureManager;
+extern ModelManager * gModelManager;
+
+ModelAsset::ModelAsset()
+{
+	frustumCullRadius = 0.0f;
+	collisionMesh = NULL;
+	collisionShape = NULL;
+	emptyCollisionShape = NULL;
+	handle = INVALID_RESOURCE_HANDLE;
+}
+
+ModelAsset::~ModelAsset()
+{
+	emptyCollisionShape = NULL;
+	collisionShape = NULL;
+	collisionMesh = NULL;
+}
+
+bool ModelAsset::Init(VulkanInterface * vulkan, std::string filename)
+{
+	if (!ReadRCMFile(vulkan, filename))
+		return false;
+
+	ReadCollisionFile(filename);
+
+	return true;
+}
+
+void ModelAsset::Unload(VulkanInterface * vulkan)
+{
+	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
+
+	// Every instance's rigid body was removed before the asset was released
+	SAFE_DELETE(collisionShape);
+	SAFE_DELETE(collisionMesh);
+	SAFE_DELETE(emptyCollisionShape);
+
+	for (unsigned int i = 0; i < textures.size(); i++)
+		gTextureManager->ReleaseTexture(textures[i], vulkanDevice);
+
+	// A failed load may leave a mesh without its material
+	for (unsigned int i = 0; i < materials.size(); i++)
+		SAFE_DELETE(materials[i]);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		SAFE_UNLOAD(meshes[i], vulkan);
+
+	// Released buffers are never restored, so the mapping can go with the meshes
+	file.Close();
+}
+
+unsigned int ModelAsset::GetMeshCount()
+{
+	return (unsigned int)meshes.size();
+}
+
+Mesh * ModelAsset::GetMesh(int meshId)
+{
+	return meshes[meshId];
+}
+
+Material * ModelAsset::GetMaterial(int materialId)
+{
+	return materials[materialId];
+}
+
+unsigned int ModelAsset::GetTextureCount()
+{
+	return (unsigned int)textures.size();
+}
+
+Texture * ModelAsset::GetTexture(int textureId)
+{
+	return textures[textureId];
+}
+
+float ModelAsset::GetFrustumCullRadius()
+{
+	return frustumCullRadius;
+}
+
+bool ModelAsset::HasCollisionMesh()
+{
+	return collisionShape != NULL;
+}
+
+btCollisionShape * ModelAsset::GetCollisionShape()
+{
+	if (collisionShape)
+		return collisionShape;
+
+	return emptyCollisionShape;
+}
+
+void ModelAsset::SetHandle(ResourceHandle handle)
+{
+	this->handle = handle;
+}
+
+ResourceHandle ModelAsset::GetHandle()
+{
+	return handle;
+}
+
+bool ModelAsset::ReadRCMFile(VulkanInterface * vulkan, std::string filename)
+{
+	if (!file.Open(filename, false))
+		return false;
+
+	frustumCullRadius = file.GetFrustumCullRadius();
+
+	for (unsigned int i = 0; i < file.GetMeshCount(); i++)
+	{
+		const MeshFileMesh & fileMesh = file.GetMesh(i);
+
+		// Create mesh from its data, named after this asset too, so one loaded again while this one waits for its frames
+		// in flight doesn't share buffers that restore from this mapping
+		char meshIdentifier[40];
+		sprintf(meshIdentifier, "_%p_mesh%d", (void*)this, i);
+
+		Mesh * mesh = new Mesh();
+		if (!mesh->Init(vulkan, fileMesh, filename + meshIdentifier, gModelManager->IsQuantizedVertices()))
+		{
+			gLogManager->AddMessage("ERROR: Failed to init a mesh!");
+			SAFE_UNLOAD(mesh, vulkan);
+			return false;
+		}
+		meshes.push_back(mesh);
+
+		std::string texturePath;
+
+		// Init mesh material
+		Material * material = new Material();
+		materials.push_back(material);
+		mesh->SetMaterial(material);
+
+		// Diffuse texture
+		if (fileMesh.diffuseTexture == "NONE")
+			texturePath = "data/textures/default_diffuse.rct";
+		else
+			texturePath = "data/textures/" + fileMesh.diffuseTexture;
+
+		Texture * diffuse = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), true);
+		if (diffuse == nullptr)
+			return false;
+
+		textures.push_back(diffuse);
+
+		material->SetDiffuseTexture(diffuse);
+
+		// Normal texture if it's available
+		if (fileMesh.normalTexture != "NONE")
+		{
+			texturePath = "data/textures/" + fileMesh.normalTexture;
+
+			Texture * normal = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), true);
+			if (normal == nullptr)
+				return false;
+
+			textures.push_back(normal);
+
+			material->SetNormalTexture(normal);
+		}
+
+		// Material texture
+		if (fileMesh.materialTexture == "NONE")
+			texturePath = "data/textures/default_material.rct";
+		else
+			texturePath = "data/textures/" + fileMesh.materialTexture;
+
+		Texture * matTexture = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), true);
+		if (matTexture == nullptr)
+			return false;
+
+		textures.push_back(matTexture);
+
+		material->SetMaterialTexture(matTexture);
+		material->SetMetallicOffset(fileMesh.metallicOffset);
+		material->SetRoughnessOffset(fileMesh.roughnessOffset);
+	}
+
+	return true;
+}
+
+void ModelAsset::ReadCollisionFile(std::string filename)
+{
+	size_t pos = filename.rfind('.');
+	filename.replace(pos, 4, ".col");
+
+	VirtualFile colFile;
+	if (!colFile.Open(filename))
+	{
+		emptyCollisionShape = new btEmptyShape();
+		return;
+	}
+
+	collisionMesh = new btTriangleMesh();
+
+	struct ColVertex
+	{
+		float x, y, z;
+	};
+
+	unsigned int colVertexCount;
+
+	colFile.Read(&colVertexCount, sizeof(unsigned int));
+	for (unsigned int i = 0; i < colVertexCount / 3; i++)
+	{
+		btVector3 v0, v1, v2;
+		ColVertex colVertex;
+
+		colFile.Read(&colVertex, sizeof(ColVertex));
+		v0 = btVector3(colVertex.x, colVertex.y, colVertex.z);
+		colFile.Read(&colVertex, sizeof(ColVertex));
+		v1 = btVector3(colVertex.x, colVertex.y, colVertex.z);
+		colFile.Read(&colVertex, sizeof(ColVertex));
+		v2 = btVector3(colVertex.x, colVertex.y, colVertex.z);
+
+		collisionMesh->addTriangle(v0, v1, v2);
+	}
+
+	// Bounds are computed once here, instances only move their bodies around the shared shape
+	collisionShape = new btGImpactMeshShape(collisionMesh);
+	collisionShape->setLocalScaling(btVector3(1, 1, 1));
+	collisionShape->setMargin(0.0f);
+	collisionShape->updateBound();
+}
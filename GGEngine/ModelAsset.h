@@ -0,0 +1,48 @@
+#pragma once
+
+#include <BulletCollision/Gimpact/btGimpactShape.h>
+
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "Texture.h"
+#include "Material.h"
+#include "ResourceRegistry.h"
+
+// Meshes, materials and collision shape parsed from one .rcm, .mat and .col, shared by every model spawned from them
+class ModelAsset
+{
+	private:
+		std::vector<Mesh*> meshes;
+		std::vector<Texture*> textures;
+		std::vector<Material*> materials;
+		float frustumCullRadius;
+
+		// Stays mapped as long as the asset, its meshes' evicted buffers are restored from it
+		MeshFile file;
+
+		// Shapes only hold local geometry, the rigid bodies of all instances point at the same ones
+		btTriangleMesh * collisionMesh;
+		btGImpactMeshShape * collisionShape;
+		btCollisionShape * emptyCollisionShape;
+
+		ResourceHandle handle;
+	private:
+		bool ReadRCMFile(VulkanInterface * vulkan, std::string filename);
+		void ReadCollisionFile(std::string filename);
+	public:
+		ModelAsset();
+		~ModelAsset();
+
+		bool Init(VulkanInterface * vulkan, std::string filename);
+		void Unload(VulkanInterface * vulkan);
+		unsigned int GetMeshCount();
+		Mesh * GetMesh(int meshId);
+		Material * GetMaterial(int materialId);
+		unsigned int GetTextureCount();
+		Texture * GetTexture(int textureId);
+		float GetFrustumCullRadius();
+		bool HasCollisionMesh();
+		btCollisionShape * GetCollisionShape();
+		void SetHandle(ResourceHandle handle);
+		ResourceHandle GetHandle();
+};
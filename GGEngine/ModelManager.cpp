@@ -0,0 +1,163 @@
+#include <filesystem>
+
+#include "ModelManager.h"
+#include "MeshFile.h"
+#include "UploadManager.h"
+#include "ResidencyManager.h"
+#include "LogManager.h"
+#include "Timer.h"
+#include "StdInc.h"
+
+namespace fs = std::experimental::filesystem;
+
+extern LogManager * gLogManager;
+extern UploadManager * gUploadManager;
+extern ResidencyManager * gResidencyManager;
+extern Timer * gTimer;
+
+ModelManager::ModelManager()
+{
+	quantizedVertices = false;
+}
+
+ModelAsset * ModelManager::RequestModel(std::string filename, VulkanInterface * vulkan)
+{
+	// If model is not loaded, parse its files once, loading jobs asking for it meanwhile wait for that
+	return modelsLoaded.Request(filename, [&filename, vulkan]() -> ModelAsset*
+	{
+		ModelAsset * model = new ModelAsset();
+		if (!model->Init(vulkan, filename))
+		{
+			gLogManager->AddMessage("ERROR: Couldn't init a model asset! (" + filename + ")");
+			SAFE_UNLOAD(model, vulkan);
+			return nullptr;
+		}
+
+		return model;
+	});
+}
+
+void ModelManager::ReleaseModel(ModelAsset * model, VulkanInterface * vulkan)
+{
+	// Its meshes' uniform buffers may still be read by frames in flight
+	if (model == nullptr || modelsLoaded.Get(model->GetHandle()) != model)
+		return;
+
+	modelsLoaded.Release(model->GetHandle(), gResidencyManager->GetFrame() + MAX_FRAMES_IN_FLIGHT);
+}
+
+void ModelManager::DestroyReleasedModels(VulkanInterface * vulkan, std::vector<VkBuffer> & destroyedBuffers, bool all)
+{
+	// The meshes' material buffers are in cached descriptor sets, their handles go to the caller to evict them
+	modelsLoaded.DestroyReleased(gResidencyManager->GetFrame(), all, [vulkan, &destroyedBuffers](ModelAsset * model)
+	{
+		for (unsigned int i = 0; i < model->GetMeshCount(); i++)
+			destroyedBuffers.push_back(model->GetMesh(i)->GetMaterialBufferInfo()->buffer);
+		SAFE_UNLOAD(model, vulkan);
+	});
+}
+
+size_t ModelManager::GetLoadedModelsCount()
+{
+	return modelsLoaded.GetCount();
+}
+
+void ModelManager::SetQuantizedVertices(bool quantized)
+{
+	// Set before anything is loaded, every mesh is stored in the layout the pipelines are built for
+	quantizedVertices = quantized;
+}
+
+bool ModelManager::IsQuantizedVertices()
+{
+	return quantizedVertices;
+}
+
+// Creates a staged vertex and index buffer for every mesh of the file, with the data copied to the heap first when asked
+static void LoadMeshBuffers(VulkanDevice * device, MeshFile & file, bool copyData, std::vector<VulkanBuffer*> & buffers)
+{
+	for (unsigned int i = 0; i < file.GetMeshCount(); i++)
+	{
+		const MeshFileMesh & mesh = file.GetMesh(i);
+		size_t vertexBytes = (size_t)mesh.vertexCount * file.GetVertexSize();
+		size_t indexBytes = (size_t)mesh.indexCount * mesh.indexSize;
+
+		const void * vertexData = mesh.vertexData;
+		const void * indexData = mesh.indexData;
+		std::vector<uint8_t> vertexCopy, indexCopy;
+		if (copyData)
+		{
+			vertexCopy.assign((const uint8_t*)mesh.vertexData, (const uint8_t*)mesh.vertexData + vertexBytes);
+			indexCopy.assign((const uint8_t*)mesh.indexData, (const uint8_t*)mesh.indexData + indexBytes);
+			vertexData = vertexCopy.data();
+			indexData = indexCopy.data();
+		}
+
+		VulkanBuffer * vertexBuffer = new VulkanBuffer();
+		if (vertexBuffer->Init(device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData, vertexBytes, true))
+			buffers.push_back(vertexBuffer);
+		else
+			SAFE_DELETE(vertexBuffer);
+
+		VulkanBuffer * indexBuffer = new VulkanBuffer();
+		if (indexBuffer->Init(device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexData, indexBytes, true))
+			buffers.push_back(indexBuffer);
+		else
+			SAFE_DELETE(indexBuffer);
+	}
+}
+
+void ModelManager::RunLoadBenchmark(VulkanDevice * device, std::string dataDir)
+{
+	std::vector<std::string> files;
+	for (auto & entry : fs::recursive_directory_iterator(dataDir))
+		if (entry.path().extension() == ".rcm" || entry.path().extension() == ".rcs")
+			files.push_back(entry.path().string());
+
+	if (files.empty())
+	{
+		gLogManager->AddMessage("MESH BENCHMARK: no .rcm/.rcs files in " + dataDir);
+		return;
+	}
+
+	char msg[192];
+	float times[2];
+	size_t totalBytes = 0;
+	unsigned int fileCounts[2] = {};
+
+	// Reference: the payloads copied to the heap before staging like the loaders used to, then staged straight from the mapping
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bool copyData = (pass == 0);
+		std::vector<VulkanBuffer*> buffers;
+
+		gTimer->BenchmarkCodeStart();
+		for (unsigned int i = 0; i < files.size(); i++)
+		{
+			bool skinned = (fs::path(files[i]).extension() == ".rcs");
+
+			MeshFile file;
+			if (!file.Open(files[i], skinned))
+				continue;
+
+			LoadMeshBuffers(device, file, copyData, buffers);
+
+			if (pass == 0)
+			{
+				totalBytes += file.GetSize();
+				fileCounts[file.GetVersion() == 1 ? 0 : 1]++;
+			}
+		}
+		gUploadManager->WaitIdle();
+		gTimer->BenchmarkCodeEnd();
+		times[pass] = gTimer->GetBenchmarkResult();
+
+		for (unsigned int i = 0; i < buffers.size(); i++)
+			SAFE_UNLOAD(buffers[i], device);
+	}
+
+	// Version 1 files parse their .mat on top, MeshConverter turns them into version 2
+	sprintf(msg, "MESH BENCHMARK: %u FILES (%u V1, %u V%d), %.2f MB: COPIED %f ms, IN PLACE %f ms", fileCounts[0] + fileCounts[1],
+		fileCounts[0], fileCounts[1], MESH_FORMAT_VERSION, totalBytes / (1024.0f * 1024.0f), times[0], times[1]);
+	gLogManager->AddMessage(msg);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include "ModelAsset.h"
+#include "ResourceRegistry.h"
+
+class ModelManager
+{
+	private:
+		ResourceRegistry<ModelAsset> modelsLoaded;
+		bool quantizedVertices;
+	public:
+		ModelManager();
+
+		ModelAsset * RequestModel(std::string filename, VulkanInterface * vulkan);
+		void ReleaseModel(ModelAsset * model, VulkanInterface * vulkan);
+		void DestroyReleasedModels(VulkanInterface * vulkan, std::vector<VkBuffer> & destroyedBuffers, bool all = false);
+		size_t GetLoadedModelsCount();
+		void SetQuantizedVertices(bool quantized);
+		bool IsQuantizedVertices();
+		void RunLoadBenchmark(VulkanDevice * device, std::string dataDir);
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// .pak archives start with the header, the table of contents and the name table follow it
+#define PAK_MAGIC 0x4B415047
+#define PAK_VERSION 1
+
+// Entry data starts on page boundaries, so a mapped entry can be handed out as is
+#define PAK_ALIGNMENT 4096
+
+enum PAK_ENTRY_FLAGS
+{
+	PAK_ENTRY_COMPRESSED = 1
+};
+
+struct PakHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t namesSize;
+};
+
+// Entries are sorted by name hash, the name is still compared in case two of them hash the same
+struct PakEntry
+{
+	uint64_t nameHash;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t storedSize;
+	uint32_t nameOffset;
+	uint32_t flags;
+};
+
+// Names are stored as the loaders ask for them, relative to the working directory with forward slashes
+inline void NormalizePakName(const char * name, char * normalized, size_t normalizedSize)
+{
+	size_t i = 0;
+	for (; name[i] != '\0' && i < normalizedSize - 1; i++)
+	{
+		char c = name[i];
+		if (c == '\\')
+			c = '/';
+		else if (c >= 'A' && c <= 'Z')
+			c = c - 'A' + 'a';
+		normalized[i] = c;
+	}
+	normalized[i] = '\0';
+}
+
+// 64 bit FNV-1a of the normalized name
+inline uint64_t HashPakName(const char * normalizedName)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char * c = normalizedName; *c != '\0'; c++)
+	{
+		hash ^= (uint8_t)*c;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+// Decodes an LZ4 block, returns false when the data doesn't decode to exactly dstSize bytes
+inline bool DecompressLz4Block(const uint8_t * src, size_t srcSize, uint8_t * dst, size_t dstSize)
+{
+	const uint8_t * srcEnd = src + srcSize;
+	uint8_t * dstStart = dst;
+	uint8_t * dstEnd = dst + dstSize;
+
+	while (src < srcEnd)
+	{
+		uint8_t token = *src++;
+
+		// Literals
+		size_t literalLength = token >> 4;
+		if (literalLength == 15)
+		{
+			uint8_t extra;
+			do
+			{
+				if (src >= srcEnd)
+					return false;
+				extra = *src++;
+				literalLength += extra;
+			} while (extra == 255);
+		}
+
+		if (literalLength > (size_t)(srcEnd - src) || literalLength > (size_t)(dstEnd - dst))
+			return false;
+
+		memcpy(dst, src, literalLength);
+		src += literalLength;
+		dst += literalLength;
+
+		// The last sequence only has literals
+		if (src == srcEnd)
+			break;
+
+		// Match, copied byte by byte because it may overlap itself
+		if (srcEnd - src < 2)
+			return false;
+
+		size_t offset = src[0] | (src[1] << 8);
+		src += 2;
+		if (offset == 0 || offset > (size_t)(dst - dstStart))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15)
+		{
+			uint8_t extra;
+			do
+			{
+				if (src >= srcEnd)
+					return false;
+				extra = *src++;
+				matchLength += extra;
+			} while (extra == 255);
+		}
+		matchLength += 4;
+
+		if (matchLength > (size_t)(dstEnd - dst))
+			return false;
+
+		const uint8_t * match = dst - offset;
+		for (size_t i = 0; i < matchLength; i++)
+			dst[i] = match[i];
+		dst += matchLength;
+	}
+
+	return dst == dstEnd;
+}
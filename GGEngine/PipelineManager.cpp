@@ -1,27 +1,43 @@
 #include "PipelineManager.h"
+#include "TextureManager.h"
+#include "Material.h"
+#include "Model.h"
+#include "MeshFormat.h"
+#include "ResidencyManager.h"
 #include "LogManager.h"
 #include "StdInc.h"
 
 extern LogManager * gLogManager;
+extern TextureManager * gTextureManager;
+extern ResidencyManager * gResidencyManager;
 
 PipelineManager::PipelineManager()
 {
 	defaultShader = NULL;
 	skinnedShader = NULL;
 	deferredShader = NULL;
+	deferredBindlessShader = NULL;
+	deferredInstancedShader = NULL;
 	wireframeShader = NULL;
 	skydomeShader = NULL;
 	canvasShader = NULL;
 	shadowShader = NULL;
+	shadowSkinnedShader = NULL;
+	shadowInstancedShader = NULL;
 
 	defaultPipeline = NULL;
 	skinnedPipeline = NULL;
 	deferredPipeline = NULL;
+	deferredBindlessPipeline = NULL;
+	deferredInstancedPipeline = NULL;
 	wireframePipeline = NULL;
 	skydomePipeline = NULL;
 	canvasPipeline = NULL;
 	shadowPipeline = NULL;
 	shadowSkinnedPipeline = NULL;
+	shadowInstancedPipeline = NULL;
+
+	quantizedVertices = false;
 }
 
 bool PipelineManager::InitUIPipelines(VulkanInterface * vulkan)
@@ -42,8 +58,27 @@ bool PipelineManager::InitUIPipelines(VulkanInterface * vulkan)
 	return true;
 }
 
+void PipelineManager::SelectVertexLayout()
+{
+	// The quantized layout needs its own G-buffer shaders, the shadow shaders still read what they need from it.
+	// Without a variant for every G-buffer pipeline in use meshes stay in the full layout
+	bool bindless = gTextureManager->IsBindlessEnabled() && Shader::Exists("deferredBindless");
+	bool instanced = Shader::Exists("deferredInstanced") && Shader::Exists("shadowInstanced");
+
+	quantizedVertices = Shader::Exists("deferredQuantized") && Shader::Exists("skinnedQuantized") &&
+		(!bindless || Shader::Exists("deferredBindlessQuantized")) && (!instanced || Shader::Exists("deferredInstancedQuantized"));
+}
+
+bool PipelineManager::IsQuantizedVertices()
+{
+	return quantizedVertices;
+}
+
 bool PipelineManager::InitGamePipelines(VulkanInterface * vulkan, ShadowMaps * shadowMaps)
 {
+	// G-buffer shaders decoding the quantized layout share the names of the full ones with this after them
+	std::string layoutVariant = (quantizedVertices ? "Quantized" : "");
+
 	// Init shaders
 	defaultShader = new Shader();
 	if (!defaultShader->Init(vulkan->GetVulkanDevice(), "default", false))
@@ -53,19 +88,48 @@ bool PipelineManager::InitGamePipelines(VulkanInterface * vulkan, ShadowMaps * s
 	}
 
 	skinnedShader = new Shader();
-	if (!skinnedShader->Init(vulkan->GetVulkanDevice(), "skinned", false))
+	if (!skinnedShader->Init(vulkan->GetVulkanDevice(), "skinned" + layoutVariant, false))
 	{
 		gLogManager->AddMessage("ERROR: Failed to init skinned shader!");
 		return false;
 	}
 
 	deferredShader = new Shader();
-	if (!deferredShader->Init(vulkan->GetVulkanDevice(), "deferred", false))
+	if (!deferredShader->Init(vulkan->GetVulkanDevice(), "deferred" + layoutVariant, false))
 	{
 		gLogManager->AddMessage("ERROR: Failed to init deferred shader!");
 		return false;
 	}
 
+	// Optional, without descriptor indexing or the shader textures are bound per draw
+	if (gTextureManager->IsBindlessEnabled() && Shader::Exists("deferredBindless"))
+	{
+		deferredBindlessShader = new Shader();
+		if (!deferredBindlessShader->Init(vulkan->GetVulkanDevice(), "deferredBindless" + layoutVariant, false))
+		{
+			gLogManager->AddMessage("ERROR: Failed to init deferred bindless shader!");
+			return false;
+		}
+	}
+
+	// Optional, without them repeated models are drawn one by one
+	if (Shader::Exists("deferredInstanced") && Shader::Exists("shadowInstanced"))
+	{
+		deferredInstancedShader = new Shader();
+		if (!deferredInstancedShader->Init(vulkan->GetVulkanDevice(), "deferredInstanced" + layoutVariant, false))
+		{
+			gLogManager->AddMessage("ERROR: Failed to init deferred instanced shader!");
+			return false;
+		}
+
+		shadowInstancedShader = new Shader();
+		if (!shadowInstancedShader->Init(vulkan->GetVulkanDevice(), "shadowInstanced", true))
+		{
+			gLogManager->AddMessage("ERROR: Failed to init shadow instanced shader!");
+			return false;
+		}
+	}
+
 	wireframeShader = new Shader();
 	if (!wireframeShader->Init(vulkan->GetVulkanDevice(), "wireframe", false))
 	{
@@ -107,12 +171,18 @@ bool PipelineManager::InitGamePipelines(VulkanInterface * vulkan, ShadowMaps * s
 		return false;
 	}
 
-	if (!BuildDeferredPipeline(vulkan))
+	if (!BuildDeferredPipeline(vulkan, false))
 	{
 		gLogManager->AddMessage("ERROR: Failed to init deferred pipeline!");
 		return false;
 	}
 
+	if (deferredBindlessShader && !BuildDeferredPipeline(vulkan, true))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init deferred bindless pipeline!");
+		return false;
+	}
+
 	if (!BuildWireframePipeline(vulkan))
 	{
 		gLogManager->AddMessage("ERROR: Failed to init wireframe pipeline!");
@@ -136,25 +206,49 @@ bool PipelineManager::InitGamePipelines(VulkanInterface * vulkan, ShadowMaps * s
 
 void PipelineManager::Unload(VulkanInterface * vulkan)
 {
+	SAFE_UNLOAD(shadowInstancedPipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(shadowSkinnedPipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(shadowPipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(canvasPipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(skydomePipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(wireframePipeline, vulkan->GetVulkanDevice());
+	SAFE_UNLOAD(deferredInstancedPipeline, vulkan->GetVulkanDevice());
+	SAFE_UNLOAD(deferredBindlessPipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(deferredPipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(skinnedPipeline, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(defaultPipeline, vulkan->GetVulkanDevice());
 
+	SAFE_UNLOAD(shadowInstancedShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(shadowSkinnedShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(shadowShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(canvasShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(skydomeShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(wireframeShader, vulkan->GetVulkanDevice());
+	SAFE_UNLOAD(deferredInstancedShader, vulkan->GetVulkanDevice());
+	SAFE_UNLOAD(deferredBindlessShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(deferredShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(skinnedShader, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(defaultShader, vulkan->GetVulkanDevice());
 }
 
+void PipelineManager::EvictDescriptorSets(VulkanDevice * device, const std::vector<VkImageView> & imageViews, const std::vector<VkBuffer> & buffers)
+{
+	VulkanPipeline * pipelines[] = { defaultPipeline, skinnedPipeline, deferredPipeline, deferredBindlessPipeline, deferredInstancedPipeline,
+		wireframePipeline, skydomePipeline, canvasPipeline, shadowPipeline, shadowSkinnedPipeline, shadowInstancedPipeline };
+
+	// Called after the frame slot's fence wait, sets evicted MAX_FRAMES_IN_FLIGHT frames ago are no longer bound
+	uint64_t frame = gResidencyManager->GetFrame();
+
+	for (unsigned int i = 0; i < sizeof(pipelines) / sizeof(pipelines[0]); i++)
+	{
+		if (pipelines[i])
+		{
+			pipelines[i]->EvictCachedDescriptorSets(imageViews, buffers, frame + MAX_FRAMES_IN_FLIGHT);
+			pipelines[i]->FreeRetiredDescriptorSets(device, frame);
+		}
+	}
+}
+
 VulkanPipeline * PipelineManager::GetDefault()
 {
 	return defaultPipeline;
@@ -167,6 +261,9 @@ VulkanPipeline * PipelineManager::GetSkinned()
 
 VulkanPipeline * PipelineManager::GetDeferred()
 {
+	if (deferredBindlessPipeline)
+		return deferredBindlessPipeline;
+
 	return deferredPipeline;
 }
 
@@ -195,6 +292,16 @@ VulkanPipeline * PipelineManager::GetShadowSkinned()
 	return shadowSkinnedPipeline;
 }
 
+VulkanPipeline * PipelineManager::GetDeferredInstanced()
+{
+	return deferredInstancedPipeline;
+}
+
+VulkanPipeline * PipelineManager::GetShadowInstanced()
+{
+	return shadowInstancedPipeline;
+}
+
 bool PipelineManager::BuildDefaultPipeline(VulkanInterface * vulkan)
 {
 	// Vertex layout
@@ -371,17 +478,50 @@ bool PipelineManager::BuildSkinnedPipeline(VulkanInterface * vulkan)
 	vertexLayoutSkinned[6].format = VK_FORMAT_R32G32B32_SFLOAT;
 	vertexLayoutSkinned[6].offset = sizeof(float) * 15 + sizeof(uint32_t) * 4;
 
+	// Quantized vertex layout, tangents and bitangents are decoded from the tangent frame at the normals' location
+	VkVertexInputAttributeDescription vertexLayoutSkinnedQuantized[5];
+
+	// Position
+	vertexLayoutSkinnedQuantized[0].binding = 0;
+	vertexLayoutSkinnedQuantized[0].location = 0;
+	vertexLayoutSkinnedQuantized[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexLayoutSkinnedQuantized[0].offset = offsetof(MeshFileQuantizedSkinnedVertex, x);
+
+	// Texture coords
+	vertexLayoutSkinnedQuantized[1].binding = 0;
+	vertexLayoutSkinnedQuantized[1].location = 1;
+	vertexLayoutSkinnedQuantized[1].format = VK_FORMAT_R16G16_SFLOAT;
+	vertexLayoutSkinnedQuantized[1].offset = offsetof(MeshFileQuantizedSkinnedVertex, u);
+
+	// Tangent frame
+	vertexLayoutSkinnedQuantized[2].binding = 0;
+	vertexLayoutSkinnedQuantized[2].location = 2;
+	vertexLayoutSkinnedQuantized[2].format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+	vertexLayoutSkinnedQuantized[2].offset = offsetof(MeshFileQuantizedSkinnedVertex, tangentFrame);
+
+	// Bone weights
+	vertexLayoutSkinnedQuantized[3].binding = 0;
+	vertexLayoutSkinnedQuantized[3].location = 3;
+	vertexLayoutSkinnedQuantized[3].format = VK_FORMAT_R8G8B8A8_UNORM;
+	vertexLayoutSkinnedQuantized[3].offset = offsetof(MeshFileQuantizedSkinnedVertex, boneWeights);
+
+	// Bone IDs
+	vertexLayoutSkinnedQuantized[4].binding = 0;
+	vertexLayoutSkinnedQuantized[4].location = 4;
+	vertexLayoutSkinnedQuantized[4].format = VK_FORMAT_R8G8B8A8_SINT;
+	vertexLayoutSkinnedQuantized[4].offset = offsetof(MeshFileQuantizedSkinnedVertex, boneIDs);
+
 	// Layout bindings
 	VkDescriptorSetLayoutBinding layoutBindingsSkinned[6];
 
 	layoutBindingsSkinned[0].binding = 0;
-	layoutBindingsSkinned[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsSkinned[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsSkinned[0].descriptorCount = 1;
 	layoutBindingsSkinned[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindingsSkinned[0].pImmutableSamplers = VK_NULL_HANDLE;
 
 	layoutBindingsSkinned[1].binding = 1;
-	layoutBindingsSkinned[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsSkinned[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsSkinned[1].descriptorCount = 1;
 	layoutBindingsSkinned[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindingsSkinned[1].pImmutableSamplers = VK_NULL_HANDLE;
@@ -413,9 +553,9 @@ bool PipelineManager::BuildSkinnedPipeline(VulkanInterface * vulkan)
 	// Type counts
 	VkDescriptorPoolSize typeCounts[6];
 
-	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[0].descriptorCount = 1;
-	typeCounts[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[1].descriptorCount = 1;
 	typeCounts[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	typeCounts[2].descriptorCount = 1;
@@ -440,12 +580,12 @@ bool PipelineManager::BuildSkinnedPipeline(VulkanInterface * vulkan)
 	pipelineCI.pipelineName = "SKINNED";
 	pipelineCI.shader = skinnedShader;
 	pipelineCI.vulkanRenderpass = vulkan->GetDeferredRenderpass();
-	pipelineCI.vertexLayout = vertexLayoutSkinned;
-	pipelineCI.numVertexLayout = 7;
+	pipelineCI.vertexLayout = (quantizedVertices ? vertexLayoutSkinnedQuantized : vertexLayoutSkinned);
+	pipelineCI.numVertexLayout = (quantizedVertices ? 5 : 7);
 	pipelineCI.layoutBindings = layoutBindingsSkinned;
 	pipelineCI.numLayoutBindings = 6;
 	pipelineCI.typeCounts = typeCounts;
-	pipelineCI.strideSize = sizeof(SkinnedVertex);
+	pipelineCI.strideSize = (quantizedVertices ? sizeof(MeshFileQuantizedSkinnedVertex) : sizeof(SkinnedVertex));
 	pipelineCI.numColorAttachments = 4;
 	pipelineCI.wireframeEnabled = false;
 	pipelineCI.cullMode = VK_CULL_MODE_BACK_BIT;
@@ -459,7 +599,7 @@ bool PipelineManager::BuildSkinnedPipeline(VulkanInterface * vulkan)
 	return true;
 }
 
-bool PipelineManager::BuildDeferredPipeline(VulkanInterface * vulkan)
+bool PipelineManager::BuildDeferredPipeline(VulkanInterface * vulkan, bool bindless)
 {
 	// Vertex layout
 	VkVertexInputAttributeDescription vertexLayoutDeferred[5];
@@ -489,11 +629,29 @@ bool PipelineManager::BuildDeferredPipeline(VulkanInterface * vulkan)
 	vertexLayoutDeferred[4].format = VK_FORMAT_R32G32B32_SFLOAT;
 	vertexLayoutDeferred[4].offset = sizeof(float) * 11;
 
+	// Quantized vertex layout, half float texture coords and the tangent frame the shader decodes the normal, tangent and bitangent from
+	VkVertexInputAttributeDescription vertexLayoutDeferredQuantized[3];
+
+	vertexLayoutDeferredQuantized[0].binding = 0;
+	vertexLayoutDeferredQuantized[0].location = 0;
+	vertexLayoutDeferredQuantized[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexLayoutDeferredQuantized[0].offset = offsetof(MeshFileQuantizedVertex, x);
+
+	vertexLayoutDeferredQuantized[1].binding = 0;
+	vertexLayoutDeferredQuantized[1].location = 1;
+	vertexLayoutDeferredQuantized[1].format = VK_FORMAT_R16G16_SFLOAT;
+	vertexLayoutDeferredQuantized[1].offset = offsetof(MeshFileQuantizedVertex, u);
+
+	vertexLayoutDeferredQuantized[2].binding = 0;
+	vertexLayoutDeferredQuantized[2].location = 2;
+	vertexLayoutDeferredQuantized[2].format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+	vertexLayoutDeferredQuantized[2].offset = offsetof(MeshFileQuantizedVertex, tangentFrame);
+
 	// Layout bindings
 	VkDescriptorSetLayoutBinding layoutBindingsDeferred[5];
 
 	layoutBindingsDeferred[0].binding = 0;
-	layoutBindingsDeferred[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsDeferred[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsDeferred[0].descriptorCount = 1;
 	layoutBindingsDeferred[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindingsDeferred[0].pImmutableSamplers = VK_NULL_HANDLE;
@@ -525,7 +683,7 @@ bool PipelineManager::BuildDeferredPipeline(VulkanInterface * vulkan)
 	// Type counts
 	VkDescriptorPoolSize typeCounts[5];
 
-	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[0].descriptorCount = 1;
 	typeCounts[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	typeCounts[1].descriptorCount = 1;
@@ -544,26 +702,72 @@ bool PipelineManager::BuildDeferredPipeline(VulkanInterface * vulkan)
 		float bx, by, bz;
 	};
 
+	// Bindless variant keeps only the vertex uniform buffer, textures come from set 1 and the material from push constants
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(MaterialPushConstants);
+
 	VulkanPipelineCI pipelineCI{};
 	pipelineCI.pipelineName = "DEFERRED";
 	pipelineCI.shader = deferredShader;
 	pipelineCI.vulkanRenderpass = vulkan->GetDeferredRenderpass();
-	pipelineCI.vertexLayout = vertexLayoutDeferred;
-	pipelineCI.numVertexLayout = 5;
+	pipelineCI.vertexLayout = (quantizedVertices ? vertexLayoutDeferredQuantized : vertexLayoutDeferred);
+	pipelineCI.numVertexLayout = (quantizedVertices ? 3 : 5);
 	pipelineCI.layoutBindings = layoutBindingsDeferred;
 	pipelineCI.numLayoutBindings = 5;
 	pipelineCI.typeCounts = typeCounts;
-	pipelineCI.strideSize = sizeof(DeferredVertex);
+	pipelineCI.strideSize = (quantizedVertices ? sizeof(MeshFileQuantizedVertex) : sizeof(DeferredVertex));
 	pipelineCI.numColorAttachments = 4;
 	pipelineCI.wireframeEnabled = false;
 	pipelineCI.cullMode = VK_CULL_MODE_BACK_BIT;
 	pipelineCI.transparencyEnabled = false;
 	pipelineCI.depthBiasEnabled = false;
 
+	if (bindless)
+	{
+		pipelineCI.pipelineName = "DEFERREDBINDLESS";
+		pipelineCI.shader = deferredBindlessShader;
+		pipelineCI.numLayoutBindings = 1;
+		pipelineCI.extraSetLayouts = gTextureManager->GetBindlessLayout();
+		pipelineCI.numExtraSetLayouts = 1;
+		pipelineCI.pushConstantRanges = &pushConstantRange;
+		pipelineCI.numPushConstantRanges = 1;
+
+		deferredBindlessPipeline = new VulkanPipeline();
+		if (!deferredBindlessPipeline->Init(vulkan, &pipelineCI))
+			return false;
+
+		return true;
+	}
+
 	deferredPipeline = new VulkanPipeline();
 	if (!deferredPipeline->Init(vulkan, &pipelineCI))
 		return false;
 
+	if (deferredInstancedShader == NULL)
+		return true;
+
+	// Instanced variant, same set so the per-mesh writes match. Binding 0 holds the view projection, world matrices come per instance
+	VkVertexInputAttributeDescription instanceLayoutDeferred[4];
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		instanceLayoutDeferred[i].binding = 1;
+		instanceLayoutDeferred[i].location = 5 + i;
+		instanceLayoutDeferred[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		instanceLayoutDeferred[i].offset = sizeof(glm::vec4) * i;
+	}
+
+	pipelineCI.pipelineName = "DEFERREDINSTANCED";
+	pipelineCI.shader = deferredInstancedShader;
+	pipelineCI.instanceLayout = instanceLayoutDeferred;
+	pipelineCI.numInstanceLayout = 4;
+	pipelineCI.instanceStrideSize = sizeof(ModelInstanceData);
+
+	deferredInstancedPipeline = new VulkanPipeline();
+	if (!deferredInstancedPipeline->Init(vulkan, &pipelineCI))
+		return false;
+
 	return true;
 }
 
@@ -702,7 +906,7 @@ bool PipelineManager::BuildCanvasPipeline(VulkanInterface * vulkan)
 	VkDescriptorSetLayoutBinding layoutBindingsCanvas[2];
 
 	layoutBindingsCanvas[0].binding = 0;
-	layoutBindingsCanvas[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsCanvas[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsCanvas[0].descriptorCount = 1;
 	layoutBindingsCanvas[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindingsCanvas[0].pImmutableSamplers = VK_NULL_HANDLE;
@@ -715,7 +919,7 @@ bool PipelineManager::BuildCanvasPipeline(VulkanInterface * vulkan)
 
 	// Type counts
 	VkDescriptorPoolSize typeCounts[2];
-	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[0].descriptorCount = 1;
 	typeCounts[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	typeCounts[1].descriptorCount = 1;
@@ -762,7 +966,7 @@ bool PipelineManager::BuildShadowPipeline(VulkanInterface * vulkan, ShadowMaps *
 	VkDescriptorSetLayoutBinding layoutBindingsShadow[3];
 
 	layoutBindingsShadow[0].binding = 0;
-	layoutBindingsShadow[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsShadow[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsShadow[0].descriptorCount = 1;
 	layoutBindingsShadow[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindingsShadow[0].pImmutableSamplers = VK_NULL_HANDLE;
@@ -774,18 +978,18 @@ bool PipelineManager::BuildShadowPipeline(VulkanInterface * vulkan, ShadowMaps *
 	layoutBindingsShadow[1].pImmutableSamplers = VK_NULL_HANDLE;
 
 	layoutBindingsShadow[2].binding = 2;
-	layoutBindingsShadow[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsShadow[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsShadow[2].descriptorCount = 1;
 	layoutBindingsShadow[2].stageFlags = VK_SHADER_STAGE_GEOMETRY_BIT;
 	layoutBindingsShadow[2].pImmutableSamplers = VK_NULL_HANDLE;
 
 	// Type counts
 	VkDescriptorPoolSize typeCounts[3];
-	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[0].descriptorCount = 1;
 	typeCounts[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	typeCounts[1].descriptorCount = 1;
-	typeCounts[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCounts[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCounts[2].descriptorCount = 1;
 
 	struct DeferredVertex {
@@ -796,6 +1000,9 @@ bool PipelineManager::BuildShadowPipeline(VulkanInterface * vulkan, ShadowMaps *
 		float bx, by, bz;
 	};
 
+	// Both layouts start with the full precision position, the quantized one only has a shorter stride
+	size_t shadowStrideSize = (quantizedVertices ? sizeof(MeshFileQuantizedVertex) : sizeof(DeferredVertex));
+
 	VulkanPipelineCI pipelineCI{};
 	pipelineCI.pipelineName = "SHADOW";
 	pipelineCI.shader = shadowShader;
@@ -805,7 +1012,7 @@ bool PipelineManager::BuildShadowPipeline(VulkanInterface * vulkan, ShadowMaps *
 	pipelineCI.layoutBindings = layoutBindingsShadow;
 	pipelineCI.numLayoutBindings = 3;
 	pipelineCI.typeCounts = typeCounts;
-	pipelineCI.strideSize = sizeof(DeferredVertex);
+	pipelineCI.strideSize = shadowStrideSize;
 	pipelineCI.numColorAttachments = 0;
 	pipelineCI.wireframeEnabled = false;
 	pipelineCI.cullMode = VK_CULL_MODE_FRONT_BIT;
@@ -839,17 +1046,35 @@ bool PipelineManager::BuildShadowPipeline(VulkanInterface * vulkan, ShadowMaps *
 	vertexLayoutShadowSkinned[2].format = VK_FORMAT_R32G32B32A32_SINT;
 	vertexLayoutShadowSkinned[2].offset = sizeof(float) * 12;
 
+	// Quantized vertex layout, the weights are read back as floats and the IDs as ints so the shader is shared
+	VkVertexInputAttributeDescription vertexLayoutShadowSkinnedQuantized[3];
+
+	vertexLayoutShadowSkinnedQuantized[0].binding = 0;
+	vertexLayoutShadowSkinnedQuantized[0].location = 0;
+	vertexLayoutShadowSkinnedQuantized[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	vertexLayoutShadowSkinnedQuantized[0].offset = offsetof(MeshFileQuantizedSkinnedVertex, x);
+
+	vertexLayoutShadowSkinnedQuantized[1].binding = 0;
+	vertexLayoutShadowSkinnedQuantized[1].location = 3;
+	vertexLayoutShadowSkinnedQuantized[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+	vertexLayoutShadowSkinnedQuantized[1].offset = offsetof(MeshFileQuantizedSkinnedVertex, boneWeights);
+
+	vertexLayoutShadowSkinnedQuantized[2].binding = 0;
+	vertexLayoutShadowSkinnedQuantized[2].location = 4;
+	vertexLayoutShadowSkinnedQuantized[2].format = VK_FORMAT_R8G8B8A8_SINT;
+	vertexLayoutShadowSkinnedQuantized[2].offset = offsetof(MeshFileQuantizedSkinnedVertex, boneIDs);
+
 	// Layout bindings
 	VkDescriptorSetLayoutBinding layoutBindingsShadowSkinned[3];
 
 	layoutBindingsShadowSkinned[0].binding = 0;
-	layoutBindingsShadowSkinned[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsShadowSkinned[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsShadowSkinned[0].descriptorCount = 1;
 	layoutBindingsShadowSkinned[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindingsShadowSkinned[0].pImmutableSamplers = VK_NULL_HANDLE;
 
 	layoutBindingsShadowSkinned[1].binding = 1;
-	layoutBindingsShadowSkinned[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsShadowSkinned[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	layoutBindingsShadowSkinned[1].descriptorCount = 1;
 	layoutBindingsShadowSkinned[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	layoutBindingsShadowSkinned[1].pImmutableSamplers = VK_NULL_HANDLE;
@@ -862,9 +1087,9 @@ bool PipelineManager::BuildShadowPipeline(VulkanInterface * vulkan, ShadowMaps *
 
 	// Type counts
 	VkDescriptorPoolSize typeCountsSkinned[3];
-	typeCountsSkinned[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCountsSkinned[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCountsSkinned[0].descriptorCount = 1;
-	typeCountsSkinned[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCountsSkinned[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	typeCountsSkinned[1].descriptorCount = 1;
 	typeCountsSkinned[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	typeCountsSkinned[2].descriptorCount = 1;
@@ -882,17 +1107,63 @@ bool PipelineManager::BuildShadowPipeline(VulkanInterface * vulkan, ShadowMaps *
 	
 	pipelineCI.pipelineName = "SHADOWSKINNED";
 	pipelineCI.shader = shadowSkinnedShader;
-	pipelineCI.vertexLayout = vertexLayoutShadowSkinned;
+	pipelineCI.vertexLayout = (quantizedVertices ? vertexLayoutShadowSkinnedQuantized : vertexLayoutShadowSkinned);
 	pipelineCI.numVertexLayout = 3;
 	pipelineCI.layoutBindings = layoutBindingsShadowSkinned;
 	pipelineCI.numLayoutBindings = 3;
 	pipelineCI.typeCounts = typeCountsSkinned;
-	pipelineCI.strideSize = sizeof(SkinnedVertex);
+	pipelineCI.strideSize = (quantizedVertices ? sizeof(MeshFileQuantizedSkinnedVertex) : sizeof(SkinnedVertex));
 	pipelineCI.cullMode = VK_CULL_MODE_BACK_BIT;
 
 	shadowSkinnedPipeline = new VulkanPipeline();
 	if (!shadowSkinnedPipeline->Init(vulkan, &pipelineCI))
 		return false;
 
+	if (shadowInstancedShader == NULL)
+		return true;
+
+	// Shadow instanced pipeline
+
+	// World matrix and cascade flags are per instance, only the cascade matrices stay in the set
+	VkVertexInputAttributeDescription instanceLayoutShadow[5];
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		instanceLayoutShadow[i].binding = 1;
+		instanceLayoutShadow[i].location = 5 + i;
+		instanceLayoutShadow[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		instanceLayoutShadow[i].offset = sizeof(glm::vec4) * i;
+	}
+
+	// Layout bindings
+	VkDescriptorSetLayoutBinding layoutBindingsShadowInstanced[1];
+
+	layoutBindingsShadowInstanced[0].binding = 0;
+	layoutBindingsShadowInstanced[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	layoutBindingsShadowInstanced[0].descriptorCount = 1;
+	layoutBindingsShadowInstanced[0].stageFlags = VK_SHADER_STAGE_GEOMETRY_BIT;
+	layoutBindingsShadowInstanced[0].pImmutableSamplers = VK_NULL_HANDLE;
+
+	// Type counts
+	VkDescriptorPoolSize typeCountsInstanced[1];
+	typeCountsInstanced[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	typeCountsInstanced[0].descriptorCount = 1;
+
+	pipelineCI.pipelineName = "SHADOWINSTANCED";
+	pipelineCI.shader = shadowInstancedShader;
+	pipelineCI.vertexLayout = vertexLayoutShadow;
+	pipelineCI.numVertexLayout = 1;
+	pipelineCI.instanceLayout = instanceLayoutShadow;
+	pipelineCI.numInstanceLayout = 5;
+	pipelineCI.instanceStrideSize = sizeof(ModelInstanceData);
+	pipelineCI.layoutBindings = layoutBindingsShadowInstanced;
+	pipelineCI.numLayoutBindings = 1;
+	pipelineCI.typeCounts = typeCountsInstanced;
+	pipelineCI.strideSize = shadowStrideSize;
+	pipelineCI.cullMode = VK_CULL_MODE_FRONT_BIT;
+
+	shadowInstancedPipeline = new VulkanPipeline();
+	if (!shadowInstancedPipeline->Init(vulkan, &pipelineCI))
+		return false;
+
 	return true;
 }
\ No newline at end of file
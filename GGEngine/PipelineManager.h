@@ -11,24 +11,32 @@ class PipelineManager
 		Shader * defaultShader;
 		Shader * skinnedShader;
 		Shader * deferredShader;
+		Shader * deferredBindlessShader;
+		Shader * deferredInstancedShader;
 		Shader * wireframeShader;
 		Shader * skydomeShader;
 		Shader * canvasShader;
 		Shader * shadowShader;
 		Shader * shadowSkinnedShader;
+		Shader * shadowInstancedShader;
 
 		VulkanPipeline * defaultPipeline;
 		VulkanPipeline * skinnedPipeline;
 		VulkanPipeline * deferredPipeline;
+		VulkanPipeline * deferredBindlessPipeline;
+		VulkanPipeline * deferredInstancedPipeline;
 		VulkanPipeline * wireframePipeline;
 		VulkanPipeline * skydomePipeline;
 		VulkanPipeline * canvasPipeline;
 		VulkanPipeline * shadowPipeline;
 		VulkanPipeline * shadowSkinnedPipeline;
+		VulkanPipeline * shadowInstancedPipeline;
+
+		bool quantizedVertices;
 	private:
 		bool BuildDefaultPipeline(VulkanInterface * vulkan);
 		bool BuildSkinnedPipeline(VulkanInterface * vulkan);
-		bool BuildDeferredPipeline(VulkanInterface * vulkan);
+		bool BuildDeferredPipeline(VulkanInterface * vulkan, bool bindless);
 		bool BuildWireframePipeline(VulkanInterface * vulkan);
 		bool BuildSkydomePipeline(VulkanInterface * vulkan);
 		bool BuildCanvasPipeline(VulkanInterface * vulkan);
@@ -37,8 +45,11 @@ class PipelineManager
 		PipelineManager();
 
 		bool InitUIPipelines(VulkanInterface * vulkan);
+		void SelectVertexLayout();
+		bool IsQuantizedVertices();
 		bool InitGamePipelines(VulkanInterface * vulkan, ShadowMaps * shadowMaps);
 		void Unload(VulkanInterface * vulkan);
+		void EvictDescriptorSets(VulkanDevice * device, const std::vector<VkImageView> & imageViews, const std::vector<VkBuffer> & buffers);
 
 		VulkanPipeline * GetDefault();
 		VulkanPipeline * GetSkinned();
@@ -48,4 +59,6 @@ class PipelineManager
 		VulkanPipeline * GetCanvas();
 		VulkanPipeline * GetShadow();
 		VulkanPipeline * GetShadowSkinned();
+		VulkanPipeline * GetDeferredInstanced();
+		VulkanPipeline * GetShadowInstanced();
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+// Encoded .rct files start with the magic and a format tag, files without them are plain RGBA8
+#define RCT_MAGIC 0x32544352
+
+// Stored right after the magic, the mip layout is the same for every format
+enum RCT_FORMAT
+{
+	RCT_FORMAT_RGBA8 = 0,
+	RCT_FORMAT_BC1,
+	RCT_FORMAT_BC3,
+	RCT_FORMAT_BC4,
+	RCT_FORMAT_BC5,
+	RCT_FORMAT_BC7,
+	RCT_FORMAT_COUNT
+};
+
+// Bytes of one 4x4 block, 0 for the uncompressed format
+inline uint32_t GetRctBlockSize(uint32_t format)
+{
+	switch (format)
+	{
+		case RCT_FORMAT_BC1:
+		case RCT_FORMAT_BC4:
+			return 8;
+		case RCT_FORMAT_BC3:
+		case RCT_FORMAT_BC5:
+		case RCT_FORMAT_BC7:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+// Size of one mip level's data, partial blocks at the edges are stored whole
+inline uint32_t GetRctLevelSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	uint32_t blockSize = GetRctBlockSize(format);
+	if (blockSize == 0)
+		return width * height * 4;
+
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
\ No newline at end of file
@@ -8,14 +8,20 @@ RenderDummy::RenderDummy()
 {
 	vertexBuffer = NULL;
 	indexBuffer = NULL;
-	vsUBO = NULL;
-	fsUBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vsUBO[i] = NULL;
+		fsUBO[i] = NULL;
+	}
 }
 
 RenderDummy::~RenderDummy()
 {
-	fsUBO = NULL;
-	vsUBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		fsUBO[i] = NULL;
+		vsUBO[i] = NULL;
+	}
 	indexBuffer = NULL;
 	vertexBuffer = NULL;
 }
@@ -25,7 +31,6 @@ bool RenderDummy::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline
 	LightManager * lightManager, VkImageView * cubemapView)
 {
 	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
-	VulkanCommandPool * cmdPool = vulkan->GetVulkanCommandPool();
 
 	vertexCount = 4;
 	indexCount = 6;
@@ -69,30 +74,18 @@ bool RenderDummy::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline
 	indexData[4] = 3;
 	indexData[5] = 0;
 
-	// Command buffer used for creating buffers
-	VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
-	if (!cmdBuffer->Init(vulkanDevice, cmdPool, true))
-		return false;
-
-	cmdBuffer->BeginRecording();
-
 	// Vertex buffer
 	vertexBuffer = new VulkanBuffer();
 	if (!vertexBuffer->Init(vulkanDevice, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData,
-		sizeof(Vertex) * vertexCount, true, cmdBuffer))
+		sizeof(Vertex) * vertexCount, true))
 		return false;
 
 	// Index buffer
 	indexBuffer = new VulkanBuffer();
 	if (!indexBuffer->Init(vulkanDevice, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexData,
-		sizeof(uint32_t) * indexCount, true, cmdBuffer))
+		sizeof(uint32_t) * indexCount, true))
 		return false;
 
-	cmdBuffer->EndRecording();
-	cmdBuffer->Execute(vulkanDevice, NULL, VK_NULL_HANDLE, VK_NULL_HANDLE, true);
-
-	SAFE_UNLOAD(cmdBuffer, vulkanDevice, cmdPool);
-
 	delete[] vertexData;
 	delete[] indexData;
 
@@ -103,159 +96,163 @@ bool RenderDummy::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline
 	fragmentUniformBuffer.cameraPosition = glm::vec3();
 	fragmentUniformBuffer.lightStrength = 0.0f;
 
-	// Vertex shader Uniform buffer
-	vsUBO = new VulkanBuffer();
-	if (!vsUBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer,
-		sizeof(vertexUniformBuffer), false))
-		return false;
+	// Uniform buffers and descriptor set for each frame in flight
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		// Vertex shader Uniform buffer
+		vsUBO[i] = new VulkanBuffer();
+		if (!vsUBO[i]->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer,
+			sizeof(vertexUniformBuffer), false))
+			return false;
 
-	// Fragment shader Uniform buffer
-	fsUBO = new VulkanBuffer();
-	if (!fsUBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &fragmentUniformBuffer,
-		sizeof(fragmentUniformBuffer), false))
-		return false;
+		// Fragment shader Uniform buffer
+		fsUBO[i] = new VulkanBuffer();
+		if (!fsUBO[i]->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &fragmentUniformBuffer,
+			sizeof(fragmentUniformBuffer), false))
+			return false;
 
-	VkWriteDescriptorSet write[10]; //must be 10 for cubemap
-
-	write[0] = {};
-	write[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[0].pNext = NULL;
-	write[0].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[0].descriptorCount = 1;
-	write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	write[0].pBufferInfo = vsUBO->GetBufferInfo();
-	write[0].dstArrayElement = 0;
-	write[0].dstBinding = 0;
-
-	VkDescriptorImageInfo positionTextureDesc{};
-	positionTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	positionTextureDesc.imageView = *positionView;
-	positionTextureDesc.sampler = vulkan->GetColorSampler();
-
-	write[1] = {};
-	write[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[1].pNext = NULL;
-	write[1].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[1].descriptorCount = 1;
-	write[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	write[1].pImageInfo = &positionTextureDesc;
-	write[1].dstArrayElement = 0;
-	write[1].dstBinding = 1;
-
-	VkDescriptorImageInfo normalTextureDesc{};
-	normalTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	normalTextureDesc.imageView = *normalView;
-	normalTextureDesc.sampler = vulkan->GetColorSampler();
-
-	write[2] = {};
-	write[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[2].pNext = NULL;
-	write[2].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[2].descriptorCount = 1;
-	write[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	write[2].pImageInfo = &normalTextureDesc;
-	write[2].dstArrayElement = 0;
-	write[2].dstBinding = 2;
-
-	VkDescriptorImageInfo albedoTextureDesc{};
-	albedoTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	albedoTextureDesc.imageView = *albedoView;
-	albedoTextureDesc.sampler = vulkan->GetColorSampler();
-
-	write[3] = {};
-	write[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[3].pNext = NULL;
-	write[3].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[3].descriptorCount = 1;
-	write[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	write[3].pImageInfo = &albedoTextureDesc;
-	write[3].dstArrayElement = 0;
-	write[3].dstBinding = 3;
-
-	VkDescriptorImageInfo materialTextureDesc{};
-	materialTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	materialTextureDesc.imageView = *materialView;
-	materialTextureDesc.sampler = vulkan->GetColorSampler();
-
-	write[4] = {};
-	write[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[4].pNext = NULL;
-	write[4].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[4].descriptorCount = 1;
-	write[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	write[4].pImageInfo = &materialTextureDesc;
-	write[4].dstArrayElement = 0;
-	write[4].dstBinding = 4;
-
-	VkDescriptorImageInfo depthTextureDesc{};
-	depthTextureDesc.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	depthTextureDesc.imageView = *depthView;
-	depthTextureDesc.sampler = vulkan->GetColorSampler();
-
-	write[5] = {};
-	write[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[5].pNext = NULL;
-	write[5].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[5].descriptorCount = 1;
-	write[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	write[5].pImageInfo = &depthTextureDesc;
-	write[5].dstArrayElement = 0;
-	write[5].dstBinding = 5;
-
-	write[6] = {};
-	write[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[6].pNext = NULL;
-	write[6].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[6].descriptorCount = 1;
-	write[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	write[6].pBufferInfo = fsUBO->GetBufferInfo();
-	write[6].dstArrayElement = 0;
-	write[6].dstBinding = 6;
-
-	VkDescriptorImageInfo shadowTextureDesc{};
-	shadowTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	shadowTextureDesc.imageView = *shadowMaps->GetImageView();
-	shadowTextureDesc.sampler = shadowMaps->GetSampler();
-
-	write[7] = {};
-	write[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[7].pNext = NULL;
-	write[7].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[7].descriptorCount = 1;
-	write[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	write[7].pImageInfo = &shadowTextureDesc;
-	write[7].dstArrayElement = 0;
-	write[7].dstBinding = 7;
-
-	write[8] = {};
-	write[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[8].pNext = NULL;
-	write[8].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[8].descriptorCount = 1;
-	write[8].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	write[8].pBufferInfo = lightManager->GetBufferInfo();
-	write[8].dstArrayElement = 0;
-	write[8].dstBinding = 8;
-
-	VkDescriptorImageInfo cubemapTextureDesc{};
-	cubemapTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-	cubemapTextureDesc.imageView = *cubemapView;
-	cubemapTextureDesc.sampler = vulkan->GetColorSampler();
-
-	write[9] = {};
-	write[9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	write[9].pNext = NULL;
-	write[9].dstSet = vulkanPipeline->GetDescriptorSet();
-	write[9].descriptorCount = 1;
-	write[9].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	write[9].pImageInfo = &cubemapTextureDesc;
-	write[9].dstArrayElement = 0;
-	write[9].dstBinding = 9;
-
-	vkUpdateDescriptorSets(vulkanDevice->GetDevice(), sizeof(write) / sizeof(write[0]), write, 0, NULL);
+		VkWriteDescriptorSet write[10]; //must be 10 for cubemap
+
+		write[0] = {};
+		write[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[0].pNext = NULL;
+		write[0].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[0].descriptorCount = 1;
+		write[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		write[0].pBufferInfo = vsUBO[i]->GetBufferInfo();
+		write[0].dstArrayElement = 0;
+		write[0].dstBinding = 0;
+
+		VkDescriptorImageInfo positionTextureDesc{};
+		positionTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		positionTextureDesc.imageView = *positionView;
+		positionTextureDesc.sampler = vulkan->GetColorSampler();
+
+		write[1] = {};
+		write[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[1].pNext = NULL;
+		write[1].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[1].descriptorCount = 1;
+		write[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write[1].pImageInfo = &positionTextureDesc;
+		write[1].dstArrayElement = 0;
+		write[1].dstBinding = 1;
+
+		VkDescriptorImageInfo normalTextureDesc{};
+		normalTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		normalTextureDesc.imageView = *normalView;
+		normalTextureDesc.sampler = vulkan->GetColorSampler();
+
+		write[2] = {};
+		write[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[2].pNext = NULL;
+		write[2].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[2].descriptorCount = 1;
+		write[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write[2].pImageInfo = &normalTextureDesc;
+		write[2].dstArrayElement = 0;
+		write[2].dstBinding = 2;
+
+		VkDescriptorImageInfo albedoTextureDesc{};
+		albedoTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		albedoTextureDesc.imageView = *albedoView;
+		albedoTextureDesc.sampler = vulkan->GetColorSampler();
+
+		write[3] = {};
+		write[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[3].pNext = NULL;
+		write[3].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[3].descriptorCount = 1;
+		write[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write[3].pImageInfo = &albedoTextureDesc;
+		write[3].dstArrayElement = 0;
+		write[3].dstBinding = 3;
+
+		VkDescriptorImageInfo materialTextureDesc{};
+		materialTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		materialTextureDesc.imageView = *materialView;
+		materialTextureDesc.sampler = vulkan->GetColorSampler();
+
+		write[4] = {};
+		write[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[4].pNext = NULL;
+		write[4].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[4].descriptorCount = 1;
+		write[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write[4].pImageInfo = &materialTextureDesc;
+		write[4].dstArrayElement = 0;
+		write[4].dstBinding = 4;
+
+		VkDescriptorImageInfo depthTextureDesc{};
+		depthTextureDesc.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthTextureDesc.imageView = *depthView;
+		depthTextureDesc.sampler = vulkan->GetColorSampler();
+
+		write[5] = {};
+		write[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[5].pNext = NULL;
+		write[5].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[5].descriptorCount = 1;
+		write[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write[5].pImageInfo = &depthTextureDesc;
+		write[5].dstArrayElement = 0;
+		write[5].dstBinding = 5;
+
+		write[6] = {};
+		write[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[6].pNext = NULL;
+		write[6].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[6].descriptorCount = 1;
+		write[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		write[6].pBufferInfo = fsUBO[i]->GetBufferInfo();
+		write[6].dstArrayElement = 0;
+		write[6].dstBinding = 6;
+
+		VkDescriptorImageInfo shadowTextureDesc{};
+		shadowTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		shadowTextureDesc.imageView = *shadowMaps->GetImageView();
+		shadowTextureDesc.sampler = shadowMaps->GetSampler();
+
+		write[7] = {};
+		write[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[7].pNext = NULL;
+		write[7].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[7].descriptorCount = 1;
+		write[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write[7].pImageInfo = &shadowTextureDesc;
+		write[7].dstArrayElement = 0;
+		write[7].dstBinding = 7;
+
+		write[8] = {};
+		write[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[8].pNext = NULL;
+		write[8].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[8].descriptorCount = 1;
+		write[8].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		write[8].pBufferInfo = lightManager->GetBufferInfo();
+		write[8].dstArrayElement = 0;
+		write[8].dstBinding = 8;
+
+		VkDescriptorImageInfo cubemapTextureDesc{};
+		cubemapTextureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		cubemapTextureDesc.imageView = *cubemapView;
+		cubemapTextureDesc.sampler = vulkan->GetColorSampler();
+
+		write[9] = {};
+		write[9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write[9].pNext = NULL;
+		write[9].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		write[9].descriptorCount = 1;
+		write[9].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write[9].pImageInfo = &cubemapTextureDesc;
+		write[9].dstArrayElement = 0;
+		write[9].dstBinding = 9;
+
+		vkUpdateDescriptorSets(vulkanDevice->GetDevice(), sizeof(write) / sizeof(write[0]), write, 0, NULL);
+	}
 
 	// Init draw command buffers
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
 		if (!cmdBuffer->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), false))
@@ -269,11 +266,14 @@ bool RenderDummy::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline
 
 void RenderDummy::Unload(VulkanInterface * vulkan)
 {
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < drawCmdBuffers.size(); i++)
 		SAFE_UNLOAD(drawCmdBuffers[i], vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
 
-	SAFE_UNLOAD(fsUBO, vulkan->GetVulkanDevice());
-	SAFE_UNLOAD(vsUBO, vulkan->GetVulkanDevice());
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		SAFE_UNLOAD(fsUBO[i], vulkan->GetVulkanDevice());
+		SAFE_UNLOAD(vsUBO[i], vulkan->GetVulkanDevice());
+	}
 	SAFE_UNLOAD(indexBuffer, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(vertexBuffer, vulkan->GetVulkanDevice());
 }
@@ -281,10 +281,13 @@ void RenderDummy::Unload(VulkanInterface * vulkan)
 void RenderDummy::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * vulkanPipeline,
 	glm::mat4 orthoMatrix, Sunlight * light, int imageIndex, Camera * camera, ShadowMaps * shadowMaps, int frameBufferId)
 {
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	VulkanCommandBuffer * drawCmdBuffer = drawCmdBuffers[frameIndex];
+
 	// Update vertex uniform buffer
 	vertexUniformBuffer.MVP = orthoMatrix;
 	
-	vsUBO->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(vertexUniformBuffer));
+	vsUBO[frameIndex]->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(vertexUniformBuffer));
 
 	// Update fragment uniform buffer
 	fragmentUniformBuffer.lightDirection = light->GetLightDirection();
@@ -295,20 +298,20 @@ void RenderDummy::Render(VulkanInterface * vulkan, VulkanCommandBuffer * command
 	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
 		fragmentUniformBuffer.lightViewMatrix[i] = shadowMaps->GetLightViewProj(i);
 
-	fsUBO->Update(vulkan->GetVulkanDevice(), &fragmentUniformBuffer, sizeof(fragmentUniformBuffer));
+	fsUBO[frameIndex]->Update(vulkan->GetVulkanDevice(), &fragmentUniformBuffer, sizeof(fragmentUniformBuffer));
 
 	// Draw
-	drawCmdBuffers[frameBufferId]->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer((int)frameBufferId));
-	vulkan->InitViewportAndScissors(drawCmdBuffers[frameBufferId], (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
+	drawCmdBuffer->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer((int)frameBufferId));
+	vulkan->InitViewportAndScissors(drawCmdBuffer, (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
 		(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
-	vulkanPipeline->SetActive(drawCmdBuffers[frameBufferId]);
+	vulkanPipeline->SetActive(drawCmdBuffer, frameIndex);
 
 	VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindVertexBuffers(drawCmdBuffers[frameBufferId]->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
-	vkCmdBindIndexBuffer(drawCmdBuffers[frameBufferId]->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindVertexBuffers(drawCmdBuffer->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
+	vkCmdBindIndexBuffer(drawCmdBuffer->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdDrawIndexed(drawCmdBuffers[frameBufferId]->GetCommandBuffer(), indexCount, 1, 0, 0, 0);
+	vkCmdDrawIndexed(drawCmdBuffer->GetCommandBuffer(), indexCount, 1, 0, 0, 0);
 
-	drawCmdBuffers[frameBufferId]->EndRecording();
-	drawCmdBuffers[frameBufferId]->ExecuteSecondary(commandBuffer);
+	drawCmdBuffer->EndRecording();
+	drawCmdBuffer->ExecuteSecondary(commandBuffer);
 }
@@ -35,8 +35,8 @@ class RenderDummy
 
 		VulkanBuffer * vertexBuffer;
 		VulkanBuffer * indexBuffer;
-		VulkanBuffer * vsUBO;
-		VulkanBuffer * fsUBO;
+		VulkanBuffer * vsUBO[MAX_FRAMES_IN_FLIGHT];
+		VulkanBuffer * fsUBO[MAX_FRAMES_IN_FLIGHT];
 
 		std::vector<VulkanCommandBuffer*> drawCmdBuffers;
 	public:
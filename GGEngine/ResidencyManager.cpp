@@ -0,0 +1,155 @@
+#include "ResidencyManager.h"
+#include "TextureManager.h"
+#include "BufferManager.h"
+#include "LogManager.h"
+
+extern LogManager * gLogManager;
+extern TextureManager * gTextureManager;
+extern BufferManager * gBufferManager;
+
+ResidencyManager::ResidencyManager()
+{
+	vulkanDevice = NULL;
+	deviceLocalHeap = 0;
+	frame = 0;
+	statistics = {};
+}
+
+ResidencyManager::~ResidencyManager()
+{
+	vulkanDevice = NULL;
+}
+
+bool ResidencyManager::Init(VulkanDevice * vulkanDevice)
+{
+	this->vulkanDevice = vulkanDevice;
+
+	// Textures and mesh buffers live in the biggest device local heap
+	VkPhysicalDeviceMemoryProperties memoryProperties = vulkanDevice->GetMemoryProperties();
+	VkDeviceSize heapSize = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memoryProperties.memoryHeaps[i].size > heapSize)
+		{
+			deviceLocalHeap = i;
+			heapSize = memoryProperties.memoryHeaps[i].size;
+		}
+	}
+
+	heaps.resize(memoryProperties.memoryHeapCount);
+	UpdateHeaps();
+
+	char msg[128];
+	sprintf(msg, "Residency: device local heap %u, budget %.2f MB%s", deviceLocalHeap, heaps[deviceLocalHeap].budget / (1024.0f * 1024.0f),
+		(vulkanDevice->IsMemoryBudgetSupported() ? "" : " (estimated)"));
+	gLogManager->AddMessage(msg);
+
+	return true;
+}
+
+void ResidencyManager::BeginFrame()
+{
+	frame++;
+	UpdateHeaps();
+}
+
+void ResidencyManager::EvictOverBudget(std::vector<VkImageView> & replacedViews)
+{
+	HeapResidency & heap = heaps[deviceLocalHeap];
+	if (heap.usage <= heap.budget)
+		return;
+
+	// Textures take most of the heap and only drop to their mip tail, mesh buffers go when that wasn't enough
+	VkDeviceSize overBudget = heap.usage - heap.budget;
+	VkDeviceSize freed = gTextureManager->EvictTextures(vulkanDevice, overBudget, replacedViews);
+	if (freed < overBudget)
+		freed += gBufferManager->EvictBuffers(vulkanDevice, overBudget - freed);
+
+	heap.usage -= (freed < heap.usage ? freed : heap.usage);
+}
+
+void ResidencyManager::ReportEviction(RESIDENCY_RESOURCE_TYPE type, VkDeviceSize size)
+{
+	statistics.evictions[type]++;
+	statistics.evictedBytes[type] += size;
+}
+
+void ResidencyManager::ReportReload(RESIDENCY_RESOURCE_TYPE type, VkDeviceSize size)
+{
+	statistics.reloads[type]++;
+	statistics.reloadedBytes[type] += size;
+}
+
+uint64_t ResidencyManager::GetFrame()
+{
+	return frame;
+}
+
+bool ResidencyManager::IsOverBudget()
+{
+	return heaps[deviceLocalHeap].usage > heaps[deviceLocalHeap].budget;
+}
+
+HeapResidency ResidencyManager::GetHeapResidency(uint32_t heapIndex)
+{
+	return heaps[heapIndex];
+}
+
+ResidencyStatistics ResidencyManager::GetStatistics()
+{
+	return statistics;
+}
+
+void ResidencyManager::LogStatistics()
+{
+	const float mb = 1024.0f * 1024.0f;
+	char msg[256];
+
+	for (uint32_t i = 0; i < heaps.size(); i++)
+	{
+		sprintf(msg, "RESIDENCY HEAP %u%s: BUDGET: %.2f MB USAGE: %.2f MB", i, (i == deviceLocalHeap ? " (EVICTING)" : ""),
+			heaps[i].budget / mb, heaps[i].usage / mb);
+		gLogManager->AddMessage(msg);
+	}
+
+	sprintf(msg, "RESIDENCY: TEXTURES EVICTED: %u (%.2f MB) RELOADED: %u (%.2f MB), BUFFERS EVICTED: %u (%.2f MB) RELOADED: %u (%.2f MB)",
+		statistics.evictions[RESIDENCY_RESOURCE_TEXTURE], statistics.evictedBytes[RESIDENCY_RESOURCE_TEXTURE] / mb,
+		statistics.reloads[RESIDENCY_RESOURCE_TEXTURE], statistics.reloadedBytes[RESIDENCY_RESOURCE_TEXTURE] / mb,
+		statistics.evictions[RESIDENCY_RESOURCE_BUFFER], statistics.evictedBytes[RESIDENCY_RESOURCE_BUFFER] / mb,
+		statistics.reloads[RESIDENCY_RESOURCE_BUFFER], statistics.reloadedBytes[RESIDENCY_RESOURCE_BUFFER] / mb);
+	gLogManager->AddMessage(msg);
+}
+
+void ResidencyManager::UpdateHeaps()
+{
+	VkPhysicalDeviceMemoryProperties memoryProperties = vulkanDevice->GetMemoryProperties();
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	if (vulkanDevice->IsMemoryBudgetSupported())
+	{
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(vulkanDevice->GetGPU(), &memoryProperties2);
+	}
+
+	for (uint32_t i = 0; i < heaps.size(); i++)
+	{
+		MemoryHeapStatistics allocatorStats = vulkanDevice->GetMemoryAllocator()->GetStatistics(i);
+
+		if (vulkanDevice->IsMemoryBudgetSupported())
+		{
+			// The driver counts the allocator's whole blocks, what's still free in them can be filled without growing the usage
+			VkDeviceSize freeInBlocks = allocatorStats.blockBytes - allocatorStats.usedBytes;
+			heaps[i].budget = (VkDeviceSize)(budgetProperties.heapBudget[i] * RESIDENCY_BUDGET_SHARE);
+			heaps[i].usage = (budgetProperties.heapUsage[i] > freeInBlocks ? budgetProperties.heapUsage[i] - freeInBlocks : 0);
+		}
+		else
+		{
+			heaps[i].budget = (VkDeviceSize)(memoryProperties.memoryHeaps[i].size * RESIDENCY_FALLBACK_BUDGET_SHARE);
+			heaps[i].usage = allocatorStats.usedBytes;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+
+#include "VulkanInterface.h"
+
+// Part of the driver's budget the engine fills before it starts evicting, the rest is headroom for spikes
+#define RESIDENCY_BUDGET_SHARE 0.9f
+// Without the memory budget extension the budget is this part of the heap
+#define RESIDENCY_FALLBACK_BUDGET_SHARE 0.8f
+// Only resources unused for longer than the frames in flight are evicted, so nothing a submitted frame reads is freed
+#define RESIDENCY_MIN_IDLE_FRAMES (MAX_FRAMES_IN_FLIGHT + 1)
+
+enum RESIDENCY_RESOURCE_TYPE
+{
+	RESIDENCY_RESOURCE_TEXTURE,
+	RESIDENCY_RESOURCE_BUFFER,
+	RESIDENCY_RESOURCE_TYPE_COUNT
+};
+
+// Budget and usage of one memory heap, usage leaves out the free parts of the allocator's blocks
+struct HeapResidency
+{
+	VkDeviceSize budget;
+	VkDeviceSize usage;
+};
+
+struct ResidencyStatistics
+{
+	uint32_t evictions[RESIDENCY_RESOURCE_TYPE_COUNT];
+	uint32_t reloads[RESIDENCY_RESOURCE_TYPE_COUNT];
+	VkDeviceSize evictedBytes[RESIDENCY_RESOURCE_TYPE_COUNT];
+	VkDeviceSize reloadedBytes[RESIDENCY_RESOURCE_TYPE_COUNT];
+};
+
+// Keeps textures and mesh buffers in the device local heap's budget, the least recently used ones are evicted first
+class ResidencyManager
+{
+	private:
+		VulkanDevice * vulkanDevice;
+		uint32_t deviceLocalHeap;
+		std::vector<HeapResidency> heaps;
+		// Read by the loading jobs to stamp what they create
+		std::atomic<uint64_t> frame;
+		ResidencyStatistics statistics;
+	private:
+		void UpdateHeaps();
+	public:
+		ResidencyManager();
+		~ResidencyManager();
+
+		bool Init(VulkanDevice * vulkanDevice);
+		void BeginFrame();
+		void EvictOverBudget(std::vector<VkImageView> & replacedViews);
+		void ReportEviction(RESIDENCY_RESOURCE_TYPE type, VkDeviceSize size);
+		void ReportReload(RESIDENCY_RESOURCE_TYPE type, VkDeviceSize size);
+		uint64_t GetFrame();
+		bool IsOverBudget();
+		HeapResidency GetHeapResidency(uint32_t heapIndex);
+		ResidencyStatistics GetStatistics();
+		void LogStatistics();
+};
\ No newline at end of file
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+
+// Index into a registry's slots, the generation changes whenever a slot is reused so old handles stop resolving
+struct ResourceHandle
+{
+	uint32_t index;
+	uint32_t generation;
+};
+
+#define INVALID_RESOURCE_HANDLE ResourceHandle{ UINT32_MAX, 0 }
+
+// Reference counted resources by name, lookups by name or handle don't depend on how many are loaded.
+// Released resources wait until the frames in flight that could use them are done before they're destroyed.
+// Safe to use from the loading jobs, T needs SetHandle()
+template <typename T>
+class ResourceRegistry
+{
+	private:
+		struct Slot
+		{
+			T * resource;
+			std::string name;
+			unsigned int useCount;
+			uint32_t generation;
+		};
+		struct ReleasedResource
+		{
+			T * resource;
+			uint64_t retireFrame;
+		};
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+		std::unordered_map<std::string, ResourceHandle> nameIndex;
+		std::vector<ReleasedResource> releasedResources;
+		size_t count;
+
+		// Names some thread is loading right now, requests for them wait instead of loading them again
+		std::unordered_set<std::string> loadingNames;
+		std::condition_variable loadDone;
+		std::mutex mutex;
+	private:
+		T * GetLocked(ResourceHandle handle)
+		{
+			if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation || slots[handle.index].resource == NULL)
+				return NULL;
+
+			return slots[handle.index].resource;
+		}
+
+		ResourceHandle AddLocked(const std::string & name, T * resource)
+		{
+			uint32_t index;
+			if (!freeSlots.empty())
+			{
+				index = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			else
+			{
+				index = (uint32_t)slots.size();
+				slots.push_back(Slot());
+				slots[index].generation = 0;
+			}
+
+			Slot & slot = slots[index];
+			slot.resource = resource;
+			slot.name = name;
+			slot.useCount = 1;
+
+			ResourceHandle handle = { index, slot.generation };
+			nameIndex[name] = handle;
+			count++;
+
+			return handle;
+		}
+	public:
+		ResourceRegistry()
+		{
+			count = 0;
+		}
+
+		// Adds a use of the named resource, only the first request calls load() and it runs without holding the lock
+		template <typename F>
+		T * Request(const std::string & name, F load)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (loadingNames.count(name) > 0)
+				loadDone.wait(lock);
+
+			auto it = nameIndex.find(name);
+			if (it != nameIndex.end())
+			{
+				slots[it->second.index].useCount++;
+				return slots[it->second.index].resource;
+			}
+
+			loadingNames.insert(name);
+			lock.unlock();
+
+			T * resource = load();
+
+			lock.lock();
+			loadingNames.erase(name);
+			if (resource)
+				resource->SetHandle(AddLocked(name, resource));
+			loadDone.notify_all();
+
+			return resource;
+		}
+
+		T * Get(ResourceHandle handle)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return GetLocked(handle);
+		}
+
+		// Returns true when that was the last use, the resource is then queued until retireFrame
+		bool Release(ResourceHandle handle, uint64_t retireFrame)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (GetLocked(handle) == NULL)
+				return false;
+
+			Slot & slot = slots[handle.index];
+			if (--slot.useCount > 0)
+				return false;
+
+			ReleasedResource released;
+			released.resource = slot.resource;
+			released.retireFrame = retireFrame;
+			releasedResources.push_back(released);
+
+			nameIndex.erase(slot.name);
+			slot.resource = NULL;
+			slot.name.clear();
+			slot.generation++;
+			freeSlots.push_back(handle.index);
+			count--;
+
+			return true;
+		}
+
+		// Hands every released resource whose frame has come to destroy, all of them when the device is idle
+		template <typename F>
+		void DestroyReleased(uint64_t frame, bool all, F destroy)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (unsigned int i = 0; i < releasedResources.size(); )
+			{
+				if (!all && releasedResources[i].retireFrame > frame)
+				{
+					i++;
+					continue;
+				}
+
+				destroy(releasedResources[i].resource);
+
+				releasedResources[i] = releasedResources.back();
+				releasedResources.pop_back();
+			}
+		}
+
+		template <typename F>
+		void ForEach(F function)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (unsigned int i = 0; i < slots.size(); i++)
+				if (slots[i].resource)
+					function(slots[i].resource);
+		}
+
+		size_t GetCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return count;
+		}
+};
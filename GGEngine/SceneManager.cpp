@@ -9,19 +9,47 @@
 #include "Timer.h"
 #include "TextureManager.h"
 #include "BufferManager.h"
+#include "ModelManager.h"
+#include "UploadManager.h"
+#include "ResidencyManager.h"
+#include "VirtualFileSystem.h"
+#include "Settings.h"
 #include "DBconnectivity.h"
+#include "JobSystem.h"
 
 TextureManager * gTextureManager;
 BufferManager * gBufferManager;
+ModelManager * gModelManager;
+UploadManager * gUploadManager;
+ResidencyManager * gResidencyManager;
+VirtualFileSystem * gVirtualFileSystem;
 DBconnectivity gConnectDB;
 
 extern LogManager * gLogManager;
 extern Input * gInput;
 extern Timer * gTimer;
+extern JobSystem * gJobSystem;
 extern GUIManager * gGUIManager;
+extern Settings * gSettings;
 
 #define DISTANSE_TO_PICKUP_ITEMS 2.0
 
+// How many times the recording benchmark records the scene per thread count
+#define RECORDING_BENCHMARK_REPEATS 32
+
+// Copies of one item the instancing benchmark spawns in a grid
+#define INSTANCING_BENCHMARK_COUNT 2048
+#define INSTANCING_BENCHMARK_MODEL "data/items/models/box.rcm"
+
+// Frames the GPU benchmark averages the pass timings over
+#define GPU_BENCHMARK_FRAMES 256
+
+// Packed by Tools/AssetPacker from the data directory next to it
+#define ASSET_ARCHIVE_FILENAME "data.pak"
+
+// Models culled by one job
+#define CULLING_BATCH_SIZE 64
+
 SceneManager::SceneManager()
 {
 	lastGameState = currentGameState = GAME_STATE_UNINITIALIZED;
@@ -31,7 +59,11 @@ SceneManager::SceneManager()
 	pipelineManager = NULL;
 
 	initCommandBuffer = NULL;
-	deferredCommandBuffer = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		deferredCommandBuffers[i] = NULL;
+	commandRecorder = NULL;
+	instanceRenderer = NULL;
+	gpuTimer = NULL;
 
 	renderDummy = NULL;
 	skydome = NULL;
@@ -47,7 +79,11 @@ SceneManager::SceneManager()
 	player = NULL;
 
 	splashScreen = NULL;
+	loadingBar = NULL;
 	showSplashScreen = true;
+	loadTaskCount = 0;
+	loadTasksDone = 0;
+	loadFailed = false;
 	gProgramRunning = true;
 }
 
@@ -66,8 +102,13 @@ SceneManager::~SceneManager()
 	SAFE_DELETE(frustumCuller);
 	SAFE_DELETE(timeCycle);
 	SAFE_DELETE(physics);
+	SAFE_DELETE(gModelManager);
 	SAFE_DELETE(gBufferManager);
 	SAFE_DELETE(gTextureManager);
+	SAFE_DELETE(gResidencyManager);
+
+	// Last, textures and everything else loaded from an archive may still point into its mapping until here
+	SAFE_UNLOAD(gVirtualFileSystem);
 }
 
 bool SceneManager::Init(VulkanInterface * vulkan)
@@ -75,9 +116,50 @@ bool SceneManager::Init(VulkanInterface * vulkan)
 	if (gConnectDB.logIn())
 		loggedin = true;
 
+	// Assets are read from data.pak when it's there, anything not packed comes from the loose data directory
+	gVirtualFileSystem = new VirtualFileSystem();
+	if (gVirtualFileSystem->Exists(ASSET_ARCHIVE_FILENAME) && !gVirtualFileSystem->Mount(ASSET_ARCHIVE_FILENAME))
+		return false;
+	if (gVirtualFileSystem->GetMountedCount() == 0)
+		gLogManager->AddMessage("WARNING: " ASSET_ARCHIVE_FILENAME " not found, loading loose files!");
+
+	if (gSettings->GetStartupBenchmark())
+		gVirtualFileSystem->RunStartupBenchmark("data");
+
 	// Init resource managers
 	gTextureManager = new TextureManager();
 	gBufferManager = new BufferManager();
+	gModelManager = new ModelManager();
+
+	// Everything loaded from here on is staged through the upload manager
+	gUploadManager = new UploadManager();
+	if (!gUploadManager->Init(vulkan->GetVulkanDevice()))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init the upload manager!");
+		return false;
+	}
+
+	// Keeps textures and mesh buffers within the device local heap's budget
+	gResidencyManager = new ResidencyManager();
+	if (!gResidencyManager->Init(vulkan->GetVulkanDevice()))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init the residency manager!");
+		return false;
+	}
+
+	// Shared texture array, only when the GPU supports descriptor indexing
+	if (!gTextureManager->InitBindless(vulkan))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init bindless textures!");
+		return false;
+	}
+
+	// Model textures load their small levels first, the rest is streamed in on a thread of its own
+	if (!gTextureManager->InitStreaming(vulkan->GetVulkanDevice()))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init texture streaming!");
+		return false;
+	}
 
 	// Init command buffers
 	initCommandBuffer = new VulkanCommandBuffer();
@@ -87,7 +169,7 @@ bool SceneManager::Init(VulkanInterface * vulkan)
 		return false;
 	}
 
-	for(size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
 		if (!cmdBuffer->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), true))
@@ -98,10 +180,30 @@ bool SceneManager::Init(VulkanInterface * vulkan)
 		renderCommandBuffers.push_back(cmdBuffer);
 	}
 
-	deferredCommandBuffer = new VulkanCommandBuffer();
-	if (!deferredCommandBuffer->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), true))
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		gLogManager->AddMessage("ERROR: Failed to create a command buffer! (deferredCommandBuffer)");
+		deferredCommandBuffers[i] = new VulkanCommandBuffer();
+		if (!deferredCommandBuffers[i]->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), true))
+		{
+			gLogManager->AddMessage("ERROR: Failed to create a command buffer! (deferredCommandBuffers)");
+			return false;
+		}
+	}
+
+	// Secondary command buffers of the shadow and deferred passes are recorded on worker threads
+	commandRecorder = new CommandRecorder();
+	if (!commandRecorder->Init(vulkan, 0))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init command recorder!");
+		return false;
+	}
+
+	instanceRenderer = new InstanceRenderer();
+
+	gpuTimer = new GPUTimer();
+	if (!gpuTimer->Init(vulkan->GetVulkanDevice()))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init GPU timer!");
 		return false;
 	}
 
@@ -135,6 +237,16 @@ bool SceneManager::Init(VulkanInterface * vulkan)
 	splashScreen->SetDimensions(0.3f, 0.4f);
 	splashScreen->SetPosition(0.35f, 0.3f);
 
+	// Grows under the logo while the game loads
+	loadingBar = new GUIElement();
+	if (!loadingBar->Init(vulkan, initCommandBuffer, "data/textures/default_diffuse.rct"))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init loading bar!");
+		return false;
+	}
+	loadingBar->SetDimensions(0.0f, 0.02f);
+	loadingBar->SetPosition(0.35f, 0.75f);
+
 	splashScreenTimer = new GameplayTimer();
 
 	ChangeGameState(GAME_STATE_SPLASH_SCREEN);
@@ -142,8 +254,32 @@ bool SceneManager::Init(VulkanInterface * vulkan)
 	return true;
 }
 
-bool SceneManager::LoadGame(VulkanInterface * vulkan)
+void SceneManager::RunLoadTask(std::function<bool()> task)
 {
+	// Every task logs its own error, the loading screen only needs to know that one failed
+	loadTaskCount++;
+	gJobSystem->Run([this, task]
+	{
+		if (!task())
+			loadFailed = true;
+		loadTasksDone++;
+	}, &loadCounter);
+}
+
+float SceneManager::GetLoadProgress()
+{
+	// The last step places everything on the main thread, it's the one left when all tasks are done
+	return (float)loadTasksDone / (float)(loadTaskCount + 1);
+}
+
+bool SceneManager::BeginLoadGame(VulkanInterface * vulkan)
+{
+	gTimer->BenchmarkCodeStart();
+
+	loadTaskCount = 0;
+	loadTasksDone = 0;
+	loadFailed = false;
+
 	// Init shadow maps
 	shadowMaps = new ShadowMaps();
 	if (!shadowMaps->Init(vulkan, initCommandBuffer, camera))
@@ -170,19 +306,81 @@ bool SceneManager::LoadGame(VulkanInterface * vulkan)
 	// Light setup
 	sunlight = new Sunlight();
 
+	// Meshes are staged in the layout the pipelines will read, so it has to be known before either starts loading
+	pipelineManager->SelectVertexLayout();
+	gModelManager->SetQuantizedVertices(pipelineManager->IsQuantizedVertices());
+
+	// Everything below only reads files, creates device objects and stages uploads, so it runs on the job system.
+	// The copies go through the upload manager, flushed every frame while the loading screen is presented. A task that fills
+	// the staging ring submits from its worker, which only ever reaches the queue through the device's submit lock
+	RunLoadTask([this, vulkan]
+	{
+		if (!pipelineManager->InitGamePipelines(vulkan, shadowMaps))
+		{
+			gLogManager->AddMessage("ERROR: Failed to init game pipelines!");
+			return false;
+		}
+		return true;
+	});
+
 	// Init test cubemap
 	testCubemap = new Cubemap();
-	if (!testCubemap->Init(vulkan->GetVulkanDevice(), initCommandBuffer, "data/cubemaps/testcubemap"))
+	RunLoadTask([this, vulkan]
 	{
-		gLogManager->AddMessage("ERROR: Failed to init cubemap!");
-		return false;
+		if (!testCubemap->Init(vulkan->GetVulkanDevice(), "data/cubemaps/testcubemap"))
+		{
+			gLogManager->AddMessage("ERROR: Failed to init cubemap!");
+			return false;
+		}
+		return true;
+	});
+
+	// Model files are parsed here, the map and item loaders only place copies of them once every task is done
+	std::string modelFiles[] = { "data/models/Map.rcm", "data/models/adam.rcm", "data/items/models/box.rcm", "data/items/models/coin.rcm" };
+	preloadedModels.assign(sizeof(modelFiles) / sizeof(modelFiles[0]), NULL);
+	for (unsigned int i = 0; i < preloadedModels.size(); i++)
+	{
+		std::string modelFile = modelFiles[i];
+		RunLoadTask([this, vulkan, modelFile, i]
+		{
+			preloadedModels[i] = gModelManager->RequestModel(modelFile, vulkan);
+			return preloadedModels[i] != nullptr;
+		});
 	}
 
-	if (!pipelineManager->InitGamePipelines(vulkan, shadowMaps))
+	// Skinned models
+	male = new SkinnedModel();
+	RunLoadTask([this, vulkan]
 	{
-		gLogManager->AddMessage("ERROR: Failed to init game pipelines!");
+		// The init command buffer belongs to the main thread, nothing in here may record into it
+		if (!male->Init("data/models/male.rcs", vulkan, NULL))
+		{
+			gLogManager->AddMessage("ERROR: Failed to init male model!");
+			return false;
+		}
+		return true;
+	});
+
+	// Animations only go through Assimp
+	idleAnim = new Animation();
+	walkAnim = new Animation();
+	fallAnim = new Animation();
+	jumpAnim = new Animation();
+	runAnim = new Animation();
+
+	RunLoadTask([this] { return idleAnim->Init("data/anims/idle.fbx", 52, true); });
+	RunLoadTask([this] { return walkAnim->Init("data/anims/walk.fbx", 52, true); });
+	RunLoadTask([this] { return fallAnim->Init("data/anims/falling.fbx", 52, true); });
+	RunLoadTask([this] { return jumpAnim->Init("data/anims/jump.fbx", 52, false); });
+	RunLoadTask([this] { return runAnim->Init("data/anims/run.fbx", 52, true); });
+
+	return true;
+}
+
+bool SceneManager::FinishLoadGame(VulkanInterface * vulkan)
+{
+	if (loadFailed)
 		return false;
-	}
 
 	// Init render dummy
 	renderDummy = new RenderDummy();
@@ -213,45 +411,21 @@ bool SceneManager::LoadGame(VulkanInterface * vulkan)
 	timeCycle->SetTime(9, 0);
 	timeCycle->SetWeather("sunny");
 
-	// Load map files
-	if (!LoadMapFile("data/testmap.map", vulkan))
-		return false;
+	// Load map files, rigid bodies are added to the physics world here on the main thread
+	bool loaded = LoadMapFile("data/testmap.map", vulkan) && LoadItemsFile("data/itemList.txt", vulkan);
 
-	if (!LoadItemsFile("data/itemList.txt", vulkan))
-		return false;
+	// The placed copies hold their own uses now
+	for (unsigned int i = 0; i < preloadedModels.size(); i++)
+		gModelManager->ReleaseModel(preloadedModels[i], vulkan);
+	preloadedModels.clear();
 
-	// Skinned models and animations
-	male = new SkinnedModel();
-	if (!male->Init("data/models/male.rcs", vulkan, initCommandBuffer))
-	{
-		gLogManager->AddMessage("ERROR: Failed to init male model!");
+	if (!loaded)
 		return false;
-	}
 
-	// Animations
-	idleAnim = new Animation();
-	if (!idleAnim->Init("data/anims/idle.fbx", 52, true))
-		return false;
 	idleAnim->SetAnimationSpeed(0.0005f);
-
-	walkAnim = new Animation();
-	if (!walkAnim->Init("data/anims/walk.fbx", 52, true))
-		return false;
-
-	fallAnim = new Animation();
-	if (!fallAnim->Init("data/anims/falling.fbx", 52, true))
-		return false;
 	fallAnim->SetAnimationSpeed(0.002f);
-
-	jumpAnim = new Animation();
-	if (!jumpAnim->Init("data/anims/jump.fbx", 52, false))
-		return false;
 	jumpAnim->SetAnimationSpeed(0.001f);
 
-	runAnim = new Animation();
-	if (!runAnim->Init("data/anims/run.fbx", 52, true))
-		return false;
-
 
 	male->SetAnimation(idleAnim);
 
@@ -275,11 +449,33 @@ bool SceneManager::LoadGame(VulkanInterface * vulkan)
 		player->getInventory().add(item);
 	}
 
+	gTimer->BenchmarkCodeEnd();
+
+	char msg[128];
+	sprintf(msg, "LOADING: TASKS: %u THREADS: %u ARCHIVES: %zu TIME: %f", loadTaskCount, gJobSystem->GetThreadCount(),
+		gVirtualFileSystem->GetMountedCount(), gTimer->GetBenchmarkResult());
+	gLogManager->AddMessage(msg);
+
 	return true;
 }
 
 void SceneManager::Unload(VulkanInterface * vulkan)
 {
+	// Loading tasks may still be running when the game is closed on the loading screen
+	gJobSystem->Wait(&loadCounter);
+
+	// FinishLoadGame never ran then, the preloaded models are released here so they're destroyed with the rest
+	for (unsigned int i = 0; i < preloadedModels.size(); i++)
+		gModelManager->ReleaseModel(preloadedModels[i], vulkan);
+	preloadedModels.clear();
+
+	// The streaming thread stages through the upload manager, it stops first
+	gTextureManager->UnloadStreaming(vulkan->GetVulkanDevice());
+
+	// Waits for the copies still in flight before anything they write to is destroyed
+	SAFE_UNLOAD(gUploadManager, vulkan->GetVulkanDevice());
+
+	SAFE_UNLOAD(loadingBar, vulkan);
 	SAFE_UNLOAD(splashScreen, vulkan);
 
 	SAFE_UNLOAD(male, vulkan);
@@ -301,16 +497,56 @@ void SceneManager::Unload(VulkanInterface * vulkan)
 	SAFE_UNLOAD(guiManager, vulkan);
 	SAFE_UNLOAD(pipelineManager, vulkan);
 
+	// The device is idle, nothing released has to wait for a frame anymore
+	std::vector<VkImageView> destroyedViews;
+	std::vector<VkBuffer> destroyedBuffers;
+	gModelManager->DestroyReleasedModels(vulkan, destroyedBuffers, true);
+	gTextureManager->DestroyReleasedTextures(vulkan->GetVulkanDevice(), destroyedViews, true);
+	gBufferManager->DestroyReleasedBuffers(vulkan->GetVulkanDevice(), destroyedBuffers, true);
+	gTextureManager->UnloadBindless(vulkan->GetVulkanDevice());
+
+	SAFE_DELETE(instanceRenderer);
+	SAFE_UNLOAD(gpuTimer, vulkan->GetVulkanDevice());
+	SAFE_UNLOAD(commandRecorder, vulkan);
 	for (unsigned int i = 0; i < renderCommandBuffers.size(); i++)
 		SAFE_UNLOAD(renderCommandBuffers[i], vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
-	SAFE_UNLOAD(deferredCommandBuffer, vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		SAFE_UNLOAD(deferredCommandBuffers[i], vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
 	SAFE_UNLOAD(initCommandBuffer, vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
+
+	vulkan->GetVulkanDevice()->GetMemoryAllocator()->Defragment();
 }
 
 int imageIndex = 5;
 
 void SceneManager::Render(VulkanInterface * vulkan)
 {
+	// Wait until the GPU is done with the frame slot we're about to reuse and acquire the next swapchain image
+	vulkan->BeginFrame();
+
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	int framebufferId = (int)vulkan->GetVulkanSwapchain()->GetCurrentBufferId();
+	VulkanCommandBuffer * deferredCommandBuffer = deferredCommandBuffers[frameIndex];
+	VulkanCommandBuffer * renderCommandBuffer = renderCommandBuffers[frameIndex];
+
+	commandRecorder->BeginFrame(vulkan);
+
+	// Destroy what was released once the frames using it are done, swap in the textures the streaming thread finished
+	// and evict what's over budget, the descriptor set caches retire the sets of old views and buffers. Loading jobs are
+	// still adding resources and pipelines while the loading screen is up, so all of that waits until they're done
+	std::vector<VkImageView> replacedViews;
+	std::vector<VkBuffer> destroyedBuffers;
+	gResidencyManager->BeginFrame();
+	if (currentGameState != GAME_STATE_LOADING)
+	{
+		gModelManager->DestroyReleasedModels(vulkan, destroyedBuffers);
+		gTextureManager->DestroyReleasedTextures(vulkan->GetVulkanDevice(), replacedViews);
+		gBufferManager->DestroyReleasedBuffers(vulkan->GetVulkanDevice(), destroyedBuffers);
+		gTextureManager->UpdateStreaming(vulkan->GetVulkanDevice(), replacedViews);
+		gResidencyManager->EvictOverBudget(replacedViews);
+		pipelineManager->EvictDescriptorSets(vulkan->GetVulkanDevice(), replacedViews, destroyedBuffers);
+	}
+
 	// Splash screen
 	if (showSplashScreen == true && splashScreenTimer)
 			splashScreenTimer->StartTimer();
@@ -318,12 +554,28 @@ void SceneManager::Render(VulkanInterface * vulkan)
 	
 	if (showSplashScreen == true)
 	{
-		if (splashScreenTimer->TimePassed(1000))
+		if (currentGameState == GAME_STATE_SPLASH_SCREEN && splashScreenTimer->TimePassed(1000))
 		{
 			ChangeGameState(GAME_STATE_LOADING);
-			if (LoadGame(vulkan))
+			if (!BeginLoadGame(vulkan))
+				THROW_ERROR();
+		}
+
+		// Frames keep being presented with the progress until the last loading task is done
+		if (currentGameState == GAME_STATE_LOADING)
+			loadingBar->SetDimensions(0.3f * GetLoadProgress(), 0.02f);
+
+		if (currentGameState == GAME_STATE_LOADING && loadCounter.count == 0)
+		{
+			if (FinishLoadGame(vulkan))
 			{
 				ChangeGameState(GAME_STATE_MAINMENU);
+
+				// Once the uploads are done their oversized staging buffers are freed, give the empty blocks back
+				gUploadManager->WaitIdle();
+				gUploadManager->LogStatistics();
+				vulkan->GetVulkanDevice()->GetMemoryAllocator()->Defragment();
+				vulkan->GetVulkanDevice()->GetMemoryAllocator()->LogStatistics();
 			}
 			else
 				THROW_ERROR();
@@ -394,12 +646,40 @@ void SceneManager::Render(VulkanInterface * vulkan)
 		}
 		if (gInput->WasKeyPressed(KEYBOARD_KEY_Q))
 		{
-			char msg[64];
-			sprintf(msg, "OBJ: %zu TXD: %zu BUF: %zu", modelList.size() + itemModelList.size(), gTextureManager->GetLoadedTexturesCount(),
-				gBufferManager->GetLoadedBuffersCount());
+			char msg[128];
+			sprintf(msg, "OBJ: %zu MDL: %zu TXD: %zu BUF: %zu", modelList.size() + itemModelList.size(), gModelManager->GetLoadedModelsCount(),
+				gTextureManager->GetLoadedTexturesCount(), gBufferManager->GetLoadedBuffersCount());
+			gLogManager->AddMessage(msg);
+
+			// Last frame's triangles per pass at the levels of detail drawn, against drawing everything at full detail
+			TriangleCounts shadowTriangles = Model::GetTriangleCounts(MODEL_PASS_SHADOW);
+			TriangleCounts deferredTriangles = Model::GetTriangleCounts(MODEL_PASS_DEFERRED);
+			sprintf(msg, "TRIANGLES: SHADOW: %llu (FULL: %llu) DEFERRED: %llu (FULL: %llu)", shadowTriangles.submitted,
+				shadowTriangles.fullDetail, deferredTriangles.submitted, deferredTriangles.fullDetail);
 			gLogManager->AddMessage(msg);
+
+			vulkan->GetVulkanDevice()->GetMemoryAllocator()->LogStatistics();
+			gResidencyManager->LogStatistics();
 		}
 
+		if (gInput->WasKeyPressed(KEYBOARD_KEY_B))
+			RunRecordingBenchmark(vulkan);
+
+		if (gInput->WasKeyPressed(KEYBOARD_KEY_K))
+			RunInstancingBenchmark(vulkan);
+
+		if (gInput->WasKeyPressed(KEYBOARD_KEY_J))
+			gJobSystem->RunBenchmark();
+
+		if (gInput->WasKeyPressed(KEYBOARD_KEY_T))
+			gTextureManager->RunLoadBenchmark(vulkan->GetVulkanDevice(), "data");
+
+		if (gInput->WasKeyPressed(KEYBOARD_KEY_M))
+			gModelManager->RunLoadBenchmark(vulkan->GetVulkanDevice(), "data");
+
+		if (gInput->WasKeyPressed(KEYBOARD_KEY_U))
+			gpuTimer->StartCapture(GPU_BENCHMARK_FRAMES);
+
 		camera->HandleInput();
 
 		player->Update(vulkan, camera);
@@ -444,105 +724,316 @@ void SceneManager::Render(VulkanInterface * vulkan)
 			changed = true;
 		}
 
+		// Triangles are counted per frame, Q logs the last one's
+		Model::ResetTriangleCounts();
+
 		// Shadow pass
 		shadowMaps->UpdatePartitions(vulkan, camera, sunlight);
 
+		// Both the shadow and the camera frustums are known now, cull everything at once on the job system
+		CullModels(modelList, modelCullResults);
+		CullModels(itemModelList, itemCullResults);
+
+		// Shadow and deferred passes share one primary command buffer, ordered by renderpass dependencies
+		deferredCommandBuffer->BeginRecording();
+
+		// Pass timings of the real frame, the way to compare mesh data before and after an optimization
+		gpuTimer->BeginFrame(vulkan->GetVulkanDevice(), deferredCommandBuffer, frameIndex);
+		gpuTimer->WriteTimestamp(deferredCommandBuffer, GPU_TIMESTAMP_FRAME_START);
+
 		shadowMaps->BeginShadowPass(deferredCommandBuffer);
 
-		float frustumCullData[SHADOW_CASCADE_COUNT];
 		for (unsigned int i = 0; i < modelList.size(); i++)
 		{
 			// Check if model is inside shadow map bound
-			if (shadowMaps->GetFrustumCuller(SHADOW_CASCADE_COUNT)->IsInsideFrustum(modelList[i]))
+			if (modelCullResults[i].inShadowMap)
 			{
-				for (int j = 0; j < SHADOW_CASCADE_COUNT; j++)
-				{
-					if (shadowMaps->GetFrustumCuller(j)->IsInsideFrustum(modelList[i]))
-						frustumCullData[j] = 1.0f;
-					else
-						frustumCullData[j] = 0.0f;
-				}
-				modelList[i]->SetFrustumCullData(frustumCullData);
-				modelList[i]->Render(vulkan, deferredCommandBuffer, pipelineManager->GetShadow(), NULL, shadowMaps);
+				modelList[i]->SetFrustumCullData(modelCullResults[i].shadowCascades);
+				modelList[i]->Render(vulkan, commandRecorder, pipelineManager->GetShadow(), NULL, shadowMaps);
 			}
 		}
 
+		// Copies of the same item are drawn together when the instanced shaders are there
+		VulkanPipeline * shadowInstanced = pipelineManager->GetShadowInstanced();
+
 		for (unsigned int i = 0; i < itemModelList.size(); i++)
 		{
 			if(itemList[i]->getOnMap())
 			{
 				// Check if model is inside shadow map bound
-				if (shadowMaps->GetFrustumCuller(SHADOW_CASCADE_COUNT)->IsInsideFrustum(itemModelList[i]))
+				if (itemCullResults[i].inShadowMap)
 				{
-					for (int j = 0; j < SHADOW_CASCADE_COUNT; j++)
-					{
-						if (shadowMaps->GetFrustumCuller(j)->IsInsideFrustum(itemModelList[i]))
-							frustumCullData[j] = 1.0f;
-						else
-							frustumCullData[j] = 0.0f;
-					}
-					itemModelList[i]->SetFrustumCullData(frustumCullData);
-					itemModelList[i]->Render(vulkan, deferredCommandBuffer, pipelineManager->GetShadow(), NULL, shadowMaps);
+					itemModelList[i]->SetFrustumCullData(itemCullResults[i].shadowCascades);
+					if (shadowInstanced)
+						instanceRenderer->AddInstance(itemModelList[i], NULL, shadowMaps);
+					else
+						itemModelList[i]->Render(vulkan, commandRecorder, pipelineManager->GetShadow(), NULL, shadowMaps);
 				}
 			}
 		}
 
-		player->GetModel()->Render(vulkan, deferredCommandBuffer, pipelineManager->GetShadowSkinned(), NULL, shadowMaps);
+		if (shadowInstanced)
+			instanceRenderer->Render(vulkan, commandRecorder, shadowInstanced, NULL, shadowMaps);
+
+		player->GetModel()->Render(vulkan, commandRecorder, pipelineManager->GetShadowSkinned(), NULL, shadowMaps);
 
-		shadowMaps->EndShadowPass(vulkan->GetVulkanDevice(), deferredCommandBuffer);
+		commandRecorder->Execute(deferredCommandBuffer);
+
+		shadowMaps->EndShadowPass(deferredCommandBuffer);
+		gpuTimer->WriteTimestamp(deferredCommandBuffer, GPU_TIMESTAMP_SHADOW_END);
 
 		// Deferred rendering
 		vulkan->BeginSceneDeferred(deferredCommandBuffer);
 
 		for (unsigned int i = 0; i < modelList.size(); i++)
-			if (frustumCuller->IsInsideFrustum(modelList[i]))
-				modelList[i]->Render(vulkan, deferredCommandBuffer, pipelineManager->GetDeferred(), camera, NULL);
+			if (modelCullResults[i].inFrustum)
+				modelList[i]->Render(vulkan, commandRecorder, pipelineManager->GetDeferred(), camera, NULL);
+
+		VulkanPipeline * deferredInstanced = pipelineManager->GetDeferredInstanced();
 
 		for (unsigned int i = 0; i < itemModelList.size(); i++)
 			if (itemList[i]->getOnMap())
 			{
-				if (frustumCuller->IsInsideFrustum(itemModelList[i]))
-					itemModelList[i]->Render(vulkan, deferredCommandBuffer, pipelineManager->GetDeferred(), camera, NULL);
+				if (itemCullResults[i].inFrustum)
+				{
+					if (deferredInstanced)
+						instanceRenderer->AddInstance(itemModelList[i], camera, NULL);
+					else
+						itemModelList[i]->Render(vulkan, commandRecorder, pipelineManager->GetDeferred(), camera, NULL);
+				}
 			}
 
-		player->GetModel()->Render(vulkan, deferredCommandBuffer, pipelineManager->GetSkinned(), camera, NULL);
+		if (deferredInstanced)
+			instanceRenderer->Render(vulkan, commandRecorder, deferredInstanced, camera, NULL);
+
+		player->GetModel()->Render(vulkan, commandRecorder, pipelineManager->GetSkinned(), camera, NULL);
+
+		commandRecorder->Execute(deferredCommandBuffer);
 
 		vulkan->EndSceneDeferred(deferredCommandBuffer);
+		gpuTimer->WriteTimestamp(deferredCommandBuffer, GPU_TIMESTAMP_DEFERRED_END);
+
+		deferredCommandBuffer->EndRecording();
 	}
 	else
 	{
+		deferredCommandBuffer->BeginRecording();
 		vulkan->BeginSceneDeferred(deferredCommandBuffer);
 		vulkan->EndSceneDeferred(deferredCommandBuffer);
+		deferredCommandBuffer->EndRecording();
+	}
+
+	// Forward rendering, only for the acquired swapchain image
+	vulkan->BeginSceneForward(renderCommandBuffer, framebufferId);
+	if (currentGameState == GAME_STATE_INGAME)
+	{
+		skydome->Render(vulkan, renderCommandBuffer, pipelineManager->GetSkydome(), camera, framebufferId);
+		renderDummy->Render(vulkan, renderCommandBuffer, pipelineManager->GetDefault(), camera->GetOrthoMatrix(), sunlight, imageIndex, camera, shadowMaps, framebufferId);
+	}
+	else if (currentGameState == GAME_STATE_SPLASH_SCREEN) 
+	{
+		splashScreen->Render(vulkan, renderCommandBuffer, pipelineManager->GetCanvas(), camera, framebufferId);
+	}
+	else if (currentGameState == GAME_STATE_LOADING)
+	{
+		splashScreen->Render(vulkan, renderCommandBuffer, pipelineManager->GetCanvas(), camera, framebufferId);
+		loadingBar->Render(vulkan, renderCommandBuffer, pipelineManager->GetCanvas(), camera, framebufferId);
+	}
+	else if (currentGameState == GAME_STATE_MAINMENU) 
+	{}
+	else
+	{
+		gLogManager->AddMessage("ERROR: Unknown game state!");
+		THROW_ERROR();
+	}
+
+	guiManager->Update(vulkan, renderCommandBuffer, pipelineManager->GetCanvas(), camera, framebufferId, inventoryList, changed);
+	changed = false;
+	vulkan->EndSceneForward(renderCommandBuffer);
+	
+	// Uploads made this frame are submitted ahead of it, so the frame can already use them
+	gUploadManager->Flush();
+
+	// Present to screen
+	vulkan->Present(deferredCommandBuffer, renderCommandBuffer);
+}
+
+void SceneManager::CullModels(std::vector<Model*>& models, std::vector<ModelCullResult>& cullResults)
+{
+	cullResults.resize(models.size());
+
+	// Read only on the cullers and models, every job writes its own range of results
+	gJobSystem->ParallelFor((unsigned int)models.size(), CULLING_BATCH_SIZE, [this, &models, &cullResults](unsigned int start, unsigned int end)
+	{
+		for (unsigned int i = start; i < end; i++)
+		{
+			ModelCullResult& result = cullResults[i];
+			result.inFrustum = frustumCuller->IsInsideFrustum(models[i]);
+			result.inShadowMap = shadowMaps->GetFrustumCuller(SHADOW_CASCADE_COUNT)->IsInsideFrustum(models[i]);
+
+			for (int j = 0; j < SHADOW_CASCADE_COUNT; j++)
+			{
+				if (result.inShadowMap && shadowMaps->GetFrustumCuller(j)->IsInsideFrustum(models[i]))
+					result.shadowCascades[j] = 1.0f;
+				else
+					result.shadowCascades[j] = 0.0f;
+			}
+		}
+	});
+}
+
+void SceneManager::RunRecordingBenchmark(VulkanInterface * vulkan)
+{
+	// Stress scene: every model is recorded many times into a primary that never gets submitted
+	VulkanCommandBuffer * benchmarkCmdBuffer = deferredCommandBuffers[vulkan->GetFrameIndex()];
+	unsigned int threadCount = commandRecorder->GetThreadCount();
+	unsigned int drawCount = 0;
+
+	for (unsigned int i = 0; i < modelList.size(); i++)
+		drawCount += modelList[i]->GetMeshCount() * RECORDING_BENCHMARK_REPEATS;
+
+	// 1, 2, 4, ... threads and finally all of them
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < threadCount; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(threadCount);
+
+	// Cached models would only replay their buffers, record everything from scratch
+	for (unsigned int i = 0; i < modelList.size(); i++)
+		modelList[i]->SetCommandBufferCacheEnabled(false);
+
+	// Every repeat allocates new uniform slices, give the ring back after each run so it can't overflow
+	VkDeviceSize ringUsage = vulkan->GetUniformRing()->GetUsage();
+
+	for (unsigned int threads : threadCounts)
+	{
+		commandRecorder->SetActiveThreadCount(threads);
+		commandRecorder->BeginFrame(vulkan);
+
+		benchmarkCmdBuffer->BeginRecording();
+		vulkan->BeginSceneDeferred(benchmarkCmdBuffer);
+
+		gTimer->BenchmarkCodeStart();
+		for (int i = 0; i < RECORDING_BENCHMARK_REPEATS; i++)
+			for (unsigned int j = 0; j < modelList.size(); j++)
+				modelList[j]->Render(vulkan, commandRecorder, pipelineManager->GetDeferred(), camera, NULL);
+		commandRecorder->Execute(benchmarkCmdBuffer);
+		gTimer->BenchmarkCodeEnd();
+
+		vulkan->EndSceneDeferred(benchmarkCmdBuffer);
+		benchmarkCmdBuffer->EndRecording();
+
+		char msg[128];
+		sprintf(msg, "RECORDING BENCHMARK: THREADS: %u DRAWS: %u TIME: %f", threads, drawCount, gTimer->GetBenchmarkResult());
+		gLogManager->AddMessage(msg);
+
+		vulkan->GetUniformRing()->Rewind(ringUsage);
+	}
+
+	for (unsigned int i = 0; i < modelList.size(); i++)
+		modelList[i]->SetCommandBufferCacheEnabled(true);
+
+	// Drop everything the benchmark recorded, the real frame is recorded after this
+	commandRecorder->SetActiveThreadCount(threadCount);
+	commandRecorder->BeginFrame(vulkan);
+}
+
+void SceneManager::RunInstancingBenchmark(VulkanInterface * vulkan)
+{
+	if (pipelineManager->GetDeferredInstanced() == NULL || pipelineManager->GetShadowInstanced() == NULL)
+	{
+		gLogManager->AddMessage("INSTANCING BENCHMARK: Instanced shaders not found!");
+		return;
 	}
 
-	// Forward rendering
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	// Stress scene: a grid of one item in every cascade, both passes recorded into a primary that never gets submitted
+	std::vector<Model*> models;
+	float shadowCascades[SHADOW_CASCADE_COUNT];
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+		shadowCascades[i] = 1.0f;
+
+	for (unsigned int i = 0; i < INSTANCING_BENCHMARK_COUNT; i++)
 	{
-		vulkan->BeginSceneForward(renderCommandBuffers[i], (int)i);
-		if (currentGameState == GAME_STATE_INGAME)
+		// The asset is parsed once, every other copy only adds a rigid body
+		Model * model = new Model();
+		if (!model->Init(INSTANCING_BENCHMARK_MODEL, vulkan, initCommandBuffer, physics, 0.0f))
 		{
-			skydome->Render(vulkan, renderCommandBuffers[i], pipelineManager->GetSkydome(), camera, (int)i);
-			renderDummy->Render(vulkan, renderCommandBuffers[i], pipelineManager->GetDefault(), camera->GetOrthoMatrix(), sunlight, imageIndex, camera, shadowMaps, (int)i);
+			gLogManager->AddMessage("ERROR: Failed to init instancing benchmark model!");
+			SAFE_DELETE(model);
+			break;
 		}
-		else if (currentGameState == GAME_STATE_SPLASH_SCREEN) 
+
+		model->SetPosition((float)(i % 64) * 2.0f, 50.0f, (float)(i / 64) * 2.0f);
+		model->SetFrustumCullData(shadowCascades);
+		models.push_back(model);
+	}
+
+	VulkanCommandBuffer * benchmarkCmdBuffer = deferredCommandBuffers[vulkan->GetFrameIndex()];
+	VkDeviceSize ringUsage = vulkan->GetUniformRing()->GetUsage();
+
+	// First every copy on its own, then one instanced draw per mesh
+	for (int run = 0; run < 2; run++)
+	{
+		bool instanced = (run == 1);
+		unsigned int drawCount = 0;
+
+		commandRecorder->BeginFrame(vulkan);
+		instanceRenderer->ResetStatistics();
+
+		benchmarkCmdBuffer->BeginRecording();
+
+		gTimer->BenchmarkCodeStart();
+
+		shadowMaps->BeginShadowPass(benchmarkCmdBuffer);
+		for (unsigned int i = 0; i < models.size(); i++)
 		{
-			splashScreen->Render(vulkan, renderCommandBuffers[i], pipelineManager->GetCanvas(), camera, (int)i);
+			if (instanced)
+				instanceRenderer->AddInstance(models[i], NULL, shadowMaps);
+			else
+				models[i]->Render(vulkan, commandRecorder, pipelineManager->GetShadow(), NULL, shadowMaps);
 		}
-		else if (currentGameState == GAME_STATE_MAINMENU) 
-		{}
-		else
+		if (instanced)
+			instanceRenderer->Render(vulkan, commandRecorder, pipelineManager->GetShadowInstanced(), NULL, shadowMaps);
+		commandRecorder->Execute(benchmarkCmdBuffer);
+		shadowMaps->EndShadowPass(benchmarkCmdBuffer);
+
+		vulkan->BeginSceneDeferred(benchmarkCmdBuffer);
+		for (unsigned int i = 0; i < models.size(); i++)
 		{
-			gLogManager->AddMessage("ERROR: Unknown game state!");
-			THROW_ERROR();
+			if (instanced)
+				instanceRenderer->AddInstance(models[i], camera, NULL);
+			else
+				models[i]->Render(vulkan, commandRecorder, pipelineManager->GetDeferred(), camera, NULL);
 		}
+		if (instanced)
+			instanceRenderer->Render(vulkan, commandRecorder, pipelineManager->GetDeferredInstanced(), camera, NULL);
+		commandRecorder->Execute(benchmarkCmdBuffer);
+		vulkan->EndSceneDeferred(benchmarkCmdBuffer);
+
+		gTimer->BenchmarkCodeEnd();
+
+		benchmarkCmdBuffer->EndRecording();
+
+		if (instanced)
+			drawCount = instanceRenderer->GetDrawCount();
+		else
+			for (unsigned int i = 0; i < models.size(); i++)
+				drawCount += models[i]->GetMeshCount() * 2;
+
+		char msg[128];
+		sprintf(msg, "INSTANCING BENCHMARK: %s INSTANCES: %zu DRAWS: %u TIME: %f", (instanced ? "INSTANCED" : "PER MODEL"), models.size(),
+			drawCount, gTimer->GetBenchmarkResult());
+		gLogManager->AddMessage(msg);
 
-		guiManager->Update(vulkan, renderCommandBuffers[i], pipelineManager->GetCanvas(), camera, (int)i, inventoryList, changed);
-		changed = false;
-		vulkan->EndSceneForward(renderCommandBuffers[i]);
+		vulkan->GetUniformRing()->Rewind(ringUsage);
 	}
-	
-	// Present to screen
-	vulkan->Present(renderCommandBuffers);
+
+	// Drop everything the benchmark recorded, the copies are destroyed once no frame can use them
+	commandRecorder->BeginFrame(vulkan);
+	instanceRenderer->ResetStatistics();
+
+	for (unsigned int i = 0; i < models.size(); i++)
+		SAFE_UNLOAD(models[i], vulkan);
 }
 
 void SceneManager::SetProgramRunning(bool toggle) {
@@ -593,6 +1084,10 @@ bool SceneManager::LoadMapFile(std::string filename, VulkanInterface * vulkan)
 		model->SetPosition(posX, posY, posZ);
 		model->SetRotation(rotX, rotY, rotZ);
 
+		// Static map geometry, its draw commands are recorded once and replayed every frame
+		if (mass == 0.0f && !model->InitCommandBufferCache(vulkan))
+			return false;
+
 		modelList.push_back(model);
 	}
 
@@ -4,6 +4,9 @@
 #include "VulkanInterface.h"
 #include "PipelineManager.h"
 #include "VulkanCommandBuffer.h"
+#include "CommandRecorder.h"
+#include "InstanceRenderer.h"
+#include "GPUTimer.h"
 #include "Model.h"
 #include "SkinnedModel.h"
 #include "WireframeModel.h"
@@ -22,6 +25,7 @@
 #include "LightManager.h"
 #include "Cubemap.h"
 #include "Item.h"
+#include "JobSystem.h"
 
 enum GAME_STATE
 {
@@ -32,6 +36,14 @@ enum GAME_STATE
 	GAME_STATE_INGAME
 };
 
+// Frustum culling results of one model, filled on the job system
+struct ModelCullResult
+{
+	bool inFrustum;
+	bool inShadowMap;
+	float shadowCascades[SHADOW_CASCADE_COUNT];
+};
+
 class SceneManager
 {
 	private:
@@ -48,8 +60,11 @@ class SceneManager
 		FrustumCuller * frustumCuller;
 
 		VulkanCommandBuffer * initCommandBuffer;
-		VulkanCommandBuffer * deferredCommandBuffer;
+		VulkanCommandBuffer * deferredCommandBuffers[MAX_FRAMES_IN_FLIGHT];
 		std::vector<VulkanCommandBuffer*> renderCommandBuffers;
+		CommandRecorder * commandRecorder;
+		InstanceRenderer * instanceRenderer;
+		GPUTimer * gpuTimer;
 
 		RenderDummy * renderDummy;
 		Skydome * skydome;
@@ -64,12 +79,22 @@ class SceneManager
 		std::vector<Model*> itemModelList;
 		std::vector<Item*> itemList;
 		std::vector<Item*> inventoryList;
+		std::vector<ModelCullResult> modelCullResults;
+		std::vector<ModelCullResult> itemCullResults;
 		SkinnedModel * male;
 		Player * player;
 
 		GUIElement * splashScreen;
+		GUIElement * loadingBar;
 		GameplayTimer * splashScreenTimer;
 		bool showSplashScreen;
+
+		// Loading tasks run on the job system while the loading screen is presented
+		JobCounter loadCounter;
+		unsigned int loadTaskCount;
+		std::atomic<unsigned int> loadTasksDone;
+		std::atomic<bool> loadFailed;
+		std::vector<ModelAsset*> preloadedModels;
 		bool gProgramRunning;
 		bool changed = false;
 		unsigned inventorySize, inv;
@@ -79,8 +104,14 @@ class SceneManager
 	private:
 		bool LoadMapFile(std::string filename, VulkanInterface * vulkan);
 		bool LoadItemsFile(std::string filename, VulkanInterface * vulkan);
-		bool LoadGame(VulkanInterface * vulkan);
+		void RunLoadTask(std::function<bool()> task);
+		float GetLoadProgress();
+		bool BeginLoadGame(VulkanInterface * vulkan);
+		bool FinishLoadGame(VulkanInterface * vulkan);
 		void ChangeGameState(GAME_STATE newGameState);
+		void CullModels(std::vector<Model*>& models, std::vector<ModelCullResult>& cullResults);
+		void RunRecordingBenchmark(VulkanInterface * vulkan);
+		void RunInstancingBenchmark(VulkanInterface * vulkan);
 	public:
 		SceneManager();
 		~SceneManager();
@@ -12,6 +12,7 @@ Settings::Settings()
 	windowWidth = desktop.right;
 	windowHeight = desktop.bottom;
 	fullscreen = false;
+	startupBenchmark = false;
 }
 
 bool Settings::ReadSettings()
@@ -40,6 +41,8 @@ bool Settings::ReadSettings()
 			file >> windowHeight;
 		else if (identifier == "fullscreen")
 			file >> (bool)fullscreen;
+		else if (identifier == "startupbenchmark")
+			file >> startupBenchmark;
 		else
 		{
 			Settings();
@@ -64,3 +67,8 @@ bool Settings::GetFullscreenMode()
 	return fullscreen;
 }
 
+bool Settings::GetStartupBenchmark()
+{
+	return startupBenchmark;
+}
+
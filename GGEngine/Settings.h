@@ -7,6 +7,9 @@ class Settings
 	private:
 		int windowWidth, windowHeight;
 		bool fullscreen;
+
+		// Times reading every asset packed and loose before anything else is loaded
+		bool startupBenchmark;
 	public:
 		Settings();
 
@@ -15,4 +18,5 @@ class Settings
 		int GetWindowWidth();
 		int GetWindowHeight();
 		bool GetFullscreenMode();
+		bool GetStartupBenchmark();
 };
\ No newline at end of file
@@ -1,9 +1,9 @@
-#include <fstream>
-
 #include "Shader.h"
 #include "LogManager.h"
+#include "VirtualFileSystem.h"
 
 extern LogManager * gLogManager;
+extern VirtualFileSystem * gVirtualFileSystem;
 
 Shader::Shader()
 {
@@ -31,31 +31,21 @@ bool Shader::Init(VulkanDevice * vulkanDevice, std::string shaderName, bool hasG
 	for(uint32_t i = 0; i < stageCount; i++)
 		shaderStages[i] = {};
 
-	FILE * file = NULL;
+	// Stages are created straight from the mapped files, SPIR-V only has to be 4 byte aligned
+	VirtualFile file;
 
 	// Vertex shader
 	std::string vertexShaderPath = shaderDir + shaderName + "VS.spv";
-	file = fopen(vertexShaderPath.c_str(), "rb");
-	if (file == NULL)
+	if (!file.Open(vertexShaderPath))
 	{
 		gLogManager->AddMessage("ERROR: Couldn't find vertex shader file: " + shaderName + "VS.spv");
 		return false;
 	}
 
-	fseek(file, 0, SEEK_END);
-	long size = ftell(file);
-	rewind(file);
-
-	char * vsBuffer = new char[size];
-	fread(vsBuffer, 1, size, file);
-
-	fclose(file);
-	file = NULL;
-
 	VkShaderModuleCreateInfo vertexShaderCI{};
 	vertexShaderCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	vertexShaderCI.codeSize = size;
-	vertexShaderCI.pCode = (uint32_t*)vsBuffer;
+	vertexShaderCI.codeSize = file.GetSize();
+	vertexShaderCI.pCode = (const uint32_t*)file.GetData();
 	vertexShaderCI.pNext = VK_NULL_HANDLE;
 	vertexShaderCI.flags = 0;
 
@@ -70,31 +60,19 @@ bool Shader::Init(VulkanDevice * vulkanDevice, std::string shaderName, bool hasG
 		return false;
 
 	currentShaderStage++;
-	delete[] vsBuffer;
 
 	// Fragment shader
 	std::string fragmentShaderPath = shaderDir + shaderName + "FS.spv";
-	file = fopen(fragmentShaderPath.c_str(), "rb");
-	if (file == NULL)
+	if (!file.Open(fragmentShaderPath))
 	{
 		gLogManager->AddMessage("ERROR: Couldn't find fragment shader file: " + shaderName + "FS.spv");
 		return false;
 	}
 
-	fseek(file, 0, SEEK_END);
-	size = ftell(file);
-	rewind(file);
-
-	char * fsBuffer = new char[size];
-	fread(fsBuffer, 1, size, file);
-
-	fclose(file);
-	file = NULL;
-
 	VkShaderModuleCreateInfo fragmentShaderCI{};
 	fragmentShaderCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	fragmentShaderCI.codeSize = size;
-	fragmentShaderCI.pCode = (uint32_t*)fsBuffer;
+	fragmentShaderCI.codeSize = file.GetSize();
+	fragmentShaderCI.pCode = (const uint32_t*)file.GetData();
 	fragmentShaderCI.pNext = VK_NULL_HANDLE;
 	fragmentShaderCI.flags = 0;
 
@@ -109,33 +87,21 @@ bool Shader::Init(VulkanDevice * vulkanDevice, std::string shaderName, bool hasG
 		return false;
 
 	currentShaderStage++;
-	delete[] fsBuffer;
 
 	// Geometry shader
 	if (hasGeometryShader)
 	{
 		std::string geometryShaderPath = shaderDir + shaderName + "GS.spv";
-		file = fopen(geometryShaderPath.c_str(), "rb");
-		if (file == NULL)
+		if (!file.Open(geometryShaderPath))
 		{
 			gLogManager->AddMessage("ERROR: Couldn't find geometry shader file: " + shaderName + "GS.spv");
 			return false;
 		}
 
-		fseek(file, 0, SEEK_END);
-		size = ftell(file);
-		rewind(file);
-
-		char * gsBuffer = new char[size];
-		fread(gsBuffer, 1, size, file);
-
-		fclose(file);
-		file = NULL;
-
 		VkShaderModuleCreateInfo geometryShaderCI{};
 		geometryShaderCI.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		geometryShaderCI.codeSize = size;
-		geometryShaderCI.pCode = (uint32_t*)gsBuffer;
+		geometryShaderCI.codeSize = file.GetSize();
+		geometryShaderCI.pCode = (const uint32_t*)file.GetData();
 		geometryShaderCI.pNext = VK_NULL_HANDLE;
 		geometryShaderCI.flags = 0;
 
@@ -150,7 +116,6 @@ bool Shader::Init(VulkanDevice * vulkanDevice, std::string shaderName, bool hasG
 			return false;
 
 		currentShaderStage++;
-		delete[] gsBuffer;
 	}
 
 	return true;
@@ -171,3 +136,16 @@ uint32_t Shader::GetStageCount()
 {
 	return stageCount;
 }
+
+bool Shader::Exists(std::string shaderName)
+{
+	// For optional shaders, so a missing one can be skipped without logging an error
+	std::string shaderDir = "data/shaders/";
+	std::string shaderStages[2] = { shaderName + "VS.spv", shaderName + "FS.spv" };
+
+	for (int i = 0; i < 2; i++)
+		if (!gVirtualFileSystem->Exists(shaderDir + shaderStages[i]))
+			return false;
+
+	return true;
+}
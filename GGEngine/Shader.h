@@ -16,4 +16,6 @@ class Shader
 		void Unload(VulkanDevice * vulkanDevice);
 		VkPipelineShaderStageCreateInfo * GetShaderStages();
 		uint32_t GetStageCount();
+
+		static bool Exists(std::string shaderName);
 };
\ No newline at end of file
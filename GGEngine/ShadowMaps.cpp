@@ -11,7 +11,10 @@ ShadowMaps::ShadowMaps()
 {
 	depthAttachment = NULL;
 	renderpass = NULL;
-	shadowGS_UBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		shadowGS_UBO[i] = NULL;
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+		cascadeTexelsPerUnit[i] = 0.0f;
 }
 
 bool ShadowMaps::Init(VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer, Camera * camera)
@@ -51,8 +54,28 @@ bool ShadowMaps::Init(VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer,
 	renderpassCI.attachmentCount = 1;
 	renderpassCI.attachmentRefs = VK_NULL_HANDLE;
 	renderpassCI.depthAttachmentRef = &attachmentRef;
-	renderpassCI.dependencies = VK_NULL_HANDLE;
-	renderpassCI.dependenciesCount = 0;
+
+	// The cascades may still be sampled by the lighting pass of the previous frame
+	VkSubpassDependency dependencies[2];
+	dependencies[0] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// The lighting pass samples the cascades once they are in the read-only layout
+	dependencies[1] = {};
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	renderpassCI.dependencies = dependencies;
+	renderpassCI.dependenciesCount = 2;
 
 	renderpass = new VulkanRenderpass();
 	if (!renderpass->Init(vulkan->GetVulkanDevice(), &renderpassCI))
@@ -104,11 +127,14 @@ bool ShadowMaps::Init(VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer,
 	projectionMatrixPartitions[2] = glm::perspective(camera->GetFieldOfView(), camera->GetAspectRatio(), 10.0f, 50.0f);
 	depthRadius = camera->GetFarClip();
 
-	// Create geometry shader uniform buffer
-	shadowGS_UBO = new VulkanBuffer();
-	if (!shadowGS_UBO->Init(vulkan->GetVulkanDevice(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &geometryUniformBuffer,
-		sizeof(geometryUniformBuffer), false))
-		return false;
+	// Create geometry shader uniform buffers
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		shadowGS_UBO[i] = new VulkanBuffer();
+		if (!shadowGS_UBO[i]->Init(vulkan->GetVulkanDevice(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &geometryUniformBuffer,
+			sizeof(geometryUniformBuffer), false))
+			return false;
+	}
 
 	// Create a frustum culler for each cascade
 	cascadeFrustumCullers = new FrustumCuller*[SHADOW_CASCADE_COUNT + 1];
@@ -124,7 +150,8 @@ void ShadowMaps::Unload(VulkanInterface * vulkan)
 		SAFE_DELETE(cascadeFrustumCullers[i]);
 	SAFE_DELETE(cascadeFrustumCullers);
 
-	SAFE_UNLOAD(shadowGS_UBO, vulkan->GetVulkanDevice());
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		SAFE_UNLOAD(shadowGS_UBO[i], vulkan->GetVulkanDevice());
 	SAFE_DELETE(projectionMatrixPartitions);
 	SAFE_DELETE(viewMatrices);
 	SAFE_DELETE(orthoMatrices);
@@ -136,19 +163,13 @@ void ShadowMaps::Unload(VulkanInterface * vulkan)
 
 void ShadowMaps::BeginShadowPass(VulkanCommandBuffer * commandBuffer)
 {
-	commandBuffer->BeginRecording();
-
 	renderpass->BeginRenderpass(commandBuffer, 0.0f, 0.0f, 0.0f, 0.0f, framebuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS,
 		mapSize, mapSize);
 }
 
-void ShadowMaps::EndShadowPass(VulkanDevice * vulkanDevice, VulkanCommandBuffer * commandBuffer)
+void ShadowMaps::EndShadowPass(VulkanCommandBuffer * commandBuffer)
 {
 	renderpass->EndRenderpass(commandBuffer);
-
-	commandBuffer->EndRecording();
-
-	commandBuffer->Execute(vulkanDevice, NULL, NULL, NULL, true);
 }
 
 void ShadowMaps::SetDepthBias(VulkanCommandBuffer * cmdBuffer)
@@ -198,6 +219,7 @@ void ShadowMaps::UpdatePartitions(VulkanInterface * vulkan, Camera * viewcamera,
 
 		// Texel snapping
 		float texelsPerUnit = (float)mapSize / (radius * 2.0f);
+		cascadeTexelsPerUnit[i] = texelsPerUnit;
 
 		glm::mat4 scalar = glm::scale(glm::mat4(), glm::vec3(texelsPerUnit, texelsPerUnit, texelsPerUnit));
 
@@ -231,7 +253,7 @@ void ShadowMaps::UpdatePartitions(VulkanInterface * vulkan, Camera * viewcamera,
 	cascadeFrustumCullers[SHADOW_CASCADE_COUNT]->BuildFrustum(orthoMatrices[SHADOW_CASCADE_COUNT - 1]
 		* viewMatrices[SHADOW_CASCADE_COUNT - 1]);
 
-	shadowGS_UBO->Update(vulkan->GetVulkanDevice(), &geometryUniformBuffer, sizeof(geometryUniformBuffer));
+	shadowGS_UBO[vulkan->GetFrameIndex()]->Update(vulkan->GetVulkanDevice(), &geometryUniformBuffer, sizeof(geometryUniformBuffer));
 }
 
 VulkanRenderpass * ShadowMaps::GetShadowRenderpass()
@@ -249,9 +271,9 @@ VkImageView * ShadowMaps::GetImageView()
 	return depthAttachment->GetImageView();
 }
 
-VkDescriptorBufferInfo * ShadowMaps::GetBufferInfo()
+VkDescriptorBufferInfo * ShadowMaps::GetBufferInfo(uint32_t frameIndex)
 {
-	return shadowGS_UBO->GetBufferInfo();
+	return shadowGS_UBO[frameIndex]->GetBufferInfo();
 }
 
 glm::mat4 ShadowMaps::GetLightViewProj(int index)
@@ -273,3 +295,8 @@ FrustumCuller * ShadowMaps::GetFrustumCuller(int index)
 {
 	return cascadeFrustumCullers[index];
 }
+
+float ShadowMaps::GetTexelsPerUnit(int cascade)
+{
+	return cascadeTexelsPerUnit[cascade];
+}
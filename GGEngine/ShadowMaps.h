@@ -22,6 +22,9 @@ class ShadowMaps
 		float depthRadius;
 		float frustumRadius;
 
+		// Shadow map resolution over each cascade, how large casters end up in it
+		float cascadeTexelsPerUnit[SHADOW_CASCADE_COUNT];
+
 		glm::mat4 * projectionMatrixPartitions;
 
 		struct GeometryUniformBuffer
@@ -29,7 +32,7 @@ class ShadowMaps
 			glm::mat4 lightViewProj[SHADOW_CASCADE_COUNT];
 		};
 		GeometryUniformBuffer geometryUniformBuffer;
-		VulkanBuffer * shadowGS_UBO;
+		VulkanBuffer * shadowGS_UBO[MAX_FRAMES_IN_FLIGHT];
 
 		FrustumCuller ** cascadeFrustumCullers;
 	public:
@@ -38,15 +41,16 @@ class ShadowMaps
 		bool Init(VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer, Camera * camera);
 		void Unload(VulkanInterface * vulkan);
 		void BeginShadowPass(VulkanCommandBuffer * commandBuffer);
-		void EndShadowPass(VulkanDevice * vulkanDevice, VulkanCommandBuffer * commandBuffer);
+		void EndShadowPass(VulkanCommandBuffer * commandBuffer);
 		void SetDepthBias(VulkanCommandBuffer * cmdBuffer);
 		void UpdatePartitions(VulkanInterface * vulkan, Camera * viewcamera, Sunlight * light);
 		VulkanRenderpass * GetShadowRenderpass();
 		VkFramebuffer GetFramebuffer();
 		VkImageView * GetImageView();
-		VkDescriptorBufferInfo * GetBufferInfo();
+		VkDescriptorBufferInfo * GetBufferInfo(uint32_t frameIndex);
 		glm::mat4 GetLightViewProj(int index);
 		VkSampler GetSampler();
 		uint32_t GetMapSize();
 		FrustumCuller * GetFrustumCuller(int index);
+		float GetTexelsPerUnit(int cascade);
 };
\ No newline at end of file
@@ -16,47 +16,62 @@ SkinnedMesh::~SkinnedMesh()
 	vertexBuffer = NULL;
 }
 
-bool SkinnedMesh::Init(VulkanInterface * vulkan, FILE * modelFile, std::string meshName)
+bool SkinnedMesh::Init(VulkanInterface * vulkan, const MeshFileMesh & fileMesh, std::string meshName, bool quantized)
 {
 	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
-	VulkanCommandPool * cmdPool = vulkan->GetVulkanCommandPool();
 
-	fread(&vertexCount, sizeof(unsigned int), 1, modelFile);
-	fread(&indexCount, sizeof(unsigned int), 1, modelFile);
-
-	Vertex * vertexData = new Vertex[vertexCount];
-	uint32_t * indexData = new uint32_t[indexCount];
-
-	fread(vertexData, sizeof(Vertex), vertexCount, modelFile);
-	fread(indexData, sizeof(uint32_t), indexCount, modelFile);
-
-	// Command buffer used for creating buffers
-	VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
-	if (!cmdBuffer->Init(vulkanDevice, cmdPool, true))
-		return false;
-
-	cmdBuffer->BeginRecording();
+	static_assert(sizeof(Vertex) == sizeof(MeshFileSkinnedVertex), "The vertex layout doesn't match the model files");
+
+	vertexCount = fileMesh.vertexCount;
+	indexCount = fileMesh.indexCount;
+	fullDetailLod = fileMesh.lods[0];
+
+	// Staged straight from the mapped file
+	const void * vertexData = fileMesh.vertexData;
+	const void * indexData = fileMesh.indexData;
+	size_t vertexSize = (quantized ? sizeof(MeshFileQuantizedSkinnedVertex) : sizeof(Vertex));
+
+	// Files in the other layout are converted here, MeshConverter writes them in the one the pipelines read
+	std::vector<MeshFileQuantizedSkinnedVertex> quantizedVertices;
+	std::vector<MeshFileSkinnedVertex> expandedVertices;
+	if (quantized && !fileMesh.quantized)
+	{
+		quantizedVertices.resize(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++)
+			QuantizeSkinnedVertex(((const MeshFileSkinnedVertex*)fileMesh.vertexData)[i], quantizedVertices[i]);
+		vertexData = quantizedVertices.data();
+	}
+	else if (!quantized && fileMesh.quantized)
+	{
+		expandedVertices.resize(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++)
+			ExpandSkinnedVertex(((const MeshFileQuantizedSkinnedVertex*)fileMesh.vertexData)[i], expandedVertices[i]);
+		vertexData = expandedVertices.data();
+	}
 
 	// Vertex buffer
 	vertexBuffer = gBufferManager->RequestBuffer(meshName + "VB", vulkanDevice, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		vertexData, sizeof(Vertex) * vertexCount, true, cmdBuffer);
+		vertexData, vertexSize * vertexCount, true);
 	if (vertexBuffer == nullptr)
 		return false;
 
+	// 16 bit indices whenever they address every vertex, 32 bit ones from files MeshConverter hasn't narrowed are narrowed here
+	uint32_t indexSize = GetMeshIndexSize(vertexCount);
+	std::vector<uint16_t> shortIndices;
+	if (indexSize < fileMesh.indexSize)
+	{
+		shortIndices.resize(indexCount);
+		NarrowIndices((const uint32_t*)fileMesh.indexData, indexCount, shortIndices.data());
+		indexData = shortIndices.data();
+	}
+	indexType = (indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
 	// Index buffer
 	indexBuffer = gBufferManager->RequestBuffer(meshName + "IB", vulkanDevice, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		indexData, sizeof(uint32_t) * indexCount, true, cmdBuffer);
+		indexData, indexSize * indexCount, true);
 	if (indexBuffer == nullptr)
 		return false;
 
-	cmdBuffer->EndRecording();
-	cmdBuffer->Execute(vulkanDevice, true, VK_NULL_HANDLE, VK_NULL_HANDLE, true);
-
-	SAFE_UNLOAD(cmdBuffer, vulkanDevice, cmdPool);
-
-	delete[] vertexData;
-	delete[] indexData;
-
 	// Material uniform buffer
 	materialUniformBuffer.hasNormalMap = 0.0f;
 	materialUniformBuffer.metallicOffset = 0.0f;
@@ -83,17 +98,23 @@ void SkinnedMesh::Render(VulkanInterface * vulkan, VulkanCommandBuffer * command
 {
 	VkDeviceSize offsets[1] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
-	vkCmdBindIndexBuffer(commandBuffer->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, indexType);
 
-	vkCmdDrawIndexed(commandBuffer->GetCommandBuffer(), indexCount, 1, 0, 0, 0);
+	vkCmdDrawIndexed(commandBuffer->GetCommandBuffer(), fullDetailLod.indexCount, 1, fullDetailLod.firstIndex, 0, 0);
 }
 
 void SkinnedMesh::UpdateUniformBuffer(VulkanInterface * vulkan)
 {
-	materialUniformBuffer.hasNormalMap = (material->HasNormalMap() ? 1.0f : 0.0f);
-	materialUniformBuffer.metallicOffset = material->GetMetallicOffset();
-	materialUniformBuffer.roughnessOffset = material->GetRoughnessOffset();
+	MaterialUniformBuffer newData = materialUniformBuffer;
+	newData.hasNormalMap = (material->HasNormalMap() ? 1.0f : 0.0f);
+	newData.metallicOffset = material->GetMetallicOffset();
+	newData.roughnessOffset = material->GetRoughnessOffset();
+
+	// Material data rarely changes, don't touch a buffer that a frame in flight may be reading
+	if (memcmp(&newData, &materialUniformBuffer, sizeof(materialUniformBuffer)) == 0)
+		return;
 
+	materialUniformBuffer = newData;
 	materialUBO->Update(vulkan->GetVulkanDevice(), &materialUniformBuffer, sizeof(materialUniformBuffer));
 }
 
@@ -4,6 +4,7 @@
 #include "VulkanPipeline.h"
 #include "VulkanBuffer.h"
 #include "Material.h"
+#include "MeshFile.h"
 
 class SkinnedMesh
 {
@@ -20,6 +21,10 @@ class SkinnedMesh
 
 		unsigned int vertexCount;
 		unsigned int indexCount;
+		VkIndexType indexType;
+
+		// Skinned models always draw the full detail level
+		MeshFileLod fullDetailLod;
 
 		struct MaterialUniformBuffer
 		{
@@ -39,7 +44,7 @@ class SkinnedMesh
 		SkinnedMesh();
 		~SkinnedMesh();
 
-		bool Init(VulkanInterface * vulkan, FILE * modelFile, std::string meshName);
+		bool Init(VulkanInterface * vulkan, const MeshFileMesh & fileMesh, std::string meshName, bool quantized);
 		void Unload(VulkanInterface * vulkan);
 		void Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer);
 		void UpdateUniformBuffer(VulkanInterface * vulkan);
@@ -1,83 +1,55 @@
-#include <fstream>
-
 #include "SkinnedModel.h"
+#include "MeshFile.h"
 #include "StdInc.h"
 #include "LogManager.h"
 #include "Timer.h"
 #include "Settings.h"
 #include "TextureManager.h"
+#include "ModelManager.h"
+
+// Quantized bone ids are single bytes read as signed by the shaders
+static_assert(MAX_BONES <= MESH_QUANTIZED_MAX_BONES, "Bone ids don't fit the quantized vertex layout");
 
 extern LogManager * gLogManager;
 extern Timer * gTimer;
 extern Settings * gSettings;
 extern TextureManager * gTextureManager;
+extern ModelManager * gModelManager;
 
 SkinnedModel::SkinnedModel()
 {
-	skinnedVS_UBO = NULL;
-	skinnedVS_bone_UBO = NULL;
 	currentAnim = NULL;
+	boneOffset = 0;
 }
 
 SkinnedModel::~SkinnedModel()
 {
 	currentAnim = NULL;
-	skinnedVS_bone_UBO = NULL;
-	skinnedVS_UBO = NULL;
 }
 
 bool SkinnedModel::Init(std::string filename, VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer)
 {
-	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
-
-	// Uniform buffer init
+	// Uniform buffer init, the data is copied to the uniform ring every frame
 	vertexUniformBuffer.worldMatrix = glm::mat4(1.0f);
 	vertexUniformBuffer.MVP = glm::mat4();
 	for (unsigned int i = 0; i < MAX_BONES; i++)
 		boneUniformBufferData.bones[i] = glm::mat4();
 
-	// Vertex shader - Uniform buffer
-	skinnedVS_UBO = new VulkanBuffer();
-	if (!skinnedVS_UBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer,
-		sizeof(vertexUniformBuffer), false))
+	// Stays mapped until every mesh's data was staged
+	MeshFile file;
+	if (!file.Open(filename, true))
 		return false;
 
-	// Vertex shader - Bone Uniform buffer
-	skinnedVS_bone_UBO = new VulkanBuffer();
-	if (!skinnedVS_bone_UBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &boneUniformBufferData,
-		sizeof(boneUniformBufferData), false))
-		return false;
-
-	// Open .rcs file
-	FILE * file = fopen(filename.c_str(), "rb");
-	if (file == NULL)
+	for (unsigned int i = 0; i < file.GetMeshCount(); i++)
 	{
-		gLogManager->AddMessage("ERROR: Model file not found! (" + filename + ")");
-		return false;
-	}
-
-	// Open .mat file
-	size_t pos = filename.rfind('.');
-	filename.replace(pos, 4, ".mat");
-
-	std::ifstream matFile(filename.c_str());
-	if (!matFile.is_open())
-	{
-		gLogManager->AddMessage("ERROR: Model .mat file not found! (" + filename + ")");
-		return false;
-	}
+		const MeshFileMesh & fileMesh = file.GetMesh(i);
 
-	unsigned int meshCount;
-	fread(&meshCount, sizeof(unsigned int), 1, file);
-
-	for (unsigned int i = 0; i < meshCount; i++)
-	{
-		// Create and read mesh data
+		// Create mesh from its data
 		char meshIdentifier[16];
 		sprintf(meshIdentifier, "_mesh%d", i);
 
 		SkinnedMesh * mesh = new SkinnedMesh();
-		if (!mesh->Init(vulkan, file, filename + meshIdentifier))
+		if (!mesh->Init(vulkan, fileMesh, filename + meshIdentifier, gModelManager->IsQuantizedVertices()))
 		{
 			gLogManager->AddMessage("ERROR: Failed to init a mesh!");
 			return false;
@@ -85,20 +57,17 @@ bool SkinnedModel::Init(std::string filename, VulkanInterface * vulkan, VulkanCo
 		meshes.push_back(mesh);
 
 		std::string texturePath;
-		char diffuseTextureName[64];
-		char normalTextureName[64];
 
 		// Init mesh material
 		Material * material = new Material();
 
-		// Read diffuse texture
-		fread(diffuseTextureName, sizeof(char), 64, file);
-		if (strcmp(diffuseTextureName, "NONE") == 0)
+		// Diffuse texture
+		if (fileMesh.diffuseTexture == "NONE")
 			texturePath = "data/textures/default_diffuse.rct";
 		else
-			texturePath = "data/textures/" + std::string(diffuseTextureName);
+			texturePath = "data/textures/" + fileMesh.diffuseTexture;
 
-		Texture * diffuse = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), cmdBuffer);
+		Texture * diffuse = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice());
 		if (diffuse == nullptr)
 			return false;
 
@@ -106,13 +75,12 @@ bool SkinnedModel::Init(std::string filename, VulkanInterface * vulkan, VulkanCo
 
 		material->SetDiffuseTexture(diffuse);
 
-		// Read normal texture if available
-		fread(normalTextureName, sizeof(char), 64, file);
-		if (strcmp(normalTextureName, "NONE") != 0)
+		// Normal texture if it's available
+		if (fileMesh.normalTexture != "NONE")
 		{
-			texturePath = "data/textures/" + std::string(normalTextureName);
+			texturePath = "data/textures/" + fileMesh.normalTexture;
 
-			Texture * normal = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), cmdBuffer);
+			Texture * normal = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice());
 			if (normal == nullptr)
 				return false;
 
@@ -121,65 +89,36 @@ bool SkinnedModel::Init(std::string filename, VulkanInterface * vulkan, VulkanCo
 			material->SetNormalTexture(normal);
 		}
 
-		std::string matName, matTextureName;
-		float metallicOffset, roughnessOffset;
-		matFile >> matName >> matTextureName >> metallicOffset >> roughnessOffset;
-		
-		// Read material texture
-		if (matTextureName == "NONE")
+		// Material texture
+		if (fileMesh.materialTexture == "NONE")
 			texturePath = "data/textures/default_material.rct";
 		else
-			texturePath = "data/textures/" + matTextureName;
+			texturePath = "data/textures/" + fileMesh.materialTexture;
 
-		Texture * matTexture = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice(), cmdBuffer);
+		Texture * matTexture = gTextureManager->RequestTexture(texturePath, vulkan->GetVulkanDevice());
 		if (matTexture == nullptr)
 			return false;
 
 		textures.push_back(matTexture);
 
 		material->SetMaterialTexture(matTexture);
-		material->SetMetallicOffset(metallicOffset);
-		material->SetRoughnessOffset(roughnessOffset);
+		material->SetMetallicOffset(fileMesh.metallicOffset);
+		material->SetRoughnessOffset(fileMesh.roughnessOffset);
 
 		materials.push_back(material);
 		meshes[i]->SetMaterial(material);
-
-		// Init draw command buffers for each meash
-		VulkanCommandBuffer * drawCmdBuffer = new VulkanCommandBuffer();
-		if (!drawCmdBuffer->Init(vulkanDevice, vulkan->GetVulkanCommandPool(), false))
-		{
-			gLogManager->AddMessage("ERROR: Failed to create a draw command buffer!");
-			return false;
-		}
-		drawCmdBuffers.push_back(drawCmdBuffer);
 	}
 
-	matFile.close();
-
-	// Read bone offsets
-	fread(&numBones, sizeof(unsigned int), 1, file);
+	// Bone offsets and the ids the animations use for them
+	numBones = file.GetBoneCount();
 	boneOffsets.resize(numBones);
-	fread(boneOffsets.data(), sizeof(aiMatrix4x4), numBones, file);
-
-	// Read bone mappings
 	for (unsigned int i = 0; i < numBones; i++)
 	{
-		unsigned int strSize;
-		char * str;
-		std::string boneName;
-		uint32_t id;
-
-		fread(&strSize, sizeof(unsigned int), 1, file);
-		str = new char[strSize+1];
-		fread(str, sizeof(char), strSize, file);
-		fread(&id, sizeof(uint32_t), 1, file);
-
-		str[strSize] = 0;
-		boneName = str;
-		boneMapping[boneName] = id;
-	}
+		const MeshFileSkinBone & bone = file.GetBone(i);
 
-	fclose(file);
+		memcpy(&boneOffsets[i], bone.offset, sizeof(aiMatrix4x4));
+		boneMapping[bone.name] = bone.id;
+	}
 
 	return true;
 }
@@ -188,63 +127,76 @@ void SkinnedModel::Unload(VulkanInterface * vulkan)
 {
 	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
 
-	SAFE_UNLOAD(skinnedVS_bone_UBO, vulkanDevice);
-	SAFE_UNLOAD(skinnedVS_UBO, vulkanDevice);
-
 	for (unsigned int i = 0; i < textures.size(); i++)
 		gTextureManager->ReleaseTexture(textures[i], vulkanDevice);
 
 	for (unsigned int i = 0; i < meshes.size(); i++)
 	{
-		SAFE_UNLOAD(drawCmdBuffers[i], vulkanDevice, vulkan->GetVulkanCommandPool());
 		SAFE_DELETE(materials[i]);
 		SAFE_UNLOAD(meshes[i], vulkan);
 	}
 }
 
-void SkinnedModel::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * vulkanPipeline,
+void SkinnedModel::Render(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
 	Camera * camera, ShadowMaps * shadowMaps)
 {
 	if(vulkanPipeline->GetPipelineName() == "SKINNED")
 		vertexUniformBuffer.MVP = camera->GetProjectionMatrix() * camera->GetViewMatrix() * vertexUniformBuffer.worldMatrix;
 
-	skinnedVS_UBO->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(vertexUniformBuffer));
+	// Binding 0 gets this pass' transforms, binding 1 the palette written in UpdateAnimation
+	uint32_t dynamicOffsets[2];
+	dynamicOffsets[0] = vulkan->GetUniformRing()->Allocate(&vertexUniformBuffer, sizeof(vertexUniformBuffer));
+	dynamicOffsets[1] = boneOffset;
 
-	for (unsigned int i = 0; i < meshes.size(); i++)
+	if (vulkanPipeline->GetPipelineName() == "SKINNED")
 	{
-		if (vulkanPipeline->GetPipelineName() == "SKINNED")
-		{
+		for (unsigned int i = 0; i < meshes.size(); i++)
 			meshes[i]->UpdateUniformBuffer(vulkan);
-			UpdateDescriptorSet(vulkan, vulkanPipeline, meshes[i], NULL);
 
-			// Record draw command
-			drawCmdBuffers[i]->BeginRecordingSecondary(vulkan->GetDeferredRenderpass()->GetRenderpass(), vulkan->GetDeferredFramebuffer());
+		// Descriptor sets are looked up here, the recording threads only record
+		std::vector<VkDescriptorSet> * descriptorSets = GetDescriptorSets(vulkan, vulkanPipeline, NULL);
 
-			vulkan->InitViewportAndScissors(drawCmdBuffers[i], (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
-				(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
-			vulkanPipeline->SetActive(drawCmdBuffers[i]);
-			meshes[i]->Render(vulkan, drawCmdBuffers[i]);
+		recorder->AddTask([this, vulkan, vulkanPipeline, descriptorSets, dynamicOffsets](CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)
+		{
+			for (unsigned int i = 0; i < meshes.size(); i++)
+			{
+				VulkanCommandBuffer * drawCmdBuffer = recorder->GetCommandBuffer(threadId, taskId);
 
-			drawCmdBuffers[i]->EndRecording();
-			drawCmdBuffers[i]->ExecuteSecondary(commandBuffer);
-		}
-		else if (vulkanPipeline->GetPipelineName() == "SHADOWSKINNED")
+				// Record draw command
+				drawCmdBuffer->BeginRecordingSecondary(vulkan->GetDeferredRenderpass()->GetRenderpass(), vulkan->GetDeferredFramebuffer());
+
+				vulkan->InitViewportAndScissors(drawCmdBuffer, (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
+					(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
+				vulkanPipeline->SetActive(drawCmdBuffer, (*descriptorSets)[i], 2, dynamicOffsets);
+				meshes[i]->Render(vulkan, drawCmdBuffer);
+
+				drawCmdBuffer->EndRecording();
+			}
+		});
+	}
+	else if (vulkanPipeline->GetPipelineName() == "SHADOWSKINNED")
+	{
+		std::vector<VkDescriptorSet> * descriptorSets = GetDescriptorSets(vulkan, vulkanPipeline, shadowMaps);
+
+		recorder->AddTask([this, vulkan, vulkanPipeline, shadowMaps, descriptorSets, dynamicOffsets](CommandRecorder * recorder, unsigned int threadId, unsigned int taskId)
 		{
-			UpdateDescriptorSet(vulkan, vulkanPipeline, meshes[i], shadowMaps);
+			for (unsigned int i = 0; i < meshes.size(); i++)
+			{
+				VulkanCommandBuffer * drawCmdBuffer = recorder->GetCommandBuffer(threadId, taskId);
 
-			// Record draw command
-			drawCmdBuffers[i]->BeginRecordingSecondary(shadowMaps->GetShadowRenderpass()->GetRenderpass(), shadowMaps->GetFramebuffer());
+				// Record draw command
+				drawCmdBuffer->BeginRecordingSecondary(shadowMaps->GetShadowRenderpass()->GetRenderpass(), shadowMaps->GetFramebuffer());
 
-			vulkan->InitViewportAndScissors(drawCmdBuffers[i], (float)shadowMaps->GetMapSize(), (float)shadowMaps->GetMapSize(),
-				shadowMaps->GetMapSize(), shadowMaps->GetMapSize());
+				vulkan->InitViewportAndScissors(drawCmdBuffer, (float)shadowMaps->GetMapSize(), (float)shadowMaps->GetMapSize(),
+					shadowMaps->GetMapSize(), shadowMaps->GetMapSize());
 
-			shadowMaps->SetDepthBias(drawCmdBuffers[i]);
-			vulkanPipeline->SetActive(drawCmdBuffers[i]);
-			meshes[i]->Render(vulkan, drawCmdBuffers[i]);
+				shadowMaps->SetDepthBias(drawCmdBuffer);
+				vulkanPipeline->SetActive(drawCmdBuffer, (*descriptorSets)[i], 2, dynamicOffsets);
+				meshes[i]->Render(vulkan, drawCmdBuffer);
 
-			drawCmdBuffers[i]->EndRecording();
-			drawCmdBuffers[i]->ExecuteSecondary(commandBuffer);
-		}
+				drawCmdBuffer->EndRecording();
+			}
+		});
 	}
 }
 
@@ -256,9 +208,10 @@ void SkinnedModel::UpdateAnimation(VulkanInterface * vulkan)
 	
 		std::vector<glm::mat4> boneTransforms = currentAnim->GetBoneTransforms();
 		memcpy(boneUniformBufferData.bones, boneTransforms.data(), sizeof(glm::mat4) * boneTransforms.size());
-
-		skinnedVS_bone_UBO->Update(vulkan->GetVulkanDevice(), &boneUniformBufferData, sizeof(boneUniformBufferData));
 	}
+
+	// The ring is reset every frame, so the palette is written even when the animation is paused
+	boneOffset = vulkan->GetUniformRing()->Allocate(&boneUniformBufferData, sizeof(boneUniformBufferData));
 }
 
 void SkinnedModel::SetWorldMatrix(glm::mat4 & worldMatrix)
@@ -271,8 +224,32 @@ void SkinnedModel::SetAnimation(Animation * anim)
 	currentAnim = anim;
 }
 
-void SkinnedModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, SkinnedMesh * mesh, ShadowMaps * shadowMaps)
+std::vector<VkDescriptorSet> * SkinnedModel::GetDescriptorSets(VulkanInterface * vulkan, VulkanPipeline * pipeline, ShadowMaps * shadowMaps)
+{
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	std::vector<VkDescriptorSet> * sets = (shadowMaps ? &shadowDescriptorSets[frameIndex] : &descriptorSets[frameIndex]);
+
+	// Only looked up once, after that the sets are just bound
+	if (sets->size() != meshes.size())
+	{
+		sets->clear();
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			sets->push_back(GetDescriptorSet(vulkan, pipeline, meshes[i], shadowMaps));
+	}
+
+	return sets;
+}
+
+VkDescriptorSet SkinnedModel::GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, SkinnedMesh * mesh, ShadowMaps * shadowMaps)
 {
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	bool result = false;
+
+	// Transforms and palette live in the uniform ring, the slices are picked by the dynamic offsets
+	VkDescriptorBufferInfo vsBufferInfo = vulkan->GetUniformRing()->GetBufferInfo(sizeof(VertexUniformBuffer));
+	VkDescriptorBufferInfo boneBufferInfo = vulkan->GetUniformRing()->GetBufferInfo(sizeof(BoneUniformBuffer));
+
 	if (pipeline->GetPipelineName() == "SKINNED")
 	{
 		VkWriteDescriptorSet descriptorWrite[6];
@@ -280,20 +257,18 @@ void SkinnedModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline
 		descriptorWrite[0] = {};
 		descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[0].pNext = NULL;
-		descriptorWrite[0].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[0].descriptorCount = 1;
-		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[0].pBufferInfo = skinnedVS_UBO->GetBufferInfo();
+		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[0].pBufferInfo = &vsBufferInfo;
 		descriptorWrite[0].dstArrayElement = 0;
 		descriptorWrite[0].dstBinding = 0;
 
 		descriptorWrite[1] = {};
 		descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[1].pNext = NULL;
-		descriptorWrite[1].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[1].descriptorCount = 1;
-		descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[1].pBufferInfo = skinnedVS_bone_UBO->GetBufferInfo();
+		descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[1].pBufferInfo = &boneBufferInfo;
 		descriptorWrite[1].dstArrayElement = 0;
 		descriptorWrite[1].dstBinding = 1;
 
@@ -306,7 +281,6 @@ void SkinnedModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline
 		descriptorWrite[2] = {};
 		descriptorWrite[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[2].pNext = NULL;
-		descriptorWrite[2].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[2].descriptorCount = 1;
 		descriptorWrite[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWrite[2].pImageInfo = &diffuseTextureDesc;
@@ -322,7 +296,6 @@ void SkinnedModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline
 		descriptorWrite[3] = {};
 		descriptorWrite[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[3].pNext = NULL;
-		descriptorWrite[3].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[3].descriptorCount = 1;
 		descriptorWrite[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWrite[3].pImageInfo = &materialTextureDesc;
@@ -341,7 +314,6 @@ void SkinnedModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline
 		descriptorWrite[4] = {};
 		descriptorWrite[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[4].pNext = NULL;
-		descriptorWrite[4].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[4].descriptorCount = 1;
 		descriptorWrite[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWrite[4].pImageInfo = (mesh->GetMaterial()->HasNormalMap() ? &normalTextureDesc : &diffuseTextureDesc);
@@ -352,14 +324,13 @@ void SkinnedModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline
 		descriptorWrite[5] = {};
 		descriptorWrite[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[5].pNext = NULL;
-		descriptorWrite[5].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[5].descriptorCount = 1;
 		descriptorWrite[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		descriptorWrite[5].pBufferInfo = mesh->GetMaterialBufferInfo();
 		descriptorWrite[5].dstArrayElement = 0;
 		descriptorWrite[5].dstBinding = 5;
 
-		vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, NULL);
+		result = pipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), descriptorWrite, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), &descriptorSet);
 	}
 	else if (pipeline->GetPipelineName() == "SHADOWSKINNED")
 	{
@@ -368,33 +339,38 @@ void SkinnedModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline
 		descriptorWrite[0] = {};
 		descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[0].pNext = NULL;
-		descriptorWrite[0].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[0].descriptorCount = 1;
-		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[0].pBufferInfo = skinnedVS_UBO->GetBufferInfo();
+		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[0].pBufferInfo = &vsBufferInfo;
 		descriptorWrite[0].dstArrayElement = 0;
 		descriptorWrite[0].dstBinding = 0;
 
 		descriptorWrite[1] = {};
 		descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[1].pNext = NULL;
-		descriptorWrite[1].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[1].descriptorCount = 1;
-		descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[1].pBufferInfo = skinnedVS_bone_UBO->GetBufferInfo();
+		descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite[1].pBufferInfo = &boneBufferInfo;
 		descriptorWrite[1].dstArrayElement = 0;
 		descriptorWrite[1].dstBinding = 1;
 
 		descriptorWrite[2] = {};
 		descriptorWrite[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite[2].pNext = NULL;
-		descriptorWrite[2].dstSet = pipeline->GetDescriptorSet();
 		descriptorWrite[2].descriptorCount = 1;
 		descriptorWrite[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite[2].pBufferInfo = shadowMaps->GetBufferInfo();
+		descriptorWrite[2].pBufferInfo = shadowMaps->GetBufferInfo(frameIndex);
 		descriptorWrite[2].dstArrayElement = 0;
 		descriptorWrite[2].dstBinding = 2;
 
-		vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, NULL);
+		result = pipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), descriptorWrite, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), &descriptorSet);
+	}
+
+	if (!result)
+	{
+		gLogManager->AddMessage("ERROR: Failed to get a descriptor set for a skinned model!");
+		THROW_ERROR();
 	}
+
+	return descriptorSet;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "Material.h"
 #include "Animation.h"
 #include "ShadowMaps.h"
+#include "CommandRecorder.h"
 
 class SkinnedModel
 {
@@ -13,7 +14,6 @@ class SkinnedModel
 		std::vector<SkinnedMesh*> meshes;
 		std::vector<Texture*> textures;
 		std::vector<Material*> materials;
-		std::vector<VulkanCommandBuffer*> drawCmdBuffers;
 		
 		Animation * currentAnim;
 		unsigned int numBones;
@@ -33,17 +33,22 @@ class SkinnedModel
 		};
 		BoneUniformBuffer boneUniformBufferData;
 
-		VulkanBuffer * skinnedVS_UBO;
-		VulkanBuffer * skinnedVS_bone_UBO;
+		// Ring offset of this frame's palette, written once in UpdateAnimation and bound by both passes
+		uint32_t boneOffset;
+
+		// One set per mesh and frame slot for each pass, looked up once from the pipeline's cache
+		std::vector<VkDescriptorSet> descriptorSets[MAX_FRAMES_IN_FLIGHT];
+		std::vector<VkDescriptorSet> shadowDescriptorSets[MAX_FRAMES_IN_FLIGHT];
 	private:
-		void UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, SkinnedMesh * mesh, ShadowMaps * shadowMaps);
+		VkDescriptorSet GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline, SkinnedMesh * mesh, ShadowMaps * shadowMaps);
+		std::vector<VkDescriptorSet> * GetDescriptorSets(VulkanInterface * vulkan, VulkanPipeline * pipeline, ShadowMaps * shadowMaps);
 	public:
 		SkinnedModel();
 		~SkinnedModel();
 
 		bool Init(std::string filename, VulkanInterface * vulkan, VulkanCommandBuffer * cmdBuffer);
 		void Unload(VulkanInterface * vulkan);
-		void Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * vulkanPipeline,
+		void Render(VulkanInterface * vulkan, CommandRecorder * recorder, VulkanPipeline * vulkanPipeline,
 			Camera * camera, ShadowMaps * shadowMaps);
 		void UpdateAnimation(VulkanInterface * vulkan);
 		void SetWorldMatrix(glm::mat4 &worldMatrix);
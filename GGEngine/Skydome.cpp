@@ -8,14 +8,20 @@ Skydome::Skydome()
 {
 	vertexBuffer = NULL;
 	indexBuffer = NULL;
-	vsUBO = NULL;
-	fsUBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vsUBO[i] = NULL;
+		fsUBO[i] = NULL;
+	}
 }
 
 Skydome::~Skydome()
 {
-	fsUBO = NULL;
-	vsUBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		fsUBO[i] = NULL;
+		vsUBO[i] = NULL;
+	}
 	indexBuffer = NULL;
 	vertexBuffer = NULL;
 }
@@ -23,7 +29,6 @@ Skydome::~Skydome()
 bool Skydome::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline)
 {
 	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
-	VulkanCommandPool * cmdPool = vulkan->GetVulkanCommandPool();
 
 	Vertex * vertexData;
 	uint32_t * indexData;
@@ -104,30 +109,18 @@ bool Skydome::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline)
 	memcpy(vertexData, vertices.data(), sizeof(Vertex) * vertexCount);
 	memcpy(indexData, indices.data(), sizeof(uint32_t) * indexCount);
 
-	// Command buffer used for creating buffers
-	VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
-	if (!cmdBuffer->Init(vulkanDevice, cmdPool, true))
-		return false;
-
-	cmdBuffer->BeginRecording();
-
 	// Vertex buffer
 	vertexBuffer = new VulkanBuffer();
 	if (!vertexBuffer->Init(vulkanDevice, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData,
-		sizeof(Vertex) * vertexCount, true, cmdBuffer))
+		sizeof(Vertex) * vertexCount, true))
 		return false;
 
 	// Index buffer
 	indexBuffer = new VulkanBuffer();
 	if (!indexBuffer->Init(vulkanDevice, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexData,
-		sizeof(uint32_t) * indexCount, true, cmdBuffer))
+		sizeof(uint32_t) * indexCount, true))
 		return false;
 
-	cmdBuffer->EndRecording();
-	cmdBuffer->Execute(vulkanDevice, NULL, VK_NULL_HANDLE, VK_NULL_HANDLE, true);
-
-	SAFE_UNLOAD(cmdBuffer, vulkanDevice, cmdPool);
-
 	delete[] vertexData;
 	delete[] indexData;
 
@@ -139,45 +132,49 @@ bool Skydome::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline)
 	fragmentUniformBuffer.atmosphereHeight = 0.0f;
 	fragmentUniformBuffer.padding = glm::vec3(0.0f, 0.0f, 0.0f);
 
-	// Vertex shader Uniform buffer
-	vsUBO = new VulkanBuffer();
-	if (!vsUBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer, sizeof(vertexUniformBuffer), false))
-		return false;
+	// Uniform buffers and descriptor set for each frame in flight
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		// Vertex shader Uniform buffer
+		vsUBO[i] = new VulkanBuffer();
+		if (!vsUBO[i]->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer, sizeof(vertexUniformBuffer), false))
+			return false;
 
-	// Fragment shader uniform buffer
-	fsUBO = new VulkanBuffer();
-	if (!fsUBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &fragmentUniformBuffer, sizeof(fragmentUniformBuffer), false))
-		return false;
+		// Fragment shader uniform buffer
+		fsUBO[i] = new VulkanBuffer();
+		if (!fsUBO[i]->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &fragmentUniformBuffer, sizeof(fragmentUniformBuffer), false))
+			return false;
 
-	// Write descriptor set
-	VkWriteDescriptorSet descriptorWrite[2];
-
-	descriptorWrite[0] = {};
-	descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite[0].pNext = NULL;
-	descriptorWrite[0].dstSet = vulkanPipeline->GetDescriptorSet();
-	descriptorWrite[0].descriptorCount = 1;
-	descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	descriptorWrite[0].pBufferInfo = vsUBO->GetBufferInfo();
-	descriptorWrite[0].dstArrayElement = 0;
-	descriptorWrite[0].dstBinding = 0;
-
-	descriptorWrite[1] = {};
-	descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite[1].pNext = NULL;
-	descriptorWrite[1].dstSet = vulkanPipeline->GetDescriptorSet();
-	descriptorWrite[1].descriptorCount = 1;
-	descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	descriptorWrite[1].pBufferInfo = fsUBO->GetBufferInfo();
-	descriptorWrite[1].dstArrayElement = 0;
-	descriptorWrite[1].dstBinding = 1;
-
-	vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, NULL);
+		// Write descriptor set
+		VkWriteDescriptorSet descriptorWrite[2];
+
+		descriptorWrite[0] = {};
+		descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite[0].pNext = NULL;
+		descriptorWrite[0].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		descriptorWrite[0].descriptorCount = 1;
+		descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite[0].pBufferInfo = vsUBO[i]->GetBufferInfo();
+		descriptorWrite[0].dstArrayElement = 0;
+		descriptorWrite[0].dstBinding = 0;
+
+		descriptorWrite[1] = {};
+		descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite[1].pNext = NULL;
+		descriptorWrite[1].dstSet = vulkanPipeline->GetDescriptorSet(i);
+		descriptorWrite[1].descriptorCount = 1;
+		descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite[1].pBufferInfo = fsUBO[i]->GetBufferInfo();
+		descriptorWrite[1].dstArrayElement = 0;
+		descriptorWrite[1].dstBinding = 1;
+
+		vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, NULL);
+	}
 
 	worldMatrix = glm::mat4(1.0f);
 
 	// Init draw command buffers
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
 		if (!cmdBuffer->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), false))
@@ -191,24 +188,30 @@ bool Skydome::Init(VulkanInterface * vulkan, VulkanPipeline * vulkanPipeline)
 
 void Skydome::Unload(VulkanInterface * vulkan)
 {
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < drawCmdBuffers.size(); i++)
 		SAFE_UNLOAD(drawCmdBuffers[i], vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
 
-	SAFE_UNLOAD(fsUBO, vulkan->GetVulkanDevice());
-	SAFE_UNLOAD(vsUBO, vulkan->GetVulkanDevice());
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		SAFE_UNLOAD(fsUBO[i], vulkan->GetVulkanDevice());
+		SAFE_UNLOAD(vsUBO[i], vulkan->GetVulkanDevice());
+	}
 	SAFE_UNLOAD(indexBuffer, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(vertexBuffer, vulkan->GetVulkanDevice());
 }
 
 void Skydome::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * pipeline, Camera * camera, int framebufferId)
 {
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	VulkanCommandBuffer * drawCmdBuffer = drawCmdBuffers[frameIndex];
+
 	// Update vertex uniform buffer
 	glm::vec3 camPos = camera->GetPosition();
 	camPos.y -= 0.5f;
 	worldMatrix = glm::translate(glm::mat4(1.0f), camPos);
 	vertexUniformBuffer.MVP = camera->GetProjectionMatrix() * camera->GetViewMatrix() * worldMatrix;
 
-	vsUBO->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(vertexUniformBuffer));
+	vsUBO[frameIndex]->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(vertexUniformBuffer));
 
 	// Update fragment uniform buffer
 	fragmentUniformBuffer.skyColor = skyColor;
@@ -216,22 +219,22 @@ void Skydome::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuff
 	fragmentUniformBuffer.groundColor = groundColor;
 	fragmentUniformBuffer.atmosphereHeight = atmosphereHeight;
 
-	fsUBO->Update(vulkan->GetVulkanDevice(), &fragmentUniformBuffer, sizeof(fragmentUniformBuffer));
+	fsUBO[frameIndex]->Update(vulkan->GetVulkanDevice(), &fragmentUniformBuffer, sizeof(fragmentUniformBuffer));
 
 	// Render
-	drawCmdBuffers[framebufferId]->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer(framebufferId));
-	vulkan->InitViewportAndScissors(drawCmdBuffers[framebufferId], (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
+	drawCmdBuffer->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer(framebufferId));
+	vulkan->InitViewportAndScissors(drawCmdBuffer, (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
 		(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
-	pipeline->SetActive(drawCmdBuffers[framebufferId]);
+	pipeline->SetActive(drawCmdBuffer, frameIndex);
 
 	VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindVertexBuffers(drawCmdBuffers[framebufferId]->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
-	vkCmdBindIndexBuffer(drawCmdBuffers[framebufferId]->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindVertexBuffers(drawCmdBuffer->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
+	vkCmdBindIndexBuffer(drawCmdBuffer->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdDrawIndexed(drawCmdBuffers[framebufferId]->GetCommandBuffer(), indexCount, 1, 0, 0, 0);
+	vkCmdDrawIndexed(drawCmdBuffer->GetCommandBuffer(), indexCount, 1, 0, 0, 0);
 
-	drawCmdBuffers[framebufferId]->EndRecording();
-	drawCmdBuffers[framebufferId]->ExecuteSecondary(commandBuffer);
+	drawCmdBuffer->EndRecording();
+	drawCmdBuffer->ExecuteSecondary(commandBuffer);
 }
 
 void Skydome::SetSkyColor(float r, float g, float b, float a)
@@ -30,7 +30,7 @@ class Skydome
 			glm::mat4 MVP;
 		};
 		VertexUniformBuffer vertexUniformBuffer;
-		VulkanBuffer * vsUBO;
+		VulkanBuffer * vsUBO[MAX_FRAMES_IN_FLIGHT];
 
 		// Fragment shader uniform buffer
 		struct FragmentUniformBuffer
@@ -42,7 +42,7 @@ class Skydome
 			glm::vec3 padding;
 		};
 		FragmentUniformBuffer fragmentUniformBuffer;
-		VulkanBuffer * fsUBO;
+		VulkanBuffer * fsUBO[MAX_FRAMES_IN_FLIGHT];
 
 		std::vector<VulkanCommandBuffer*> drawCmdBuffers;
 	public:
@@ -2,208 +2,286 @@
 
 #include "Texture.h"
 #include "LogManager.h"
-#include "VulkanTools.h"
+#include "UploadManager.h"
 
 extern LogManager * gLogManager;
+extern UploadManager * gUploadManager;
 
 Texture::Texture()
 {
-	textureImage = VK_NULL_HANDLE;
-	textureMemory = VK_NULL_HANDLE;
-	textureImageView = VK_NULL_HANDLE;
+	resident.image = VK_NULL_HANDLE;
+	resident.imageView = VK_NULL_HANDLE;
+	resident.baseLevel = 0;
+	format = VK_FORMAT_R8G8B8A8_UNORM;
+	bindlessIndex = UINT32_MAX;
+	handle = INVALID_RESOURCE_HANDLE;
+	streaming = false;
+	tailLevel = 0;
+	requestedSize = 0.0f;
+	residencyVersion = 0;
+	lastUsedFrame = 0;
+	evicted = false;
 }
 
 Texture::~Texture()
 {
-	textureImageView = VK_NULL_HANDLE;
-	textureMemory = VK_NULL_HANDLE;
-	textureImage = VK_NULL_HANDLE;
+	resident.imageView = VK_NULL_HANDLE;
+	resident.image = VK_NULL_HANDLE;
 }
 
-bool Texture::Init(VulkanDevice * device, VulkanCommandBuffer * cmdBuffer, std::string filename)
+bool Texture::Init(VulkanDevice * device, std::string filename, bool streaming)
 {
-	struct MipMap
+	// Mip levels are parsed in place and copied from the mapped file straight into staging
+	if (!file.Open(filename))
 	{
-		unsigned char * data;
-		int width;
-		int height;
-		unsigned int size;
-	};
-
-	VkResult result;
-	void * pData;
+		gLogManager->AddMessage("ERROR: Texture file not found! (" + filename + ")");
+		return false;
+	}
 
-	std::vector<MipMap> mipMaps;
+	uint32_t rctFormat;
+	if (!ParseRct(&file, &rctFormat, mipLevels))
+	{
+		gLogManager->AddMessage("ERROR: Texture file is corrupted! (" + filename + ")");
+		return false;
+	}
 
-	FILE * file = fopen(filename.c_str(), "rb");
-	if (file == NULL)
+	format = GetVkFormat(rctFormat);
+	if (!device->IsTextureFormatSupported(format))
 	{
-		gLogManager->AddMessage("ERROR: Texture file not found! (" + filename + ")");
+		gLogManager->AddMessage("ERROR: Texture format is not supported by the GPU, re-encode it as RGBA8! (" + filename + ")");
 		return false;
 	}
 
-	// Read original image (as mipmap level 0)
-	MipMap originalImage;
-	fread(&originalImage.width, sizeof(unsigned int), 1, file);
-	fread(&originalImage.height, sizeof(unsigned int), 1, file);
-	fread(&originalImage.size, sizeof(unsigned int), 1, file);
+	mipMapsCount = (int)mipLevels.size() - 1;
 
-	originalImage.data = new unsigned char[originalImage.size];
-	fread(originalImage.data, sizeof(unsigned char), originalImage.size, file);
-	mipMaps.push_back(originalImage);
+	// Streamed textures only load their small levels here, the rest comes in once something on screen needs it
+	uint32_t baseLevel = 0;
+	if (streaming)
+		while (baseLevel < mipLevels.size() - 1 &&
+			(mipLevels[baseLevel].width > STREAMING_TAIL_SIZE || mipLevels[baseLevel].height > STREAMING_TAIL_SIZE))
+			baseLevel++;
 
-	// Read mipmaps
-	fread(&mipMapsCount, sizeof(int), 1, file);
+	if (!CreateResidency(device, baseLevel, &resident))
+		return false;
 
-	for (int i = 0; i < mipMapsCount; i++)
-	{
-		MipMap mipMap;
-		fread(&mipMap.width, sizeof(int), 1, file);
-		fread(&mipMap.height, sizeof(int), 1, file);
-		fread(&mipMap.size, sizeof(unsigned int), 1, file);
+	tailLevel = baseLevel;
+	this->streaming = (baseLevel > 0);
+	if (!this->streaming)
+		EndStreaming();
 
-		mipMap.data = new unsigned char[mipMap.size];
-		fread(mipMap.data, sizeof(unsigned char), mipMap.size, file);
+	return true;
+}
 
-		mipMaps.push_back(mipMap);
-	}
+void Texture::Unload(VulkanDevice * vulkanDevice)
+{
+	DestroyResidency(vulkanDevice, &resident);
+	EndStreaming();
+}
+
+VkImageView * Texture::GetImageView()
+{
+	return &resident.imageView;
+}
+
+int Texture::GetMipMapCount()
+{
+	return mipMapsCount;
+}
+
+void Texture::SetBindlessIndex(uint32_t index)
+{
+	bindlessIndex = index;
+}
+
+uint32_t Texture::GetBindlessIndex()
+{
+	return bindlessIndex;
+}
+
+void Texture::SetHandle(ResourceHandle handle)
+{
+	this->handle = handle;
+}
 
-	fclose(file);
+ResourceHandle Texture::GetHandle()
+{
+	return handle;
+}
 
-	unsigned int totalTextureSize = 0;
-	for (unsigned int i = 0; i < mipMaps.size(); i++)
-		totalTextureSize += mipMaps[i].size;
+bool Texture::StreamLevels(VulkanDevice * device, uint32_t baseLevel, TextureResidency * residency)
+{
+	// Runs on the streaming thread, the file and the parsed levels don't change while the texture is streaming
+	residency->image = VK_NULL_HANDLE;
+	residency->imageView = VK_NULL_HANDLE;
 
-	// Create an array of bits which stores all of the texture data
-	std::vector<unsigned char> textureData;
-	for (unsigned int i = 0; i < mipMaps.size(); i++)
-		for (unsigned int j = 0; j < mipMaps[i].size; j++)
-			textureData.push_back(mipMaps[i].data[j]);
+	return CreateResidency(device, baseLevel, residency);
+}
 
-	for (int i = 0; i < mipMaps.size(); i++)
-		delete[] mipMaps[i].data;
+void Texture::SwapResidency(TextureResidency * residency)
+{
+	// The old image comes back in residency, the caller keeps it until the frames in flight are done with it
+	TextureResidency oldResidency = resident;
+	resident = *residency;
+	*residency = oldResidency;
 
-	VkMemoryRequirements memReq{};
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	residencyVersion++;
+}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
+void Texture::EndStreaming()
+{
+	streaming = false;
+	mipLevels.clear();
+	file.Close();
+}
 
-	VkBufferCreateInfo bufferCI{};
-	bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferCI.size = totalTextureSize;
-	bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+void Texture::RequestScreenSize(float size)
+{
+	if (size > requestedSize)
+		requestedSize = size;
+}
 
-	result = vkCreateBuffer(device->GetDevice(), &bufferCI, VK_NULL_HANDLE, &stagingBuffer);
-	if (result != VK_SUCCESS)
-		return false;
+void Texture::ResetRequestedScreenSize()
+{
+	requestedSize = 0.0f;
+}
 
-	vkGetBufferMemoryRequirements(device->GetDevice(), stagingBuffer, &memReq);
+float Texture::GetRequestedScreenSize()
+{
+	return requestedSize;
+}
 
-	allocInfo.allocationSize = memReq.size;
-	if (!device->MemoryTypeFromProperties(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &allocInfo.memoryTypeIndex))
-		return false;
+uint32_t Texture::GetWantedLevel()
+{
+	if (!streaming)
+		return resident.baseLevel;
 
-	result = vkAllocateMemory(device->GetDevice(), &allocInfo, VK_NULL_HANDLE, &stagingMemory);
-	if (result != VK_SUCCESS)
-		return false;
+	// Smallest level that still has about as many texels as the meshes using it cover in pixels
+	uint32_t level = resident.baseLevel;
+	while (level > 0 && (float)(mipLevels[level].width > mipLevels[level].height ? mipLevels[level].width : mipLevels[level].height) < requestedSize)
+		level--;
 
-	result = vkBindBufferMemory(device->GetDevice(), stagingBuffer, stagingMemory, 0);
-	if (result != VK_SUCCESS)
-		return false;
+	return level;
+}
 
-	result = vkMapMemory(device->GetDevice(), stagingMemory, 0, memReq.size, 0, &pData);
-	if (result != VK_SUCCESS)
-		return false;
+uint32_t Texture::GetResidentLevel()
+{
+	return resident.baseLevel;
+}
+
+uint32_t Texture::GetTailLevel()
+{
+	return tailLevel;
+}
+
+uint32_t Texture::GetResidencyVersion()
+{
+	return residencyVersion;
+}
 
-	memcpy(pData, textureData.data(), textureData.size());
+VkDeviceSize Texture::GetResidentSize()
+{
+	return resident.memory.size;
+}
 
-	vkUnmapMemory(device->GetDevice(), stagingMemory);
+void Texture::SetLastUsedFrame(uint64_t frame)
+{
+	lastUsedFrame = frame;
+}
+
+uint64_t Texture::GetLastUsedFrame()
+{
+	return lastUsedFrame;
+}
 
-	std::vector<VkBufferImageCopy> bufferCopyRegions;
-	uint32_t offset = 0;
+void Texture::SetEvicted(bool evicted)
+{
+	this->evicted = evicted;
+}
+
+bool Texture::IsEvicted()
+{
+	return evicted;
+}
+
+bool Texture::IsStreaming()
+{
+	return streaming;
+}
 
-	for (unsigned int level = 0; level < mipMaps.size(); level++)
+void Texture::DestroyResidency(VulkanDevice * device, TextureResidency * residency)
+{
+	vkDestroyImageView(device->GetDevice(), residency->imageView, VK_NULL_HANDLE);
+	device->GetMemoryAllocator()->Free(&residency->memory);
+	vkDestroyImage(device->GetDevice(), residency->image, VK_NULL_HANDLE);
+
+	residency->imageView = VK_NULL_HANDLE;
+	residency->image = VK_NULL_HANDLE;
+	residency->memory = VulkanAllocation();
+}
+
+bool Texture::CreateResidency(VulkanDevice * device, uint32_t baseLevel, TextureResidency * residency)
+{
+	VkResult result;
+
+	uint32_t levelCount = (uint32_t)mipLevels.size() - baseLevel;
+	residency->baseLevel = baseLevel;
+
+	std::vector<ImageUploadRegion> uploadRegions;
+	for (uint32_t level = 0; level < levelCount; level++)
 	{
-		VkBufferImageCopy bufferCopyRegion{};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = level;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.depth = 1;
-		bufferCopyRegion.bufferOffset = offset;
-		bufferCopyRegion.imageExtent.width = mipMaps[level].width;
-		bufferCopyRegion.imageExtent.height = mipMaps[level].height;
-		offset += (uint32_t)mipMaps[level].size;
-
-		bufferCopyRegions.push_back(bufferCopyRegion);
+		const RctMipLevel & mipLevel = mipLevels[baseLevel + level];
+
+		ImageUploadRegion uploadRegion{};
+		uploadRegion.dataPtr = mipLevel.data;
+		uploadRegion.dataSize = mipLevel.size;
+		uploadRegion.copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		uploadRegion.copyRegion.imageSubresource.mipLevel = level;
+		uploadRegion.copyRegion.imageSubresource.baseArrayLayer = 0;
+		uploadRegion.copyRegion.imageSubresource.layerCount = 1;
+		uploadRegion.copyRegion.imageExtent.width = mipLevel.width;
+		uploadRegion.copyRegion.imageExtent.height = mipLevel.height;
+		uploadRegion.copyRegion.imageExtent.depth = 1;
+
+		uploadRegions.push_back(uploadRegion);
 	}
 
 	VkImageCreateInfo imageCI{};
 	imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageCI.imageType = VK_IMAGE_TYPE_2D;
-	imageCI.format = VK_FORMAT_R8G8B8A8_UNORM;
-	imageCI.mipLevels = (uint32_t)mipMaps.size();
+	imageCI.format = format;
+	imageCI.mipLevels = levelCount;
 	imageCI.arrayLayers = 1;
 	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageCI.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageCI.extent.width = mipMaps[0].width;
-	imageCI.extent.height = mipMaps[0].height;
+	imageCI.extent.width = mipLevels[baseLevel].width;
+	imageCI.extent.height = mipLevels[baseLevel].height;
 	imageCI.extent.depth = 1;
 
-	result = vkCreateImage(device->GetDevice(), &imageCI, VK_NULL_HANDLE, &textureImage);
+	result = vkCreateImage(device->GetDevice(), &imageCI, VK_NULL_HANDLE, &residency->image);
 	if (result != VK_SUCCESS)
 		return false;
 
-	vkGetImageMemoryRequirements(device->GetDevice(), textureImage, &memReq);
-
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAlloc.allocationSize = memReq.size;
-
-	if (!device->MemoryTypeFromProperties(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAlloc.memoryTypeIndex))
-		return false;
-
-	result = vkAllocateMemory(device->GetDevice(), &memAlloc, VK_NULL_HANDLE, &textureMemory);
-	if (result != VK_SUCCESS)
-		return false;
-
-	result = vkBindImageMemory(device->GetDevice(), textureImage, textureMemory, 0);
-	if (result != VK_SUCCESS)
+	if (!device->GetMemoryAllocator()->AllocateImageMemory(residency->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &residency->memory))
 		return false;
 
 	VkImageSubresourceRange range{};
 	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	range.baseMipLevel = 0;
-	range.levelCount = (uint32_t)mipMaps.size();
+	range.levelCount = levelCount;
 	range.layerCount = 1;
 
-	cmdBuffer->BeginRecording();
-	VulkanTools::SetImageLayout(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		&range, cmdBuffer, device, false);
-
-	vkCmdCopyBufferToImage(cmdBuffer->GetCommandBuffer(), stagingBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		(uint32_t)bufferCopyRegions.size(), bufferCopyRegions.data());
-
-	VulkanTools::SetImageLayout(textureImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		&range, cmdBuffer, device, false);
-
-	cmdBuffer->EndRecording();
-	cmdBuffer->Execute(device, NULL, NULL, NULL, true);
-
-	vkFreeMemory(device->GetDevice(), stagingMemory, VK_NULL_HANDLE);
-	vkDestroyBuffer(device->GetDevice(), stagingBuffer, VK_NULL_HANDLE);
+	// The upload manager copies every level into staging before returning, the file isn't read after it
+	if (!gUploadManager->UploadImage(residency->image, range, uploadRegions))
+		return false;
 
 	VkImageViewCreateInfo viewCI{};
 	viewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewCI.image = textureImage;
+	viewCI.image = residency->image;
 	viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewCI.format = VK_FORMAT_R8G8B8A8_UNORM;
+	viewCI.format = format;
 	viewCI.components.r = VK_COMPONENT_SWIZZLE_R;
 	viewCI.components.g = VK_COMPONENT_SWIZZLE_G;
 	viewCI.components.b = VK_COMPONENT_SWIZZLE_B;
@@ -212,27 +290,92 @@ bool Texture::Init(VulkanDevice * device, VulkanCommandBuffer * cmdBuffer, std::
 	viewCI.subresourceRange.baseMipLevel = 0;
 	viewCI.subresourceRange.baseArrayLayer = 0;
 	viewCI.subresourceRange.layerCount = 1;
-	viewCI.subresourceRange.levelCount = (uint32_t)mipMaps.size();
-	result = vkCreateImageView(device->GetDevice(), &viewCI, VK_NULL_HANDLE, &textureImageView);
+	viewCI.subresourceRange.levelCount = levelCount;
+	result = vkCreateImageView(device->GetDevice(), &viewCI, VK_NULL_HANDLE, &residency->imageView);
 	if (result != VK_SUCCESS)
 		return false;
 
 	return true;
 }
 
-void Texture::Unload(VulkanDevice * vulkanDevice)
+// Width, height and size, then the level's data
+static bool ReadRctLevel(const uint8_t * data, size_t size, size_t & offset, uint32_t format, RctMipLevel & mipLevel)
 {
-	vkDestroyImageView(vulkanDevice->GetDevice(), textureImageView, VK_NULL_HANDLE);
-	vkFreeMemory(vulkanDevice->GetDevice(), textureMemory, VK_NULL_HANDLE);
-	vkDestroyImage(vulkanDevice->GetDevice(), textureImage, VK_NULL_HANDLE);
+	if (size - offset < 3 * sizeof(uint32_t))
+		return false;
+
+	memcpy(&mipLevel.width, data + offset, sizeof(uint32_t));
+	memcpy(&mipLevel.height, data + offset + sizeof(uint32_t), sizeof(uint32_t));
+	memcpy(&mipLevel.size, data + offset + 2 * sizeof(uint32_t), sizeof(uint32_t));
+	offset += 3 * sizeof(uint32_t);
+
+	if (size - offset < mipLevel.size || mipLevel.size < GetRctLevelSize(format, mipLevel.width, mipLevel.height))
+		return false;
+
+	mipLevel.data = data + offset;
+	offset += mipLevel.size;
+
+	return true;
 }
 
-VkImageView * Texture::GetImageView()
+bool Texture::ParseRct(VirtualFile * file, uint32_t * format, std::vector<RctMipLevel> & mipLevels)
 {
-	return &textureImageView;
+	const uint8_t * data = file->GetData();
+	size_t size = file->GetSize();
+	size_t offset = 0;
+
+	// Files from the texture encoder are tagged with their format, older ones are RGBA8
+	uint32_t magic = 0;
+	if (size >= 2 * sizeof(uint32_t))
+		memcpy(&magic, data, sizeof(uint32_t));
+
+	*format = RCT_FORMAT_RGBA8;
+	if (magic == RCT_MAGIC)
+	{
+		memcpy(format, data + sizeof(uint32_t), sizeof(uint32_t));
+		offset += 2 * sizeof(uint32_t);
+
+		if (*format >= RCT_FORMAT_COUNT)
+			return false;
+	}
+
+	// Original image as level 0, then the mipmap count and the mipmaps
+	RctMipLevel mipLevel;
+	if (!ReadRctLevel(data, size, offset, *format, mipLevel))
+		return false;
+	mipLevels.push_back(mipLevel);
+
+	int32_t mipMapCount;
+	if (size - offset < sizeof(int32_t))
+		return false;
+	memcpy(&mipMapCount, data + offset, sizeof(int32_t));
+	offset += sizeof(int32_t);
+
+	for (int32_t i = 0; i < mipMapCount; i++)
+	{
+		if (!ReadRctLevel(data, size, offset, *format, mipLevel))
+			return false;
+		mipLevels.push_back(mipLevel);
+	}
+
+	return true;
 }
 
-int Texture::GetMipMapCount()
+VkFormat Texture::GetVkFormat(uint32_t rctFormat)
 {
-	return mipMapsCount;
-}
+	switch (rctFormat)
+	{
+		case RCT_FORMAT_BC1:
+			return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case RCT_FORMAT_BC3:
+			return VK_FORMAT_BC3_UNORM_BLOCK;
+		case RCT_FORMAT_BC4:
+			return VK_FORMAT_BC4_UNORM_BLOCK;
+		case RCT_FORMAT_BC5:
+			return VK_FORMAT_BC5_UNORM_BLOCK;
+		case RCT_FORMAT_BC7:
+			return VK_FORMAT_BC7_UNORM_BLOCK;
+		default:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
\ No newline at end of file
@@ -1,22 +1,85 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "VulkanCommandBuffer.h"
+#include "VirtualFileSystem.h"
+#include "RctFormat.h"
+#include "ResourceRegistry.h"
+
+// Streamed textures start with the levels up to this size, they're small enough to load with the model
+#define STREAMING_TAIL_SIZE 64
+
+// One mip level of a .rct file, the data points into the mapped file
+struct RctMipLevel
+{
+	const uint8_t * data;
+	uint32_t width;
+	uint32_t height;
+	uint32_t size;
+};
+
+// Image holding the mip levels from baseLevel to the last one, streaming replaces it with a bigger one
+struct TextureResidency
+{
+	VkImage image;
+	VkImageView imageView;
+	VulkanAllocation memory;
+	uint32_t baseLevel;
+};
 
 class Texture
 {
 	private:
-		VkImage textureImage;
-		VkImageView textureImageView;
-		VkDeviceMemory textureMemory;
+		TextureResidency resident;
+		VkFormat format;
 		int mipMapsCount;
+		uint32_t bindlessIndex;
+		ResourceHandle handle;
+
+		// Kept mapped while the texture streams, levels dropped by an eviction are streamed in again from it
+		VirtualFile file;
+		std::vector<RctMipLevel> mipLevels;
+		bool streaming;
+		uint32_t tailLevel;
+		float requestedSize;
+		uint32_t residencyVersion;
+		uint64_t lastUsedFrame;
+		bool evicted;
+	private:
+		bool CreateResidency(VulkanDevice * device, uint32_t baseLevel, TextureResidency * residency);
 	public:
 		Texture();
 		~Texture();
 
-		bool Init(VulkanDevice * device, VulkanCommandBuffer * cmdBuffer, std::string filename);
+		bool Init(VulkanDevice * device, std::string filename, bool streaming = false);
 		void Unload(VulkanDevice * vulkanDevice);
 		VkImageView * GetImageView();
 		int GetMipMapCount();
+		void SetBindlessIndex(uint32_t index);
+		uint32_t GetBindlessIndex();
+		void SetHandle(ResourceHandle handle);
+		ResourceHandle GetHandle();
+
+		bool StreamLevels(VulkanDevice * device, uint32_t baseLevel, TextureResidency * residency);
+		void SwapResidency(TextureResidency * residency);
+		void EndStreaming();
+		void RequestScreenSize(float size);
+		void ResetRequestedScreenSize();
+		float GetRequestedScreenSize();
+		uint32_t GetWantedLevel();
+		uint32_t GetResidentLevel();
+		uint32_t GetTailLevel();
+		uint32_t GetResidencyVersion();
+		VkDeviceSize GetResidentSize();
+		void SetLastUsedFrame(uint64_t frame);
+		uint64_t GetLastUsedFrame();
+		void SetEvicted(bool evicted);
+		bool IsEvicted();
+		bool IsStreaming();
+
+		static void DestroyResidency(VulkanDevice * device, TextureResidency * residency);
+		static bool ParseRct(VirtualFile * file, uint32_t * format, std::vector<RctMipLevel> & mipLevels);
+		static VkFormat GetVkFormat(uint32_t rctFormat);
 };
\ No newline at end of file
@@ -1,59 +1,598 @@
+#include <filesystem>
+#include <algorithm>
+
 #include "TextureManager.h"
+#include "UploadManager.h"
+#include "ResidencyManager.h"
 #include "LogManager.h"
+#include "Timer.h"
 #include "StdInc.h"
 
+namespace fs = std::experimental::filesystem;
+
 extern LogManager * gLogManager;
+extern UploadManager * gUploadManager;
+extern ResidencyManager * gResidencyManager;
+extern Timer * gTimer;
+
+TextureManager::TextureManager()
+{
+	bindlessLayout = VK_NULL_HANDLE;
+	bindlessPool = VK_NULL_HANDLE;
+	bindlessSet = VK_NULL_HANDLE;
+	nextBindlessIndex = 0;
+	streamDevice = NULL;
+	activeStream = NULL;
+	streamRunning = false;
+}
+
+TextureManager::~TextureManager()
+{
+	bindlessSet = VK_NULL_HANDLE;
+	bindlessPool = VK_NULL_HANDLE;
+	bindlessLayout = VK_NULL_HANDLE;
+	streamDevice = NULL;
+}
+
+bool TextureManager::InitBindless(VulkanInterface * vulkan)
+{
+	VkResult result;
+	VulkanDevice * device = vulkan->GetVulkanDevice();
+
+	// Not an error, materials fall back to per-draw texture descriptors
+	if (!device->IsDescriptorIndexingSupported())
+		return true;
+
+	// Binding 0 is the sampler every texture shares, binding 1 the image array
+	VkSampler sampler = vulkan->GetColorSampler();
+
+	VkDescriptorSetLayoutBinding layoutBindings[2];
+
+	layoutBindings[0].binding = 0;
+	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	layoutBindings[0].descriptorCount = 1;
+	layoutBindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	layoutBindings[0].pImmutableSamplers = &sampler;
+
+	layoutBindings[1].binding = 1;
+	layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	layoutBindings[1].descriptorCount = MAX_BINDLESS_TEXTURES;
+	layoutBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	layoutBindings[1].pImmutableSamplers = VK_NULL_HANDLE;
+
+	// Slots of textures that aren't loaded stay empty, and new ones can be written while frames in flight use the others
+	VkDescriptorBindingFlagsEXT bindingFlags[2];
+	bindingFlags[0] = 0;
+	bindingFlags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT |
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCI{};
+	bindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsCI.bindingCount = 2;
+	bindingFlagsCI.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+	descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorLayoutCI.pNext = &bindingFlagsCI;
+	descriptorLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	descriptorLayoutCI.bindingCount = 2;
+	descriptorLayoutCI.pBindings = layoutBindings;
+
+	result = vkCreateDescriptorSetLayout(device->GetDevice(), &descriptorLayoutCI, VK_NULL_HANDLE, &bindlessLayout);
+	if (result != VK_SUCCESS)
+		return false;
+
+	VkDescriptorPoolSize typeCounts[2];
+	typeCounts[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	typeCounts[0].descriptorCount = 1;
+	typeCounts[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	typeCounts[1].descriptorCount = MAX_BINDLESS_TEXTURES;
+
+	VkDescriptorPoolCreateInfo descriptorPoolCI{};
+	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	descriptorPoolCI.maxSets = 1;
+	descriptorPoolCI.poolSizeCount = 2;
+	descriptorPoolCI.pPoolSizes = typeCounts;
+
+	result = vkCreateDescriptorPool(device->GetDevice(), &descriptorPoolCI, VK_NULL_HANDLE, &bindlessPool);
+	if (result != VK_SUCCESS)
+		return false;
+
+	uint32_t textureCount = MAX_BINDLESS_TEXTURES;
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo{};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableCountInfo.descriptorSetCount = 1;
+	variableCountInfo.pDescriptorCounts = &textureCount;
+
+	VkDescriptorSetAllocateInfo descSetAllocInfo{};
+	descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descSetAllocInfo.pNext = &variableCountInfo;
+	descSetAllocInfo.descriptorPool = bindlessPool;
+	descSetAllocInfo.descriptorSetCount = 1;
+	descSetAllocInfo.pSetLayouts = &bindlessLayout;
+
+	result = vkAllocateDescriptorSets(device->GetDevice(), &descSetAllocInfo, &bindlessSet);
+	if (result != VK_SUCCESS)
+		return false;
 
-Texture * TextureManager::RequestTexture(std::string filename, VulkanDevice * device, VulkanCommandBuffer * cmdBuffer)
+	// Textures loaded before the array existed
+	texturesLoaded.ForEach([this, device](Texture * texture) { AddBindlessTexture(texture, device); });
+
+	gLogManager->AddMessage("Bindless textures enabled");
+
+	return true;
+}
+
+void TextureManager::UnloadBindless(VulkanDevice * device)
+{
+	vkDestroyDescriptorPool(device->GetDevice(), bindlessPool, VK_NULL_HANDLE);
+	vkDestroyDescriptorSetLayout(device->GetDevice(), bindlessLayout, VK_NULL_HANDLE);
+
+	bindlessSet = VK_NULL_HANDLE;
+	bindlessPool = VK_NULL_HANDLE;
+	bindlessLayout = VK_NULL_HANDLE;
+	freeBindlessIndices.clear();
+	nextBindlessIndex = 0;
+}
+
+bool TextureManager::InitStreaming(VulkanDevice * device)
+{
+	streamDevice = device;
+	streamRunning = true;
+	streamThread = std::thread(&TextureManager::StreamMain, this);
+
+	return true;
+}
+
+void TextureManager::UnloadStreaming(VulkanDevice * device)
 {
-	// Check if texture is already loaded
-	for (unsigned int i = 0; i < texturesLoaded.size(); i++)
 	{
-		if (filename == texturesLoaded[i].filename)
+		std::lock_guard<std::mutex> lock(streamMutex);
+		streamRunning = false;
+		streamQueue.clear();
+	}
+	streamWake.notify_all();
+
+	if (streamThread.joinable())
+		streamThread.join();
+
+	// The copies into finished and replaced images may still be queued
+	gUploadManager->WaitIdle();
+
+	for (unsigned int i = 0; i < streamResults.size(); i++)
+		Texture::DestroyResidency(device, &streamResults[i].residency);
+	streamResults.clear();
+
+	for (unsigned int i = 0; i < retiredResidencies.size(); i++)
+		Texture::DestroyResidency(device, &retiredResidencies[i].residency);
+	retiredResidencies.clear();
+}
+
+void TextureManager::UpdateStreaming(VulkanDevice * device, std::vector<VkImageView> & replacedViews)
+{
+	// Called after the frame slot's fence wait, so whatever was retired MAX_FRAMES_IN_FLIGHT frames ago is done
+	uint64_t frame = gResidencyManager->GetFrame();
+
+	for (unsigned int i = 0; i < retiredResidencies.size(); )
+	{
+		if (retiredResidencies[i].retireFrame > frame)
 		{
-			texturesLoaded[i].useCount++;
-			return texturesLoaded[i].texturePtr;
+			i++;
+			continue;
 		}
+
+		Texture::DestroyResidency(device, &retiredResidencies[i].residency);
+		if (retiredResidencies[i].bindlessIndex != UINT32_MAX)
+			FreeBindlessIndex(retiredResidencies[i].bindlessIndex);
+
+		retiredResidencies.erase(retiredResidencies.begin() + i);
 	}
 
-	// If texture is not loaded, create new entry
-	Texture * texture = new Texture();
-	if (!texture->Init(device, cmdBuffer, filename))
+	std::vector<StreamResult> results;
 	{
-		gLogManager->AddMessage("ERROR: Couldn't init a texture!");
-		return nullptr;
+		std::lock_guard<std::mutex> lock(streamMutex);
+		results.swap(streamResults);
 	}
 
-	TextureEntry entry;
-	entry.filename = filename;
-	entry.texturePtr = texture;
-	entry.useCount = 1;
-	texturesLoaded.push_back(entry);
+	// The copies were recorded into the upload manager's current batch, which is submitted ahead of this frame
+	for (unsigned int i = 0; i < results.size(); i++)
+	{
+		Texture * texture = results[i].texture;
 
-	return texture;
-}
+		RetiredResidency retired;
+		retired.bindlessIndex = UINT32_MAX;
+		retired.retireFrame = frame + MAX_FRAMES_IN_FLIGHT;
 
-void TextureManager::ReleaseTexture(Texture * texture, VulkanDevice * device)
-{
-	for (unsigned int i = 0; i < texturesLoaded.size(); i++)
+		if (!results[i].success)
+		{
+			gLogManager->AddMessage("ERROR: Failed to stream in a texture, it stays at its current size!");
+			texture->EndStreaming();
+
+			retired.residency = results[i].residency;
+			retiredResidencies.push_back(retired);
+			continue;
+		}
+
+		replacedViews.push_back(*texture->GetImageView());
+		texture->SwapResidency(&results[i].residency);
+		retired.residency = results[i].residency;
+
+		if (texture->IsEvicted())
+		{
+			gResidencyManager->ReportReload(RESIDENCY_RESOURCE_TEXTURE, texture->GetResidentSize());
+			texture->SetEvicted(false);
+		}
+
+		// Frames in flight may still sample the old slot, so the new view gets a slot of its own
+		if (bindlessSet != VK_NULL_HANDLE && texture->GetBindlessIndex() != UINT32_MAX)
+		{
+			retired.bindlessIndex = texture->GetBindlessIndex();
+			AddBindlessTexture(texture, device);
+		}
+
+		retiredResidencies.push_back(retired);
+	}
+
+	// Everything drawn this frame asked for a size, textures that need more levels than they have are queued
+	std::vector<StreamRequest> requests;
+	bool overBudget = gResidencyManager->IsOverBudget();
+	texturesLoaded.ForEach([&requests, frame, overBudget](Texture * texture)
 	{
-		if (texture == texturesLoaded[i].texturePtr)
+		if (texture->GetRequestedScreenSize() > 0.0f)
+			texture->SetLastUsedFrame(frame);
+
+		// No bigger levels are streamed in while the heap is over its budget, that would only evict them again
+		if (texture->IsStreaming() && !overBudget)
 		{
-			if (texturesLoaded[i].useCount > 1)
-				texturesLoaded[i].useCount--;
-			else
+			uint32_t wantedLevel = texture->GetWantedLevel();
+			if (wantedLevel < texture->GetResidentLevel())
 			{
-				SAFE_UNLOAD(texturesLoaded[i].texturePtr, device);
-				texturesLoaded.erase(texturesLoaded.begin() + i);
+				StreamRequest request;
+				request.texture = texture;
+				request.baseLevel = wantedLevel;
+				request.priority = texture->GetRequestedScreenSize();
+				requests.push_back(request);
 			}
+		}
+
+		texture->ResetRequestedScreenSize();
+	});
+
+	// Biggest on screen at the back, that's where the streaming thread takes from
+	std::sort(requests.begin(), requests.end(), [](const StreamRequest & a, const StreamRequest & b) { return a.priority < b.priority; });
+
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+
+		// A texture that is being built or waits to be swapped in is only queued again after the swap
+		for (unsigned int i = 0; i < requests.size(); )
+		{
+			bool pending = (requests[i].texture == activeStream);
+			for (unsigned int j = 0; j < streamResults.size() && !pending; j++)
+				pending = (requests[i].texture == streamResults[j].texture);
 
-			texture = NULL;
-			break;
+			if (pending)
+				requests.erase(requests.begin() + i);
+			else
+				i++;
 		}
+
+		streamQueue.swap(requests);
 	}
+	streamWake.notify_one();
+}
+
+VkDeviceSize TextureManager::EvictTextures(VulkanDevice * device, VkDeviceSize bytes, std::vector<VkImageView> & replacedViews)
+{
+	uint64_t frame = gResidencyManager->GetFrame();
+
+	// Least recently used first, only streamed textures above their mip tail that no frame in flight can be sampling
+	std::vector<Texture*> candidates;
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+
+		texturesLoaded.ForEach([this, &candidates, frame](Texture * texture)
+		{
+			if (!texture->IsStreaming() || texture->GetResidentLevel() >= texture->GetTailLevel())
+				return;
+			if (texture->GetLastUsedFrame() + RESIDENCY_MIN_IDLE_FRAMES > frame)
+				return;
+
+			bool pending = (texture == activeStream);
+			for (unsigned int j = 0; j < streamResults.size() && !pending; j++)
+				pending = (texture == streamResults[j].texture);
+
+			if (!pending)
+				candidates.push_back(texture);
+		});
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](Texture * a, Texture * b) { return a->GetLastUsedFrame() < b->GetLastUsedFrame(); });
+
+	VkDeviceSize freed = 0;
+	for (unsigned int i = 0; i < candidates.size() && freed < bytes; i++)
+	{
+		Texture * texture = candidates[i];
+		VkDeviceSize size = texture->GetResidentSize();
+
+		// Drops back to the mip tail it started with, streaming brings the levels back once it's drawn again
+		TextureResidency residency;
+		if (!texture->StreamLevels(device, texture->GetTailLevel(), &residency))
+		{
+			gLogManager->AddMessage("ERROR: Failed to evict a texture, it stays resident!");
+			Texture::DestroyResidency(device, &residency);
+			continue;
+		}
+
+		replacedViews.push_back(*texture->GetImageView());
+		texture->SwapResidency(&residency);
+
+		// Idle for longer than the frames in flight, the old image goes right away and its slot is rewritten in place
+		Texture::DestroyResidency(device, &residency);
+		if (bindlessSet != VK_NULL_HANDLE && texture->GetBindlessIndex() != UINT32_MAX)
+			RewriteBindlessTexture(texture, device);
+
+		VkDeviceSize evicted = size - texture->GetResidentSize();
+		gResidencyManager->ReportEviction(RESIDENCY_RESOURCE_TEXTURE, evicted);
+		texture->SetEvicted(true);
+		freed += evicted;
+	}
+
+	return freed;
+}
+
+Texture * TextureManager::RequestTexture(std::string filename, VulkanDevice * device, bool streaming)
+{
+	// If texture is not loaded, create new entry
+	return texturesLoaded.Request(filename, [this, &filename, device, streaming]() -> Texture*
+	{
+		Texture * texture = new Texture();
+		if (!texture->Init(device, filename, streaming))
+		{
+			gLogManager->AddMessage("ERROR: Couldn't init a texture!");
+			return nullptr;
+		}
+
+		if (bindlessSet != VK_NULL_HANDLE)
+			AddBindlessTexture(texture, device);
+
+		texture->SetLastUsedFrame(gResidencyManager->GetFrame());
+
+		return texture;
+	});
+}
+
+void TextureManager::ReleaseTexture(Texture * texture, VulkanDevice * device)
+{
+	if (texture == NULL || texturesLoaded.Get(texture->GetHandle()) != texture)
+		return;
+
+	// Frames in flight may still sample it, the image and its bindless slot go once their fences signaled
+	if (texturesLoaded.Release(texture->GetHandle(), gResidencyManager->GetFrame() + MAX_FRAMES_IN_FLIGHT))
+		CancelStreaming(texture);
+}
+
+void TextureManager::DestroyReleasedTextures(VulkanDevice * device, std::vector<VkImageView> & destroyedViews, bool all)
+{
+	texturesLoaded.DestroyReleased(gResidencyManager->GetFrame(), all, [this, device, &destroyedViews](Texture * texture)
+	{
+		destroyedViews.push_back(*texture->GetImageView());
+		RemoveBindlessTexture(texture);
+		SAFE_UNLOAD(texture, device);
+	});
 }
 
 size_t TextureManager::GetLoadedTexturesCount()
 {
-	return texturesLoaded.size();
+	return texturesLoaded.GetCount();
+}
+
+bool TextureManager::IsBindlessEnabled()
+{
+	return bindlessSet != VK_NULL_HANDLE;
+}
+
+VkDescriptorSetLayout * TextureManager::GetBindlessLayout()
+{
+	return &bindlessLayout;
+}
+
+VkDescriptorSet TextureManager::GetBindlessSet()
+{
+	return bindlessSet;
 }
+
+void TextureManager::RunLoadBenchmark(VulkanDevice * device, std::string dataDir)
+{
+	std::vector<std::string> files;
+	for (auto & entry : fs::recursive_directory_iterator(dataDir))
+		if (entry.path().extension() == ".rct")
+			files.push_back(entry.path().string());
+
+	if (files.empty())
+	{
+		gLogManager->AddMessage("TEXTURE BENCHMARK: no .rct files in " + dataDir);
+		return;
+	}
+
+	char msg[160];
+	size_t totalBytes = 0;
+
+	// Reference: only reading every file into memory with fread
+	std::vector<unsigned char> readBuffer;
+	gTimer->BenchmarkCodeStart();
+	for (unsigned int i = 0; i < files.size(); i++)
+	{
+		FILE * file = fopen(files[i].c_str(), "rb");
+		if (file == NULL)
+			continue;
+
+		fseek(file, 0, SEEK_END);
+		readBuffer.resize(ftell(file));
+		fseek(file, 0, SEEK_SET);
+		fread(readBuffer.data(), 1, readBuffer.size(), file);
+		fclose(file);
+
+		totalBytes += readBuffer.size();
+	}
+	gTimer->BenchmarkCodeEnd();
+	float readTime = gTimer->GetBenchmarkResult();
+
+	// Full load: mapping, parsing, staging, creating the image and waiting until the copies are done
+	std::vector<Texture*> textures;
+	gTimer->BenchmarkCodeStart();
+	for (unsigned int i = 0; i < files.size(); i++)
+	{
+		Texture * texture = new Texture();
+		if (!texture->Init(device, files[i]))
+		{
+			SAFE_DELETE(texture);
+			continue;
+		}
+		textures.push_back(texture);
+	}
+	gUploadManager->WaitIdle();
+	gTimer->BenchmarkCodeEnd();
+	float loadTime = gTimer->GetBenchmarkResult();
+
+	for (unsigned int i = 0; i < textures.size(); i++)
+		SAFE_UNLOAD(textures[i], device);
+
+	float totalMB = totalBytes / (1024.0f * 1024.0f);
+	sprintf(msg, "TEXTURE BENCHMARK: %zu FILES, %.2f MB: FREAD %.1f MB/s, MAPPED LOAD %.1f MB/s (%f ms)", files.size(), totalMB,
+		totalMB * 1000.0f / readTime, totalMB * 1000.0f / loadTime, loadTime);
+	gLogManager->AddMessage(msg);
+}
+
+void TextureManager::AddBindlessTexture(Texture * texture, VulkanDevice * device)
+{
+	std::lock_guard<std::mutex> lock(bindlessMutex);
+
+	uint32_t index;
+	if (!freeBindlessIndices.empty())
+	{
+		index = freeBindlessIndices.back();
+		freeBindlessIndices.pop_back();
+	}
+	else if (nextBindlessIndex < MAX_BINDLESS_TEXTURES)
+		index = nextBindlessIndex++;
+	else
+	{
+		gLogManager->AddMessage("ERROR: Bindless texture array is full!");
+		return;
+	}
+
+	WriteBindlessDescriptor(index, *texture->GetImageView(), device);
+
+	texture->SetBindlessIndex(index);
+}
+
+void TextureManager::RewriteBindlessTexture(Texture * texture, VulkanDevice * device)
+{
+	// Keeps its slot without going through the free list, the lock serializes updates of the shared set with loading jobs
+	std::lock_guard<std::mutex> lock(bindlessMutex);
+
+	WriteBindlessDescriptor(texture->GetBindlessIndex(), *texture->GetImageView(), device);
+}
+
+void TextureManager::WriteBindlessDescriptor(uint32_t index, VkImageView imageView, VulkanDevice * device)
+{
+	VkDescriptorImageInfo textureDesc{};
+	textureDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	textureDesc.imageView = imageView;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = bindlessSet;
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = index;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptorWrite.pImageInfo = &textureDesc;
+
+	vkUpdateDescriptorSets(device->GetDevice(), 1, &descriptorWrite, 0, NULL);
+}
+
+void TextureManager::RemoveBindlessTexture(Texture * texture)
+{
+	if (texture->GetBindlessIndex() == UINT32_MAX)
+		return;
+
+	// Released textures are only destroyed once the GPU is done with them, so the slot can be handed out again right away
+	FreeBindlessIndex(texture->GetBindlessIndex());
+	texture->SetBindlessIndex(UINT32_MAX);
+}
+
+void TextureManager::FreeBindlessIndex(uint32_t index)
+{
+	// Loading jobs add textures from the workers while the main thread hands slots back
+	std::lock_guard<std::mutex> lock(bindlessMutex);
+
+	freeBindlessIndices.push_back(index);
+}
+
+
+void TextureManager::StreamMain()
+{
+	std::unique_lock<std::mutex> lock(streamMutex);
+
+	while (true)
+	{
+		streamWake.wait(lock, [this] { return !streamRunning || !streamQueue.empty(); });
+
+		if (!streamRunning)
+			return;
+
+		StreamRequest request = streamQueue.back();
+		streamQueue.pop_back();
+		activeStream = request.texture;
+
+		// Reading the file and staging it runs unlocked, the main thread only waits for it when it releases the texture.
+		// A full staging ring makes the upload manager submit from here, through the device's submit lock
+		lock.unlock();
+
+		StreamResult result;
+		result.texture = request.texture;
+		result.success = request.texture->StreamLevels(streamDevice, request.baseLevel, &result.residency);
+
+		lock.lock();
+
+		streamResults.push_back(result);
+		activeStream = NULL;
+		streamDone.notify_all();
+	}
+}
+
+void TextureManager::CancelStreaming(Texture * texture)
+{
+	std::unique_lock<std::mutex> lock(streamMutex);
+
+	for (unsigned int i = 0; i < streamQueue.size(); )
+	{
+		if (streamQueue[i].texture == texture)
+			streamQueue.erase(streamQueue.begin() + i);
+		else
+			i++;
+	}
+
+	streamDone.wait(lock, [this, texture] { return activeStream != texture; });
+
+	// A finished image may still have its copies queued, it's destroyed with the other retired ones
+	for (unsigned int i = 0; i < streamResults.size(); )
+	{
+		if (streamResults[i].texture != texture)
+		{
+			i++;
+			continue;
+		}
+
+		RetiredResidency retired;
+		retired.residency = streamResults[i].residency;
+		retired.bindlessIndex = UINT32_MAX;
+		retired.retireFrame = gResidencyManager->GetFrame() + MAX_FRAMES_IN_FLIGHT;
+		retiredResidencies.push_back(retired);
+
+		streamResults.erase(streamResults.begin() + i);
+	}
+}
\ No newline at end of file
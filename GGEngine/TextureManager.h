@@ -2,20 +2,84 @@
 
 #include <vector>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "Texture.h"
+#include "ResourceRegistry.h"
+#include "VulkanInterface.h"
+
+// Size of the bindless texture array, every loaded texture takes one slot
+#define MAX_BINDLESS_TEXTURES 4096
 
 class TextureManager
 {
 	private:
-		struct TextureEntry
+		ResourceRegistry<Texture> texturesLoaded;
+
+		// One sampled image array with every loaded texture, only created when descriptor indexing is supported
+		VkDescriptorSetLayout bindlessLayout;
+		VkDescriptorPool bindlessPool;
+		VkDescriptorSet bindlessSet;
+		std::vector<uint32_t> freeBindlessIndices;
+		uint32_t nextBindlessIndex;
+		// Loading jobs take slots for the textures they load
+		std::mutex bindlessMutex;
+
+		// Bigger images of streamed textures are built on the streaming thread and swapped in between frames
+		struct StreamRequest
+		{
+			Texture * texture;
+			uint32_t baseLevel;
+			float priority;
+		};
+		struct StreamResult
 		{
-			std::string filename;
-			Texture * texturePtr;
-			unsigned int useCount;
+			Texture * texture;
+			TextureResidency residency;
+			bool success;
 		};
-		std::vector<TextureEntry> texturesLoaded;
+		// Replaced images and their bindless slots, destroyed once the frames in flight can't use them anymore
+		struct RetiredResidency
+		{
+			TextureResidency residency;
+			uint32_t bindlessIndex;
+			uint64_t retireFrame;
+		};
+		VulkanDevice * streamDevice;
+		std::thread streamThread;
+		std::mutex streamMutex;
+		std::condition_variable streamWake;
+		std::condition_variable streamDone;
+		std::vector<StreamRequest> streamQueue;
+		std::vector<StreamResult> streamResults;
+		Texture * activeStream;
+		bool streamRunning;
+		std::vector<RetiredResidency> retiredResidencies;
+	private:
+		void AddBindlessTexture(Texture * texture, VulkanDevice * device);
+		void RemoveBindlessTexture(Texture * texture);
+		void FreeBindlessIndex(uint32_t index);
+		void RewriteBindlessTexture(Texture * texture, VulkanDevice * device);
+		void WriteBindlessDescriptor(uint32_t index, VkImageView imageView, VulkanDevice * device);
+		void StreamMain();
+		void CancelStreaming(Texture * texture);
 	public:
-		Texture * RequestTexture(std::string filename, VulkanDevice * device, VulkanCommandBuffer * cmdBuffer);
+		TextureManager();
+		~TextureManager();
+
+		bool InitBindless(VulkanInterface * vulkan);
+		void UnloadBindless(VulkanDevice * device);
+		bool InitStreaming(VulkanDevice * device);
+		void UnloadStreaming(VulkanDevice * device);
+		void UpdateStreaming(VulkanDevice * device, std::vector<VkImageView> & replacedViews);
+		VkDeviceSize EvictTextures(VulkanDevice * device, VkDeviceSize bytes, std::vector<VkImageView> & replacedViews);
+		Texture * RequestTexture(std::string filename, VulkanDevice * device, bool streaming = false);
 		void ReleaseTexture(Texture * texture, VulkanDevice * device);
+		void DestroyReleasedTextures(VulkanDevice * device, std::vector<VkImageView> & destroyedViews, bool all = false);
 		size_t GetLoadedTexturesCount();
+		bool IsBindlessEnabled();
+		VkDescriptorSetLayout * GetBindlessLayout();
+		VkDescriptorSet GetBindlessSet();
+		void RunLoadBenchmark(VulkanDevice * device, std::string dataDir);
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
-#include <fstream>
+#include <sstream>
 #include "TimeCycle.h"
 #include "LogManager.h"
+#include "VirtualFileSystem.h"
 
 extern LogManager * gLogManager;
 
@@ -10,12 +11,13 @@ bool TimeCycle::Init(Skydome * skydome, Sunlight * light)
 	lightPtr = light;
 	timePassSpeed = 1000;
 
-	std::ifstream file("data/timecycle.dat");
-	if (!file.is_open())
+	VirtualFile timeCycleFile;
+	if (!timeCycleFile.Open("data/timecycle.dat"))
 	{
 		gLogManager->AddMessage("ERROR: Missing timecycle.dat");
 		return false;
 	}
+	std::istringstream file(timeCycleFile.GetText());
 
 	std::string identifier, weatherName;
 	while (!file.eof())
@@ -67,7 +69,7 @@ bool TimeCycle::Init(Skydome * skydome, Sunlight * light)
 		weatherList.push_back(weather);
 	}
 
-	file.close();
+	timeCycleFile.Close();
 
 	timer = new GameplayTimer();
 	return true;
@@ -0,0 +1,150 @@
+#include "UniformRing.h"
+#include "LogManager.h"
+#include "StdInc.h"
+
+extern LogManager * gLogManager;
+
+UniformRing::UniformRing()
+{
+	buffer = VK_NULL_HANDLE;
+	frameSize = 0;
+	alignment = 1;
+	frameStart = 0;
+	head = 0;
+	slotSize = 0;
+	slotHead = 0;
+}
+
+UniformRing::~UniformRing()
+{
+	buffer = VK_NULL_HANDLE;
+}
+
+bool UniformRing::Init(VulkanDevice * vulkanDevice, VkDeviceSize frameSize, uint32_t frameCount)
+{
+	VkResult result;
+
+	// Every slice starts at an offset the device accepts for dynamic uniform buffers
+	alignment = vulkanDevice->GetGPUProperties().limits.minUniformBufferOffsetAlignment;
+	if (alignment == 0)
+		alignment = 1;
+
+	this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+	slotSize = (UNIFORM_RING_SLOT_SIZE + alignment - 1) & ~(alignment - 1);
+	head = slotSize;
+
+	VkBufferCreateInfo bufferCI{};
+	bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	// Also read as a vertex buffer, instanced draws take their per-instance data from the same frame region
+	bufferCI.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	bufferCI.size = this->frameSize * frameCount;
+	bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	result = vkCreateBuffer(vulkanDevice->GetDevice(), &bufferCI, VK_NULL_HANDLE, &buffer);
+	if (result != VK_SUCCESS)
+		return false;
+
+	// Coherent and mapped by the allocator, writes need no flush
+	if (!vulkanDevice->GetMemoryAllocator()->AllocateBufferMemory(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memory))
+		return false;
+
+	return true;
+}
+
+void UniformRing::Unload(VulkanDevice * vulkanDevice)
+{
+	vulkanDevice->GetMemoryAllocator()->Free(&memory);
+	vkDestroyBuffer(vulkanDevice->GetDevice(), buffer, VK_NULL_HANDLE);
+}
+
+void UniformRing::BeginFrame(uint32_t frameIndex)
+{
+	// The slot's fence has been waited on, everything in its region can be overwritten
+	frameStart = frameSize * frameIndex;
+	head = slotSize;
+}
+
+uint32_t UniformRing::Allocate(const void * dataPtr, size_t dataSize)
+{
+	VkDeviceSize allocationSize = ((VkDeviceSize)dataSize + alignment - 1) & ~(alignment - 1);
+	VkDeviceSize offset = head.fetch_add(allocationSize);
+
+	if (offset + allocationSize > frameSize)
+	{
+		gLogManager->AddMessage("ERROR: Uniform ring is full, raise UNIFORM_RING_FRAME_SIZE!");
+		THROW_ERROR();
+	}
+
+	memcpy(memory.mappedData + frameStart + offset, dataPtr, dataSize);
+
+	return (uint32_t)(frameStart + offset);
+}
+
+uint32_t UniformRing::AllocateSlot(size_t dataSize)
+{
+	VkDeviceSize allocationSize = ((VkDeviceSize)dataSize + alignment - 1) & ~(alignment - 1);
+
+	for (unsigned int i = 0; i < freeSlots.size(); i++)
+	{
+		if (freeSlots[i].size == allocationSize)
+		{
+			uint32_t slot = freeSlots[i].offset;
+			freeSlots[i] = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+	}
+
+	if (slotHead + allocationSize > slotSize)
+		return UNIFORM_RING_NO_SLOT;
+
+	uint32_t slot = (uint32_t)slotHead;
+	slotHead += allocationSize;
+
+	return slot;
+}
+
+void UniformRing::FreeSlot(uint32_t slot, size_t dataSize)
+{
+	if (slot == UNIFORM_RING_NO_SLOT)
+		return;
+
+	RingSlot freeSlot;
+	freeSlot.offset = slot;
+	freeSlot.size = ((VkDeviceSize)dataSize + alignment - 1) & ~(alignment - 1);
+	freeSlots.push_back(freeSlot);
+}
+
+uint32_t UniformRing::WriteSlot(uint32_t slot, const void * dataPtr, size_t dataSize)
+{
+	// Same place in every frame region, so the offset handed back only depends on the frame slot
+	memcpy(memory.mappedData + frameStart + slot, dataPtr, dataSize);
+
+	return (uint32_t)(frameStart + slot);
+}
+
+VkDescriptorBufferInfo UniformRing::GetBufferInfo(VkDeviceSize range)
+{
+	// Offset comes from the dynamic offset at bind time, the range is the size of one slice
+	VkDescriptorBufferInfo bufferInfo;
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = range;
+
+	return bufferInfo;
+}
+
+VkBuffer UniformRing::GetBuffer()
+{
+	return buffer;
+}
+
+VkDeviceSize UniformRing::GetUsage()
+{
+	return head;
+}
+
+void UniformRing::Rewind(VkDeviceSize usage)
+{
+	// Only for data no submitted command buffer points at, like the recording benchmark's
+	head = usage;
+}
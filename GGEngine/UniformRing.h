@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "VulkanDevice.h"
+
+// Transient uniform data one frame slot can hold, overflowing it is an error
+#define UNIFORM_RING_FRAME_SIZE (4 * 1024 * 1024)
+
+// Start of every frame region, kept for slots that stay at the same offset from frame to frame
+#define UNIFORM_RING_SLOT_SIZE (256 * 1024)
+
+// AllocateSlot() found no room, the caller writes its data to the transient part instead
+#define UNIFORM_RING_NO_SLOT UINT32_MAX
+
+// Persistently mapped buffer split into one region per frame slot, draws bind slices of it with dynamic offsets
+class UniformRing
+{
+	private:
+		VkBuffer buffer;
+		VulkanAllocation memory;
+		VkDeviceSize frameSize;
+		VkDeviceSize alignment;
+		VkDeviceSize frameStart;
+		std::atomic<VkDeviceSize> head;
+
+		// Slots are handed out and given back on the main thread, freed ones are reused by data of the same size
+		struct RingSlot
+		{
+			uint32_t offset;
+			VkDeviceSize size;
+		};
+		VkDeviceSize slotSize;
+		VkDeviceSize slotHead;
+		std::vector<RingSlot> freeSlots;
+	public:
+		UniformRing();
+		~UniformRing();
+
+		bool Init(VulkanDevice * vulkanDevice, VkDeviceSize frameSize, uint32_t frameCount);
+		void Unload(VulkanDevice * vulkanDevice);
+		void BeginFrame(uint32_t frameIndex);
+		uint32_t Allocate(const void * dataPtr, size_t dataSize);
+		uint32_t AllocateSlot(size_t dataSize);
+		void FreeSlot(uint32_t slot, size_t dataSize);
+		uint32_t WriteSlot(uint32_t slot, const void * dataPtr, size_t dataSize);
+		VkDescriptorBufferInfo GetBufferInfo(VkDeviceSize range);
+		VkBuffer GetBuffer();
+		VkDeviceSize GetUsage();
+		void Rewind(VkDeviceSize usage);
+};
\ No newline at end of file
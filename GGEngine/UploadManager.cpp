@@ -0,0 +1,529 @@
+#include "UploadManager.h"
+#include "LogManager.h"
+#include "StdInc.h"
+
+extern LogManager * gLogManager;
+
+UploadManager::UploadManager()
+{
+	vulkanDevice = NULL;
+	transferCommandPool = NULL;
+	graphicsCommandPool = NULL;
+	transferTimeline = VK_NULL_HANDLE;
+	uploadTimeline = VK_NULL_HANDLE;
+	lastTimelineValue = 0;
+	stagingRing.buffer = VK_NULL_HANDLE;
+	stagingHead = 0;
+	stagingUsed = 0;
+	stagingAlignment = 16;
+	currentBatch = NULL;
+	uploadCount = 0;
+	batchCount = 0;
+	uploadedBytes = 0;
+}
+
+UploadManager::~UploadManager()
+{
+	vulkanDevice = NULL;
+	currentBatch = NULL;
+}
+
+bool UploadManager::Init(VulkanDevice * vulkanDevice)
+{
+	VkResult result;
+
+	this->vulkanDevice = vulkanDevice;
+
+	transferCommandPool = new VulkanCommandPool();
+	if (!transferCommandPool->Init(vulkanDevice, true))
+	{
+		gLogManager->AddMessage("ERROR: Failed to create the upload command pool!");
+		return false;
+	}
+
+	// Ownership is only acquired on the graphics queue when the copies ran on another one
+	if (vulkanDevice->HasTransferQueue())
+	{
+		graphicsCommandPool = new VulkanCommandPool();
+		if (!graphicsCommandPool->Init(vulkanDevice))
+		{
+			gLogManager->AddMessage("ERROR: Failed to create the upload acquire command pool!");
+			return false;
+		}
+	}
+
+	// Both timelines count batches, the upload timeline reaches a value once its resources are usable
+	VkSemaphoreTypeCreateInfo semaphoreTypeCI{};
+	semaphoreTypeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeCI.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCI{};
+	semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCI.pNext = &semaphoreTypeCI;
+
+	result = vkCreateSemaphore(vulkanDevice->GetDevice(), &semaphoreCI, VK_NULL_HANDLE, &transferTimeline);
+	if (result != VK_SUCCESS)
+		return false;
+
+	result = vkCreateSemaphore(vulkanDevice->GetDevice(), &semaphoreCI, VK_NULL_HANDLE, &uploadTimeline);
+	if (result != VK_SUCCESS)
+		return false;
+
+	// Copies start at offsets the device prefers, 16 covers every texel block size
+	stagingAlignment = vulkanDevice->GetGPUProperties().limits.optimalBufferCopyOffsetAlignment;
+	if (stagingAlignment < 16)
+		stagingAlignment = 16;
+
+	VkBufferCreateInfo bufferCI{};
+	bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferCI.size = UPLOAD_STAGING_SIZE;
+	bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	result = vkCreateBuffer(vulkanDevice->GetDevice(), &bufferCI, VK_NULL_HANDLE, &stagingRing.buffer);
+	if (result != VK_SUCCESS)
+		return false;
+
+	// Coherent and mapped by the allocator, filling the ring is a plain copy
+	if (!vulkanDevice->GetMemoryAllocator()->AllocateBufferMemory(stagingRing.buffer,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingRing.memory))
+		return false;
+
+	return true;
+}
+
+void UploadManager::Unload(VulkanDevice * vulkanDevice)
+{
+	WaitIdle();
+
+	for (unsigned int i = 0; i < freeBatches.size(); i++)
+	{
+		SAFE_UNLOAD(freeBatches[i]->transferCmdBuffer, vulkanDevice, transferCommandPool);
+		SAFE_UNLOAD(freeBatches[i]->acquireCmdBuffer, vulkanDevice, graphicsCommandPool);
+		SAFE_DELETE(freeBatches[i]);
+	}
+	freeBatches.clear();
+
+	vulkanDevice->GetMemoryAllocator()->Free(&stagingRing.memory);
+	vkDestroyBuffer(vulkanDevice->GetDevice(), stagingRing.buffer, VK_NULL_HANDLE);
+
+	vkDestroySemaphore(vulkanDevice->GetDevice(), uploadTimeline, VK_NULL_HANDLE);
+	vkDestroySemaphore(vulkanDevice->GetDevice(), transferTimeline, VK_NULL_HANDLE);
+
+	SAFE_UNLOAD(graphicsCommandPool, vulkanDevice);
+	SAFE_UNLOAD(transferCommandPool, vulkanDevice);
+}
+
+bool UploadManager::UploadBuffer(VkBuffer buffer, VkBufferUsageFlags usage, const void * dataPtr, VkDeviceSize dataSize)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	uint8_t * stagingData = AllocateStaging(dataSize, &stagingBuffer, &stagingOffset);
+	if (stagingData == NULL)
+		return false;
+
+	memcpy(stagingData, dataPtr, (size_t)dataSize);
+
+	UploadBatch * batch = GetBatch();
+
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = stagingOffset;
+	copyRegion.size = dataSize;
+	vkCmdCopyBuffer(batch->transferCmdBuffer->GetCommandBuffer(), stagingBuffer, buffer, 1, &copyRegion);
+
+	// Recorded when the batch is submitted, together with the rest of the batch's barriers
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = GetBufferAccess(usage);
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	if (vulkanDevice->HasTransferQueue())
+	{
+		barrier.srcQueueFamilyIndex = vulkanDevice->GetTransferQueueFamilyIndex();
+		barrier.dstQueueFamilyIndex = vulkanDevice->GetGraphicsQueueFamilyIndex();
+	}
+
+	batch->bufferBarriers.push_back(barrier);
+
+	uploadCount++;
+	uploadedBytes += dataSize;
+
+	return true;
+}
+
+bool UploadManager::UploadImage(VkImage image, const VkImageSubresourceRange & range, const std::vector<ImageUploadRegion> & regions)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Every piece starts aligned, so each copy gets an offset the device accepts
+	VkDeviceSize dataSize = 0;
+	std::vector<VkDeviceSize> pieceOffsets(regions.size());
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		pieceOffsets[i] = dataSize;
+		dataSize += ((regions[i].dataSize + stagingAlignment - 1) / stagingAlignment) * stagingAlignment;
+	}
+
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	uint8_t * stagingData = AllocateStaging(dataSize, &stagingBuffer, &stagingOffset);
+	if (stagingData == NULL)
+		return false;
+
+	std::vector<VkBufferImageCopy> copyRegions(regions.size());
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		memcpy(stagingData + pieceOffsets[i], regions[i].dataPtr, (size_t)regions[i].dataSize);
+
+		copyRegions[i] = regions[i].copyRegion;
+		copyRegions[i].bufferOffset = stagingOffset + pieceOffsets[i];
+	}
+
+	UploadBatch * batch = GetBatch();
+	VkCommandBuffer cmdBuffer = batch->transferCmdBuffer->GetCommandBuffer();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+	vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		(uint32_t)copyRegions.size(), copyRegions.data());
+
+	// The transition to shader reads is recorded when the batch is submitted
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	if (vulkanDevice->HasTransferQueue())
+	{
+		barrier.srcQueueFamilyIndex = vulkanDevice->GetTransferQueueFamilyIndex();
+		barrier.dstQueueFamilyIndex = vulkanDevice->GetGraphicsQueueFamilyIndex();
+	}
+
+	batch->imageBarriers.push_back(barrier);
+
+	uploadCount++;
+	uploadedBytes += dataSize;
+
+	return true;
+}
+
+void UploadManager::Flush()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (currentBatch != NULL)
+		SubmitBatch();
+
+	RetireBatches(false);
+}
+
+void UploadManager::WaitIdle()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (currentBatch != NULL)
+		SubmitBatch();
+
+	while (!pendingBatches.empty())
+		RetireBatches(true);
+}
+
+void UploadManager::LogStatistics()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	char msg[128];
+	sprintf(msg, "Uploads: %u resources in %u batches, %.2f MB", uploadCount, batchCount, uploadedBytes / (1024.0f * 1024.0f));
+	gLogManager->AddMessage(msg);
+}
+
+UploadManager::UploadBatch * UploadManager::GetBatch()
+{
+	if (currentBatch != NULL)
+		return currentBatch;
+
+	if (!freeBatches.empty())
+	{
+		currentBatch = freeBatches.back();
+		freeBatches.pop_back();
+	}
+	else
+	{
+		currentBatch = new UploadBatch();
+		currentBatch->transferCmdBuffer = new VulkanCommandBuffer();
+		currentBatch->acquireCmdBuffer = NULL;
+
+		if (!currentBatch->transferCmdBuffer->Init(vulkanDevice, transferCommandPool, true))
+		{
+			gLogManager->AddMessage("ERROR: Failed to create an upload command buffer!");
+			THROW_ERROR();
+		}
+
+		if (graphicsCommandPool != NULL)
+		{
+			currentBatch->acquireCmdBuffer = new VulkanCommandBuffer();
+			if (!currentBatch->acquireCmdBuffer->Init(vulkanDevice, graphicsCommandPool, true))
+			{
+				gLogManager->AddMessage("ERROR: Failed to create an upload acquire command buffer!");
+				THROW_ERROR();
+			}
+		}
+	}
+
+	currentBatch->stagingBytes = 0;
+	currentBatch->timelineValue = 0;
+	currentBatch->transferCmdBuffer->BeginRecording();
+
+	return currentBatch;
+}
+
+uint8_t * UploadManager::AllocateStaging(VkDeviceSize size, VkBuffer * buffer, VkDeviceSize * offset)
+{
+	VkDeviceSize alignedSize = ((size + stagingAlignment - 1) / stagingAlignment) * stagingAlignment;
+
+	// Too big to share the ring, staged on its own and freed with its batch
+	if (alignedSize > UPLOAD_STAGING_SIZE / 2)
+	{
+		StagingBuffer staging;
+
+		VkBufferCreateInfo bufferCI{};
+		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCI.size = size;
+		bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(vulkanDevice->GetDevice(), &bufferCI, VK_NULL_HANDLE, &staging.buffer) != VK_SUCCESS)
+			return NULL;
+
+		if (!vulkanDevice->GetMemoryAllocator()->AllocateBufferMemory(staging.buffer,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging.memory))
+		{
+			vkDestroyBuffer(vulkanDevice->GetDevice(), staging.buffer, VK_NULL_HANDLE);
+			return NULL;
+		}
+
+		GetBatch()->dedicatedStaging.push_back(staging);
+
+		*buffer = staging.buffer;
+		*offset = 0;
+		return staging.memory.mappedData;
+	}
+
+	// Batches retire in order, so the used bytes always sit between the oldest batch and the head
+	bool wrap;
+	VkDeviceSize padding;
+	while (true)
+	{
+		wrap = (stagingHead + alignedSize > UPLOAD_STAGING_SIZE);
+		padding = (wrap ? UPLOAD_STAGING_SIZE - stagingHead : 0);
+
+		if (stagingUsed + padding + alignedSize <= UPLOAD_STAGING_SIZE)
+			break;
+
+		// Full, submit what was recorded and wait for the oldest batch to free its part
+		if (currentBatch != NULL)
+			SubmitBatch();
+
+		if (pendingBatches.empty())
+		{
+			gLogManager->AddMessage("ERROR: Upload staging ring is full with nothing in flight!");
+			return NULL;
+		}
+
+		RetireBatches(true);
+	}
+
+	if (wrap)
+		stagingHead = 0;
+
+	*buffer = stagingRing.buffer;
+	*offset = stagingHead;
+
+	// The skipped tail of the ring is freed together with the data after it
+	stagingHead += alignedSize;
+	stagingUsed += padding + alignedSize;
+	GetBatch()->stagingBytes += padding + alignedSize;
+
+	return stagingRing.memory.mappedData + *offset;
+}
+
+void UploadManager::SubmitBatch()
+{
+	UploadBatch * batch = currentBatch;
+	currentBatch = NULL;
+
+	batch->timelineValue = ++lastTimelineValue;
+
+	VkCommandBuffer transferCmdBuffer = batch->transferCmdBuffer->GetCommandBuffer();
+
+	if (vulkanDevice->HasTransferQueue())
+	{
+		// Release on the transfer queue, the access masks of the acquiring side are ignored here
+		std::vector<VkBufferMemoryBarrier> bufferBarriers = batch->bufferBarriers;
+		std::vector<VkImageMemoryBarrier> imageBarriers = batch->imageBarriers;
+		for (unsigned int i = 0; i < bufferBarriers.size(); i++)
+			bufferBarriers[i].dstAccessMask = 0;
+		for (unsigned int i = 0; i < imageBarriers.size(); i++)
+			imageBarriers[i].dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(transferCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL,
+			(uint32_t)bufferBarriers.size(), bufferBarriers.data(), (uint32_t)imageBarriers.size(), imageBarriers.data());
+		batch->transferCmdBuffer->EndRecording();
+
+		// Acquire on the graphics queue, after the semaphore wait so the release has happened
+		for (unsigned int i = 0; i < batch->bufferBarriers.size(); i++)
+			batch->bufferBarriers[i].srcAccessMask = 0;
+		for (unsigned int i = 0; i < batch->imageBarriers.size(); i++)
+			batch->imageBarriers[i].srcAccessMask = 0;
+
+		VkCommandBuffer acquireCmdBuffer = batch->acquireCmdBuffer->GetCommandBuffer();
+		batch->acquireCmdBuffer->BeginRecording();
+		vkCmdPipelineBarrier(acquireCmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL,
+			(uint32_t)batch->bufferBarriers.size(), batch->bufferBarriers.data(), (uint32_t)batch->imageBarriers.size(), batch->imageBarriers.data());
+		batch->acquireCmdBuffer->EndRecording();
+
+		VkTimelineSemaphoreSubmitInfo transferTimelineInfo{};
+		transferTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		transferTimelineInfo.signalSemaphoreValueCount = 1;
+		transferTimelineInfo.pSignalSemaphoreValues = &batch->timelineValue;
+
+		VkSubmitInfo transferSubmitInfo{};
+		transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		transferSubmitInfo.pNext = &transferTimelineInfo;
+		transferSubmitInfo.commandBufferCount = 1;
+		transferSubmitInfo.pCommandBuffers = &transferCmdBuffer;
+		transferSubmitInfo.signalSemaphoreCount = 1;
+		transferSubmitInfo.pSignalSemaphores = &transferTimeline;
+		vulkanDevice->Submit(vulkanDevice->GetTransferQueue(), 1, &transferSubmitInfo, VK_NULL_HANDLE);
+
+		VkTimelineSemaphoreSubmitInfo acquireTimelineInfo{};
+		acquireTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		acquireTimelineInfo.waitSemaphoreValueCount = 1;
+		acquireTimelineInfo.pWaitSemaphoreValues = &batch->timelineValue;
+		acquireTimelineInfo.signalSemaphoreValueCount = 1;
+		acquireTimelineInfo.pSignalSemaphoreValues = &batch->timelineValue;
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo acquireSubmitInfo{};
+		acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireSubmitInfo.pNext = &acquireTimelineInfo;
+		acquireSubmitInfo.waitSemaphoreCount = 1;
+		acquireSubmitInfo.pWaitSemaphores = &transferTimeline;
+		acquireSubmitInfo.pWaitDstStageMask = &waitStage;
+		acquireSubmitInfo.commandBufferCount = 1;
+		acquireSubmitInfo.pCommandBuffers = &acquireCmdBuffer;
+		acquireSubmitInfo.signalSemaphoreCount = 1;
+		acquireSubmitInfo.pSignalSemaphores = &uploadTimeline;
+		vulkanDevice->Submit(vulkanDevice->GetQueue(), 1, &acquireSubmitInfo, VK_NULL_HANDLE);
+	}
+	else
+	{
+		// Same queue, one barrier makes the whole batch visible to the frames submitted after it
+		vkCmdPipelineBarrier(transferCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL,
+			(uint32_t)batch->bufferBarriers.size(), batch->bufferBarriers.data(), (uint32_t)batch->imageBarriers.size(), batch->imageBarriers.data());
+		batch->transferCmdBuffer->EndRecording();
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &batch->timelineValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &transferCmdBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &uploadTimeline;
+		vulkanDevice->Submit(vulkanDevice->GetQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+	}
+
+	pendingBatches.push_back(batch);
+	batchCount++;
+}
+
+void UploadManager::RetireBatches(bool waitForOldest)
+{
+	VkDevice device = vulkanDevice->GetDevice();
+
+	uint64_t completedValue;
+	vkGetSemaphoreCounterValue(device, uploadTimeline, &completedValue);
+
+	while (!pendingBatches.empty())
+	{
+		UploadBatch * batch = pendingBatches.front();
+
+		if (completedValue < batch->timelineValue)
+		{
+			if (!waitForOldest)
+				break;
+
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &uploadTimeline;
+			waitInfo.pValues = &batch->timelineValue;
+			vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+
+			vkGetSemaphoreCounterValue(device, uploadTimeline, &completedValue);
+			waitForOldest = false;
+		}
+
+		stagingUsed -= batch->stagingBytes;
+
+		for (unsigned int i = 0; i < batch->dedicatedStaging.size(); i++)
+		{
+			vulkanDevice->GetMemoryAllocator()->Free(&batch->dedicatedStaging[i].memory);
+			vkDestroyBuffer(device, batch->dedicatedStaging[i].buffer, VK_NULL_HANDLE);
+		}
+
+		batch->dedicatedStaging.clear();
+		batch->bufferBarriers.clear();
+		batch->imageBarriers.clear();
+
+		pendingBatches.pop_front();
+		freeBatches.push_back(batch);
+	}
+
+	// Nothing left in the ring, the next upload starts at the front again
+	if (stagingUsed == 0)
+		stagingHead = 0;
+}
+
+VkAccessFlags UploadManager::GetBufferAccess(VkBufferUsageFlags usage)
+{
+	VkAccessFlags access = 0;
+
+	if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+		access |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+		access |= VK_ACCESS_INDEX_READ_BIT;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		access |= VK_ACCESS_UNIFORM_READ_BIT;
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		access |= VK_ACCESS_SHADER_READ_BIT;
+	if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)
+		access |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	if (access == 0)
+		access = VK_ACCESS_MEMORY_READ_BIT;
+
+	return access;
+}
\ No newline at end of file
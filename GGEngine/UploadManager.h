@@ -0,0 +1,79 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <vector>
+
+#include "VulkanCommandBuffer.h"
+
+// Staging memory shared by every upload in flight, bigger uploads get a staging buffer of their own
+#define UPLOAD_STAGING_SIZE (32 * 1024 * 1024)
+
+// One piece of image data and where it goes, the buffer offset of the copy is filled in when it is staged
+struct ImageUploadRegion
+{
+	const void * dataPtr;
+	VkDeviceSize dataSize;
+	VkBufferImageCopy copyRegion;
+};
+
+// Packs uploads into a staging ring and submits their copies in batches on the transfer queue
+class UploadManager
+{
+	private:
+		struct StagingBuffer
+		{
+			VkBuffer buffer;
+			VulkanAllocation memory;
+		};
+
+		// Copies recorded together and submitted as one timeline value
+		struct UploadBatch
+		{
+			VulkanCommandBuffer * transferCmdBuffer;
+			VulkanCommandBuffer * acquireCmdBuffer;
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+			std::vector<StagingBuffer> dedicatedStaging;
+			VkDeviceSize stagingBytes;
+			uint64_t timelineValue;
+		};
+
+		VulkanDevice * vulkanDevice;
+		VulkanCommandPool * transferCommandPool;
+		VulkanCommandPool * graphicsCommandPool;
+		VkSemaphore transferTimeline;
+		VkSemaphore uploadTimeline;
+		uint64_t lastTimelineValue;
+
+		StagingBuffer stagingRing;
+		VkDeviceSize stagingHead;
+		VkDeviceSize stagingUsed;
+		VkDeviceSize stagingAlignment;
+
+		UploadBatch * currentBatch;
+		std::deque<UploadBatch*> pendingBatches;
+		std::vector<UploadBatch*> freeBatches;
+		std::mutex mutex;
+
+		unsigned int uploadCount;
+		unsigned int batchCount;
+		VkDeviceSize uploadedBytes;
+	private:
+		UploadBatch * GetBatch();
+		uint8_t * AllocateStaging(VkDeviceSize size, VkBuffer * buffer, VkDeviceSize * offset);
+		void SubmitBatch();
+		void RetireBatches(bool waitForOldest);
+		VkAccessFlags GetBufferAccess(VkBufferUsageFlags usage);
+	public:
+		UploadManager();
+		~UploadManager();
+
+		bool Init(VulkanDevice * vulkanDevice);
+		void Unload(VulkanDevice * vulkanDevice);
+		bool UploadBuffer(VkBuffer buffer, VkBufferUsageFlags usage, const void * dataPtr, VkDeviceSize dataSize);
+		bool UploadImage(VkImage image, const VkImageSubresourceRange & range, const std::vector<ImageUploadRegion> & regions);
+		void Flush();
+		void WaitIdle();
+		void LogStatistics();
+};
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include <filesystem>
+
+#include "VirtualFileSystem.h"
+#include "LogManager.h"
+#include "Timer.h"
+#include "StdInc.h"
+
+namespace fs = std::experimental::filesystem;
+
+extern LogManager * gLogManager;
+extern Timer * gTimer;
+extern VirtualFileSystem * gVirtualFileSystem;
+
+PakArchive::PakArchive()
+{
+	entries = NULL;
+	names = NULL;
+	entryCount = 0;
+	namesSize = 0;
+}
+
+PakArchive::~PakArchive()
+{
+	Close();
+}
+
+bool PakArchive::Open(std::string filename)
+{
+	if (!file.Open(filename))
+		return false;
+
+	this->filename = filename;
+
+	const uint8_t * data = file.GetData();
+	size_t size = file.GetSize();
+
+	PakHeader header;
+	if (size < sizeof(PakHeader))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(PakHeader));
+
+	if (header.magic != PAK_MAGIC || header.version != PAK_VERSION)
+	{
+		Close();
+		return false;
+	}
+
+	// The table and the names have to fit in the file, every entry has to fit after them
+	size_t tableEnd = sizeof(PakHeader) + (size_t)header.entryCount * sizeof(PakEntry) + header.namesSize;
+	if (tableEnd > size)
+	{
+		Close();
+		return false;
+	}
+
+	entries = (const PakEntry*)(data + sizeof(PakHeader));
+	names = (const char*)(entries + header.entryCount);
+	entryCount = header.entryCount;
+	namesSize = header.namesSize;
+
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		if (entries[i].offset < tableEnd || entries[i].offset > size || entries[i].storedSize > size - entries[i].offset ||
+			entries[i].nameOffset >= namesSize || (i > 0 && entries[i].nameHash < entries[i - 1].nameHash))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	if (namesSize == 0 || names[namesSize - 1] != '\0')
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void PakArchive::Close()
+{
+	file.Close();
+	entries = NULL;
+	names = NULL;
+	entryCount = 0;
+	namesSize = 0;
+}
+
+const PakEntry * PakArchive::Find(const char * normalizedName, uint64_t nameHash)
+{
+	// Binary search for the first entry with the hash, then the names of the ones sharing it
+	uint32_t first = 0;
+	uint32_t last = entryCount;
+	while (first < last)
+	{
+		uint32_t middle = first + (last - first) / 2;
+		if (entries[middle].nameHash < nameHash)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	for (uint32_t i = first; i < entryCount && entries[i].nameHash == nameHash; i++)
+		if (strcmp(names + entries[i].nameOffset, normalizedName) == 0)
+			return &entries[i];
+
+	return NULL;
+}
+
+const uint8_t * PakArchive::GetEntryData(const PakEntry * entry)
+{
+	return file.GetData() + entry->offset;
+}
+
+uint32_t PakArchive::GetEntryCount()
+{
+	return entryCount;
+}
+
+const char * PakArchive::GetEntryName(uint32_t entryId)
+{
+	return names + entries[entryId].nameOffset;
+}
+
+std::string PakArchive::GetFilename()
+{
+	return filename;
+}
+
+VirtualFile::VirtualFile()
+{
+	data = NULL;
+	size = 0;
+	position = 0;
+}
+
+VirtualFile::~VirtualFile()
+{
+	Close();
+}
+
+bool VirtualFile::Open(std::string filename)
+{
+	Close();
+
+	if (gVirtualFileSystem)
+		return gVirtualFileSystem->Open(filename, this);
+
+	if (!looseFile.Open(filename))
+		return false;
+
+	data = looseFile.GetData();
+	size = looseFile.GetSize();
+
+	return true;
+}
+
+void VirtualFile::Close()
+{
+	looseFile.Close();
+	decompressed.clear();
+	decompressed.shrink_to_fit();
+	data = NULL;
+	size = 0;
+	position = 0;
+}
+
+const uint8_t * VirtualFile::GetData()
+{
+	return data;
+}
+
+size_t VirtualFile::GetSize()
+{
+	return size;
+}
+
+size_t VirtualFile::Read(void * dest, size_t size)
+{
+	// Like fread, a short read leaves the rest of dest untouched
+	size_t readSize = this->size - position;
+	if (size < readSize)
+		readSize = size;
+
+	memcpy(dest, data + position, readSize);
+	position += readSize;
+
+	return readSize;
+}
+
+const uint8_t * VirtualFile::ReadInPlace(size_t size)
+{
+	// Skips over the data instead of copying it, NULL when the file ends before it
+	if (size > this->size - position)
+		return NULL;
+
+	const uint8_t * dataPtr = data + position;
+	position += size;
+
+	return dataPtr;
+}
+
+std::string VirtualFile::GetText()
+{
+	return std::string((const char*)data, size);
+}
+
+VirtualFileSystem::VirtualFileSystem()
+{
+}
+
+VirtualFileSystem::~VirtualFileSystem()
+{
+	Unload();
+}
+
+bool VirtualFileSystem::Mount(std::string archiveFilename)
+{
+	PakArchive * archive = new PakArchive();
+	if (!archive->Open(archiveFilename))
+	{
+		gLogManager->AddMessage("ERROR: Failed to mount archive! (" + archiveFilename + ")");
+		SAFE_DELETE(archive);
+		return false;
+	}
+
+	// Archives mounted later are searched first, so a patch archive overrides the base one
+	archives.insert(archives.begin(), archive);
+
+	char msg[64];
+	sprintf(msg, " (%u files)", archive->GetEntryCount());
+	gLogManager->AddMessage("SUCCESS: Mounted " + archiveFilename + msg);
+
+	return true;
+}
+
+void VirtualFileSystem::Unload()
+{
+	for (unsigned int i = 0; i < archives.size(); i++)
+		SAFE_DELETE(archives[i]);
+	archives.clear();
+}
+
+bool VirtualFileSystem::OpenPacked(const std::string & filename, VirtualFile * file)
+{
+	char normalizedName[260];
+	NormalizePakName(filename.c_str(), normalizedName, sizeof(normalizedName));
+	uint64_t nameHash = HashPakName(normalizedName);
+
+	for (unsigned int i = 0; i < archives.size(); i++)
+	{
+		const PakEntry * entry = archives[i]->Find(normalizedName, nameHash);
+		if (entry == NULL)
+			continue;
+
+		const uint8_t * entryData = archives[i]->GetEntryData(entry);
+
+		// Stored entries are used in place, compressed ones are decoded into memory of their own
+		if ((entry->flags & PAK_ENTRY_COMPRESSED) == 0)
+		{
+			file->data = entryData;
+			file->size = (size_t)entry->size;
+			return true;
+		}
+
+		file->decompressed.resize((size_t)entry->size);
+		if (!DecompressLz4Block(entryData, (size_t)entry->storedSize, file->decompressed.data(), file->decompressed.size()))
+		{
+			gLogManager->AddMessage("ERROR: Archive entry is corrupted! (" + filename + ")");
+			file->Close();
+			return false;
+		}
+
+		file->data = file->decompressed.data();
+		file->size = file->decompressed.size();
+		return true;
+	}
+
+	return false;
+}
+
+bool VirtualFileSystem::Open(std::string filename, VirtualFile * file)
+{
+	if (OpenPacked(filename, file))
+		return true;
+
+	// Not packed, development builds run from the loose data directory
+	if (!file->looseFile.Open(filename))
+		return false;
+
+	file->data = file->looseFile.GetData();
+	file->size = file->looseFile.GetSize();
+
+	return true;
+}
+
+bool VirtualFileSystem::Exists(std::string filename)
+{
+	char normalizedName[260];
+	NormalizePakName(filename.c_str(), normalizedName, sizeof(normalizedName));
+	uint64_t nameHash = HashPakName(normalizedName);
+
+	for (unsigned int i = 0; i < archives.size(); i++)
+		if (archives[i]->Find(normalizedName, nameHash))
+			return true;
+
+	return fs::exists(filename);
+}
+
+size_t VirtualFileSystem::GetMountedCount()
+{
+	return archives.size();
+}
+
+// Touches every page of the file, so a mapped file is actually read
+static size_t TouchFile(const uint8_t * data, size_t size)
+{
+	size_t sum = 0;
+	for (size_t offset = 0; offset < size; offset += PAK_ALIGNMENT)
+		sum += data[offset];
+
+	return sum;
+}
+
+void VirtualFileSystem::RunStartupBenchmark(std::string dataDir)
+{
+	// Runs before anything is loaded, the first pass reads from disk when the file cache was cold at launch
+	// (first run after a reboot), the second one shows the same reads from the warm cache
+	std::vector<std::string> looseFiles;
+	for (auto & entry : fs::recursive_directory_iterator(dataDir))
+		if (fs::is_regular_file(entry.path()))
+			looseFiles.push_back(entry.path().string());
+
+	std::vector<std::string> packedFiles;
+	for (unsigned int i = 0; i < archives.size(); i++)
+		for (uint32_t j = 0; j < archives[i]->GetEntryCount(); j++)
+			packedFiles.push_back(archives[i]->GetEntryName(j));
+
+	char msg[192];
+	size_t touched = 0;
+
+	if (!packedFiles.empty())
+	{
+		float packedTimes[2];
+		size_t packedBytes = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			packedBytes = 0;
+			gTimer->BenchmarkCodeStart();
+			for (unsigned int i = 0; i < packedFiles.size(); i++)
+			{
+				VirtualFile file;
+				if (!OpenPacked(packedFiles[i], &file))
+					continue;
+
+				touched += TouchFile(file.GetData(), file.GetSize());
+				packedBytes += file.GetSize();
+			}
+			gTimer->BenchmarkCodeEnd();
+			packedTimes[pass] = gTimer->GetBenchmarkResult();
+		}
+
+		sprintf(msg, "STARTUP BENCHMARK: PACKED: %zu FILES, %.2f MB: COLD %f ms, WARM %f ms", packedFiles.size(),
+			packedBytes / (1024.0f * 1024.0f), packedTimes[0], packedTimes[1]);
+		gLogManager->AddMessage(msg);
+	}
+
+	if (!looseFiles.empty())
+	{
+		float looseTimes[2];
+		size_t looseBytes = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			looseBytes = 0;
+			gTimer->BenchmarkCodeStart();
+			for (unsigned int i = 0; i < looseFiles.size(); i++)
+			{
+				MappedFile file;
+				if (!file.Open(looseFiles[i]))
+					continue;
+
+				touched += TouchFile(file.GetData(), file.GetSize());
+				looseBytes += file.GetSize();
+			}
+			gTimer->BenchmarkCodeEnd();
+			looseTimes[pass] = gTimer->GetBenchmarkResult();
+		}
+
+		sprintf(msg, "STARTUP BENCHMARK: LOOSE: %zu FILES, %.2f MB: COLD %f ms, WARM %f ms", looseFiles.size(),
+			looseBytes / (1024.0f * 1024.0f), looseTimes[0], looseTimes[1]);
+		gLogManager->AddMessage(msg);
+	}
+
+	// Keeps the reads from being optimized out
+	sprintf(msg, "STARTUP BENCHMARK: CHECKSUM %zu", touched);
+	gLogManager->AddMessage(msg);
+}
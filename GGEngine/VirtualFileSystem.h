@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "MappedFile.h"
+#include "PakFormat.h"
+
+// Mounted .pak, the whole archive stays mapped and stored entries are handed out straight from the mapping
+class PakArchive
+{
+	private:
+		MappedFile file;
+		std::string filename;
+		const PakEntry * entries;
+		const char * names;
+		uint32_t entryCount;
+		uint32_t namesSize;
+	public:
+		PakArchive();
+		~PakArchive();
+
+		bool Open(std::string filename);
+		void Close();
+		const PakEntry * Find(const char * normalizedName, uint64_t nameHash);
+		const uint8_t * GetEntryData(const PakEntry * entry);
+		uint32_t GetEntryCount();
+		const char * GetEntryName(uint32_t entryId);
+		std::string GetFilename();
+};
+
+// Read only view of an asset from a mounted archive or a loose file, parsed in place or read in order like a FILE
+class VirtualFile
+{
+	private:
+		MappedFile looseFile;
+		std::vector<uint8_t> decompressed;
+		const uint8_t * data;
+		size_t size;
+		size_t position;
+	public:
+		VirtualFile();
+		~VirtualFile();
+
+		bool Open(std::string filename);
+		void Close();
+		const uint8_t * GetData();
+		size_t GetSize();
+		size_t Read(void * dest, size_t size);
+		const uint8_t * ReadInPlace(size_t size);
+		std::string GetText();
+
+		friend class VirtualFileSystem;
+};
+
+// Looks assets up in the mounted archives, files that aren't packed are read from the data directory as loose files
+class VirtualFileSystem
+{
+	private:
+		std::vector<PakArchive*> archives;
+	private:
+		bool OpenPacked(const std::string & filename, VirtualFile * file);
+	public:
+		VirtualFileSystem();
+		~VirtualFileSystem();
+
+		bool Mount(std::string archiveFilename);
+		void Unload();
+		bool Open(std::string filename, VirtualFile * file);
+		bool Exists(std::string filename);
+		size_t GetMountedCount();
+		void RunStartupBenchmark(std::string dataDir);
+};
@@ -1,22 +1,31 @@
 #include "VulkanBuffer.h"
 #include "LogManager.h"
+#include "UploadManager.h"
 
 extern LogManager * gLogManager;
+extern UploadManager * gUploadManager;
 
 VulkanBuffer::VulkanBuffer()
 {
 	buffer = VK_NULL_HANDLE;
-	memory = VK_NULL_HANDLE;
+	stagedBuffer = false;
+	usage = 0;
+	size = 0;
+	restoreData = NULL;
+	lastUsedFrame = 0;
+	residencyVersion = 0;
+	handle = INVALID_RESOURCE_HANDLE;
 }
 
 bool VulkanBuffer::Init(VulkanDevice * vulkanDevice, VkBufferUsageFlags usage, const void * dataPtr,
-	VkDeviceSize dataSize, bool useStaging, VulkanCommandBuffer * cmdBuffer)
+	VkDeviceSize dataSize, bool useStaging, bool evictable, bool persistentData)
 {
 	VkResult result;
-	uint8_t *pData;
-	VkMemoryAllocateInfo allocInfo{};
+	VulkanMemoryAllocator * allocator = vulkanDevice->GetMemoryAllocator();
 
 	stagedBuffer = useStaging;
+	this->usage = usage;
+	size = dataSize;
 
 	if (useStaging == false)
 	{
@@ -31,28 +40,11 @@ bool VulkanBuffer::Init(VulkanDevice * vulkanDevice, VkBufferUsageFlags usage, c
 		if (result != VK_SUCCESS)
 			return false;
 
-		vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), buffer, &memReq);
-
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memReq.size;
-		if (!vulkanDevice->MemoryTypeFromProperties(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &allocInfo.memoryTypeIndex))
-			return false;
-
-		result = vkAllocateMemory(vulkanDevice->GetDevice(), &allocInfo, VK_NULL_HANDLE, &memory);
-		if (result != VK_SUCCESS)
+		// Host buffers live in mapped blocks, Update() is then just a copy
+		if (!allocator->AllocateBufferMemory(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memory))
 			return false;
 
-		result = vkMapMemory(vulkanDevice->GetDevice(), memory, 0, memReq.size, 0, (void**)&pData);
-		if (result != VK_SUCCESS)
-			return false;
-
-		memcpy(pData, dataPtr, (size_t)dataSize);
-
-		vkUnmapMemory(vulkanDevice->GetDevice(), memory);
-
-		result = vkBindBufferMemory(vulkanDevice->GetDevice(), buffer, memory, 0);
-		if (result != VK_SUCCESS)
-			return false;
+		memcpy(memory.mappedData, dataPtr, (size_t)dataSize);
 
 		bufferInfo.buffer = buffer;
 		bufferInfo.offset = 0;
@@ -60,96 +52,126 @@ bool VulkanBuffer::Init(VulkanDevice * vulkanDevice, VkBufferUsageFlags usage, c
 	}
 	else
 	{
-		if (cmdBuffer == NULL)
-		{
-			gLogManager->AddMessage("ERROR: Staged buffer creation requires a valid command buffer!");
+		if (!CreateStaged(vulkanDevice, dataPtr))
 			return false;
+
+		// Only device local buffers are worth evicting, host buffers don't count against the VRAM budget
+		if (evictable && persistentData)
+			restoreData = dataPtr;
+		else if (evictable)
+		{
+			backingData.assign((const uint8_t*)dataPtr, (const uint8_t*)dataPtr + dataSize);
+			restoreData = backingData.data();
 		}
+	}
 
-		VkBufferCreateInfo bufferCI{};
-		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCI.size = dataSize;
-		result = vkCreateBuffer(vulkanDevice->GetDevice(), &bufferCI, VK_NULL_HANDLE, &stagingBuffer);
-		if (result != VK_SUCCESS)
-			return false;
+	return true;
+}
 
-		vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), stagingBuffer, &memReq);
+bool VulkanBuffer::CreateStaged(VulkanDevice * vulkanDevice, const void * dataPtr)
+{
+	VkResult result;
 
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memReq.size;
-		if (!vulkanDevice->MemoryTypeFromProperties(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &allocInfo.memoryTypeIndex))
-			return false;
+	VkBufferCreateInfo bufferCI{};
+	bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCI.size = size;
+	bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bufferCI.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	result = vkCreateBuffer(vulkanDevice->GetDevice(), &bufferCI, VK_NULL_HANDLE, &buffer);
+	if (result != VK_SUCCESS)
+		return false;
 
-		result = vkAllocateMemory(vulkanDevice->GetDevice(), &allocInfo, VK_NULL_HANDLE, &stagingMemory);
-		if (result != VK_SUCCESS)
-			return false;
+	if (!vulkanDevice->GetMemoryAllocator()->AllocateBufferMemory(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory))
+		return false;
 
-		result = vkMapMemory(vulkanDevice->GetDevice(), stagingMemory, 0, memReq.size, 0, (void**)&pData);
-		if (result != VK_SUCCESS)
-			return false;
+	// Copied from the upload manager's staging ring with the next batch
+	if (!gUploadManager->UploadBuffer(buffer, usage, dataPtr, size))
+		return false;
 
-		memcpy(pData, dataPtr, (size_t)dataSize);
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = size;
 
-		vkUnmapMemory(vulkanDevice->GetDevice(), stagingMemory);
+	return true;
+}
 
-		result = vkBindBufferMemory(vulkanDevice->GetDevice(), stagingBuffer, stagingMemory, 0);
-		if (result != VK_SUCCESS)
-			return false;
+void VulkanBuffer::Update(VulkanDevice * vulkanDevice, const void * dataPtr, size_t dataSize)
+{
+	if (stagedBuffer)
+	{
+		gLogManager->AddMessage("WARNING: Trying to update a staged buffer!");
+		return;
+	}
 
-		bufferCI.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-		result = vkCreateBuffer(vulkanDevice->GetDevice(), &bufferCI, VK_NULL_HANDLE, &buffer);
-		if (result != VK_SUCCESS)
-			return false;
+	memcpy(memory.mappedData, dataPtr, dataSize);
+}
 
-		vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), buffer, &memReq);
+void VulkanBuffer::Unload(VulkanDevice * vulkanDevice)
+{
+	vulkanDevice->GetMemoryAllocator()->Free(&memory);
+	vkDestroyBuffer(vulkanDevice->GetDevice(), buffer, VK_NULL_HANDLE);
+}
 
-		allocInfo.allocationSize = memReq.size;
-		if (!vulkanDevice->MemoryTypeFromProperties(memReq.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocInfo.memoryTypeIndex))
-			return false;
+void VulkanBuffer::Evict(VulkanDevice * vulkanDevice)
+{
+	// The caller makes sure no frame in flight still reads it
+	vulkanDevice->GetMemoryAllocator()->Free(&memory);
+	vkDestroyBuffer(vulkanDevice->GetDevice(), buffer, VK_NULL_HANDLE);
 
-		result = vkAllocateMemory(vulkanDevice->GetDevice(), &allocInfo, VK_NULL_HANDLE, &memory);
-		if (result != VK_SUCCESS)
-			return false;
+	memory = VulkanAllocation();
+	buffer = VK_NULL_HANDLE;
+	bufferInfo.buffer = VK_NULL_HANDLE;
+}
 
-		result = vkBindBufferMemory(vulkanDevice->GetDevice(), buffer, memory, 0);
-		if (result != VK_SUCCESS)
-			return false;
+bool VulkanBuffer::Restore(VulkanDevice * vulkanDevice)
+{
+	// A new handle, whatever recorded the old one has to be recorded again
+	if (!CreateStaged(vulkanDevice, restoreData))
+		return false;
 
-		VkBufferCopy copyRegion{};
-		copyRegion.size = dataSize;
-		vkCmdCopyBuffer(cmdBuffer->GetCommandBuffer(), stagingBuffer, buffer, 1, &copyRegion);
-	}
+	residencyVersion++;
 
 	return true;
 }
 
-void VulkanBuffer::Update(VulkanDevice * vulkanDevice, const void * dataPtr, size_t dataSize)
+bool VulkanBuffer::IsEvictable()
 {
-	if (stagedBuffer)
-	{
-		gLogManager->AddMessage("WARNING: Trying to update a staged buffer!");
-		return;
-	}
+	return restoreData != NULL;
+}
 
-	uint8_t * pData;
+bool VulkanBuffer::IsResident()
+{
+	return buffer != VK_NULL_HANDLE;
+}
 
-	vkMapMemory(vulkanDevice->GetDevice(), memory, 0, memReq.size, 0, (void**)&pData);
+void VulkanBuffer::SetLastUsedFrame(uint64_t frame)
+{
+	lastUsedFrame = frame;
+}
 
-	memcpy(pData, dataPtr, dataSize);
+uint64_t VulkanBuffer::GetLastUsedFrame()
+{
+	return lastUsedFrame;
+}
 
-	vkUnmapMemory(vulkanDevice->GetDevice(), memory);
+uint32_t VulkanBuffer::GetResidencyVersion()
+{
+	return residencyVersion;
 }
 
-void VulkanBuffer::Unload(VulkanDevice * vulkanDevice)
+VkDeviceSize VulkanBuffer::GetMemorySize()
 {
-	if (stagedBuffer)
-	{
-		vkFreeMemory(vulkanDevice->GetDevice(), stagingMemory, VK_NULL_HANDLE);
-		vkDestroyBuffer(vulkanDevice->GetDevice(), stagingBuffer, VK_NULL_HANDLE);
-	}
-	vkFreeMemory(vulkanDevice->GetDevice(), memory, VK_NULL_HANDLE);
-	vkDestroyBuffer(vulkanDevice->GetDevice(), buffer, VK_NULL_HANDLE);
+	return memory.size;
+}
+
+void VulkanBuffer::SetHandle(ResourceHandle handle)
+{
+	this->handle = handle;
+}
+
+ResourceHandle VulkanBuffer::GetHandle()
+{
+	return handle;
 }
 
 VkBuffer * VulkanBuffer::GetBuffer()
@@ -1,5 +1,8 @@
+#include <vector>
+
 #include "VulkanDevice.h"
 #include "VulkanCommandBuffer.h"
+#include "ResourceRegistry.h"
 
 #pragma once
 
@@ -7,20 +10,38 @@ class VulkanBuffer
 {
 	private:
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		VulkanAllocation memory;
 		VkDescriptorBufferInfo bufferInfo;
-		VkMemoryRequirements memReq;
 		bool stagedBuffer;
+		VkBufferUsageFlags usage;
+		VkDeviceSize size;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+		// Evictable buffers are recreated from data that outlives them, or from a copy in system memory when the caller's doesn't
+		const void * restoreData;
+		std::vector<uint8_t> backingData;
+		uint64_t lastUsedFrame;
+		uint32_t residencyVersion;
+		ResourceHandle handle;
+	private:
+		bool CreateStaged(VulkanDevice * vulkanDevice, const void * dataPtr);
 	public:
 		VulkanBuffer();
 
 		bool Init(VulkanDevice * vulkanDevice, VkBufferUsageFlags usage, const void * dataPtr,
-			VkDeviceSize dataSize, bool useStaging, VulkanCommandBuffer * cmdBuffer = NULL);
+			VkDeviceSize dataSize, bool useStaging, bool evictable = false, bool persistentData = false);
 		void Update(VulkanDevice * vulkanDevice, const void * dataPtr, size_t dataSize);
 		void Unload(VulkanDevice * vulkanDevice);
 		VkBuffer * GetBuffer();
 		VkDescriptorBufferInfo * GetBufferInfo();
+
+		void Evict(VulkanDevice * vulkanDevice);
+		bool Restore(VulkanDevice * vulkanDevice);
+		bool IsEvictable();
+		bool IsResident();
+		void SetLastUsedFrame(uint64_t frame);
+		uint64_t GetLastUsedFrame();
+		uint32_t GetResidencyVersion();
+		VkDeviceSize GetMemorySize();
+		void SetHandle(ResourceHandle handle);
+		ResourceHandle GetHandle();
 };
\ No newline at end of file
@@ -112,13 +112,13 @@ void VulkanCommandBuffer::Execute(VulkanDevice * device, VkPipelineStageFlags fl
 
 		if (waitFence)
 		{
-			vkQueueSubmit(device->GetQueue(), 1, &submitInfo, fence);
+			device->Submit(device->GetQueue(), 1, &submitInfo, fence);
 
 			vkWaitForFences(device->GetDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
 			vkResetFences(device->GetDevice(), 1, &fence);
 		}
 		else
-			vkQueueSubmit(device->GetQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+			device->Submit(device->GetQueue(), 1, &submitInfo, VK_NULL_HANDLE);
 
 	}
 	else
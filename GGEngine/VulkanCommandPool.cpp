@@ -10,13 +10,13 @@ VulkanCommandPool::~VulkanCommandPool()
 	commandPool = VK_NULL_HANDLE;
 }
 
-bool VulkanCommandPool::Init(VulkanDevice * vulkanDevice)
+bool VulkanCommandPool::Init(VulkanDevice * vulkanDevice, bool transfer)
 {
 	VkResult result;
 	VkCommandPoolCreateInfo cmdPoolCI{};
 
 	cmdPoolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cmdPoolCI.queueFamilyIndex = vulkanDevice->GetGraphicsQueueFamilyIndex();
+	cmdPoolCI.queueFamilyIndex = (transfer ? vulkanDevice->GetTransferQueueFamilyIndex() : vulkanDevice->GetGraphicsQueueFamilyIndex());
 	cmdPoolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	result = vkCreateCommandPool(vulkanDevice->GetDevice(), &cmdPoolCI, VK_NULL_HANDLE, &commandPool);
@@ -31,6 +31,11 @@ void VulkanCommandPool::Unload(VulkanDevice * vulkanDevice)
 	vkDestroyCommandPool(vulkanDevice->GetDevice(), commandPool, VK_NULL_HANDLE);
 }
 
+void VulkanCommandPool::Reset(VulkanDevice * vulkanDevice)
+{
+	vkResetCommandPool(vulkanDevice->GetDevice(), commandPool, 0);
+}
+
 VkCommandPool VulkanCommandPool::GetCommandPool()
 {
 	return commandPool;
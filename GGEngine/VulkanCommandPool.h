@@ -10,7 +10,8 @@ class VulkanCommandPool
 		VulkanCommandPool();
 		~VulkanCommandPool();
 
-		bool Init(VulkanDevice * vulkanDevice);
+		bool Init(VulkanDevice * vulkanDevice, bool transfer = false);
 		void Unload(VulkanDevice * vulkanDevice);
+		void Reset(VulkanDevice * vulkanDevice);
 		VkCommandPool GetCommandPool();
 };
\ No newline at end of file
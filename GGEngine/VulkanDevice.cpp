@@ -1,5 +1,8 @@
+#include <string.h>
+
 #include "VulkanDevice.h"
 #include "LogManager.h"
+#include "StdInc.h"
 
 extern LogManager * gLogManager;
 
@@ -7,10 +10,15 @@ VulkanDevice::VulkanDevice()
 {
 	device = VK_NULL_HANDLE;
 	surface = VK_NULL_HANDLE;
+	transferQueue = VK_NULL_HANDLE;
+	descriptorIndexingSupported = false;
+	memoryBudgetSupported = false;
+	memoryAllocator = NULL;
 }
 
 VulkanDevice::~VulkanDevice()
 {
+	memoryAllocator = NULL;
 	device = VK_NULL_HANDLE;
 	surface = VK_NULL_HANDLE;
 }
@@ -86,6 +94,23 @@ bool VulkanDevice::Init(VulkanInstance * vulkanInstance, HWND hwnd)
 		return false;
 	}
 
+	// A transfer only family is usually a DMA engine, uploads on it run beside rendering
+	transferQueueFamilyIndex = graphicsQueueFamilyIndex;
+	for (uint32_t i = 0; i < queueFamiliyProperties.size(); i++)
+	{
+		VkQueueFlags flags = queueFamiliyProperties[i].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT))
+		{
+			transferQueueFamilyIndex = i;
+			break;
+		}
+	}
+
+	if (HasTransferQueue())
+		gLogManager->AddMessage("Uploading on a dedicated transfer queue");
+	else
+		gLogManager->AddMessage("No transfer only queue family, uploading on the graphics queue");
+
 	uint32_t numFormats;
 	result = vkGetPhysicalDeviceSurfaceFormatsKHR(gpu, surface, &numFormats, VK_NULL_HANDLE);
 	if (result != VK_SUCCESS)
@@ -105,11 +130,16 @@ bool VulkanDevice::Init(VulkanInstance * vulkanInstance, HWND hwnd)
 	// Device queue
 
 	float pQueuePriorities[] = { 1.0f };
-	VkDeviceQueueCreateInfo deviceQueueCI{};
-	deviceQueueCI.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	deviceQueueCI.queueCount = 1;
-	deviceQueueCI.queueFamilyIndex = graphicsQueueFamilyIndex;
-	deviceQueueCI.pQueuePriorities = pQueuePriorities;
+	VkDeviceQueueCreateInfo deviceQueueCI[2]{};
+	deviceQueueCI[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	deviceQueueCI[0].queueCount = 1;
+	deviceQueueCI[0].queueFamilyIndex = graphicsQueueFamilyIndex;
+	deviceQueueCI[0].pQueuePriorities = pQueuePriorities;
+
+	deviceQueueCI[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	deviceQueueCI[1].queueCount = 1;
+	deviceQueueCI[1].queueFamilyIndex = transferQueueFamilyIndex;
+	deviceQueueCI[1].pQueuePriorities = pQueuePriorities;
 
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.shaderClipDistance = VK_TRUE;
@@ -118,14 +148,57 @@ bool VulkanDevice::Init(VulkanInstance * vulkanInstance, HWND hwnd)
 	deviceFeatures.shaderTessellationAndGeometryPointSize = VK_TRUE;
 	deviceFeatures.fillModeNonSolid = VK_TRUE;
 
+	// Block compressed textures, without it encoded .rct files can't be loaded
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(gpu, &supportedFeatures);
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+	if (!supportedFeatures.textureCompressionBC)
+		gLogManager->AddMessage("WARNING: BC texture compression is not supported, only RGBA8 textures can be loaded");
+
+	// Timeline semaphores tell the upload manager when staging memory can be reused
+	if (!CheckTimelineSemaphoreSupport())
+	{
+		gLogManager->AddMessage("ERROR: Timeline semaphores are not supported!");
+		return false;
+	}
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
+	// Descriptor indexing, only the features the bindless texture array needs
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	descriptorIndexingSupported = CheckDescriptorIndexingSupport();
+	if (descriptorIndexingSupported)
+	{
+		AddDeviceExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	}
+
+	// Heap budgets reported by the driver, the residency manager guesses them from the heap sizes otherwise
+	memoryBudgetSupported = CheckMemoryBudgetSupport();
+	if (memoryBudgetSupported)
+		AddDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
 	// Device
 	VkDeviceCreateInfo deviceCI{};
 	deviceCI.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCI.queueCreateInfoCount = 1;
-	deviceCI.pQueueCreateInfos = &deviceQueueCI;
+	deviceCI.queueCreateInfoCount = (HasTransferQueue() ? 2 : 1);
+	deviceCI.pQueueCreateInfos = deviceQueueCI;
 	deviceCI.enabledExtensionCount = (uint32_t)deviceExtensions.size();
 	deviceCI.ppEnabledExtensionNames = deviceExtensions.data();
 	deviceCI.pEnabledFeatures = &deviceFeatures;
+	deviceCI.pNext = &timelineFeatures;
+	timelineFeatures.pNext = (descriptorIndexingSupported ? &indexingFeatures : VK_NULL_HANDLE);
 
 	result = vkCreateDevice(gpu, &deviceCI, VK_NULL_HANDLE, &device);
 	if (result != VK_SUCCESS)
@@ -135,11 +208,22 @@ bool VulkanDevice::Init(VulkanInstance * vulkanInstance, HWND hwnd)
 	}
 
 	vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &deviceQueue);
+	vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferQueue);
+
+	// Every resource's memory comes out of the allocator's blocks
+	memoryAllocator = new VulkanMemoryAllocator();
+	if (!memoryAllocator->Init(this))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init the memory allocator!");
+		return false;
+	}
+
 	return true;
 }
 
 void VulkanDevice::Unload(VulkanInstance * vulkanInstance)
 {
+	SAFE_UNLOAD(memoryAllocator);
 	vkDestroyDevice(device, VK_NULL_HANDLE);
 	vkDestroySurfaceKHR(vulkanInstance->GetInstance(), surface, VK_NULL_HANDLE);
 }
@@ -169,6 +253,40 @@ uint32_t VulkanDevice::GetGraphicsQueueFamilyIndex()
 	return graphicsQueueFamilyIndex;
 }
 
+VkQueue VulkanDevice::GetTransferQueue()
+{
+	return transferQueue;
+}
+
+uint32_t VulkanDevice::GetTransferQueueFamilyIndex()
+{
+	return transferQueueFamilyIndex;
+}
+
+bool VulkanDevice::HasTransferQueue()
+{
+	return transferQueueFamilyIndex != graphicsQueueFamilyIndex;
+}
+
+// Uploads submit from worker threads, every use of the queues has to go through the one lock
+VkResult VulkanDevice::Submit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo * submitInfo, VkFence fence)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return vkQueueSubmit(queue, submitCount, submitInfo, fence);
+}
+
+VkResult VulkanDevice::Present(const VkPresentInfoKHR * presentInfo)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return vkQueuePresentKHR(deviceQueue, presentInfo);
+}
+
+void VulkanDevice::WaitIdle()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	vkDeviceWaitIdle(device);
+}
+
 VkSurfaceKHR VulkanDevice::GetSurface()
 {
 	return surface;
@@ -184,6 +302,79 @@ VkPhysicalDeviceProperties VulkanDevice::GetGPUProperties()
 	return gpuProperties;
 }
 
+VkPhysicalDeviceMemoryProperties VulkanDevice::GetMemoryProperties()
+{
+	return memoryProperties;
+}
+
+VulkanMemoryAllocator * VulkanDevice::GetMemoryAllocator()
+{
+	return memoryAllocator;
+}
+
+bool VulkanDevice::IsDescriptorIndexingSupported()
+{
+	return descriptorIndexingSupported;
+}
+
+bool VulkanDevice::IsMemoryBudgetSupported()
+{
+	return memoryBudgetSupported;
+}
+
+bool VulkanDevice::IsTextureFormatSupported(VkFormat format)
+{
+	// Textures are copied into and sampled from optimal tiling images
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(gpu, format, &formatProperties);
+
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+bool VulkanDevice::CheckDescriptorIndexingSupport()
+{
+	uint32_t numExtensions = 0;
+	vkEnumerateDeviceExtensionProperties(gpu, VK_NULL_HANDLE, &numExtensions, VK_NULL_HANDLE);
+
+	std::vector<VkExtensionProperties> extensions(numExtensions);
+	vkEnumerateDeviceExtensionProperties(gpu, VK_NULL_HANDLE, &numExtensions, extensions.data());
+
+	bool extensionFound = false;
+	for (uint32_t i = 0; i < numExtensions; i++)
+	{
+		if (strcmp(extensions[i].extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+		{
+			extensionFound = true;
+			break;
+		}
+	}
+
+	if (!extensionFound)
+	{
+		gLogManager->AddMessage("Descriptor indexing not supported, textures are bound per draw");
+		return false;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(gpu, &features);
+
+	if (!indexingFeatures.shaderSampledImageArrayNonUniformIndexing || !indexingFeatures.runtimeDescriptorArray ||
+		!indexingFeatures.descriptorBindingPartiallyBound || !indexingFeatures.descriptorBindingVariableDescriptorCount ||
+		!indexingFeatures.descriptorBindingSampledImageUpdateAfterBind || !indexingFeatures.descriptorBindingUpdateUnusedWhilePending)
+	{
+		gLogManager->AddMessage("Descriptor indexing features missing, textures are bound per draw");
+		return false;
+	}
+
+	return true;
+}
+
 bool VulkanDevice::MemoryTypeFromProperties(uint32_t typeBits, VkFlags reqMask, uint32_t * typeIndex)
 {
 	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
@@ -199,4 +390,37 @@ bool VulkanDevice::MemoryTypeFromProperties(uint32_t typeBits, VkFlags reqMask,
 		typeBits >>= 1;
 	}
 	return false;
+}
+
+bool VulkanDevice::CheckTimelineSemaphoreSupport()
+{
+	// Core since 1.2, but the device may still be older than the instance
+	if (gpuProperties.apiVersion < VK_API_VERSION_1_2)
+		return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(gpu, &features);
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool VulkanDevice::CheckMemoryBudgetSupport()
+{
+	uint32_t numExtensions = 0;
+	vkEnumerateDeviceExtensionProperties(gpu, VK_NULL_HANDLE, &numExtensions, VK_NULL_HANDLE);
+
+	std::vector<VkExtensionProperties> extensions(numExtensions);
+	vkEnumerateDeviceExtensionProperties(gpu, VK_NULL_HANDLE, &numExtensions, extensions.data());
+
+	for (uint32_t i = 0; i < numExtensions; i++)
+		if (strcmp(extensions[i].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+			return true;
+
+	gLogManager->AddMessage("Memory budget extension not supported, VRAM budget is estimated from the heap sizes");
+	return false;
 }
\ No newline at end of file
@@ -3,10 +3,12 @@
 #define VK_USE_PLATFORM_WIN32_KHR
 
 #include <Windows.h>
+#include <mutex>
 #include <vector>
 #include <vulkan/vulkan.h>
 
 #include "VulkanInstance.h"
+#include "VulkanMemoryAllocator.h"
 
 class VulkanDevice
 {
@@ -17,10 +19,20 @@ class VulkanDevice
 		std::vector<VkQueueFamilyProperties> queueFamiliyProperties;
 		VkSurfaceKHR surface;
 		uint32_t graphicsQueueFamilyIndex;
+		uint32_t transferQueueFamilyIndex;
 		VkFormat format;
 		VkQueue deviceQueue;
+		VkQueue transferQueue;
+		std::mutex queueMutex;
 		VkDevice device;
 		std::vector<const char*> deviceExtensions;
+		bool descriptorIndexingSupported;
+		bool memoryBudgetSupported;
+		VulkanMemoryAllocator * memoryAllocator;
+	private:
+		bool CheckDescriptorIndexingSupport();
+		bool CheckTimelineSemaphoreSupport();
+		bool CheckMemoryBudgetSupport();
 	public:
 		VulkanDevice();
 		~VulkanDevice();
@@ -33,7 +45,18 @@ class VulkanDevice
 		VkPhysicalDevice GetGPU();
 		VkQueue GetQueue();
 		uint32_t GetGraphicsQueueFamilyIndex();
+		VkQueue GetTransferQueue();
+		uint32_t GetTransferQueueFamilyIndex();
+		bool HasTransferQueue();
+		VkResult Submit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo * submitInfo, VkFence fence);
+		VkResult Present(const VkPresentInfoKHR * presentInfo);
+		void WaitIdle();
 		VkSurfaceKHR GetSurface();
 		VkFormat GetFormat();
 		VkPhysicalDeviceProperties GetGPUProperties();
+		VkPhysicalDeviceMemoryProperties GetMemoryProperties();
+		VulkanMemoryAllocator * GetMemoryAllocator();
+		bool IsDescriptorIndexingSupported();
+		bool IsMemoryBudgetSupported();
+		bool IsTextureFormatSupported(VkFormat format);
 };
\ No newline at end of file
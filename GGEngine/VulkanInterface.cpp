@@ -22,6 +22,10 @@ VulkanInterface::VulkanInterface()
 	albedoAtt = NULL;
 	materialAtt = NULL;
 	depthAtt = NULL;
+
+	uniformRing = NULL;
+
+	frameIndex = 0;
 }
 
 VulkanInterface::~VulkanInterface()
@@ -30,9 +34,14 @@ VulkanInterface::~VulkanInterface()
 		UnloadVulkanDebugMode();
 #endif
 	vkDestroyPipelineCache(vulkanDevice->GetDevice(), pipelineCache, VK_NULL_HANDLE);
+	SAFE_UNLOAD(uniformRing, vulkanDevice);
 
-	vkDestroySemaphore(vulkanDevice->GetDevice(), drawCompleteSemaphore, VK_NULL_HANDLE);
-	vkDestroySemaphore(vulkanDevice->GetDevice(), imageReadySemaphore, VK_NULL_HANDLE);
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkDestroyFence(vulkanDevice->GetDevice(), frameFences[i], VK_NULL_HANDLE);
+		vkDestroySemaphore(vulkanDevice->GetDevice(), drawCompleteSemaphores[i], VK_NULL_HANDLE);
+		vkDestroySemaphore(vulkanDevice->GetDevice(), imageReadySemaphores[i], VK_NULL_HANDLE);
+	}
 
 	vkDestroyFramebuffer(vulkanDevice->GetDevice(), deferredFramebuffer, VK_NULL_HANDLE);
 	SAFE_UNLOAD(deferredRenderPass, vulkanDevice);
@@ -43,7 +52,7 @@ VulkanInterface::~VulkanInterface()
 	SAFE_UNLOAD(positionAtt, vulkanDevice);
 	
 	vkDestroySampler(vulkanDevice->GetDevice(), colorSampler, VK_NULL_HANDLE);
-	vkFreeMemory(vulkanDevice->GetDevice(), depthImage.mem, VK_NULL_HANDLE); depthImage.mem = VK_NULL_HANDLE;
+	vulkanDevice->GetMemoryAllocator()->Free(&depthImage.mem);
 	vkDestroyImage(vulkanDevice->GetDevice(), depthImage.image, VK_NULL_HANDLE); depthImage.image = VK_NULL_HANDLE;
 	vkDestroyImageView(vulkanDevice->GetDevice(), depthImage.view, VK_NULL_HANDLE); depthImage.view = VK_NULL_HANDLE;
 	
@@ -136,21 +145,31 @@ bool VulkanInterface::Init(HWND hwnd)
 	depthAttachmentRef.attachment = 1;
 	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependency.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	VkSubpassDependency dependencies[2];
+	dependencies[0] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	// The depth buffer is shared by all frames in flight
+	dependencies[1] = {};
+	dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].dstSubpass = 0;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 	VulkanRenderpassCI renderpassCI;
 	renderpassCI.attachments = attachmentDesc;
 	renderpassCI.attachmentCount = 2;
 	renderpassCI.attachmentRefs = &colorAttachmentRef;
 	renderpassCI.depthAttachmentRef = &depthAttachmentRef;
-	renderpassCI.dependencies = &dependency;
-	renderpassCI.dependenciesCount = 1;
+	renderpassCI.dependencies = dependencies;
+	renderpassCI.dependenciesCount = 2;
 
 	forwardRenderPass = new VulkanRenderpass();
 	if (!forwardRenderPass->Init(vulkanDevice, &renderpassCI))
@@ -178,27 +197,61 @@ bool VulkanInterface::Init(HWND hwnd)
 		return false;
 	}
 
-	// Semaphores
+	// Per frame semaphores and fences
+	VkResult result;
 	VkSemaphoreCreateInfo semaphoreCI{};
 	semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	vkCreateSemaphore(vulkanDevice->GetDevice(), &semaphoreCI, VK_NULL_HANDLE, &imageReadySemaphore);
-	vkCreateSemaphore(vulkanDevice->GetDevice(), &semaphoreCI, VK_NULL_HANDLE, &drawCompleteSemaphore);
+
+	// Fences start signaled so the first wait on each frame slot returns immediately
+	VkFenceCreateInfo fenceCI{};
+	fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkCreateSemaphore(vulkanDevice->GetDevice(), &semaphoreCI, VK_NULL_HANDLE, &imageReadySemaphores[i]);
+		vkCreateSemaphore(vulkanDevice->GetDevice(), &semaphoreCI, VK_NULL_HANDLE, &drawCompleteSemaphores[i]);
+
+		result = vkCreateFence(vulkanDevice->GetDevice(), &fenceCI, VK_NULL_HANDLE, &frameFences[i]);
+		if (result != VK_SUCCESS)
+			return false;
+	}
+	frameIndex = 0;
+
+	// Transient uniform data, one region per frame slot
+	uniformRing = new UniformRing();
+	if (!uniformRing->Init(vulkanDevice, UNIFORM_RING_FRAME_SIZE, MAX_FRAMES_IN_FLIGHT))
+	{
+		gLogManager->AddMessage("ERROR: Failed to init uniform ring!");
+		return false;
+	}
+	uniformRing->BeginFrame(frameIndex);
 
 	// Pipeline cache
 	VkPipelineCacheCreateInfo pipelineCacheCI{};
 	pipelineCacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 	pipelineCacheCI.pNext = NULL;
-	VkResult result = vkCreatePipelineCache(vulkanDevice->GetDevice(), &pipelineCacheCI, VK_NULL_HANDLE, &pipelineCache);
+	result = vkCreatePipelineCache(vulkanDevice->GetDevice(), &pipelineCacheCI, VK_NULL_HANDLE, &pipelineCache);
 	if (result != VK_SUCCESS)
 		return false;
 
 	return true;
 }
 
+void VulkanInterface::BeginFrame()
+{
+	// Only wait for the GPU to finish with the frame slot that is about to be reused
+	vkWaitForFences(vulkanDevice->GetDevice(), 1, &frameFences[frameIndex], VK_TRUE, UINT64_MAX);
+	vkResetFences(vulkanDevice->GetDevice(), 1, &frameFences[frameIndex]);
+
+	uniformRing->BeginFrame(frameIndex);
+
+	// Acquire before recording so only the forward pass of this image has to be recorded
+	vulkanSwapchain->AcquireNextImage(vulkanDevice, imageReadySemaphores[frameIndex]);
+}
+
 void VulkanInterface::BeginSceneDeferred(VulkanCommandBuffer * commandBuffer)
 {
-	commandBuffer->BeginRecording();
-	
 	deferredRenderPass->BeginRenderpass(commandBuffer, 0.0f, 0.0f, 0.0f, 1.0f, deferredFramebuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS,
 		(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
 }
@@ -206,10 +259,6 @@ void VulkanInterface::BeginSceneDeferred(VulkanCommandBuffer * commandBuffer)
 void VulkanInterface::EndSceneDeferred(VulkanCommandBuffer * commandBuffer)
 {
 	deferredRenderPass->EndRenderpass(commandBuffer);
-	
-	commandBuffer->EndRecording();
-
-	commandBuffer->Execute(vulkanDevice, NULL, NULL, NULL, true);
 }
 
 void VulkanInterface::BeginSceneForward(VulkanCommandBuffer * commandBuffer, int frameId)
@@ -227,14 +276,38 @@ void VulkanInterface::EndSceneForward(VulkanCommandBuffer * commandBuffer)
 	commandBuffer->EndRecording();
 }
 
-void VulkanInterface::Present(std::vector<VulkanCommandBuffer*>& renderCommandBuffers)
+void VulkanInterface::Present(VulkanCommandBuffer * deferredCommandBuffer, VulkanCommandBuffer * renderCommandBuffer)
 {
-	vulkanSwapchain->AcquireNextImage(vulkanDevice, imageReadySemaphore);
-	
-	renderCommandBuffers[vulkanSwapchain->GetCurrentBufferId()]->Execute(vulkanDevice, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		imageReadySemaphore, drawCompleteSemaphore, false);
+	VkResult result;
 
-	vulkanSwapchain->Present(vulkanDevice, drawCompleteSemaphore);
+	VkCommandBuffer commandBuffers[2] = { deferredCommandBuffer->GetCommandBuffer(), renderCommandBuffer->GetCommandBuffer() };
+
+	// Shadow and G-buffer passes don't touch the swapchain image so they go in a batch of their own and
+	// start without waiting for it. Renderpass dependencies order them before the lighting pass on the queue.
+	VkSubmitInfo submitInfo[2];
+	submitInfo[0] = {};
+	submitInfo[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo[0].commandBufferCount = 1;
+	submitInfo[0].pCommandBuffers = &commandBuffers[0];
+
+	VkPipelineStageFlags waitFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	submitInfo[1] = {};
+	submitInfo[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo[1].waitSemaphoreCount = 1;
+	submitInfo[1].pWaitSemaphores = &imageReadySemaphores[frameIndex];
+	submitInfo[1].pWaitDstStageMask = &waitFlags;
+	submitInfo[1].commandBufferCount = 1;
+	submitInfo[1].pCommandBuffers = &commandBuffers[1];
+	submitInfo[1].signalSemaphoreCount = 1;
+	submitInfo[1].pSignalSemaphores = &drawCompleteSemaphores[frameIndex];
+
+	result = vulkanDevice->Submit(vulkanDevice->GetQueue(), 2, submitInfo, frameFences[frameIndex]);
+	if (result != VK_SUCCESS)
+		gLogManager->AddMessage("ERROR: Failed to submit frame!");
+
+	vulkanSwapchain->Present(vulkanDevice, drawCompleteSemaphores[frameIndex]);
+
+	frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 VulkanCommandPool * VulkanInterface::GetVulkanCommandPool()
@@ -302,6 +375,16 @@ VkPipelineCache VulkanInterface::GetPipelineCache()
 	return pipelineCache;
 }
 
+uint32_t VulkanInterface::GetFrameIndex()
+{
+	return frameIndex;
+}
+
+UniformRing * VulkanInterface::GetUniformRing()
+{
+	return uniformRing;
+}
+
 bool VulkanInterface::InitDepthBuffer()
 {
 	VkResult result;
@@ -346,9 +429,6 @@ bool VulkanInterface::InitDepthBuffer()
 	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 	imageCI.flags = 0;
 
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	
 	VkImageViewCreateInfo viewCI{};
 	viewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewCI.image = VK_NULL_HANDLE;
@@ -365,22 +445,11 @@ bool VulkanInterface::InitDepthBuffer()
 	viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewCI.flags = 0;
 
-	VkMemoryRequirements memReq;
 	result = vkCreateImage(vulkanDevice->GetDevice(), &imageCI, VK_NULL_HANDLE, &depthImage.image);
 	if (result != VK_SUCCESS)
 		return false;
 
-	vkGetImageMemoryRequirements(vulkanDevice->GetDevice(), depthImage.image, &memReq);
-	memAlloc.allocationSize = memReq.size;
-	if (!vulkanDevice->MemoryTypeFromProperties(memReq.memoryTypeBits, 0, &memAlloc.memoryTypeIndex))
-		return false;
-
-	result = vkAllocateMemory(vulkanDevice->GetDevice(), &memAlloc, VK_NULL_HANDLE, &depthImage.mem);
-	if (result != VK_SUCCESS)
-		return false;
-
-	result = vkBindImageMemory(vulkanDevice->GetDevice(), depthImage.image, depthImage.mem, 0);
-	if (result != VK_SUCCESS)
+	if (!vulkanDevice->GetMemoryAllocator()->AllocateImageMemory(depthImage.image, 0, &depthImage.mem))
 		return false;
 
 	VulkanTools::SetImageLayout(depthImage.image, viewCI.subresourceRange.aspectMask, VK_IMAGE_LAYOUT_UNDEFINED,
@@ -482,8 +551,28 @@ bool VulkanInterface::InitDeferredFramebuffer()
 	renderpassCI.attachmentCount = 5;
 	renderpassCI.attachmentRefs = (VkAttachmentReference*)attachmentRefs.data();
 	renderpassCI.depthAttachmentRef = &depthAttachmentRef;
-	renderpassCI.dependencies = VK_NULL_HANDLE;
-	renderpassCI.dependenciesCount = 0;
+
+	// The G-buffer may still be sampled by the lighting pass of the previous frame
+	VkSubpassDependency dependencies[2];
+	dependencies[0] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// The lighting pass samples the G-buffer once it is in the read-only layout
+	dependencies[1] = {};
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	renderpassCI.dependencies = dependencies;
+	renderpassCI.dependenciesCount = 2;
 
 	deferredRenderPass = new VulkanRenderpass();
 	if (!deferredRenderPass->Init(vulkanDevice, &renderpassCI))
@@ -550,6 +639,8 @@ bool VulkanInterface::InitColorSampler()
 
 void VulkanInterface::InitViewportAndScissors(VulkanCommandBuffer * commandBuffer, float vWidth, float vHeight, uint32_t sWidth, uint32_t sHeight)
 {
+	// Locals only, this is called from the recording threads
+	VkViewport viewport;
 	viewport.width = vWidth;
 	viewport.height = vHeight;
 	viewport.minDepth = 0.0f;
@@ -558,6 +649,7 @@ void VulkanInterface::InitViewportAndScissors(VulkanCommandBuffer * commandBuffe
 	viewport.y = 0;
 	vkCmdSetViewport(commandBuffer->GetCommandBuffer(), 0, 1, &viewport);
 
+	VkRect2D scissor;
 	scissor.extent.width = sWidth;
 	scissor.extent.height = sHeight;
 	scissor.offset.x = 0;
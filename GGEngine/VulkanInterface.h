@@ -2,6 +2,9 @@
 
 #define VULKAN_DEBUG_MODE_ENABLED false
 
+// Number of frames the CPU may record ahead of the GPU
+#define MAX_FRAMES_IN_FLIGHT 2
+
 #define VK_USE_PLATFORM_WIN32_KHR
 
 #define GLM_FORCE_RADIANS
@@ -16,6 +19,7 @@
 #include "VulkanSwapchain.h"
 #include "VulkanRenderpass.h"
 #include "FrameBufferAttachment.h"
+#include "UniformRing.h"
 
 class VulkanInterface
 {
@@ -24,7 +28,7 @@ class VulkanInterface
 		{
 			VkFormat format;
 			VkImage image;
-			VkDeviceMemory mem;
+			VulkanAllocation mem;
 			VkImageView view;
 		} depthImage;
 
@@ -36,9 +40,6 @@ class VulkanInterface
 		VulkanRenderpass * forwardRenderPass;
 		VulkanRenderpass * deferredRenderPass;
 
-		VkViewport viewport;
-		VkRect2D scissor;
-
 		VkSampler colorSampler;
 		VkFramebuffer deferredFramebuffer;
 
@@ -49,8 +50,12 @@ class VulkanInterface
 		FrameBufferAttachment * depthAtt;
 		std::vector<FrameBufferAttachment*> attachmentsPtr;
 
-		VkSemaphore imageReadySemaphore;
-		VkSemaphore drawCompleteSemaphore;
+		VkSemaphore imageReadySemaphores[MAX_FRAMES_IN_FLIGHT];
+		VkSemaphore drawCompleteSemaphores[MAX_FRAMES_IN_FLIGHT];
+		VkFence frameFences[MAX_FRAMES_IN_FLIGHT];
+		uint32_t frameIndex;
+
+		UniformRing * uniformRing;
 
 		VkPipelineCache pipelineCache;
 #if VULKAN_DEBUG_MODE_ENABLED
@@ -70,11 +75,12 @@ class VulkanInterface
 		~VulkanInterface();
 
 		bool Init(HWND hwnd);
+		void BeginFrame();
 		void BeginSceneDeferred(VulkanCommandBuffer * commandBuffer);
 		void EndSceneDeferred(VulkanCommandBuffer * commandBuffer);
 		void BeginSceneForward(VulkanCommandBuffer * commandBuffer, int frameId);
 		void EndSceneForward(VulkanCommandBuffer * commandBuffer);
-		void Present(std::vector<VulkanCommandBuffer*>& renderCommandBuffers);
+		void Present(VulkanCommandBuffer * deferredCommandBuffer, VulkanCommandBuffer * renderCommandBuffer);
 		void InitViewportAndScissors(VulkanCommandBuffer * commandBuffer, float vWidth, float vHeight, uint32_t sWidth, uint32_t sHeight);
 		VulkanCommandPool * GetVulkanCommandPool();
 		VulkanDevice * GetVulkanDevice();
@@ -89,4 +95,6 @@ class VulkanInterface
 		FrameBufferAttachment * GetDepthAttachment();
 		VkFramebuffer GetDeferredFramebuffer();
 		VkPipelineCache GetPipelineCache();
+		uint32_t GetFrameIndex();
+		UniformRing * GetUniformRing();
 };
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include <algorithm>
+
+#include "VulkanDevice.h"
+#include "VulkanMemoryAllocator.h"
+#include "LogManager.h"
+
+extern LogManager * gLogManager;
+
+VulkanMemoryAllocator::VulkanMemoryAllocator()
+{
+	vulkanDevice = NULL;
+	bufferImageGranularity = 1;
+	separateImagePools = false;
+
+	for (int i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+		blockSizes[i] = MEMORY_BLOCK_SIZE;
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator()
+{
+	vulkanDevice = NULL;
+}
+
+bool VulkanMemoryAllocator::Init(VulkanDevice * vulkanDevice)
+{
+	this->vulkanDevice = vulkanDevice;
+	memoryProperties = vulkanDevice->GetMemoryProperties();
+	bufferImageGranularity = vulkanDevice->GetGPUProperties().limits.bufferImageGranularity;
+
+	// Buddy ranges never share a granularity page when the page is smaller than the smallest range,
+	// otherwise buffers and images are kept in separate blocks so they can't end up as neighbours
+	separateImagePools = (bufferImageGranularity > MEMORY_MIN_ALLOCATION_SIZE);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		// Small heaps, like the host visible part of VRAM, would be eaten by a few blocks
+		VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+		while (blockSizes[i] > heapSize / 8 && blockSizes[i] > MEMORY_MIN_ALLOCATION_SIZE * 1024)
+			blockSizes[i] /= 2;
+	}
+
+	char msg[128];
+	sprintf(msg, "Memory allocator: buffer image granularity %llu, %s", (unsigned long long)bufferImageGranularity,
+		(separateImagePools ? "separate image blocks" : "shared blocks"));
+	gLogManager->AddMessage(msg);
+
+	return true;
+}
+
+void VulkanMemoryAllocator::Unload()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t leakedAllocations = 0;
+
+	for (int i = 0; i < MEMORY_RESOURCE_TYPE_COUNT; i++)
+	{
+		for (int j = 0; j < VK_MAX_MEMORY_TYPES; j++)
+		{
+			for (unsigned int k = 0; k < pools[i][j].size(); k++)
+			{
+				leakedAllocations += pools[i][j][k]->allocationCount;
+				DestroyBlock(pools[i][j][k]);
+			}
+			pools[i][j].clear();
+		}
+	}
+
+	if (leakedAllocations > 0)
+	{
+		char msg[128];
+		sprintf(msg, "WARNING: %u device memory allocations were never freed!", leakedAllocations);
+		gLogManager->AddMessage(msg);
+	}
+}
+
+bool VulkanMemoryAllocator::Allocate(const VkMemoryRequirements & memReq, VkMemoryPropertyFlags properties, MEMORY_RESOURCE_TYPE resourceType,
+	VulkanAllocation * allocation)
+{
+	uint32_t memoryTypeIndex;
+	if (!vulkanDevice->MemoryTypeFromProperties(memReq.memoryTypeBits, properties, &memoryTypeIndex))
+		return false;
+
+	if (!separateImagePools)
+		resourceType = MEMORY_RESOURCE_BUFFER;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<VulkanMemoryBlock*> & pool = pools[resourceType][memoryTypeIndex];
+
+	// Ranges are aligned to their own size, so rounding up to the alignment is enough to satisfy it
+	VkDeviceSize size = (memReq.size > memReq.alignment ? memReq.size : memReq.alignment);
+
+	VulkanMemoryBlock * block = NULL;
+	VkDeviceSize offset = 0;
+	uint32_t order = 0;
+
+	if (size > blockSizes[memoryTypeIndex] / 2)
+	{
+		// Big resources like render targets would waste most of a block, they get memory of their own
+		block = CreateBlock(memoryTypeIndex, resourceType, memReq.size, true);
+		if (block == NULL)
+			return false;
+
+		pool.push_back(block);
+	}
+	else
+	{
+		order = GetOrder(size);
+
+		for (unsigned int i = 0; i < pool.size(); i++)
+		{
+			if (!pool[i]->dedicated && AllocateFromBlock(pool[i], order, &offset))
+			{
+				block = pool[i];
+				break;
+			}
+		}
+
+		if (block == NULL)
+		{
+			block = CreateBlock(memoryTypeIndex, resourceType, blockSizes[memoryTypeIndex], false);
+			if (block == NULL)
+				return false;
+
+			pool.push_back(block);
+			AllocateFromBlock(block, order, &offset);
+		}
+	}
+
+	block->allocationCount++;
+	block->usedSize += memReq.size;
+
+	allocation->memory = block->memory;
+	allocation->offset = offset;
+	allocation->size = memReq.size;
+	allocation->mappedData = (block->mappedData ? block->mappedData + offset : NULL);
+	allocation->block = block;
+	allocation->order = order;
+
+	return true;
+}
+
+bool VulkanMemoryAllocator::AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags properties, VulkanAllocation * allocation)
+{
+	VkMemoryRequirements memReq;
+	vkGetBufferMemoryRequirements(vulkanDevice->GetDevice(), buffer, &memReq);
+
+	if (!Allocate(memReq, properties, MEMORY_RESOURCE_BUFFER, allocation))
+		return false;
+
+	VkResult result = vkBindBufferMemory(vulkanDevice->GetDevice(), buffer, allocation->memory, allocation->offset);
+	if (result != VK_SUCCESS)
+	{
+		Free(allocation);
+		return false;
+	}
+
+	return true;
+}
+
+bool VulkanMemoryAllocator::AllocateImageMemory(VkImage image, VkMemoryPropertyFlags properties, VulkanAllocation * allocation)
+{
+	VkMemoryRequirements memReq;
+	vkGetImageMemoryRequirements(vulkanDevice->GetDevice(), image, &memReq);
+
+	if (!Allocate(memReq, properties, MEMORY_RESOURCE_IMAGE, allocation))
+		return false;
+
+	VkResult result = vkBindImageMemory(vulkanDevice->GetDevice(), image, allocation->memory, allocation->offset);
+	if (result != VK_SUCCESS)
+	{
+		Free(allocation);
+		return false;
+	}
+
+	return true;
+}
+
+void VulkanMemoryAllocator::Free(VulkanAllocation * allocation)
+{
+	if (allocation->block == NULL)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	VulkanMemoryBlock * block = allocation->block;
+	std::vector<VulkanMemoryBlock*> & pool = pools[block->resourceType][block->memoryTypeIndex];
+
+	block->allocationCount--;
+	block->usedSize -= allocation->size;
+
+	if (block->dedicated)
+	{
+		pool.erase(std::find(pool.begin(), pool.end(), block));
+		DestroyBlock(block);
+	}
+	else
+	{
+		FreeInBlock(block, allocation->offset, allocation->order);
+
+		// Keep one empty block around so loading and unloading a single model doesn't allocate every time
+		if (block->allocationCount == 0)
+		{
+			unsigned int emptyBlocks = 0;
+			for (unsigned int i = 0; i < pool.size(); i++)
+				if (!pool[i]->dedicated && pool[i]->allocationCount == 0)
+					emptyBlocks++;
+
+			if (emptyBlocks > 1)
+			{
+				pool.erase(std::find(pool.begin(), pool.end(), block));
+				DestroyBlock(block);
+			}
+		}
+	}
+
+	*allocation = VulkanAllocation();
+}
+
+void VulkanMemoryAllocator::Defragment()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	VkDeviceSize releasedBytes = 0;
+	uint32_t releasedBlocks = 0;
+
+	// Live resources are bound to their memory, so only the empty blocks left behind can be given back
+	for (int i = 0; i < MEMORY_RESOURCE_TYPE_COUNT; i++)
+	{
+		for (int j = 0; j < VK_MAX_MEMORY_TYPES; j++)
+		{
+			std::vector<VulkanMemoryBlock*> & pool = pools[i][j];
+			for (unsigned int k = 0; k < pool.size(); )
+			{
+				if (pool[k]->allocationCount == 0)
+				{
+					releasedBytes += pool[k]->size;
+					releasedBlocks++;
+					DestroyBlock(pool[k]);
+					pool.erase(pool.begin() + k);
+				}
+				else
+					k++;
+			}
+		}
+	}
+
+	if (releasedBlocks > 0)
+	{
+		char msg[128];
+		sprintf(msg, "Memory allocator: released %u empty blocks (%.2f MB)", releasedBlocks, releasedBytes / (1024.0f * 1024.0f));
+		gLogManager->AddMessage(msg);
+	}
+}
+
+MemoryHeapStatistics VulkanMemoryAllocator::GetStatistics(uint32_t heapIndex)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	MemoryHeapStatistics stats{};
+
+	for (int i = 0; i < MEMORY_RESOURCE_TYPE_COUNT; i++)
+	{
+		for (uint32_t j = 0; j < memoryProperties.memoryTypeCount; j++)
+		{
+			if (memoryProperties.memoryTypes[j].heapIndex != heapIndex)
+				continue;
+
+			for (unsigned int k = 0; k < pools[i][j].size(); k++)
+			{
+				VulkanMemoryBlock * block = pools[i][j][k];
+
+				stats.blockCount++;
+				stats.allocationCount += block->allocationCount;
+				stats.blockBytes += block->size;
+				stats.usedBytes += block->usedSize;
+
+				for (unsigned int order = 0; order < block->freeRanges.size(); order++)
+				{
+					VkDeviceSize rangeSize = (VkDeviceSize)MEMORY_MIN_ALLOCATION_SIZE << order;
+
+					stats.freeBytes += rangeSize * block->freeRanges[order].size();
+					if (!block->freeRanges[order].empty() && rangeSize > stats.largestFreeRange)
+						stats.largestFreeRange = rangeSize;
+				}
+			}
+		}
+	}
+
+	// 0 when all free memory is one range, close to 1 when it's scattered in small pieces
+	if (stats.freeBytes > 0)
+		stats.fragmentation = 1.0f - (float)stats.largestFreeRange / (float)stats.freeBytes;
+
+	return stats;
+}
+
+void VulkanMemoryAllocator::LogStatistics()
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		MemoryHeapStatistics stats = GetStatistics(i);
+		if (stats.blockCount == 0)
+			continue;
+
+		bool deviceLocal = ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0);
+		const float mb = 1024.0f * 1024.0f;
+
+		char msg[256];
+		sprintf(msg, "MEM HEAP %u%s: BLOCKS: %u ALLOCS: %u RESERVED: %.2f MB USED: %.2f MB FREE: %.2f MB FRAG: %.1f%%", i,
+			(deviceLocal ? " (DEVICE LOCAL)" : ""), stats.blockCount, stats.allocationCount, stats.blockBytes / mb,
+			stats.usedBytes / mb, stats.freeBytes / mb, stats.fragmentation * 100.0f);
+		gLogManager->AddMessage(msg);
+	}
+}
+
+VulkanMemoryBlock * VulkanMemoryAllocator::CreateBlock(uint32_t memoryTypeIndex, MEMORY_RESOURCE_TYPE resourceType, VkDeviceSize size, bool dedicated)
+{
+	VkResult result;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VulkanMemoryBlock * block = new VulkanMemoryBlock();
+	block->memory = VK_NULL_HANDLE;
+	block->size = size;
+	block->mappedData = NULL;
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->resourceType = resourceType;
+	block->dedicated = dedicated;
+	block->allocationCount = 0;
+	block->usedSize = 0;
+
+	result = vkAllocateMemory(vulkanDevice->GetDevice(), &allocInfo, VK_NULL_HANDLE, &block->memory);
+	if (result != VK_SUCCESS)
+	{
+		gLogManager->AddMessage("ERROR: Failed to allocate a device memory block!");
+		delete block;
+		return NULL;
+	}
+
+	// Suballocations can't be mapped on their own, so host visible blocks are mapped once for good
+	if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		result = vkMapMemory(vulkanDevice->GetDevice(), block->memory, 0, VK_WHOLE_SIZE, 0, (void**)&block->mappedData);
+		if (result != VK_SUCCESS)
+		{
+			gLogManager->AddMessage("ERROR: Failed to map a device memory block!");
+			DestroyBlock(block);
+			return NULL;
+		}
+	}
+
+	if (!dedicated)
+	{
+		uint32_t maxOrder = GetOrder(size);
+		block->freeRanges.resize(maxOrder + 1);
+		block->freeRanges[maxOrder].insert(0);
+	}
+
+	return block;
+}
+
+void VulkanMemoryAllocator::DestroyBlock(VulkanMemoryBlock * block)
+{
+	if (block->mappedData)
+		vkUnmapMemory(vulkanDevice->GetDevice(), block->memory);
+
+	vkFreeMemory(vulkanDevice->GetDevice(), block->memory, VK_NULL_HANDLE);
+	delete block;
+}
+
+bool VulkanMemoryAllocator::AllocateFromBlock(VulkanMemoryBlock * block, uint32_t order, VkDeviceSize * offset)
+{
+	uint32_t maxOrder = (uint32_t)block->freeRanges.size() - 1;
+
+	// Smallest free range that fits
+	uint32_t freeOrder = order;
+	while (freeOrder <= maxOrder && block->freeRanges[freeOrder].empty())
+		freeOrder++;
+
+	if (freeOrder > maxOrder)
+		return false;
+
+	VkDeviceSize start = *block->freeRanges[freeOrder].begin();
+	block->freeRanges[freeOrder].erase(block->freeRanges[freeOrder].begin());
+
+	// Split it down to the requested size, the upper halves become free buddies
+	while (freeOrder > order)
+	{
+		freeOrder--;
+		block->freeRanges[freeOrder].insert(start + ((VkDeviceSize)MEMORY_MIN_ALLOCATION_SIZE << freeOrder));
+	}
+
+	*offset = start;
+	return true;
+}
+
+void VulkanMemoryAllocator::FreeInBlock(VulkanMemoryBlock * block, VkDeviceSize offset, uint32_t order)
+{
+	uint32_t maxOrder = (uint32_t)block->freeRanges.size() - 1;
+
+	// Merge with the buddy for as long as it's free too
+	while (order < maxOrder)
+	{
+		VkDeviceSize buddy = offset ^ ((VkDeviceSize)MEMORY_MIN_ALLOCATION_SIZE << order);
+
+		std::set<VkDeviceSize>::iterator it = block->freeRanges[order].find(buddy);
+		if (it == block->freeRanges[order].end())
+			break;
+
+		block->freeRanges[order].erase(it);
+		offset = (offset < buddy ? offset : buddy);
+		order++;
+	}
+
+	block->freeRanges[order].insert(offset);
+}
+
+uint32_t VulkanMemoryAllocator::GetOrder(VkDeviceSize size)
+{
+	uint32_t order = 0;
+	while (((VkDeviceSize)MEMORY_MIN_ALLOCATION_SIZE << order) < size)
+		order++;
+
+	return order;
+}
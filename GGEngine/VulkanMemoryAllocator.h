@@ -0,0 +1,90 @@
+#pragma once
+
+#include <set>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Smallest piece a block is split into, every allocation is a power of two multiple of it
+#define MEMORY_MIN_ALLOCATION_SIZE 256
+// Size of the blocks resources are carved out of, anything bigger than half of it gets its own allocation
+#define MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
+
+class VulkanDevice;
+
+enum MEMORY_RESOURCE_TYPE
+{
+	MEMORY_RESOURCE_BUFFER,
+	MEMORY_RESOURCE_IMAGE,
+	MEMORY_RESOURCE_TYPE_COUNT
+};
+
+// One vkAllocateMemory, split with a buddy allocator, the free ranges of each order are kept so buddies can be merged
+struct VulkanMemoryBlock
+{
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint8_t * mappedData;
+	uint32_t memoryTypeIndex;
+	MEMORY_RESOURCE_TYPE resourceType;
+	bool dedicated;
+	uint32_t allocationCount;
+	VkDeviceSize usedSize;
+	std::vector<std::set<VkDeviceSize>> freeRanges;
+};
+
+// Piece of a block a resource is bound to, host visible memory is mapped for the block's lifetime
+struct VulkanAllocation
+{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint8_t * mappedData;
+	VulkanMemoryBlock * block;
+	uint32_t order;
+
+	VulkanAllocation() { memory = VK_NULL_HANDLE; offset = 0; size = 0; mappedData = NULL; block = NULL; order = 0; }
+};
+
+struct MemoryHeapStatistics
+{
+	uint32_t blockCount;
+	uint32_t allocationCount;
+	VkDeviceSize blockBytes;
+	VkDeviceSize usedBytes;
+	VkDeviceSize freeBytes;
+	VkDeviceSize largestFreeRange;
+	float fragmentation;
+};
+
+class VulkanMemoryAllocator
+{
+	private:
+		VulkanDevice * vulkanDevice;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize bufferImageGranularity;
+		bool separateImagePools;
+		std::vector<VulkanMemoryBlock*> pools[MEMORY_RESOURCE_TYPE_COUNT][VK_MAX_MEMORY_TYPES];
+		VkDeviceSize blockSizes[VK_MAX_MEMORY_TYPES];
+		std::mutex mutex;
+	private:
+		VulkanMemoryBlock * CreateBlock(uint32_t memoryTypeIndex, MEMORY_RESOURCE_TYPE resourceType, VkDeviceSize size, bool dedicated);
+		void DestroyBlock(VulkanMemoryBlock * block);
+		bool AllocateFromBlock(VulkanMemoryBlock * block, uint32_t order, VkDeviceSize * offset);
+		void FreeInBlock(VulkanMemoryBlock * block, VkDeviceSize offset, uint32_t order);
+		uint32_t GetOrder(VkDeviceSize size);
+	public:
+		VulkanMemoryAllocator();
+		~VulkanMemoryAllocator();
+
+		bool Init(VulkanDevice * vulkanDevice);
+		void Unload();
+		bool Allocate(const VkMemoryRequirements & memReq, VkMemoryPropertyFlags properties, MEMORY_RESOURCE_TYPE resourceType,
+			VulkanAllocation * allocation);
+		bool AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags properties, VulkanAllocation * allocation);
+		bool AllocateImageMemory(VkImage image, VkMemoryPropertyFlags properties, VulkanAllocation * allocation);
+		void Free(VulkanAllocation * allocation);
+		void Defragment();
+		MemoryHeapStatistics GetStatistics(uint32_t heapIndex);
+		void LogStatistics();
+};
\ No newline at end of file
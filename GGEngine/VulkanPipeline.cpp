@@ -1,11 +1,35 @@
+#include <algorithm>
+
 #include "VulkanPipeline.h"
 
+bool DescriptorKeyEntry::operator==(const DescriptorKeyEntry & other) const
+{
+	return binding == other.binding && descriptorType == other.descriptorType && buffer == other.buffer && offset == other.offset &&
+		range == other.range && sampler == other.sampler && imageView == other.imageView && imageLayout == other.imageLayout;
+}
+
+size_t DescriptorSetKeyHash::operator()(const DescriptorSetKey & key) const
+{
+	size_t hash = key.size();
+	for (unsigned int i = 0; i < key.size(); i++)
+	{
+		size_t entryHash[] = { std::hash<uint32_t>()(key[i].binding), std::hash<VkBuffer>()(key[i].buffer),
+			std::hash<VkDeviceSize>()(key[i].offset), std::hash<VkSampler>()(key[i].sampler), std::hash<VkImageView>()(key[i].imageView) };
+
+		for (unsigned int j = 0; j < sizeof(entryHash) / sizeof(entryHash[0]); j++)
+			hash ^= entryHash[j] + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	return hash;
+}
+
 VulkanPipeline::VulkanPipeline()
 {
 	descriptorLayout = VK_NULL_HANDLE;
 	pipelineLayout = VK_NULL_HANDLE;
 	pipeline = VK_NULL_HANDLE;
 	descriptorPool = VK_NULL_HANDLE;
+	vertexBindingCount = 0;
 }
 
 VulkanPipeline::~VulkanPipeline()
@@ -23,9 +47,23 @@ bool VulkanPipeline::Init(VulkanInterface * vulkan, VulkanPipelineCI * pipelineC
 	pipelineName = pipelineCI->pipelineName;
 
 	// Vertex layout
-	vertexBinding.binding = 0;
-	vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-	vertexBinding.stride = (uint32_t)pipelineCI->strideSize;
+	vertexBindings[0].binding = 0;
+	vertexBindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	vertexBindings[0].stride = (uint32_t)pipelineCI->strideSize;
+	vertexBindingCount = 1;
+
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes(pipelineCI->vertexLayout, pipelineCI->vertexLayout + pipelineCI->numVertexLayout);
+
+	// Instanced pipelines step a second buffer once per instance
+	if (pipelineCI->numInstanceLayout > 0)
+	{
+		vertexBindings[1].binding = 1;
+		vertexBindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		vertexBindings[1].stride = (uint32_t)pipelineCI->instanceStrideSize;
+		vertexBindingCount = 2;
+
+		vertexAttributes.insert(vertexAttributes.end(), pipelineCI->instanceLayout, pipelineCI->instanceLayout + pipelineCI->numInstanceLayout);
+	}
 
 	// Pipeline layout
 	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
@@ -37,35 +75,53 @@ bool VulkanPipeline::Init(VulkanInterface * vulkan, VulkanPipelineCI * pipelineC
 	if (result != VK_SUCCESS)
 		return false;
 
+	// Set 0 is the pipeline's own, shared sets like the bindless textures follow it
+	std::vector<VkDescriptorSetLayout> pipelineSetLayouts;
+	pipelineSetLayouts.push_back(descriptorLayout);
+	for (uint32_t i = 0; i < pipelineCI->numExtraSetLayouts; i++)
+		pipelineSetLayouts.push_back(pipelineCI->extraSetLayouts[i]);
+
 	VkPipelineLayoutCreateInfo pipelineLayoutCI{};
 	pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCI.setLayoutCount = 1;
-	pipelineLayoutCI.pSetLayouts = &descriptorLayout;
+	pipelineLayoutCI.setLayoutCount = (uint32_t)pipelineSetLayouts.size();
+	pipelineLayoutCI.pSetLayouts = pipelineSetLayouts.data();
+	pipelineLayoutCI.pushConstantRangeCount = pipelineCI->numPushConstantRanges;
+	pipelineLayoutCI.pPushConstantRanges = pipelineCI->pushConstantRanges;
 
 	result = vkCreatePipelineLayout(vulkan->GetVulkanDevice()->GetDevice(), &pipelineLayoutCI, VK_NULL_HANDLE, &pipelineLayout);
 	if (result != VK_SUCCESS)
 		return false;
 
 	
-	// Descriptor pool
+	// Descriptor pool, one set per frame in flight
+	setPoolSizes.assign(pipelineCI->typeCounts, pipelineCI->typeCounts + pipelineCI->numLayoutBindings);
+
+	std::vector<VkDescriptorPoolSize> poolSizes(setPoolSizes);
+	for (unsigned int i = 0; i < poolSizes.size(); i++)
+		poolSizes[i].descriptorCount *= MAX_FRAMES_IN_FLIGHT;
+
 	VkDescriptorPoolCreateInfo descriptorPoolCI{};
 	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descriptorPoolCI.maxSets = 1;
-	descriptorPoolCI.poolSizeCount = pipelineCI->numLayoutBindings;
-	descriptorPoolCI.pPoolSizes = pipelineCI->typeCounts;
+	descriptorPoolCI.maxSets = MAX_FRAMES_IN_FLIGHT;
+	descriptorPoolCI.poolSizeCount = (uint32_t)poolSizes.size();
+	descriptorPoolCI.pPoolSizes = poolSizes.data();
 
 	result = vkCreateDescriptorPool(vulkan->GetVulkanDevice()->GetDevice(), &descriptorPoolCI, VK_NULL_HANDLE, &descriptorPool);
 	if (result != VK_SUCCESS)
 		return false;
 
-	// Descriptor set
+	// Descriptor sets
+	VkDescriptorSetLayout setLayouts[MAX_FRAMES_IN_FLIGHT];
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		setLayouts[i] = descriptorLayout;
+
 	VkDescriptorSetAllocateInfo descSetAllocInfo[1];
 	descSetAllocInfo[0].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	descSetAllocInfo[0].pNext = NULL;
 	descSetAllocInfo[0].descriptorPool = descriptorPool;
-	descSetAllocInfo[0].descriptorSetCount = 1;
-	descSetAllocInfo[0].pSetLayouts = &descriptorLayout;
-	result = vkAllocateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), descSetAllocInfo, &descriptorSet);
+	descSetAllocInfo[0].descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+	descSetAllocInfo[0].pSetLayouts = setLayouts;
+	result = vkAllocateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), descSetAllocInfo, descriptorSets);
 	if (result != VK_SUCCESS)
 		return false;
 
@@ -83,10 +139,10 @@ bool VulkanPipeline::Init(VulkanInterface * vulkan, VulkanPipelineCI * pipelineC
 	vi.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vi.pNext = NULL;
 	vi.flags = 0;
-	vi.vertexBindingDescriptionCount = 1;
-	vi.pVertexBindingDescriptions = &vertexBinding;
-	vi.vertexAttributeDescriptionCount = pipelineCI->numVertexLayout;
-	vi.pVertexAttributeDescriptions = pipelineCI->vertexLayout;
+	vi.vertexBindingDescriptionCount = vertexBindingCount;
+	vi.pVertexBindingDescriptions = vertexBindings;
+	vi.vertexAttributeDescriptionCount = (uint32_t)vertexAttributes.size();
+	vi.pVertexAttributeDescriptions = vertexAttributes.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCI{};
 	inputAssemblyCI.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -228,22 +284,208 @@ bool VulkanPipeline::Init(VulkanInterface * vulkan, VulkanPipelineCI * pipelineC
 
 void VulkanPipeline::Unload(VulkanDevice * vulkanDevice)
 {
+	for (unsigned int i = 0; i < setPools.size(); i++)
+		vkDestroyDescriptorPool(vulkanDevice->GetDevice(), setPools[i], VK_NULL_HANDLE);
+	setPools.clear();
+	setPoolUsage.clear();
+	descriptorSetCache.clear();
+	retiredDescriptorSets.clear();
+
 	vkDestroyDescriptorPool(vulkanDevice->GetDevice(), descriptorPool, VK_NULL_HANDLE);
 	vkDestroyPipelineLayout(vulkanDevice->GetDevice(), pipelineLayout, VK_NULL_HANDLE);
 	vkDestroyDescriptorSetLayout(vulkanDevice->GetDevice(), descriptorLayout, VK_NULL_HANDLE);
 	vkDestroyPipeline(vulkanDevice->GetDevice(), pipeline, VK_NULL_HANDLE);
 }
 
-void VulkanPipeline::SetActive(VulkanCommandBuffer * commandBuffer)
+void VulkanPipeline::SetActive(VulkanCommandBuffer * commandBuffer, uint32_t frameIndex)
+{
+	vkCmdBindPipeline(commandBuffer->GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer->GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipelineLayout, 0, 1, &descriptorSets[frameIndex], 0, NULL);
+}
+
+void VulkanPipeline::SetActive(VulkanCommandBuffer * commandBuffer, VkDescriptorSet descriptorSet,
+	uint32_t dynamicOffsetCount, const uint32_t * dynamicOffsets)
 {
 	vkCmdBindPipeline(commandBuffer->GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 	vkCmdBindDescriptorSets(commandBuffer->GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS,
-		pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		pipelineLayout, 0, 1, &descriptorSet, dynamicOffsetCount, dynamicOffsets);
+}
+
+void VulkanPipeline::BindDescriptorSet(VulkanCommandBuffer * commandBuffer, uint32_t setIndex, VkDescriptorSet descriptorSet)
+{
+	vkCmdBindDescriptorSets(commandBuffer->GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipelineLayout, setIndex, 1, &descriptorSet, 0, NULL);
+}
+
+void VulkanPipeline::PushConstants(VulkanCommandBuffer * commandBuffer, VkShaderStageFlags stageFlags, uint32_t size, const void * data)
+{
+	vkCmdPushConstants(commandBuffer->GetCommandBuffer(), pipelineLayout, stageFlags, 0, size, data);
+}
+
+bool VulkanPipeline::AllocateDescriptorSet(VulkanDevice * vulkanDevice, VkDescriptorSet * descriptorSet, uint32_t * poolIndex)
+{
+	VkResult result;
+
+	// Freed sets go back to their pool, so the first one with room left is reused before a new one is added
+	uint32_t pool = 0;
+	while (pool < setPools.size() && setPoolUsage[pool] == DESCRIPTOR_SETS_PER_POOL)
+		pool++;
+
+	if (pool == setPools.size())
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes(setPoolSizes);
+		for (unsigned int i = 0; i < poolSizes.size(); i++)
+			poolSizes[i].descriptorCount *= DESCRIPTOR_SETS_PER_POOL;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCI{};
+		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		descriptorPoolCI.maxSets = DESCRIPTOR_SETS_PER_POOL;
+		descriptorPoolCI.poolSizeCount = (uint32_t)poolSizes.size();
+		descriptorPoolCI.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool setPool;
+		result = vkCreateDescriptorPool(vulkanDevice->GetDevice(), &descriptorPoolCI, VK_NULL_HANDLE, &setPool);
+		if (result != VK_SUCCESS)
+			return false;
+
+		setPools.push_back(setPool);
+		setPoolUsage.push_back(0);
+	}
+
+	VkDescriptorSetAllocateInfo descSetAllocInfo{};
+	descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descSetAllocInfo.descriptorPool = setPools[pool];
+	descSetAllocInfo.descriptorSetCount = 1;
+	descSetAllocInfo.pSetLayouts = &descriptorLayout;
+	result = vkAllocateDescriptorSets(vulkanDevice->GetDevice(), &descSetAllocInfo, descriptorSet);
+	if (result != VK_SUCCESS)
+		return false;
+
+	setPoolUsage[pool]++;
+	if (poolIndex)
+		*poolIndex = pool;
+
+	return true;
+}
+
+bool VulkanPipeline::GetCachedDescriptorSet(VulkanDevice * vulkanDevice, VkWriteDescriptorSet * writes, uint32_t writeCount, VkDescriptorSet * descriptorSet)
+{
+	// Key on the bindings and the resources they point at
+	DescriptorSetKey key;
+	for (uint32_t i = 0; i < writeCount; i++)
+	{
+		for (uint32_t j = 0; j < writes[i].descriptorCount; j++)
+		{
+			DescriptorKeyEntry entry{};
+			entry.binding = writes[i].dstBinding;
+			entry.descriptorType = writes[i].descriptorType;
+
+			if (writes[i].pBufferInfo)
+			{
+				entry.buffer = writes[i].pBufferInfo[j].buffer;
+				entry.offset = writes[i].pBufferInfo[j].offset;
+				entry.range = writes[i].pBufferInfo[j].range;
+			}
+			else if (writes[i].pImageInfo)
+			{
+				entry.sampler = writes[i].pImageInfo[j].sampler;
+				entry.imageView = writes[i].pImageInfo[j].imageView;
+				entry.imageLayout = writes[i].pImageInfo[j].imageLayout;
+			}
+
+			key.push_back(entry);
+		}
+	}
+
+	std::unordered_map<DescriptorSetKey, CachedDescriptorSet, DescriptorSetKeyHash>::iterator cachedSet = descriptorSetCache.find(key);
+	if (cachedSet != descriptorSetCache.end())
+	{
+		*descriptorSet = cachedSet->second.descriptorSet;
+		return true;
+	}
+
+	// Never written again after this, so it's safe to bind while older frames still use it
+	CachedDescriptorSet newSet;
+	if (!AllocateDescriptorSet(vulkanDevice, &newSet.descriptorSet, &newSet.poolIndex))
+		return false;
+
+	for (uint32_t i = 0; i < writeCount; i++)
+		writes[i].dstSet = newSet.descriptorSet;
+
+	vkUpdateDescriptorSets(vulkanDevice->GetDevice(), writeCount, writes, 0, NULL);
+
+	descriptorSetCache[key] = newSet;
+	*descriptorSet = newSet.descriptorSet;
+
+	return true;
+}
+
+void VulkanPipeline::EvictCachedDescriptorSets(const std::vector<VkImageView> & imageViews, const std::vector<VkBuffer> & buffers, uint64_t retireFrame)
+{
+	// Sets that point at a replaced or destroyed resource, its handle could come back for a different one.
+	// Frames in flight may still bind them, so they're freed at retireFrame
+	if (imageViews.empty() && buffers.empty())
+		return;
+
+	std::unordered_map<DescriptorSetKey, CachedDescriptorSet, DescriptorSetKeyHash>::iterator it = descriptorSetCache.begin();
+	while (it != descriptorSetCache.end())
+	{
+		bool evict = false;
+		for (unsigned int i = 0; i < it->first.size() && !evict; i++)
+		{
+			const DescriptorKeyEntry & entry = it->first[i];
+
+			if (entry.imageView != VK_NULL_HANDLE)
+				evict = (std::find(imageViews.begin(), imageViews.end(), entry.imageView) != imageViews.end());
+			else if (entry.buffer != VK_NULL_HANDLE)
+				evict = (std::find(buffers.begin(), buffers.end(), entry.buffer) != buffers.end());
+		}
+
+		if (!evict)
+		{
+			++it;
+			continue;
+		}
+
+		RetiredDescriptorSet retired;
+		retired.descriptorSet = it->second.descriptorSet;
+		retired.poolIndex = it->second.poolIndex;
+		retired.retireFrame = retireFrame;
+		retiredDescriptorSets.push_back(retired);
+
+		it = descriptorSetCache.erase(it);
+	}
+}
+
+void VulkanPipeline::FreeRetiredDescriptorSets(VulkanDevice * vulkanDevice, uint64_t frame)
+{
+	for (unsigned int i = 0; i < retiredDescriptorSets.size(); )
+	{
+		if (retiredDescriptorSets[i].retireFrame > frame)
+		{
+			i++;
+			continue;
+		}
+
+		uint32_t pool = retiredDescriptorSets[i].poolIndex;
+		vkFreeDescriptorSets(vulkanDevice->GetDevice(), setPools[pool], 1, &retiredDescriptorSets[i].descriptorSet);
+		setPoolUsage[pool]--;
+
+		retiredDescriptorSets[i] = retiredDescriptorSets.back();
+		retiredDescriptorSets.pop_back();
+	}
+}
+
+size_t VulkanPipeline::GetCachedDescriptorSetCount()
+{
+	return descriptorSetCache.size();
 }
 
-VkDescriptorSet VulkanPipeline::GetDescriptorSet()
+VkDescriptorSet VulkanPipeline::GetDescriptorSet(uint32_t frameIndex)
 {
-	return descriptorSet;
+	return descriptorSets[frameIndex];
 }
 
 VkDescriptorSetLayout * VulkanPipeline::GetDescriptorLayout()
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "VulkanInterface.h"
 #include "Shader.h"
 
+// Sets in every pool AllocateDescriptorSet() creates
+#define DESCRIPTOR_SETS_PER_POOL 64
+
 struct VulkanPipelineCI
 {
 	std::string pipelineName;
@@ -10,6 +15,10 @@ struct VulkanPipelineCI
 	VulkanRenderpass * vulkanRenderpass;
 	VkVertexInputAttributeDescription * vertexLayout;
 	uint32_t numVertexLayout;
+	// Optional, attributes read once per instance from binding 1
+	VkVertexInputAttributeDescription * instanceLayout;
+	uint32_t numInstanceLayout;
+	size_t instanceStrideSize;
 	VkDescriptorSetLayoutBinding * layoutBindings;
 	uint32_t numLayoutBindings;
 	size_t strideSize;
@@ -19,18 +28,67 @@ struct VulkanPipelineCI
 	VkCullModeFlags cullMode;
 	bool transparencyEnabled;
 	bool depthBiasEnabled;
+	VkDescriptorSetLayout * extraSetLayouts;
+	uint32_t numExtraSetLayouts;
+	VkPushConstantRange * pushConstantRanges;
+	uint32_t numPushConstantRanges;
+};
+
+// One descriptor a cached set was written with, unused fields of the other descriptor kind stay null
+struct DescriptorKeyEntry
+{
+	uint32_t binding;
+	VkDescriptorType descriptorType;
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize range;
+	VkSampler sampler;
+	VkImageView imageView;
+	VkImageLayout imageLayout;
+
+	bool operator==(const DescriptorKeyEntry & other) const;
+};
+
+typedef std::vector<DescriptorKeyEntry> DescriptorSetKey;
+
+struct DescriptorSetKeyHash
+{
+	size_t operator()(const DescriptorSetKey & key) const;
 };
 
 class VulkanPipeline
 {
 	private:
-		VkVertexInputBindingDescription vertexBinding;
+		VkVertexInputBindingDescription vertexBindings[2];
+		uint32_t vertexBindingCount;
 		VkDescriptorSetLayout descriptorLayout;
 		VkPipelineLayout pipelineLayout;
 		VkDescriptorPool descriptorPool;
-		VkDescriptorSet descriptorSet;
+		VkDescriptorSet descriptorSets[MAX_FRAMES_IN_FLIGHT];
 		VkPipeline pipeline;
 
+		struct CachedDescriptorSet
+		{
+			VkDescriptorSet descriptorSet;
+			uint32_t poolIndex;
+		};
+
+		struct RetiredDescriptorSet
+		{
+			VkDescriptorSet descriptorSet;
+			uint32_t poolIndex;
+			uint64_t retireFrame;
+		};
+
+		// Pools for the sets objects allocate for themselves, a new one is added when all of them are full
+		std::vector<VkDescriptorPoolSize> setPoolSizes;
+		std::vector<VkDescriptorPool> setPools;
+		std::vector<uint32_t> setPoolUsage;
+
+		// Written once, keyed by the content of their writes. Evicted sets are freed once no frame in flight binds them
+		std::unordered_map<DescriptorSetKey, CachedDescriptorSet, DescriptorSetKeyHash> descriptorSetCache;
+		std::vector<RetiredDescriptorSet> retiredDescriptorSets;
+
 		std::string pipelineName;
 	public:
 		VulkanPipeline();
@@ -38,8 +96,17 @@ class VulkanPipeline
 
 		bool Init(VulkanInterface * vulkan, VulkanPipelineCI * pipelineCI);
 		void Unload(VulkanDevice * vulkanDevice);
-		void SetActive(VulkanCommandBuffer * commandBuffer);
-		VkDescriptorSet GetDescriptorSet();
+		void SetActive(VulkanCommandBuffer * commandBuffer, uint32_t frameIndex);
+		void SetActive(VulkanCommandBuffer * commandBuffer, VkDescriptorSet descriptorSet,
+			uint32_t dynamicOffsetCount = 0, const uint32_t * dynamicOffsets = NULL);
+		void BindDescriptorSet(VulkanCommandBuffer * commandBuffer, uint32_t setIndex, VkDescriptorSet descriptorSet);
+		void PushConstants(VulkanCommandBuffer * commandBuffer, VkShaderStageFlags stageFlags, uint32_t size, const void * data);
+		bool AllocateDescriptorSet(VulkanDevice * vulkanDevice, VkDescriptorSet * descriptorSet, uint32_t * poolIndex = NULL);
+		bool GetCachedDescriptorSet(VulkanDevice * vulkanDevice, VkWriteDescriptorSet * writes, uint32_t writeCount, VkDescriptorSet * descriptorSet);
+		void EvictCachedDescriptorSets(const std::vector<VkImageView> & imageViews, const std::vector<VkBuffer> & buffers, uint64_t retireFrame);
+		void FreeRetiredDescriptorSets(VulkanDevice * vulkanDevice, uint64_t frame);
+		size_t GetCachedDescriptorSetCount();
+		VkDescriptorSet GetDescriptorSet(uint32_t frameIndex);
 		VkDescriptorSetLayout * GetDescriptorLayout();
 		VkPipelineLayout GetPipelineLayout();
 		std::string GetPipelineName();
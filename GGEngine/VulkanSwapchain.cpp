@@ -175,7 +175,7 @@ void VulkanSwapchain::Present(VulkanDevice * vulkanDevice, VkSemaphore waitSemap
 	present.waitSemaphoreCount = 1;
 	present.pWaitSemaphores = &waitSemaphore;
 	present.pResults = VK_NULL_HANDLE;
-	vkQueuePresentKHR(vulkanDevice->GetQueue(), &present);
+	vulkanDevice->Present(&present);
 }
 
 VkImage VulkanSwapchain::GetCurrentImage()
@@ -1,14 +1,17 @@
 #include "WireframeModel.h"
 #include "StdInc.h"
 #include "Settings.h"
+#include "LogManager.h"
 
 extern Settings * gSettings;
+extern LogManager * gLogManager;
 
 WireframeModel::WireframeModel()
 {
 	vertexBuffer = NULL;
 	indexBuffer = NULL;
-	vsUBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		vsUBO[i] = NULL;
 
 	posX = posY = posZ = 0.0f;
 	rotX = rotY = rotZ = 0.0f;
@@ -16,7 +19,8 @@ WireframeModel::WireframeModel()
 
 WireframeModel::~WireframeModel()
 {
-	vsUBO = NULL;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		vsUBO[i] = NULL;
 	indexBuffer = NULL;
 	vertexBuffer = NULL;
 }
@@ -24,7 +28,6 @@ WireframeModel::~WireframeModel()
 bool WireframeModel::Init(VulkanInterface * vulkan, GEOMETRY_GENERATE_INFO generateInfo, glm::vec4 color)
 {
 	VulkanDevice * vulkanDevice = vulkan->GetVulkanDevice();
-	VulkanCommandPool * cmdPool = vulkan->GetVulkanCommandPool();
 
 	Vertex * vertexData;
 	uint32_t * indexData;
@@ -313,46 +316,37 @@ bool WireframeModel::Init(VulkanInterface * vulkan, GEOMETRY_GENERATE_INFO gener
 		vertexData[i].a = color.a;
 	}
 
-	// Command buffer used for creating buffers
-	VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
-	if (!cmdBuffer->Init(vulkanDevice, cmdPool, true))
-		return false;
-
-	cmdBuffer->BeginRecording();
-
 	// Vertex buffer
 	vertexBuffer = new VulkanBuffer();
 	if (!vertexBuffer->Init(vulkanDevice, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexData,
-		sizeof(Vertex) * vertexCount, true, cmdBuffer))
+		sizeof(Vertex) * vertexCount, true))
 		return false;
 
 	// Index buffer
 	indexBuffer = new VulkanBuffer();
 	if (!indexBuffer->Init(vulkanDevice, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexData,
-		sizeof(uint32_t) * indexCount, true, cmdBuffer))
+		sizeof(uint32_t) * indexCount, true))
 		return false;
 
-	cmdBuffer->EndRecording();
-	cmdBuffer->Execute(vulkanDevice, true, VK_NULL_HANDLE, VK_NULL_HANDLE, true);
-
-	SAFE_UNLOAD(cmdBuffer, vulkanDevice, cmdPool);
-
 	delete[] vertexData;
 	delete[] indexData;
 
 	// Uniform buffer init
 	vertexUniformBuffer.MVP = glm::mat4();
 
-	// Vertex shader Uniform buffer
-	vsUBO = new VulkanBuffer();
-	if (!vsUBO->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer,
-		sizeof(vertexUniformBuffer), false))
-		return false;
+	// Vertex shader Uniform buffer for each frame in flight
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vsUBO[i] = new VulkanBuffer();
+		if (!vsUBO[i]->Init(vulkanDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vertexUniformBuffer,
+			sizeof(vertexUniformBuffer), false))
+			return false;
+	}
 
 	worldMatrix = glm::mat4(1.0f);
 
 	// Init draw command buffers
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
 		VulkanCommandBuffer * cmdBuffer = new VulkanCommandBuffer();
 		if (!cmdBuffer->Init(vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool(), false))
@@ -366,37 +360,41 @@ bool WireframeModel::Init(VulkanInterface * vulkan, GEOMETRY_GENERATE_INFO gener
 
 void WireframeModel::Unload(VulkanInterface * vulkan)
 {
-	for (size_t i = 0; i < vulkan->GetVulkanSwapchain()->GetSwapchainBufferCount(); i++)
+	for (size_t i = 0; i < drawCmdBuffers.size(); i++)
 		SAFE_UNLOAD(drawCmdBuffers[i], vulkan->GetVulkanDevice(), vulkan->GetVulkanCommandPool());
 
-	SAFE_UNLOAD(vsUBO, vulkan->GetVulkanDevice());
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		SAFE_UNLOAD(vsUBO[i], vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(indexBuffer, vulkan->GetVulkanDevice());
 	SAFE_UNLOAD(vertexBuffer, vulkan->GetVulkanDevice());
 }
 
 void WireframeModel::Render(VulkanInterface * vulkan, VulkanCommandBuffer * commandBuffer, VulkanPipeline * pipeline, Camera * camera, int framebufferId)
 {
+	uint32_t frameIndex = vulkan->GetFrameIndex();
+	VulkanCommandBuffer * drawCmdBuffer = drawCmdBuffers[frameIndex];
+
 	// Update vertex uniform buffer
 	vertexUniformBuffer.MVP = camera->GetProjectionMatrix() * camera->GetViewMatrix() * worldMatrix;
 
-	vsUBO->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(VertexUniformBuffer));
+	vsUBO[frameIndex]->Update(vulkan->GetVulkanDevice(), &vertexUniformBuffer, sizeof(VertexUniformBuffer));
 
-	UpdateDescriptorSet(vulkan, pipeline);
+	VkDescriptorSet descriptorSet = GetDescriptorSet(vulkan, pipeline);
 
 	// Render
-	drawCmdBuffers[framebufferId]->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer(framebufferId));
-	vulkan->InitViewportAndScissors(drawCmdBuffers[framebufferId], (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
+	drawCmdBuffer->BeginRecordingSecondary(vulkan->GetForwardRenderpass()->GetRenderpass(), vulkan->GetVulkanSwapchain()->GetFramebuffer(framebufferId));
+	vulkan->InitViewportAndScissors(drawCmdBuffer, (float)gSettings->GetWindowWidth(), (float)gSettings->GetWindowHeight(),
 		(uint32_t)gSettings->GetWindowWidth(), (uint32_t)gSettings->GetWindowHeight());
-	pipeline->SetActive(drawCmdBuffers[framebufferId]);
+	pipeline->SetActive(drawCmdBuffer, descriptorSet);
 
 	VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindVertexBuffers(drawCmdBuffers[framebufferId]->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
-	vkCmdBindIndexBuffer(drawCmdBuffers[framebufferId]->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindVertexBuffers(drawCmdBuffer->GetCommandBuffer(), 0, 1, vertexBuffer->GetBuffer(), offsets);
+	vkCmdBindIndexBuffer(drawCmdBuffer->GetCommandBuffer(), *indexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdDrawIndexed(drawCmdBuffers[framebufferId]->GetCommandBuffer(), indexCount, 1, 0, 0, 0);
+	vkCmdDrawIndexed(drawCmdBuffer->GetCommandBuffer(), indexCount, 1, 0, 0, 0);
 
-	drawCmdBuffers[framebufferId]->EndRecording();
-	drawCmdBuffers[framebufferId]->ExecuteSecondary(commandBuffer);
+	drawCmdBuffer->EndRecording();
+	drawCmdBuffer->ExecuteSecondary(commandBuffer);
 }
 
 void WireframeModel::SetPosition(float x, float y, float z)
@@ -423,19 +421,26 @@ void WireframeModel::UpdateWorldMatrix()
 	worldMatrix = glm::rotate(worldMatrix, glm::radians(rotZ), glm::vec3(0.0f, 0.0f, 1.0f));
 }
 
-void WireframeModel::UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline)
+VkDescriptorSet WireframeModel::GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline)
 {
+	uint32_t frameIndex = vulkan->GetFrameIndex();
 	VkWriteDescriptorSet descriptorWrite[1];
 
 	descriptorWrite[0] = {};
 	descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	descriptorWrite[0].pNext = NULL;
-	descriptorWrite[0].dstSet = pipeline->GetDescriptorSet();
 	descriptorWrite[0].descriptorCount = 1;
 	descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	descriptorWrite[0].pBufferInfo = vsUBO->GetBufferInfo();
+	descriptorWrite[0].pBufferInfo = vsUBO[frameIndex]->GetBufferInfo();
 	descriptorWrite[0].dstArrayElement = 0;
 	descriptorWrite[0].dstBinding = 0;
 
-	vkUpdateDescriptorSets(vulkan->GetVulkanDevice()->GetDevice(), sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, NULL);
+	VkDescriptorSet descriptorSet;
+	if (!pipeline->GetCachedDescriptorSet(vulkan->GetVulkanDevice(), descriptorWrite, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), &descriptorSet))
+	{
+		gLogManager->AddMessage("ERROR: Failed to get a descriptor set for a wireframe model!");
+		THROW_ERROR();
+	}
+
+	return descriptorSet;
 }
\ No newline at end of file
@@ -46,12 +46,12 @@ class WireframeModel
 			glm::mat4 MVP;
 		};
 		VertexUniformBuffer vertexUniformBuffer;
-		VulkanBuffer * vsUBO;
+		VulkanBuffer * vsUBO[MAX_FRAMES_IN_FLIGHT];
 
 		std::vector<VulkanCommandBuffer*> drawCmdBuffers;
 	private:
 		void UpdateWorldMatrix();
-		void UpdateDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline);
+		VkDescriptorSet GetDescriptorSet(VulkanInterface * vulkan, VulkanPipeline * pipeline);
 	public:
 		WireframeModel();
 		~WireframeModel();
@@ -0,0 +1,103 @@
+#include <string.h>
+
+#include "Lz4Compression.h"
+
+// LZ4 block rules: matches are at least 4 bytes, the last 5 bytes are always literals
+// and no match starts within the last 12 bytes
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define MATCH_START_LIMIT 12
+#define MAX_OFFSET 65535
+
+#define HASH_BITS 16
+#define NO_POSITION UINT32_MAX
+
+static void WriteLength(std::vector<uint8_t> & output, size_t length)
+{
+	// Lengths from 15 on continue in extra bytes, 255 means another byte follows
+	length -= 15;
+	while (length >= 255)
+	{
+		output.push_back(255);
+		length -= 255;
+	}
+	output.push_back((uint8_t)length);
+}
+
+static void WriteSequence(std::vector<uint8_t> & output, const uint8_t * literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength - MIN_MATCH;
+
+	uint8_t token = (uint8_t)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+	output.push_back(token);
+
+	if (literalLength >= 15)
+		WriteLength(output, literalLength);
+	output.insert(output.end(), literals, literals + literalLength);
+
+	output.push_back((uint8_t)(offset & 0xFF));
+	output.push_back((uint8_t)(offset >> 8));
+
+	if (matchCode >= 15)
+		WriteLength(output, matchCode);
+}
+
+static void WriteLastLiterals(std::vector<uint8_t> & output, const uint8_t * literals, size_t literalLength)
+{
+	output.push_back((uint8_t)((literalLength < 15 ? literalLength : 15) << 4));
+
+	if (literalLength >= 15)
+		WriteLength(output, literalLength);
+	output.insert(output.end(), literals, literals + literalLength);
+}
+
+static uint32_t HashSequence(const uint8_t * data)
+{
+	uint32_t sequence;
+	memcpy(&sequence, data, sizeof(uint32_t));
+
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+std::vector<uint8_t> CompressLz4Block(const uint8_t * data, size_t size)
+{
+	std::vector<uint8_t> output;
+	output.reserve(size + size / 255 + 16);
+
+	// Last position each hashed 4 byte sequence was seen at
+	std::vector<uint32_t> positions(1 << HASH_BITS, NO_POSITION);
+
+	size_t anchor = 0;
+	size_t position = 0;
+
+	if (size > MATCH_START_LIMIT)
+	{
+		size_t matchLimit = size - LAST_LITERALS;
+
+		while (position + MATCH_START_LIMIT <= size)
+		{
+			uint32_t hash = HashSequence(data + position);
+			uint32_t candidate = positions[hash];
+			positions[hash] = (uint32_t)position;
+
+			if (candidate == NO_POSITION || position - candidate > MAX_OFFSET || memcmp(data + candidate, data + position, MIN_MATCH) != 0)
+			{
+				position++;
+				continue;
+			}
+
+			size_t matchLength = MIN_MATCH;
+			while (position + matchLength < matchLimit && data[candidate + matchLength] == data[position + matchLength])
+				matchLength++;
+
+			WriteSequence(output, data + anchor, position - anchor, position - candidate, matchLength);
+
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	WriteLastLiterals(output, data + anchor, size - anchor);
+
+	return output;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Greedy LZ4 block compressor, the engine decodes its output with DecompressLz4Block from PakFormat.h
+std::vector<uint8_t> CompressLz4Block(const uint8_t * data, size_t size);
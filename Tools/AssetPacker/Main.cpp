@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#include "Lz4Compression.h"
+#include "PakFormat.h"
+
+namespace fs = std::experimental::filesystem;
+
+// Packs the data directory into one .pak the engine maps at startup instead of opening every file on its own
+
+struct PackedFile
+{
+	std::string path;
+	std::string name;
+	PakEntry entry;
+};
+
+// Compression only pays off when it saves at least this part of the file
+#define MIN_COMPRESSION_SAVING 8
+
+static bool ReadFile(std::string filename, std::vector<uint8_t> & data)
+{
+	FILE * file = fopen(filename.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	data.resize(ftell(file));
+	fseek(file, 0, SEEK_SET);
+
+	bool read = (fread(data.data(), 1, data.size(), file) == data.size());
+	fclose(file);
+
+	return read;
+}
+
+static void PadTo(FILE * file, uint64_t alignment)
+{
+	static const uint8_t zeros[PAK_ALIGNMENT] = {};
+
+	uint64_t position = (uint64_t)_ftelli64(file);
+	uint64_t padding = (alignment - position % alignment) % alignment;
+	fwrite(zeros, 1, (size_t)padding, file);
+}
+
+// Streamed textures read their levels in place for as long as they stream, so they're always stored
+static bool ShouldCompress(std::string path)
+{
+	std::string extension = fs::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+	return extension != ".rct";
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 3)
+	{
+		printf("Usage: AssetPacker <data directory> <output.pak> [-compress]\n");
+		printf("Run it from the directory the engine runs in, entries are named by their path from there (data/textures/...)\n");
+		return 1;
+	}
+
+	std::string dataDir = argv[1];
+	std::string output = argv[2];
+	bool compress = (argc > 3 && std::string(argv[3]) == "-compress");
+
+	if (!fs::is_directory(dataDir))
+	{
+		printf("ERROR: %s is not a directory\n", dataDir.c_str());
+		return 1;
+	}
+
+	// settings.cfg is read before the archive is mounted and stays editable next to it
+	std::vector<PackedFile> files;
+	for (auto & entry : fs::recursive_directory_iterator(dataDir))
+	{
+		if (!fs::is_regular_file(entry.path()) || entry.path().extension() == ".cfg")
+			continue;
+
+		PackedFile file;
+		file.path = entry.path().string();
+
+		// Named the way the loaders open them, relative to the working directory
+		char normalizedName[260];
+		NormalizePakName(file.path.c_str(), normalizedName, sizeof(normalizedName));
+		file.name = normalizedName;
+		while (file.name.compare(0, 2, "./") == 0)
+			file.name.erase(0, 2);
+
+		file.entry = {};
+		file.entry.nameHash = HashPakName(file.name.c_str());
+
+		files.push_back(file);
+	}
+
+	if (files.empty())
+	{
+		printf("ERROR: No files in %s\n", dataDir.c_str());
+		return 1;
+	}
+
+	// The engine binary searches the entries by hash
+	std::sort(files.begin(), files.end(), [](const PackedFile & a, const PackedFile & b)
+	{
+		if (a.entry.nameHash != b.entry.nameHash)
+			return a.entry.nameHash < b.entry.nameHash;
+		return a.name < b.name;
+	});
+
+	std::vector<char> names;
+	for (unsigned int i = 0; i < files.size(); i++)
+	{
+		files[i].entry.nameOffset = (uint32_t)names.size();
+		names.insert(names.end(), files[i].name.begin(), files[i].name.end());
+		names.push_back('\0');
+	}
+
+	PakHeader header;
+	header.magic = PAK_MAGIC;
+	header.version = PAK_VERSION;
+	header.entryCount = (uint32_t)files.size();
+	header.namesSize = (uint32_t)names.size();
+
+	FILE * pak = fopen(output.c_str(), "wb");
+	if (pak == NULL)
+	{
+		printf("ERROR: Couldn't write %s\n", output.c_str());
+		return 1;
+	}
+
+	// The table is written again once every entry's offset and size are known
+	std::vector<PakEntry> entries(files.size());
+	fwrite(&header, sizeof(PakHeader), 1, pak);
+	fwrite(entries.data(), sizeof(PakEntry), entries.size(), pak);
+	fwrite(names.data(), 1, names.size(), pak);
+
+	size_t inputBytes = 0, storedBytes = 0;
+	unsigned int compressedCount = 0;
+	bool success = true;
+
+	for (unsigned int i = 0; i < files.size(); i++)
+	{
+		std::vector<uint8_t> data;
+		if (!ReadFile(files[i].path, data))
+		{
+			printf("ERROR: Couldn't read %s\n", files[i].path.c_str());
+			success = false;
+			break;
+		}
+
+		PakEntry & entry = files[i].entry;
+		entry.size = data.size();
+		entry.storedSize = data.size();
+		entry.flags = 0;
+
+		const uint8_t * stored = data.data();
+		std::vector<uint8_t> compressed;
+		if (compress && ShouldCompress(files[i].path) && !data.empty())
+		{
+			compressed = CompressLz4Block(data.data(), data.size());
+
+			// Checked here so a bad block never ships
+			std::vector<uint8_t> decompressed(data.size());
+			bool valid = DecompressLz4Block(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) &&
+				decompressed == data;
+
+			if (valid && compressed.size() <= data.size() - data.size() / MIN_COMPRESSION_SAVING)
+			{
+				stored = compressed.data();
+				entry.storedSize = compressed.size();
+				entry.flags |= PAK_ENTRY_COMPRESSED;
+				compressedCount++;
+			}
+		}
+
+		PadTo(pak, PAK_ALIGNMENT);
+		entry.offset = (uint64_t)_ftelli64(pak);
+		fwrite(stored, 1, (size_t)entry.storedSize, pak);
+
+		entries[i] = entry;
+		inputBytes += (size_t)entry.size;
+		storedBytes += (size_t)entry.storedSize;
+
+		if (entry.flags & PAK_ENTRY_COMPRESSED)
+			printf("%s: %.1f KB -> %.1f KB\n", files[i].name.c_str(), entry.size / 1024.0f, entry.storedSize / 1024.0f);
+		else
+			printf("%s: %.1f KB\n", files[i].name.c_str(), entry.size / 1024.0f);
+	}
+
+	if (success)
+	{
+		_fseeki64(pak, sizeof(PakHeader), SEEK_SET);
+		fwrite(entries.data(), sizeof(PakEntry), entries.size(), pak);
+	}
+
+	fclose(pak);
+
+	if (!success)
+	{
+		remove(output.c_str());
+		return 1;
+	}
+
+	printf("Packed %zu files (%u compressed): %.2f MB -> %.2f MB\n", files.size(), compressedCount, inputBytes / (1024.0f * 1024.0f),
+		storedBytes / (1024.0f * 1024.0f));
+
+	return 0;
+}
@@ -0,0 +1,735 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
+
+#include "MeshFormat.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+namespace fs = std::experimental::filesystem;
+
+// Converts version 1 .rcm/.rcs files and their .mat, or older version 2 and 3 ones, into the current layout the engine maps and
+// stages from directly, with 16 bit indices for every mesh they can address. Static meshes get simplified levels of detail, every
+// level's triangles and the vertices are reordered for the vertex cache, overdraw and vertex fetch. -quantize also rewrites the
+// vertices in the quantized layout
+
+// Meshes with fewer triangles keep full detail only
+#define LOD_MIN_TRIANGLES 64
+
+// A level has to get down to this part of the one before, else the simplifier got stuck and the ones after are dropped
+#define LOD_MIN_REDUCTION 0.8f
+
+struct ConvertedMesh
+{
+	std::vector<uint8_t> vertices;
+	std::vector<uint8_t> indices;
+	MeshFileEntry entry;
+};
+
+// Bounds checked reader over the whole input file
+class InputFile
+{
+	private:
+		std::vector<uint8_t> data;
+		size_t position;
+	public:
+		bool Open(std::string filename)
+		{
+			FILE * file = fopen(filename.c_str(), "rb");
+			if (file == NULL)
+				return false;
+
+			fseek(file, 0, SEEK_END);
+			data.resize(ftell(file));
+			fseek(file, 0, SEEK_SET);
+
+			bool read = (fread(data.data(), 1, data.size(), file) == data.size());
+			fclose(file);
+
+			position = 0;
+			return read;
+		}
+
+		bool Read(void * dest, size_t size)
+		{
+			if (size > data.size() - position)
+				return false;
+
+			memcpy(dest, data.data() + position, size);
+			position += size;
+			return true;
+		}
+
+		bool Read(std::vector<uint8_t> & dest, size_t size)
+		{
+			if (size > data.size() - position)
+				return false;
+
+			dest.assign(data.begin() + position, data.begin() + position + size);
+			position += size;
+			return true;
+		}
+
+		const uint8_t * GetData()
+		{
+			return data.data();
+		}
+
+		size_t GetSize()
+		{
+			return data.size();
+		}
+
+		bool IsVersion2(uint32_t magic)
+		{
+			uint32_t fileMagic = 0;
+			if (data.size() >= sizeof(uint32_t))
+				memcpy(&fileMagic, data.data(), sizeof(uint32_t));
+
+			return fileMagic == magic;
+		}
+};
+
+static bool SetName(char * dest, const std::string & name)
+{
+	// Names fill the whole field at most, the engine doesn't need the terminator then
+	if (name.size() > MESH_NAME_SIZE)
+		return false;
+
+	memset(dest, 0, MESH_NAME_SIZE);
+	memcpy(dest, name.data(), name.size());
+	return true;
+}
+
+static std::string GetName(const char * name)
+{
+	size_t length = 0;
+	while (length < MESH_NAME_SIZE && name[length] != '\0')
+		length++;
+
+	return std::string(name, length);
+}
+
+static void PadTo(FILE * file, uint64_t alignment)
+{
+	static const uint8_t zeros[MESH_BLOB_ALIGNMENT] = {};
+
+	uint64_t position = (uint64_t)_ftelli64(file);
+	uint64_t padding = (alignment - position % alignment) % alignment;
+	fwrite(zeros, 1, (size_t)padding, file);
+}
+
+static bool ReadVersion1(fs::path path, InputFile & input, MeshFileHeader & header, std::vector<ConvertedMesh> & meshes,
+	std::vector<MeshFileBone> & bones)
+{
+	bool skinned = (path.extension() == ".rcs");
+	uint32_t magic = (skinned ? RCS_MAGIC : RCM_MAGIC);
+	uint32_t vertexSize = (skinned ? RCS_VERTEX_SIZE : RCM_VERTEX_SIZE);
+
+	header = {};
+	header.magic = magic;
+	header.version = MESH_FORMAT_VERSION;
+	header.vertexSize = vertexSize;
+
+	// Every mesh takes at least its counts and texture names
+	if (!input.Read(&header.meshCount, sizeof(uint32_t)) || (!skinned && !input.Read(&header.frustumCullRadius, sizeof(float))) ||
+		header.meshCount > input.GetSize() / (2 * sizeof(uint32_t) + 2 * MESH_NAME_SIZE))
+	{
+		printf("ERROR: %s is corrupted\n", path.string().c_str());
+		return false;
+	}
+
+	meshes.resize(header.meshCount);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		MeshFileEntry & entry = meshes[i].entry;
+		entry = {};
+		entry.indexSize = sizeof(uint32_t);
+
+		if (!input.Read(&entry.vertexCount, sizeof(uint32_t)) || !input.Read(&entry.indexCount, sizeof(uint32_t)) ||
+			!input.Read(meshes[i].vertices, (size_t)entry.vertexCount * vertexSize) ||
+			!input.Read(meshes[i].indices, (size_t)entry.indexCount * sizeof(uint32_t)) ||
+			!input.Read(entry.diffuseTexture, MESH_NAME_SIZE) || !input.Read(entry.normalTexture, MESH_NAME_SIZE))
+		{
+			printf("ERROR: %s is corrupted\n", path.string().c_str());
+			return false;
+		}
+
+		// Cleared past the terminator, version 1 left whatever was in memory there
+		if (!SetName(entry.diffuseTexture, GetName(entry.diffuseTexture)) || !SetName(entry.normalTexture, GetName(entry.normalTexture)))
+			return false;
+
+		SetFullDetailLod(entry);
+	}
+
+	if (skinned)
+	{
+		uint32_t boneCount;
+		if (!input.Read(&boneCount, sizeof(uint32_t)) || boneCount > input.GetSize() / sizeof(bones[0].offset))
+		{
+			printf("ERROR: %s is corrupted\n", path.string().c_str());
+			return false;
+		}
+
+		bones.resize(boneCount);
+		for (unsigned int i = 0; i < boneCount; i++)
+		{
+			bones[i] = {};
+			if (!input.Read(bones[i].offset, sizeof(bones[i].offset)))
+			{
+				printf("ERROR: %s is corrupted\n", path.string().c_str());
+				return false;
+			}
+		}
+
+		for (unsigned int i = 0; i < boneCount; i++)
+		{
+			uint32_t nameSize;
+			std::vector<uint8_t> name;
+			if (!input.Read(&nameSize, sizeof(uint32_t)) || !input.Read(name, nameSize) || !input.Read(&bones[i].id, sizeof(uint32_t)))
+			{
+				printf("ERROR: %s is corrupted\n", path.string().c_str());
+				return false;
+			}
+
+			if (!SetName(bones[i].name, std::string(name.begin(), name.end())))
+			{
+				printf("ERROR: %s: bone name longer than %d characters\n", path.string().c_str(), MESH_NAME_SIZE);
+				return false;
+			}
+		}
+
+		header.boneCount = boneCount;
+	}
+
+	// One line per mesh in the .mat: name, material texture, metallic and roughness offset
+	fs::path matPath = path;
+	matPath.replace_extension(".mat");
+
+	InputFile matInput;
+	if (!matInput.Open(matPath.string()))
+	{
+		printf("ERROR: Couldn't read %s\n", matPath.string().c_str());
+		return false;
+	}
+
+	std::vector<uint8_t> matText;
+	matInput.Read(matText, matInput.GetSize());
+	std::istringstream matFile(std::string(matText.begin(), matText.end()));
+
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		std::string matName, matTextureName = "NONE";
+		float metallicOffset = 0.0f, roughnessOffset = 0.0f;
+		matFile >> matName >> matTextureName >> metallicOffset >> roughnessOffset;
+
+		if (!SetName(meshes[i].entry.materialTexture, matTextureName))
+		{
+			printf("ERROR: %s: texture name longer than %d characters\n", matPath.string().c_str(), MESH_NAME_SIZE);
+			return false;
+		}
+		meshes[i].entry.metallicOffset = metallicOffset;
+		meshes[i].entry.roughnessOffset = roughnessOffset;
+	}
+
+	return true;
+}
+
+static bool ReadVersion2(fs::path path, InputFile & input, MeshFileHeader & header, std::vector<ConvertedMesh> & meshes,
+	std::vector<MeshFileBone> & bones)
+{
+	const uint8_t * data = input.GetData();
+	size_t size = input.GetSize();
+
+	if (size < sizeof(MeshFileHeader))
+	{
+		printf("ERROR: %s is corrupted\n", path.string().c_str());
+		return false;
+	}
+	memcpy(&header, data, sizeof(MeshFileHeader));
+
+	size_t entrySize = GetMeshEntrySize(header.version);
+	if (header.version < 2 || header.version > MESH_FORMAT_VERSION || (size - sizeof(MeshFileHeader)) / entrySize < header.meshCount)
+	{
+		printf("ERROR: %s is corrupted\n", path.string().c_str());
+		return false;
+	}
+
+	// Blobs are copied out, the offsets are assigned again when the file is written
+	meshes.resize(header.meshCount);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		MeshFileEntry & entry = meshes[i].entry;
+		entry = {};
+		entry.indexSize = sizeof(uint32_t);
+		memcpy(&entry, data + sizeof(MeshFileHeader) + i * entrySize, entrySize);
+
+		if (header.version < MESH_FORMAT_VERSION)
+			SetFullDetailLod(entry);
+
+		if (entry.indexSize != sizeof(uint32_t) && entry.indexSize != sizeof(uint16_t))
+		{
+			printf("ERROR: %s is corrupted\n", path.string().c_str());
+			return false;
+		}
+
+		bool validLods = (entry.lodCount > 0 && entry.lodCount <= MESH_MAX_LODS);
+		for (uint32_t j = 0; j < entry.lodCount && validLods; j++)
+			validLods = (entry.lods[j].firstIndex <= entry.indexCount && entry.lods[j].indexCount <= entry.indexCount - entry.lods[j].firstIndex);
+		if (!validLods)
+		{
+			printf("ERROR: %s is corrupted\n", path.string().c_str());
+			return false;
+		}
+
+		uint64_t vertexBytes = (uint64_t)entry.vertexCount * header.vertexSize;
+		uint64_t indexBytes = (uint64_t)entry.indexCount * entry.indexSize;
+		if (entry.vertexOffset > size || vertexBytes > size - entry.vertexOffset || entry.indexOffset > size || indexBytes > size - entry.indexOffset)
+		{
+			printf("ERROR: %s is corrupted\n", path.string().c_str());
+			return false;
+		}
+
+		meshes[i].vertices.assign(data + entry.vertexOffset, data + entry.vertexOffset + vertexBytes);
+		meshes[i].indices.assign(data + entry.indexOffset, data + entry.indexOffset + indexBytes);
+	}
+
+	if (header.boneCount > 0)
+	{
+		if (header.boneTableOffset > size || (size - header.boneTableOffset) / sizeof(MeshFileBone) < header.boneCount)
+		{
+			printf("ERROR: %s is corrupted\n", path.string().c_str());
+			return false;
+		}
+
+		bones.resize(header.boneCount);
+		memcpy(bones.data(), data + header.boneTableOffset, bones.size() * sizeof(MeshFileBone));
+	}
+
+	return true;
+}
+
+static float GetAngle(const float a[3], const float b[3])
+{
+	float lengths = sqrtf((a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) * (b[0] * b[0] + b[1] * b[1] + b[2] * b[2]));
+	if (lengths == 0.0f)
+		return 0.0f;
+
+	float cosAngle = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / lengths;
+	cosAngle = (cosAngle < -1.0f ? -1.0f : (cosAngle > 1.0f ? 1.0f : cosAngle));
+
+	return acosf(cosAngle) * 360.0f / MESH_TWO_PI;
+}
+
+static bool QuantizeMeshes(fs::path path, MeshFileHeader & header, std::vector<ConvertedMesh> & meshes, float & maxNormalError)
+{
+	bool skinned = (path.extension() == ".rcs");
+
+	maxNormalError = 0.0f;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		uint32_t vertexCount = meshes[i].entry.vertexCount;
+		std::vector<uint8_t> quantized;
+
+		if (skinned)
+		{
+			quantized.resize((size_t)vertexCount * sizeof(MeshFileQuantizedSkinnedVertex));
+
+			const MeshFileSkinnedVertex * vertices = (const MeshFileSkinnedVertex*)meshes[i].vertices.data();
+			MeshFileQuantizedSkinnedVertex * quantizedVertices = (MeshFileQuantizedSkinnedVertex*)quantized.data();
+			for (uint32_t j = 0; j < vertexCount; j++)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					if (vertices[j].boneIDs[k] >= MESH_QUANTIZED_MAX_BONES)
+					{
+						printf("ERROR: %s: bone id %u doesn't fit the quantized layout\n", path.string().c_str(), vertices[j].boneIDs[k]);
+						return false;
+					}
+				}
+
+				QuantizeSkinnedVertex(vertices[j], quantizedVertices[j]);
+
+				MeshFileSkinnedVertex expanded;
+				ExpandSkinnedVertex(quantizedVertices[j], expanded);
+
+				float normal[3] = { vertices[j].nx, vertices[j].ny, vertices[j].nz };
+				float expandedNormal[3] = { expanded.nx, expanded.ny, expanded.nz };
+				maxNormalError = std::max(maxNormalError, GetAngle(normal, expandedNormal));
+			}
+		}
+		else
+		{
+			quantized.resize((size_t)vertexCount * sizeof(MeshFileQuantizedVertex));
+
+			const MeshFileVertex * vertices = (const MeshFileVertex*)meshes[i].vertices.data();
+			MeshFileQuantizedVertex * quantizedVertices = (MeshFileQuantizedVertex*)quantized.data();
+			for (uint32_t j = 0; j < vertexCount; j++)
+			{
+				QuantizeVertex(vertices[j], quantizedVertices[j]);
+
+				MeshFileVertex expanded;
+				ExpandVertex(quantizedVertices[j], expanded);
+
+				float normal[3] = { vertices[j].nx, vertices[j].ny, vertices[j].nz };
+				float expandedNormal[3] = { expanded.nx, expanded.ny, expanded.nz };
+				maxNormalError = std::max(maxNormalError, GetAngle(normal, expandedNormal));
+			}
+		}
+
+		meshes[i].vertices.swap(quantized);
+	}
+
+	header.vertexSize = (skinned ? RCS_QUANTIZED_VERTEX_SIZE : RCM_QUANTIZED_VERTEX_SIZE);
+
+	return true;
+}
+
+static void WidenMeshIndices(std::vector<ConvertedMesh> & meshes)
+{
+	// Everything before writing works on 32 bit indices
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		MeshFileEntry & entry = meshes[i].entry;
+		if (entry.indexSize == sizeof(uint32_t))
+			continue;
+
+		std::vector<uint8_t> indices((size_t)entry.indexCount * sizeof(uint32_t));
+		const uint16_t * shortIndices = (const uint16_t*)meshes[i].indices.data();
+		for (uint32_t j = 0; j < entry.indexCount; j++)
+			((uint32_t*)indices.data())[j] = shortIndices[j];
+
+		meshes[i].indices.swap(indices);
+		entry.indexSize = sizeof(uint32_t);
+	}
+}
+
+static void GenerateLods(MeshFileHeader & header, std::vector<ConvertedMesh> & meshes)
+{
+	float maxErrors[MESH_MAX_LODS] = {};
+	bool simplified = false;
+
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		MeshFileEntry & entry = meshes[i].entry;
+
+		// Files that already have levels keep them, a partial triangle at the end can't be simplified
+		if (entry.lodCount > 1 || entry.indexCount % 3 != 0 || entry.indexCount / 3 < LOD_MIN_TRIANGLES)
+			continue;
+
+		std::vector<uint32_t> indices((const uint32_t*)meshes[i].indices.data(), (const uint32_t*)meshes[i].indices.data() + entry.indexCount);
+		std::vector<uint32_t> lodIndices(entry.indexCount);
+
+		// Every level has half the triangles of the one before, simplified from full detail so the errors don't add up
+		size_t previousIndexCount = entry.indexCount;
+		for (uint32_t lod = 1; lod < MESH_MAX_LODS; lod++)
+		{
+			size_t targetIndexCount = (entry.indexCount >> lod) / 3 * 3;
+
+			float error;
+			size_t lodIndexCount = SimplifyMesh(lodIndices.data(), (const uint32_t*)meshes[i].indices.data(), entry.indexCount,
+				meshes[i].vertices.data(), entry.vertexCount, header.vertexSize, targetIndexCount, error);
+			if (lodIndexCount == 0 || (float)lodIndexCount > (float)previousIndexCount * LOD_MIN_REDUCTION)
+				break;
+
+			entry.lods[lod].firstIndex = (uint32_t)indices.size();
+			entry.lods[lod].indexCount = (uint32_t)lodIndexCount;
+			entry.lodCount = lod + 1;
+			indices.insert(indices.end(), lodIndices.begin(), lodIndices.begin() + lodIndexCount);
+
+			maxErrors[lod] = std::max(maxErrors[lod], error);
+			previousIndexCount = lodIndexCount;
+			simplified = true;
+		}
+
+		entry.indexCount = (uint32_t)indices.size();
+		meshes[i].indices.assign((const uint8_t*)indices.data(), (const uint8_t*)(indices.data() + indices.size()));
+	}
+
+	// Meshes without a level draw their coarsest one in its place
+	printf("  LOD triangles");
+	for (uint32_t lod = 0; lod < MESH_MAX_LODS; lod++)
+	{
+		size_t triangleCount = 0;
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			triangleCount += meshes[i].entry.lods[std::min(lod, meshes[i].entry.lodCount - 1)].indexCount / 3;
+		printf("%s%zu", (lod == 0 ? " " : " / "), triangleCount);
+	}
+	if (simplified)
+	{
+		printf(", max error");
+		for (uint32_t lod = 1; lod < MESH_MAX_LODS; lod++)
+			printf("%s%f", (lod == 1 ? " " : " / "), maxErrors[lod]);
+	}
+	printf("\n");
+}
+
+static bool OptimizeMeshes(fs::path path, MeshFileHeader & header, std::vector<ConvertedMesh> & meshes)
+{
+	size_t triangleCount = 0;
+	size_t vertexCounts[2] = {};
+	float misses[2] = {};
+
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		MeshFileEntry & entry = meshes[i].entry;
+		uint32_t * indices = (uint32_t*)meshes[i].indices.data();
+
+		for (uint32_t j = 0; j < entry.indexCount; j++)
+		{
+			if (indices[j] >= entry.vertexCount)
+			{
+				printf("ERROR: %s: index %u out of range\n", path.string().c_str(), indices[j]);
+				return false;
+			}
+		}
+
+		// Only whole triangles are reordered, a partial one at the end stays where it is. The statistics are full detail's
+		size_t optimizedIndexCount = entry.lods[0].indexCount - entry.lods[0].indexCount % 3;
+		uint32_t vertexCount = entry.vertexCount;
+
+		VertexCacheStatistics before = AnalyzeVertexCache(indices + entry.lods[0].firstIndex, optimizedIndexCount, entry.vertexCount);
+
+		for (uint32_t j = 0; j < entry.lodCount; j++)
+		{
+			uint32_t * lodIndices = indices + entry.lods[j].firstIndex;
+			size_t lodIndexCount = entry.lods[j].indexCount - entry.lods[j].indexCount % 3;
+
+			OptimizeVertexCache(lodIndices, lodIndexCount, entry.vertexCount);
+			OptimizeOverdraw(lodIndices, lodIndexCount, meshes[i].vertices.data(), entry.vertexCount, header.vertexSize, OVERDRAW_ACMR_THRESHOLD);
+		}
+
+		// Unused vertices are dropped, unless the partial triangle still points at them. The levels only use full detail's vertices,
+		// so those keep the order full detail gives them
+		if (optimizedIndexCount == entry.lods[0].indexCount)
+		{
+			entry.vertexCount = (uint32_t)OptimizeVertexFetch(meshes[i].vertices.data(), indices, entry.indexCount, entry.vertexCount,
+				header.vertexSize);
+			meshes[i].vertices.resize((size_t)entry.vertexCount * header.vertexSize);
+		}
+
+		VertexCacheStatistics after = AnalyzeVertexCache(indices + entry.lods[0].firstIndex, optimizedIndexCount, entry.vertexCount);
+
+		triangleCount += optimizedIndexCount / 3;
+		vertexCounts[0] += vertexCount;
+		vertexCounts[1] += entry.vertexCount;
+		misses[0] += before.acmr * (optimizedIndexCount / 3);
+		misses[1] += after.acmr * (optimizedIndexCount / 3);
+	}
+
+	if (triangleCount > 0)
+		printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", misses[0] / triangleCount, misses[1] / triangleCount,
+			misses[0] / vertexCounts[0], misses[1] / vertexCounts[1]);
+
+	return true;
+}
+
+static void NarrowMeshIndices(std::vector<ConvertedMesh> & meshes)
+{
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		MeshFileEntry & entry = meshes[i].entry;
+		if (GetMeshIndexSize(entry.vertexCount) >= entry.indexSize)
+			continue;
+
+		std::vector<uint8_t> shortIndices((size_t)entry.indexCount * sizeof(uint16_t));
+		NarrowIndices((const uint32_t*)meshes[i].indices.data(), entry.indexCount, (uint16_t*)shortIndices.data());
+
+		meshes[i].indices.swap(shortIndices);
+		entry.indexSize = sizeof(uint16_t);
+	}
+}
+
+static size_t GetVertexDataSize(const std::vector<ConvertedMesh> & meshes)
+{
+	size_t size = 0;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		size += meshes[i].vertices.size();
+
+	return size;
+}
+
+static size_t GetIndexDataSize(const std::vector<ConvertedMesh> & meshes)
+{
+	size_t size = 0;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		size += meshes[i].indices.size();
+
+	return size;
+}
+
+static bool ConvertFile(fs::path path, bool quantize, bool optimize, bool generateLods)
+{
+	bool skinned = (path.extension() == ".rcs");
+	uint32_t magic = (skinned ? RCS_MAGIC : RCM_MAGIC);
+	uint32_t quantizedSize = (skinned ? RCS_QUANTIZED_VERTEX_SIZE : RCM_QUANTIZED_VERTEX_SIZE);
+
+	InputFile input;
+	if (!input.Open(path.string()))
+	{
+		printf("ERROR: Couldn't read %s\n", path.string().c_str());
+		return false;
+	}
+
+	MeshFileHeader header;
+	std::vector<ConvertedMesh> meshes;
+	std::vector<MeshFileBone> bones;
+
+	if (input.IsVersion2(magic))
+	{
+		if (!ReadVersion2(path, input, header, meshes, bones))
+			return false;
+
+		bool quantized = (header.vertexSize == quantizedSize);
+		if (!quantized && header.vertexSize != (skinned ? RCS_VERTEX_SIZE : RCM_VERTEX_SIZE))
+		{
+			printf("ERROR: %s has an unknown vertex layout\n", path.string().c_str());
+			return false;
+		}
+
+		// Current version files already have their indices narrowed and their meshes optimized
+		if (header.version == MESH_FORMAT_VERSION && (!quantize || quantized))
+		{
+			printf("%s: already version %d%s\n", path.string().c_str(), MESH_FORMAT_VERSION, (quantized ? ", quantized" : ""));
+			return true;
+		}
+
+		quantize = quantize && !quantized;
+		header.version = MESH_FORMAT_VERSION;
+	}
+	else if (!ReadVersion1(path, input, header, meshes, bones))
+		return false;
+
+	size_t vertexDataSize = GetVertexDataSize(meshes);
+	size_t indexDataSize = GetIndexDataSize(meshes);
+	WidenMeshIndices(meshes);
+
+	printf("%s: %u meshes, %zu bones\n", path.string().c_str(), header.meshCount, bones.size());
+
+	float maxNormalError = 0.0f;
+	if (quantize && !QuantizeMeshes(path, header, meshes, maxNormalError))
+		return false;
+
+	// Skinned meshes are drawn at full detail, the player is the only one and always close
+	if (generateLods && !skinned)
+		GenerateLods(header, meshes);
+
+	if (optimize && !OptimizeMeshes(path, header, meshes))
+		return false;
+
+	NarrowMeshIndices(meshes);
+
+	// Written next to the original and swapped in once complete
+	fs::path tempPath = path;
+	tempPath += ".tmp";
+
+	FILE * output = fopen(tempPath.string().c_str(), "wb");
+	if (output == NULL)
+	{
+		printf("ERROR: Couldn't write %s\n", tempPath.string().c_str());
+		return false;
+	}
+
+	// The tables are written again once the blob offsets are known
+	fwrite(&header, sizeof(MeshFileHeader), 1, output);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		fwrite(&meshes[i].entry, sizeof(MeshFileEntry), 1, output);
+
+	if (!bones.empty())
+	{
+		PadTo(output, MESH_BLOB_ALIGNMENT);
+		header.boneTableOffset = (uint64_t)_ftelli64(output);
+		fwrite(bones.data(), sizeof(MeshFileBone), bones.size(), output);
+	}
+
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		PadTo(output, MESH_BLOB_ALIGNMENT);
+		meshes[i].entry.vertexOffset = (uint64_t)_ftelli64(output);
+		fwrite(meshes[i].vertices.data(), 1, meshes[i].vertices.size(), output);
+
+		PadTo(output, MESH_BLOB_ALIGNMENT);
+		meshes[i].entry.indexOffset = (uint64_t)_ftelli64(output);
+		fwrite(meshes[i].indices.data(), 1, meshes[i].indices.size(), output);
+	}
+
+	_fseeki64(output, 0, SEEK_SET);
+	fwrite(&header, sizeof(MeshFileHeader), 1, output);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		fwrite(&meshes[i].entry, sizeof(MeshFileEntry), 1, output);
+
+	bool written = (ferror(output) == 0);
+	fclose(output);
+
+	std::error_code error;
+	if (written)
+		fs::rename(tempPath, path, error);
+
+	if (!written || error)
+	{
+		printf("ERROR: Couldn't write %s\n", path.string().c_str());
+		fs::remove(tempPath, error);
+		return false;
+	}
+
+	if (quantize)
+		printf("  vertices %zu -> %zu bytes, max normal error %.3f degrees\n", vertexDataSize, GetVertexDataSize(meshes), maxNormalError);
+	printf("  indices %zu -> %zu bytes\n", indexDataSize, GetIndexDataSize(meshes));
+
+	return true;
+}
+
+int main(int argc, char ** argv)
+{
+	bool quantize = false;
+	bool optimize = true;
+	bool generateLods = true;
+	bool validOptions = (argc >= 2);
+	for (int i = 1; i < argc - 1; i++)
+	{
+		if (strcmp(argv[i], "-quantize") == 0)
+			quantize = true;
+		else if (strcmp(argv[i], "-nooptimize") == 0)
+			optimize = false;
+		else if (strcmp(argv[i], "-nolods") == 0)
+			generateLods = false;
+		else
+			validOptions = false;
+	}
+
+	if (!validOptions)
+	{
+		printf("Usage: MeshConverter [-quantize] [-nooptimize] [-nolods] <file.rcm/.rcs or directory>\n");
+		printf("Converts the files in place, the .mat files aren't read by the engine afterwards\n");
+		printf("-quantize writes the vertices in the quantized layout, the engine expands them again when its shaders lack it\n");
+		printf("-nooptimize keeps the triangle and vertex order, to compare against optimized files\n");
+		printf("-nolods writes full detail only, to compare the triangles drawn against files with levels of detail\n");
+		return 1;
+	}
+
+	fs::path input = argv[argc - 1];
+
+	std::vector<fs::path> files;
+	if (fs::is_directory(input))
+	{
+		for (auto & entry : fs::recursive_directory_iterator(input))
+			if (fs::is_regular_file(entry.path()) && (entry.path().extension() == ".rcm" || entry.path().extension() == ".rcs"))
+				files.push_back(entry.path());
+	}
+	else
+		files.push_back(input);
+
+	unsigned int failed = 0;
+	for (unsigned int i = 0; i < files.size(); i++)
+		if (!ConvertFile(files[i], quantize, optimize, generateLods))
+			failed++;
+
+	printf("Converted %zu files, %u failed\n", files.size() - failed, failed);
+
+	return (failed == 0 ? 0 : 1);
+}
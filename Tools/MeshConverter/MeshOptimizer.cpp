@@ -0,0 +1,358 @@
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "MeshOptimizer.h"
+
+// LRU cache the Forsyth scores are modeled on, the three most recent vertices score the same
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+#define NO_TRIANGLE UINT32_MAX
+
+// FIFO cache simulation, a timestamp per vertex tells if it's still among the last cacheSize misses
+class VertexCacheSimulation
+{
+	private:
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t cacheSize;
+	public:
+		VertexCacheSimulation(size_t vertexCount, uint32_t cacheSize)
+		{
+			timestamps.assign(vertexCount, 0);
+			this->cacheSize = cacheSize;
+			time = cacheSize + 1;
+		}
+
+		// Misses of the three vertices of a triangle
+		unsigned int AddTriangle(const uint32_t * triangle)
+		{
+			unsigned int misses = 0;
+			for (int i = 0; i < 3; i++)
+			{
+				if (time - timestamps[triangle[i]] > cacheSize)
+				{
+					timestamps[triangle[i]] = time++;
+					misses++;
+				}
+			}
+
+			return misses;
+		}
+
+		void Clear()
+		{
+			time += cacheSize + 1;
+		}
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t * indices, size_t indexCount, size_t vertexCount)
+{
+	VertexCacheStatistics statistics = {};
+	if (indexCount == 0 || vertexCount == 0)
+		return statistics;
+
+	VertexCacheSimulation cache(vertexCount, VERTEX_CACHE_ANALYSIS_SIZE);
+
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i += 3)
+		misses += cache.AddTriangle(indices + i);
+
+	statistics.acmr = (float)misses / (float)(indexCount / 3);
+	statistics.atvr = (float)misses / (float)vertexCount;
+
+	return statistics;
+}
+
+static float GetVertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	// Vertices no triangle needs anymore don't pull any in
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		else
+			score = powf(1.0f - (float)(cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+	}
+
+	// Vertices with few triangles left are finished first, so they don't stay behind alone
+	score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+void OptimizeVertexCache(uint32_t * indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles of every vertex, the ones still to be drawn are kept at the front of its range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		remaining[indices[i]]++;
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < vertexCount; i++)
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remaining[i];
+
+	std::vector<uint32_t> adjacency(indexCount);
+	std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indexCount; i++)
+		adjacency[adjacencyFill[indices[i]]++] = (uint32_t)(i / 3);
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		vertexScores[i] = GetVertexScore(-1, remaining[i]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	uint32_t bestTriangle = 0;
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		if (triangleScores[i] > triangleScores[bestTriangle])
+			bestTriangle = (uint32_t)i;
+	}
+
+	std::vector<uint32_t> output(indexCount);
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	size_t nextUnemitted = 0;
+
+	for (size_t outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++)
+	{
+		// Nothing in the cache leads anywhere, continue with the first triangle left in the input order
+		if (bestTriangle == NO_TRIANGLE)
+		{
+			while (emitted[nextUnemitted])
+				nextUnemitted++;
+			bestTriangle = (uint32_t)nextUnemitted;
+		}
+
+		const uint32_t * triangle = indices + (size_t)bestTriangle * 3;
+		memcpy(&output[outputTriangle * 3], triangle, 3 * sizeof(uint32_t));
+		emitted[bestTriangle] = true;
+
+		for (int i = 0; i < 3; i++)
+		{
+			uint32_t vertex = triangle[i];
+			uint32_t * vertexTriangles = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; j++)
+			{
+				if (vertexTriangles[j] == bestTriangle)
+				{
+					vertexTriangles[j] = vertexTriangles[remaining[vertex] - 1];
+					break;
+				}
+			}
+			remaining[vertex]--;
+		}
+
+		// The triangle's vertices move to the front, the three past the cache size drop out of it
+		unsigned int newCacheCount = 0;
+		for (int i = 0; i < 3; i++)
+			newCache[newCacheCount++] = triangle[i];
+		for (unsigned int i = 0; i < cacheCount; i++)
+			if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+				newCache[newCacheCount++] = cache[i];
+
+		for (unsigned int i = 0; i < newCacheCount; i++)
+		{
+			uint32_t vertex = newCache[i];
+			cachePositions[vertex] = (i < FORSYTH_CACHE_SIZE ? (int)i : -1);
+			vertexScores[vertex] = GetVertexScore(cachePositions[vertex], remaining[vertex]);
+		}
+
+		// Only the triangles around the cached vertices changed their score, the best of them is next
+		bestTriangle = NO_TRIANGLE;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < newCacheCount; i++)
+		{
+			uint32_t vertex = newCache[i];
+			const uint32_t * vertexTriangles = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; j++)
+			{
+				uint32_t candidate = vertexTriangles[j];
+				const uint32_t * candidateVertices = indices + (size_t)candidate * 3;
+				triangleScores[candidate] = vertexScores[candidateVertices[0]] + vertexScores[candidateVertices[1]] +
+					vertexScores[candidateVertices[2]];
+
+				if (triangleScores[candidate] > bestScore)
+				{
+					bestScore = triangleScores[candidate];
+					bestTriangle = candidate;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCacheCount, (unsigned int)FORSYTH_CACHE_SIZE);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+	}
+
+	memcpy(indices, output.data(), indexCount * sizeof(uint32_t));
+}
+
+struct OverdrawCluster
+{
+	size_t firstTriangle;
+	size_t triangleCount;
+	float sortKey;
+};
+
+static const float * GetPosition(const uint8_t * vertices, size_t vertexSize, uint32_t vertex)
+{
+	return (const float*)(vertices + (size_t)vertex * vertexSize);
+}
+
+void OptimizeOverdraw(uint32_t * indices, size_t indexCount, const uint8_t * vertices, size_t vertexCount, size_t vertexSize,
+	float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	// Hard boundaries where the cache optimized order starts over anyway, every vertex of the triangle misses
+	std::vector<size_t> hardBoundaries;
+	VertexCacheSimulation cache(vertexCount, VERTEX_CACHE_ANALYSIS_SIZE);
+	for (size_t i = 0; i < triangleCount; i++)
+		if (cache.AddTriangle(indices + i * 3) == 3 || i == 0)
+			hardBoundaries.push_back(i);
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries split them further wherever the part so far is within the threshold of the whole one's misses
+	std::vector<OverdrawCluster> clusters;
+	for (size_t i = 0; i + 1 < hardBoundaries.size(); i++)
+	{
+		size_t start = hardBoundaries[i];
+		size_t end = hardBoundaries[i + 1];
+
+		cache.Clear();
+		size_t misses = 0;
+		for (size_t j = start; j < end; j++)
+			misses += cache.AddTriangle(indices + j * 3);
+		float clusterThreshold = threshold * (float)misses / (float)(end - start);
+
+		cache.Clear();
+		size_t clusterStart = start;
+		size_t clusterMisses = 0;
+		for (size_t j = start; j < end; j++)
+		{
+			clusterMisses += cache.AddTriangle(indices + j * 3);
+
+			if (j + 1 == end || (float)clusterMisses / (float)(j + 1 - clusterStart) <= clusterThreshold)
+			{
+				OverdrawCluster cluster = { clusterStart, j + 1 - clusterStart, 0.0f };
+				clusters.push_back(cluster);
+
+				cache.Clear();
+				clusterStart = j + 1;
+				clusterMisses = 0;
+			}
+		}
+	}
+
+	// Area weighted centroid of the whole mesh
+	float meshCentroid[3] = {};
+	float meshArea = 0.0f;
+	std::vector<float> triangleData(triangleCount * 7);
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		const float * p0 = GetPosition(vertices, vertexSize, indices[i * 3]);
+		const float * p1 = GetPosition(vertices, vertexSize, indices[i * 3 + 1]);
+		const float * p2 = GetPosition(vertices, vertexSize, indices[i * 3 + 2]);
+
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+		// Cross product, twice the area in its length
+		float * data = &triangleData[i * 7];
+		data[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		data[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		data[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		data[3] = sqrtf(data[0] * data[0] + data[1] * data[1] + data[2] * data[2]);
+		for (int j = 0; j < 3; j++)
+			data[4 + j] = (p0[j] + p1[j] + p2[j]) / 3.0f;
+
+		for (int j = 0; j < 3; j++)
+			meshCentroid[j] += data[4 + j] * data[3];
+		meshArea += data[3];
+	}
+
+	if (meshArea > 0.0f)
+		for (int j = 0; j < 3; j++)
+			meshCentroid[j] /= meshArea;
+
+	// Clusters far out along the way they face are most likely to cover the others
+	for (unsigned int i = 0; i < clusters.size(); i++)
+	{
+		float normal[3] = {};
+		float centroid[3] = {};
+		float area = 0.0f;
+		for (size_t j = clusters[i].firstTriangle; j < clusters[i].firstTriangle + clusters[i].triangleCount; j++)
+		{
+			const float * data = &triangleData[j * 7];
+			for (int k = 0; k < 3; k++)
+			{
+				normal[k] += data[k];
+				centroid[k] += data[4 + k] * data[3];
+			}
+			area += data[3];
+		}
+
+		float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (area == 0.0f || normalLength == 0.0f)
+			continue;
+
+		clusters[i].sortKey = 0.0f;
+		for (int k = 0; k < 3; k++)
+			clusters[i].sortKey += (centroid[k] / area - meshCentroid[k]) * normal[k] / normalLength;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const OverdrawCluster & a, const OverdrawCluster & b)
+	{
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(indexCount);
+	for (unsigned int i = 0; i < clusters.size(); i++)
+		output.insert(output.end(), indices + clusters[i].firstTriangle * 3,
+			indices + (clusters[i].firstTriangle + clusters[i].triangleCount) * 3);
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t OptimizeVertexFetch(uint8_t * vertices, uint32_t * indices, size_t indexCount, size_t vertexCount, size_t vertexSize)
+{
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	std::vector<uint8_t> output(vertexCount * vertexSize);
+	uint32_t nextVertex = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t vertex = indices[i];
+		if (remap[vertex] == UINT32_MAX)
+		{
+			memcpy(&output[(size_t)nextVertex * vertexSize], vertices + (size_t)vertex * vertexSize, vertexSize);
+			remap[vertex] = nextVertex++;
+		}
+
+		indices[i] = remap[vertex];
+	}
+
+	memcpy(vertices, output.data(), (size_t)nextVertex * vertexSize);
+
+	return nextVertex;
+}
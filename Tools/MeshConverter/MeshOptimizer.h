@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Post-transform vertex cache the statistics are measured with, a FIFO about the size of the ones on current GPUs
+#define VERTEX_CACHE_ANALYSIS_SIZE 16
+
+// Clusters may be reordered for overdraw while they stay within this factor of the mesh's cache misses
+#define OVERDRAW_ACMR_THRESHOLD 1.05f
+
+// Average cache misses per triangle (ACMR, 0.5 at best) and per vertex (ATVR, 1.0 at best)
+struct VertexCacheStatistics
+{
+	float acmr;
+	float atvr;
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t * indices, size_t indexCount, size_t vertexCount);
+
+// Reorders the triangles for the post-transform vertex cache, Tom Forsyth's linear-speed optimizer
+void OptimizeVertexCache(uint32_t * indices, size_t indexCount, size_t vertexCount);
+
+// Splits the cache optimized order into clusters and draws the ones facing out of the mesh first, so they occlude the rest.
+// Positions are the first three floats of every vertex
+void OptimizeOverdraw(uint32_t * indices, size_t indexCount, const uint8_t * vertices, size_t vertexCount, size_t vertexSize,
+	float threshold);
+
+// Stores the vertices in the order the triangles first use them and drops unused ones, returns the new vertex count
+size_t OptimizeVertexFetch(uint8_t * vertices, uint32_t * indices, size_t indexCount, size_t vertexCount, size_t vertexSize);
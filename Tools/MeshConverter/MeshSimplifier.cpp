@@ -0,0 +1,454 @@
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "MeshSimplifier.h"
+
+enum VERTEX_KIND
+{
+	VERTEX_KIND_MANIFOLD,
+	VERTEX_KIND_BORDER,
+	VERTEX_KIND_LOCKED
+};
+
+// Sum of the squared distances to a set of planes, weighted by the area they came from
+struct Quadric
+{
+	double a00, a11, a22, a01, a02, a12;
+	double b0, b1, b2;
+	double c;
+	double weight;
+};
+
+struct Collapse
+{
+	uint32_t source;
+	uint32_t target;
+	double cost;
+};
+
+static const float * GetPosition(const uint8_t * vertices, size_t vertexSize, uint32_t vertex)
+{
+	return (const float*)(vertices + (size_t)vertex * vertexSize);
+}
+
+static void Cross(const float a[3], const float b[3], float result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float Dot(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void AddPlane(Quadric & quadric, const float normal[3], const float point[3], double weight)
+{
+	double n0 = normal[0], n1 = normal[1], n2 = normal[2];
+	double d = -(n0 * point[0] + n1 * point[1] + n2 * point[2]);
+
+	quadric.a00 += weight * n0 * n0;
+	quadric.a11 += weight * n1 * n1;
+	quadric.a22 += weight * n2 * n2;
+	quadric.a01 += weight * n0 * n1;
+	quadric.a02 += weight * n0 * n2;
+	quadric.a12 += weight * n1 * n2;
+	quadric.b0 += weight * n0 * d;
+	quadric.b1 += weight * n1 * d;
+	quadric.b2 += weight * n2 * d;
+	quadric.c += weight * d * d;
+	quadric.weight += weight;
+}
+
+static void AddQuadric(Quadric & quadric, const Quadric & other)
+{
+	quadric.a00 += other.a00;
+	quadric.a11 += other.a11;
+	quadric.a22 += other.a22;
+	quadric.a01 += other.a01;
+	quadric.a02 += other.a02;
+	quadric.a12 += other.a12;
+	quadric.b0 += other.b0;
+	quadric.b1 += other.b1;
+	quadric.b2 += other.b2;
+	quadric.c += other.c;
+	quadric.weight += other.weight;
+}
+
+// Mean squared distance of the point to the planes
+static double EvaluateQuadric(const Quadric & quadric, const float point[3])
+{
+	if (quadric.weight <= 0.0)
+		return 0.0;
+
+	double x = point[0], y = point[1], z = point[2];
+	double result = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z +
+		2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z) +
+		2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+
+	return fabs(result) / quadric.weight;
+}
+
+static uint64_t GetEdgeKey(uint32_t from, uint32_t to)
+{
+	return ((uint64_t)from << 32) | to;
+}
+
+size_t SimplifyMesh(uint32_t * destination, const uint32_t * indices, size_t indexCount, const uint8_t * vertices, size_t vertexCount,
+	size_t vertexSize, size_t targetIndexCount, float & error)
+{
+	error = 0.0f;
+
+	size_t triangleCount = indexCount / 3;
+	std::vector<uint32_t> triangles(indices, indices + triangleCount * 3);
+
+	// Vertices at the same position are wedges of one corner that only differ in their attributes, the first of them stands for
+	// the position
+	std::vector<uint32_t> sorted(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		sorted[i] = (uint32_t)i;
+	std::sort(sorted.begin(), sorted.end(), [vertices, vertexSize](uint32_t a, uint32_t b)
+	{
+		int order = memcmp(GetPosition(vertices, vertexSize, a), GetPosition(vertices, vertexSize, b), 3 * sizeof(float));
+		return order < 0 || (order == 0 && a < b);
+	});
+
+	std::vector<uint32_t> positionIds(vertexCount);
+	for (size_t i = 0; i < vertexCount; )
+	{
+		size_t end = i + 1;
+		while (end < vertexCount && memcmp(GetPosition(vertices, vertexSize, sorted[i]), GetPosition(vertices, vertexSize, sorted[end]),
+			3 * sizeof(float)) == 0)
+			end++;
+
+		for (size_t j = i; j < end; j++)
+			positionIds[sorted[j]] = sorted[i];
+		i = end;
+	}
+
+	// Half edges between vertices and between positions, a missing opposite marks a border or an attribute seam
+	std::unordered_map<uint64_t, uint32_t> vertexEdges;
+	std::unordered_map<uint64_t, uint32_t> positionEdges;
+	auto countEdges = [&]()
+	{
+		vertexEdges.clear();
+		positionEdges.clear();
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				uint32_t from = triangles[i * 3 + j];
+				uint32_t to = triangles[i * 3 + (j + 1) % 3];
+				vertexEdges[GetEdgeKey(from, to)]++;
+				positionEdges[GetEdgeKey(positionIds[from], positionIds[to])]++;
+			}
+		}
+	};
+
+	auto isBorderEdge = [&](uint32_t from, uint32_t to)
+	{
+		return positionEdges.find(GetEdgeKey(to, from)) == positionEdges.end();
+	};
+
+	countEdges();
+
+	// Every position gets the planes of the triangles around it, the borders and seams additional ones standing up from them
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		const float * p[3];
+		for (int j = 0; j < 3; j++)
+			p[j] = GetPosition(vertices, vertexSize, triangles[i * 3 + j]);
+
+		float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		float normal[3];
+		Cross(e1, e2, normal);
+
+		float length = sqrtf(Dot(normal, normal));
+		if (length == 0.0f)
+			continue;
+		for (int j = 0; j < 3; j++)
+			normal[j] /= length;
+
+		for (int j = 0; j < 3; j++)
+			AddPlane(quadrics[positionIds[triangles[i * 3 + j]]], normal, p[0], length * 0.5f);
+
+		for (int j = 0; j < 3; j++)
+		{
+			uint32_t from = triangles[i * 3 + j];
+			uint32_t to = triangles[i * 3 + (j + 1) % 3];
+			if (vertexEdges.find(GetEdgeKey(to, from)) != vertexEdges.end())
+				continue;
+
+			const float * a = p[j];
+			const float * b = p[(j + 1) % 3];
+			float edge[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float edgeNormal[3];
+			Cross(edge, normal, edgeNormal);
+
+			float edgeLength = sqrtf(Dot(edgeNormal, edgeNormal));
+			if (edgeLength == 0.0f)
+				continue;
+			for (int k = 0; k < 3; k++)
+				edgeNormal[k] /= edgeLength;
+
+			double weight = Dot(edge, edge) * SIMPLIFY_BORDER_WEIGHT;
+			AddPlane(quadrics[positionIds[from]], edgeNormal, a, weight);
+			AddPlane(quadrics[positionIds[to]], edgeNormal, a, weight);
+		}
+	}
+
+	std::vector<uint8_t> kinds(vertexCount);
+	std::vector<uint8_t> locked(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<std::pair<uint32_t, uint32_t>> wedgeTargets;
+	std::vector<uint32_t> sourceNeighbours, targetNeighbours;
+	double maxCost = 0.0;
+
+	// Each pass collapses the cheapest edges that don't touch each other, then the mesh is compacted and the costs found again
+	while (triangleCount * 3 > targetIndexCount)
+	{
+		// Vertices on more than one border loop or on edges shared by more than two triangles stay where they are
+		std::fill(kinds.begin(), kinds.end(), (uint8_t)VERTEX_KIND_MANIFOLD);
+		std::vector<uint8_t> borderEdgeCounts(vertexCount);
+		for (auto & edge : positionEdges)
+		{
+			uint32_t from = (uint32_t)(edge.first >> 32);
+			uint32_t to = (uint32_t)edge.first;
+			if (edge.second > 1)
+			{
+				kinds[from] = VERTEX_KIND_LOCKED;
+				kinds[to] = VERTEX_KIND_LOCKED;
+			}
+			else if (isBorderEdge(from, to))
+			{
+				borderEdgeCounts[from] = (uint8_t)std::min(borderEdgeCounts[from] + 1, 255);
+				borderEdgeCounts[to] = (uint8_t)std::min(borderEdgeCounts[to] + 1, 255);
+			}
+		}
+		for (size_t i = 0; i < vertexCount; i++)
+			if (kinds[i] != VERTEX_KIND_LOCKED && borderEdgeCounts[i] > 0)
+				kinds[i] = (borderEdgeCounts[i] == 2 ? VERTEX_KIND_BORDER : VERTEX_KIND_LOCKED);
+
+		// Triangles around every position
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacencyOffsets[positionIds[triangles[i]] + 1]++;
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		adjacency.resize(triangleCount * 3);
+		std::vector<uint32_t> adjacencyCounts(vertexCount);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			uint32_t position = positionIds[triangles[i]];
+			adjacency[adjacencyOffsets[position] + adjacencyCounts[position]++] = (uint32_t)(i / 3);
+		}
+
+		// Every edge once, collapsed in the cheaper of the directions its ends allow. Border vertices only move along the border
+		collapses.clear();
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				uint32_t a = positionIds[triangles[i * 3 + j]];
+				uint32_t b = positionIds[triangles[i * 3 + (j + 1) % 3]];
+				if (a > b && !isBorderEdge(a, b))
+					continue;
+
+				bool border = isBorderEdge(a, b) || isBorderEdge(b, a);
+				Collapse collapse = { 0, 0, -1.0 };
+				for (int k = 0; k < 2; k++)
+				{
+					uint32_t source = (k == 0 ? a : b);
+					uint32_t target = (k == 0 ? b : a);
+					if (kinds[source] == VERTEX_KIND_LOCKED || (kinds[source] == VERTEX_KIND_BORDER && !border))
+						continue;
+
+					double cost = EvaluateQuadric(quadrics[source], GetPosition(vertices, vertexSize, target));
+					if (collapse.cost < 0.0 || cost < collapse.cost)
+						collapse = { source, target, cost };
+				}
+
+				if (collapse.cost >= 0.0)
+					collapses.push_back(collapse);
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse & a, const Collapse & b)
+		{
+			return a.cost < b.cost;
+		});
+
+		// Half of what is left to remove per pass at most, the costs of the later collapses have changed by then
+		size_t removeCount = triangleCount - targetIndexCount / 3;
+		removeCount = std::max<size_t>((removeCount + 1) / 2, 1);
+
+		size_t removed = 0;
+		std::fill(locked.begin(), locked.end(), 0);
+		for (size_t i = 0; i < collapses.size() && removed < removeCount; i++)
+		{
+			uint32_t source = collapses[i].source;
+			uint32_t target = collapses[i].target;
+			if (locked[source] || locked[target])
+				continue;
+
+			// Every wedge of the source needs the wedge of the target it shares triangles with, anything else would tear a seam
+			wedgeTargets.clear();
+			sourceNeighbours.clear();
+			targetNeighbours.clear();
+			size_t sharedTriangles = 0;
+			bool valid = true;
+			for (uint32_t j = adjacencyOffsets[source]; j < adjacencyOffsets[source + 1] && valid; j++)
+			{
+				const uint32_t * triangle = &triangles[adjacency[j] * 3];
+				uint32_t wedge = UINT32_MAX, targetWedge = UINT32_MAX;
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t position = positionIds[triangle[k]];
+					if (position == source)
+						wedge = triangle[k];
+					else if (position == target)
+						targetWedge = triangle[k];
+					else
+						sourceNeighbours.push_back(position);
+				}
+
+				if (targetWedge == UINT32_MAX)
+					continue;
+				sharedTriangles++;
+
+				for (unsigned int k = 0; k < wedgeTargets.size(); k++)
+					if (wedgeTargets[k].first == wedge && wedgeTargets[k].second != targetWedge)
+						valid = false;
+				wedgeTargets.push_back(std::make_pair(wedge, targetWedge));
+			}
+
+			for (uint32_t j = adjacencyOffsets[source]; j < adjacencyOffsets[source + 1] && valid; j++)
+			{
+				const uint32_t * triangle = &triangles[adjacency[j] * 3];
+				for (int k = 0; k < 3; k++)
+				{
+					if (positionIds[triangle[k]] != source)
+						continue;
+
+					bool mapped = false;
+					for (unsigned int l = 0; l < wedgeTargets.size(); l++)
+						mapped = mapped || (wedgeTargets[l].first == triangle[k]);
+					valid = valid && mapped;
+				}
+			}
+
+			if (!valid || sharedTriangles == 0)
+				continue;
+
+			// Link condition, the ends may only have the neighbours in common that the shared triangles give them
+			for (uint32_t j = adjacencyOffsets[target]; j < adjacencyOffsets[target + 1]; j++)
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t position = positionIds[triangles[adjacency[j] * 3 + k]];
+					if (position != source && position != target)
+						targetNeighbours.push_back(position);
+				}
+
+			std::sort(sourceNeighbours.begin(), sourceNeighbours.end());
+			sourceNeighbours.erase(std::unique(sourceNeighbours.begin(), sourceNeighbours.end()), sourceNeighbours.end());
+			std::sort(targetNeighbours.begin(), targetNeighbours.end());
+			targetNeighbours.erase(std::unique(targetNeighbours.begin(), targetNeighbours.end()), targetNeighbours.end());
+
+			size_t commonNeighbours = 0;
+			for (unsigned int j = 0; j < sourceNeighbours.size(); j++)
+				if (std::binary_search(targetNeighbours.begin(), targetNeighbours.end(), sourceNeighbours[j]))
+					commonNeighbours++;
+			if (commonNeighbours != sharedTriangles)
+				continue;
+
+			// The triangles that stay must not fold over
+			const float * targetPosition = GetPosition(vertices, vertexSize, target);
+			for (uint32_t j = adjacencyOffsets[source]; j < adjacencyOffsets[source + 1] && valid; j++)
+			{
+				const uint32_t * triangle = &triangles[adjacency[j] * 3];
+				const float * p[3];
+				const float * moved[3];
+				bool shared = false;
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t position = positionIds[triangle[k]];
+					shared = shared || (position == target);
+					p[k] = GetPosition(vertices, vertexSize, position);
+					moved[k] = (position == source ? targetPosition : p[k]);
+				}
+
+				if (shared)
+					continue;
+
+				float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+				float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+				float m1[3] = { moved[1][0] - moved[0][0], moved[1][1] - moved[0][1], moved[1][2] - moved[0][2] };
+				float m2[3] = { moved[2][0] - moved[0][0], moved[2][1] - moved[0][1], moved[2][2] - moved[0][2] };
+				float normal[3], movedNormal[3];
+				Cross(e1, e2, normal);
+				Cross(m1, m2, movedNormal);
+
+				float lengths = sqrtf(Dot(normal, normal) * Dot(movedNormal, movedNormal));
+				if (Dot(normal, movedNormal) < SIMPLIFY_MAX_NORMAL_TURN * lengths)
+					valid = false;
+			}
+
+			if (!valid)
+				continue;
+
+			// Nothing around the collapse moves again this pass, the adjacency and the checks above stay exact
+			for (uint32_t j = adjacencyOffsets[source]; j < adjacencyOffsets[source + 1]; j++)
+			{
+				uint32_t * triangle = &triangles[adjacency[j] * 3];
+				for (int k = 0; k < 3; k++)
+				{
+					locked[positionIds[triangle[k]]] = 1;
+
+					for (unsigned int l = 0; l < wedgeTargets.size(); l++)
+						if (wedgeTargets[l].first == triangle[k])
+						{
+							triangle[k] = wedgeTargets[l].second;
+							break;
+						}
+				}
+			}
+
+			AddQuadric(quadrics[target], quadrics[source]);
+			maxCost = std::max(maxCost, collapses[i].cost);
+			removed += sharedTriangles;
+		}
+
+		if (removed == 0)
+			break;
+
+		// The triangles that lost a corner are dropped
+		size_t writeTriangle = 0;
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			uint32_t a = positionIds[triangles[i * 3]];
+			uint32_t b = positionIds[triangles[i * 3 + 1]];
+			uint32_t c = positionIds[triangles[i * 3 + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			memmove(&triangles[writeTriangle * 3], &triangles[i * 3], 3 * sizeof(uint32_t));
+			writeTriangle++;
+		}
+		triangleCount = writeTriangle;
+
+		countEdges();
+	}
+
+	memcpy(destination, triangles.data(), triangleCount * 3 * sizeof(uint32_t));
+	error = (float)sqrt(maxCost);
+
+	return triangleCount * 3;
+}
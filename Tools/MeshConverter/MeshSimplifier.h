@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Border and attribute seam edges are held in place by planes through them, weighted this much over the surface ones
+#define SIMPLIFY_BORDER_WEIGHT 10.0f
+
+// Normals of the triangles around a collapse may turn by about 75 degrees at most
+#define SIMPLIFY_MAX_NORMAL_TURN 0.25f
+
+// Quadric error edge collapse simplification (Garland and Heckbert) down to about targetIndexCount indices. Corners collapse onto
+// a neighbouring vertex, so the result indexes the same vertices, and only along attribute seams. Writes the indices to destination,
+// which holds indexCount of them, and returns how many there are. error is the largest distance moved, in model units.
+// Positions are the first three floats of every vertex
+size_t SimplifyMesh(uint32_t * destination, const uint32_t * indices, size_t indexCount, const uint8_t * vertices, size_t vertexCount,
+	size_t vertexSize, size_t targetIndexCount, float & error);
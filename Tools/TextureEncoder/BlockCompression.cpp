@@ -0,0 +1,345 @@
+#include <float.h>
+#include <string.h>
+#include <math.h>
+
+#include "BlockCompression.h"
+#include "RctFormat.h"
+
+// Writes a compressed block least significant bit first, the way BC7 blocks are laid out
+struct BitWriter
+{
+	uint8_t * data;
+	uint32_t position;
+
+	BitWriter(uint8_t * block) { data = block; position = 0; }
+
+	void Write(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; i++, position++)
+			if ((value >> i) & 1)
+				data[position >> 3] |= (uint8_t)(1 << (position & 7));
+	}
+};
+
+static float Clamp(float value, float min, float max)
+{
+	return (value < min ? min : (value > max ? max : value));
+}
+
+// Endpoints at both ends of the line through the texels with the most variance
+static void FindEndpoints(const uint8_t * texels, int channels, float * endpoint0, float * endpoint1)
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			mean[c] += texels[i * 4 + c];
+	for (int c = 0; c < channels; c++)
+		mean[c] /= 16.0f;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+
+	// Power iteration, a few steps are enough for 16 points
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float largest = 0.0f;
+		for (int a = 0; a < channels; a++)
+		{
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			largest = fmaxf(largest, fabsf(next[a]));
+		}
+
+		// Flat block, every texel is the mean
+		if (largest == 0.0f)
+			break;
+
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	float length = 0.0f;
+	for (int c = 0; c < channels; c++)
+		length += axis[c] * axis[c];
+	length = sqrtf(length);
+	for (int c = 0; c < channels; c++)
+		axis[c] /= length;
+
+	float minT = FLT_MAX, maxT = -FLT_MAX;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (texels[i * 4 + c] - mean[c]) * axis[c];
+		minT = fminf(minT, t);
+		maxT = fmaxf(maxT, t);
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		endpoint0[c] = (c < channels ? Clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f) : 255.0f);
+		endpoint1[c] = (c < channels ? Clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f) : 255.0f);
+	}
+}
+
+static uint16_t PackRGB565(const float * color)
+{
+	uint16_t r = (uint16_t)(color[0] * 31.0f / 255.0f + 0.5f);
+	uint16_t g = (uint16_t)(color[1] * 63.0f / 255.0f + 0.5f);
+	uint16_t b = (uint16_t)(color[2] * 31.0f / 255.0f + 0.5f);
+
+	return (r << 11) | (g << 5) | b;
+}
+
+static void UnpackRGB565(uint16_t packed, int * color)
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+void EncodeBC1(const uint8_t * texels, uint8_t * block)
+{
+	float endpoint0[4], endpoint1[4];
+	FindEndpoints(texels, 3, endpoint0, endpoint1);
+
+	// The first color has to be the bigger one, otherwise the block decodes in the 3 color mode
+	uint16_t color0 = PackRGB565(endpoint1);
+	uint16_t color1 = PackRGB565(endpoint0);
+	if (color0 < color1)
+	{
+		uint16_t swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		UnpackRGB565(color0, palette[0]);
+		UnpackRGB565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int bestIndex = 0, bestError = INT32_MAX;
+			for (int j = 0; j < 4; j++)
+			{
+				int error = 0;
+				for (int c = 0; c < 3; c++)
+					error += (texels[i * 4 + c] - palette[j][c]) * (texels[i * 4 + c] - palette[j][c]);
+
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = j;
+				}
+			}
+			indices |= bestIndex << (i * 2);
+		}
+	}
+
+	memcpy(block, &color0, 2);
+	memcpy(block + 2, &color1, 2);
+	memcpy(block + 4, &indices, 4);
+}
+
+void EncodeBC4(const uint8_t * texels, int channel, uint8_t * block)
+{
+	int minValue = 255, maxValue = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int value = texels[i * 4 + channel];
+		minValue = (value < minValue ? value : minValue);
+		maxValue = (value > maxValue ? value : maxValue);
+	}
+
+	// Bigger value first selects the 8 value mode, index 0 and 1 are the endpoints, 2 to 7 lie between them
+	uint64_t indices = 0;
+	if (maxValue > minValue)
+	{
+		int range = maxValue - minValue;
+		for (int i = 0; i < 16; i++)
+		{
+			int step = ((texels[i * 4 + channel] - minValue) * 14 + range) / (2 * range);
+			uint64_t index = (step == 7 ? 0 : (step == 0 ? 1 : 8 - step));
+			indices |= index << (i * 3);
+		}
+	}
+
+	block[0] = (uint8_t)maxValue;
+	block[1] = (uint8_t)minValue;
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+void EncodeBC3(const uint8_t * texels, uint8_t * block)
+{
+	// Alpha is stored like a BC4 block, the color block always decodes in the 4 color mode here
+	EncodeBC4(texels, 3, block);
+	EncodeBC1(texels, block + 8);
+}
+
+void EncodeBC5(const uint8_t * texels, uint8_t * block)
+{
+	EncodeBC4(texels, 0, block);
+	EncodeBC4(texels, 1, block + 8);
+}
+
+void EncodeBC7(const uint8_t * texels, uint8_t * block)
+{
+	// Mode 6 only: one subset, RGBA endpoints with 7 bits and a p bit each, 16 interpolation steps
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float endpoints[2][4];
+	FindEndpoints(texels, 4, endpoints[0], endpoints[1]);
+
+	// Try both p bits for each endpoint and keep the one closer to it
+	int quantized[2][4], pBits[2];
+	for (int e = 0; e < 2; e++)
+	{
+		float bestError = FLT_MAX;
+		for (int pBit = 0; pBit < 2; pBit++)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++)
+			{
+				candidate[c] = (int)Clamp((endpoints[e][c] - pBit) / 2.0f + 0.5f, 0.0f, 127.0f);
+				float difference = ((candidate[c] << 1) | pBit) - endpoints[e][c];
+				error += difference * difference;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pBits[e] = pBit;
+				memcpy(quantized[e], candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	int palette[16][4];
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int value0 = (quantized[0][c] << 1) | pBits[0];
+			int value1 = (quantized[1][c] << 1) | pBits[1];
+			palette[i][c] = ((64 - weights[i]) * value0 + weights[i] * value1 + 32) >> 6;
+		}
+	}
+
+	int indices[16];
+	for (int i = 0; i < 16; i++)
+	{
+		int bestError = INT32_MAX;
+		for (int j = 0; j < 16; j++)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; c++)
+				error += (texels[i * 4 + c] - palette[j][c]) * (texels[i * 4 + c] - palette[j][c]);
+
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = j;
+			}
+		}
+	}
+
+	// The first index is stored without its top bit, swapping the endpoints keeps it in the lower half
+	if (indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int swap = quantized[0][c];
+			quantized[0][c] = quantized[1][c];
+			quantized[1][c] = swap;
+		}
+
+		int swap = pBits[0];
+		pBits[0] = pBits[1];
+		pBits[1] = swap;
+
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(block, 0, 16);
+	BitWriter writer(block);
+	writer.Write(1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writer.Write(quantized[0][c], 7);
+		writer.Write(quantized[1][c], 7);
+	}
+	writer.Write(pBits[0], 1);
+	writer.Write(pBits[1], 1);
+	writer.Write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.Write(indices[i], 4);
+}
+
+std::vector<uint8_t> CompressLevel(uint32_t format, const uint8_t * rgba, uint32_t width, uint32_t height)
+{
+	uint32_t blockSize = GetRctBlockSize(format);
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+
+	std::vector<uint8_t> output(blocksX * blocksY * blockSize);
+
+	for (uint32_t by = 0; by < blocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			// Blocks over the edge repeat the last row and column
+			uint8_t texels[64];
+			for (uint32_t y = 0; y < 4; y++)
+			{
+				for (uint32_t x = 0; x < 4; x++)
+				{
+					uint32_t sourceX = (bx * 4 + x < width ? bx * 4 + x : width - 1);
+					uint32_t sourceY = (by * 4 + y < height ? by * 4 + y : height - 1);
+					memcpy(texels + (y * 4 + x) * 4, rgba + (sourceY * width + sourceX) * 4, 4);
+				}
+			}
+
+			uint8_t * block = &output[(by * blocksX + bx) * blockSize];
+			switch (format)
+			{
+				case RCT_FORMAT_BC1:
+					EncodeBC1(texels, block);
+					break;
+				case RCT_FORMAT_BC3:
+					EncodeBC3(texels, block);
+					break;
+				case RCT_FORMAT_BC4:
+					EncodeBC4(texels, 0, block);
+					break;
+				case RCT_FORMAT_BC5:
+					EncodeBC5(texels, block);
+					break;
+				case RCT_FORMAT_BC7:
+					EncodeBC7(texels, block);
+					break;
+			}
+		}
+	}
+
+	return output;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Every encoder takes a 4x4 block of RGBA8 texels, row by row, and writes one compressed block
+void EncodeBC1(const uint8_t * texels, uint8_t * block);
+void EncodeBC3(const uint8_t * texels, uint8_t * block);
+void EncodeBC4(const uint8_t * texels, int channel, uint8_t * block);
+void EncodeBC5(const uint8_t * texels, uint8_t * block);
+void EncodeBC7(const uint8_t * texels, uint8_t * block);
+
+// Compresses a whole RGBA8 mip level into the given RCT_FORMAT
+std::vector<uint8_t> CompressLevel(uint32_t format, const uint8_t * rgba, uint32_t width, uint32_t height);
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#include "BlockCompression.h"
+#include "RctFormat.h"
+
+namespace fs = std::experimental::filesystem;
+
+// Converts RGBA8 .rct textures into block compressed ones the engine uploads without decoding
+
+struct MipLevel
+{
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> data;
+};
+
+static const char * formatNames[RCT_FORMAT_COUNT] = { "rgba8", "bc1", "bc3", "bc4", "bc5", "bc7" };
+
+static bool ReadTexture(std::string filename, uint32_t * format, std::vector<MipLevel> & levels)
+{
+	FILE * file = fopen(filename.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	uint32_t value;
+	fread(&value, sizeof(uint32_t), 1, file);
+
+	// Encoded files start with the magic, older ones straight with the width
+	*format = RCT_FORMAT_RGBA8;
+	if (value == RCT_MAGIC)
+	{
+		fread(format, sizeof(uint32_t), 1, file);
+		fclose(file);
+		return true;
+	}
+	fseek(file, 0, SEEK_SET);
+
+	int32_t mipMapCount = 0;
+	for (int32_t i = 0; i <= mipMapCount; i++)
+	{
+		MipLevel level;
+		uint32_t size;
+		if (fread(&level.width, sizeof(uint32_t), 1, file) != 1 || fread(&level.height, sizeof(uint32_t), 1, file) != 1 ||
+			fread(&size, sizeof(uint32_t), 1, file) != 1 || size != level.width * level.height * 4)
+		{
+			fclose(file);
+			return false;
+		}
+
+		level.data.resize(size);
+		if (fread(level.data.data(), 1, size, file) != size)
+		{
+			fclose(file);
+			return false;
+		}
+		levels.push_back(level);
+
+		// The mipmap count comes after the original image
+		if (i == 0 && fread(&mipMapCount, sizeof(int32_t), 1, file) != 1)
+		{
+			fclose(file);
+			return false;
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+static bool WriteTexture(std::string filename, uint32_t format, const std::vector<MipLevel> & levels)
+{
+	FILE * file = fopen(filename.c_str(), "wb");
+	if (file == NULL)
+		return false;
+
+	uint32_t magic = RCT_MAGIC;
+	fwrite(&magic, sizeof(uint32_t), 1, file);
+	fwrite(&format, sizeof(uint32_t), 1, file);
+
+	for (unsigned int i = 0; i < levels.size(); i++)
+	{
+		uint32_t size = (uint32_t)levels[i].data.size();
+		fwrite(&levels[i].width, sizeof(uint32_t), 1, file);
+		fwrite(&levels[i].height, sizeof(uint32_t), 1, file);
+		fwrite(&size, sizeof(uint32_t), 1, file);
+		fwrite(levels[i].data.data(), 1, size, file);
+
+		if (i == 0)
+		{
+			int32_t mipMapCount = (int32_t)levels.size() - 1;
+			fwrite(&mipMapCount, sizeof(int32_t), 1, file);
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+// BC5 for normal maps, BC4 for material masks, BC7 for everything else
+static uint32_t PickFormat(std::string filename)
+{
+	std::string name = fs::path(filename).filename().string();
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	if (name.find("normal") != std::string::npos || name.find("_n.") != std::string::npos || name.find("_nrm") != std::string::npos)
+		return RCT_FORMAT_BC5;
+	if (name.find("material") != std::string::npos || name.find("mask") != std::string::npos || name.find("_m.") != std::string::npos)
+		return RCT_FORMAT_BC4;
+
+	return RCT_FORMAT_BC7;
+}
+
+static bool EncodeFile(std::string input, std::string output, int requestedFormat, size_t * inputBytes, size_t * outputBytes)
+{
+	uint32_t sourceFormat;
+	std::vector<MipLevel> levels;
+	if (!ReadTexture(input, &sourceFormat, levels))
+	{
+		printf("ERROR: %s is not a valid .rct file\n", input.c_str());
+		return false;
+	}
+
+	if (sourceFormat != RCT_FORMAT_RGBA8)
+	{
+		printf("%s: already %s, skipped\n", input.c_str(), formatNames[sourceFormat]);
+		return true;
+	}
+
+	uint32_t format = (requestedFormat < 0 ? PickFormat(input) : (uint32_t)requestedFormat);
+
+	size_t sourceSize = 0, encodedSize = 0;
+	for (unsigned int i = 0; i < levels.size(); i++)
+	{
+		sourceSize += levels[i].data.size();
+		if (format != RCT_FORMAT_RGBA8)
+			levels[i].data = CompressLevel(format, levels[i].data.data(), levels[i].width, levels[i].height);
+		encodedSize += levels[i].data.size();
+	}
+
+	if (!WriteTexture(output, format, levels))
+	{
+		printf("ERROR: Couldn't write %s\n", output.c_str());
+		return false;
+	}
+
+	printf("%s: %ux%u, %zu levels, %s, %.1f KB -> %.1f KB\n", input.c_str(), levels[0].width, levels[0].height, levels.size(),
+		formatNames[format], sourceSize / 1024.0f, encodedSize / 1024.0f);
+
+	*inputBytes += sourceSize;
+	*outputBytes += encodedSize;
+	return true;
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: TextureEncoder <file.rct or directory> [auto|rgba8|bc1|bc3|bc4|bc5|bc7] [output.rct]\n");
+		printf("Directories are converted in place, auto picks BC5 for normal maps, BC4 for material masks and BC7 for the rest\n");
+		return 1;
+	}
+
+	std::string input = argv[1];
+
+	int requestedFormat = -1;
+	if (argc > 2 && std::string(argv[2]) != "auto")
+	{
+		for (int i = 0; i < RCT_FORMAT_COUNT; i++)
+			if (std::string(argv[2]) == formatNames[i])
+				requestedFormat = i;
+
+		if (requestedFormat < 0)
+		{
+			printf("ERROR: Unknown format %s\n", argv[2]);
+			return 1;
+		}
+	}
+
+	size_t inputBytes = 0, outputBytes = 0;
+	bool success = true;
+
+	if (fs::is_directory(input))
+	{
+		for (auto & entry : fs::recursive_directory_iterator(input))
+			if (entry.path().extension() == ".rct")
+				success &= EncodeFile(entry.path().string(), entry.path().string(), requestedFormat, &inputBytes, &outputBytes);
+	}
+	else
+		success = EncodeFile(input, (argc > 3 ? argv[3] : input), requestedFormat, &inputBytes, &outputBytes);
+
+	if (outputBytes > 0)
+		printf("Total: %.2f MB -> %.2f MB (%.1fx smaller)\n", inputBytes / (1024.0f * 1024.0f), outputBytes / (1024.0f * 1024.0f),
+			(float)inputBytes / outputBytes);
+
+	return (success ? 0 : 1);
+}
\ No newline at end of file